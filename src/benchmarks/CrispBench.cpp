@@ -0,0 +1,188 @@
+// NOTE: performance regression suite over the shipped examples. Every example is measured in four phases:
+//   ColdStart      taping, code generation and compilation of its model library
+//   WarmLoad       construction of the problem from the already compiled library
+//   Solve          one solve from the initial guess of the example, SolveStage and SolveElastic with the stage-structured
+//                  QP backend (ordered by the stages the example sets) on the slack-augmented and on the elastic
+//                  subproblem, SolveLagrangian with the lagrangian hessian (hessianType = 1) for the examples whose
+//                  constraints carry second order information
+//   WarmSolve      repeated solves, each warm-started from the (slightly perturbed) previous solution
+// The solve phases report the SolverStats phase times as counters. Run for example
+//   ./crisp_bench --benchmark_out=crisp_bench.json --benchmark_out_format=json
+// and compare the json files of two releases with the compare.py tool of Google Benchmark.
+#include "ExampleProblems.h"
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+#include <functional>
+#include <memory>
+#include <random>
+
+using namespace CRISP;
+
+namespace {
+const std::string kModelFolder = "crisp_bench_model";          // libraries of the warm phases, compiled once
+const std::string kColdModelFolder = "crisp_bench_model_cold"; // removed before every cold start
+const unsigned kSeed = 2024;                                    // seed of the warm-start perturbation
+const scalar_t kWarmStartPerturbation = 1e-4;
+
+// QP backend, subproblem formulation and QP hessian of a solve benchmark
+struct SubproblemConfiguration {
+    scalar_t qpBackend;
+    scalar_t elasticMode;
+    scalar_t hessianType;
+};
+const SubproblemConfiguration kDefaultSubproblem = {0, 0, 0};
+const SubproblemConfiguration kStageSubproblem = {1, 0, 0};
+const SubproblemConfiguration kElasticSubproblem = {1, 1, 0};
+const SubproblemConfiguration kLagrangianSubproblem = {0, 0, 1};
+const std::vector<std::string> kSecondOrderExamples = {"hopper"}; // examples with SECOND_ORDER constraints
+
+// the problem of the warm phases, its library is compiled on first use (outside of any timed region)
+OptimizationProblem& loadedProblem(const ExampleProblem& problem) {
+    static std::unordered_map<std::string, std::unique_ptr<OptimizationProblem>> problems;
+    auto it = problems.find(problem.name);
+    if (it == problems.end()) {
+        it = problems.emplace(problem.name, std::make_unique<OptimizationProblem>(problem.create(kModelFolder, false))).first;
+    }
+    return *it->second;
+}
+
+void setupSolver(SolverInterface& solver, const ExampleProblem& problem, const vector_t& initialGuess,
+                 const SubproblemConfiguration& subproblem = kDefaultSubproblem) {
+    problem.setup(solver, initialGuess);
+    solver.setHyperParameters("verbose", vector_t::Constant(1, 0));
+    solver.setHyperParameters("collectStats", vector_t::Constant(1, 1));
+    solver.setHyperParameters("qpBackend", vector_t::Constant(1, subproblem.qpBackend));
+    solver.setHyperParameters("elasticMode", vector_t::Constant(1, subproblem.elasticMode));
+    solver.setHyperParameters("hessianType", vector_t::Constant(1, subproblem.hessianType));
+}
+
+void accumulateStats(SolverStats& sum, const SolverStats& stats) {
+    sum.evaluationTime += stats.evaluationTime;
+    sum.derivativeTime += stats.derivativeTime;
+    sum.subproblemTime += stats.subproblemTime;
+    sum.qpTime += stats.qpTime;
+    sum.meritTime += stats.meritTime;
+    sum.secondOrderCorrectionTime += stats.secondOrderCorrectionTime;
+    sum.totalTime += stats.totalTime;
+    sum.iterations += stats.iterations;
+    sum.acceptedSteps += stats.acceptedSteps;
+    sum.rejectedSteps += stats.rejectedSteps;
+    sum.secondOrderCorrections += stats.secondOrderCorrections;
+    sum.penaltyIncreases += stats.penaltyIncreases;
+    sum.qpIterations += stats.qpIterations;
+}
+
+// per-solve averages of the phase times (ms) and counters, plus the quality of the last solution
+void reportStats(benchmark::State& state, const SolverStats& sum, const SolverInterface& solver) {
+    const auto average = benchmark::Counter::kAvgIterations;
+    state.counters["evaluation_ms"] = benchmark::Counter(sum.evaluationTime, average);
+    state.counters["derivative_ms"] = benchmark::Counter(sum.derivativeTime, average);
+    state.counters["subproblem_ms"] = benchmark::Counter(sum.subproblemTime, average);
+    state.counters["qp_ms"] = benchmark::Counter(sum.qpTime, average);
+    state.counters["merit_ms"] = benchmark::Counter(sum.meritTime, average);
+    state.counters["soc_ms"] = benchmark::Counter(sum.secondOrderCorrectionTime, average);
+    state.counters["sqp_iterations"] = benchmark::Counter(sum.iterations, average);
+    state.counters["rejected_steps"] = benchmark::Counter(sum.rejectedSteps, average);
+    state.counters["soc"] = benchmark::Counter(sum.secondOrderCorrections, average);
+    state.counters["penalty_increases"] = benchmark::Counter(sum.penaltyIncreases, average);
+    state.counters["qp_iterations"] = benchmark::Counter(sum.qpIterations, average);
+    state.counters["objective"] = solver.getObjectiveValue();
+    state.counters["max_eq_violation"] = solver.getMaxEqualityViolation();
+    state.counters["max_ineq_violation"] = solver.getMaxInequalityViolation();
+}
+
+void benchColdStart(benchmark::State& state, const ExampleProblem& problem) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        boost::filesystem::remove_all(kColdModelFolder);
+        state.ResumeTiming();
+        auto optimizationProblem = std::make_unique<OptimizationProblem>(problem.create(kColdModelFolder, true));
+        benchmark::DoNotOptimize(optimizationProblem);
+        state.PauseTiming(); // unloading the library is not part of the cold start
+        optimizationProblem.reset();
+        state.ResumeTiming();
+    }
+}
+
+void benchWarmLoad(benchmark::State& state, const ExampleProblem& problem) {
+    loadedProblem(problem); // make sure the library is compiled
+    for (auto _ : state) {
+        OptimizationProblem optimizationProblem = problem.create(kModelFolder, false);
+        benchmark::DoNotOptimize(optimizationProblem);
+    }
+}
+
+void benchSolve(benchmark::State& state, const ExampleProblem& problem, const SubproblemConfiguration& subproblem) {
+    OptimizationProblem& optimizationProblem = loadedProblem(problem);
+    const vector_t initialGuess = problem.initialGuess();
+    SolverParameters parameters;
+    SolverInterface solver(optimizationProblem, parameters);
+    setupSolver(solver, problem, initialGuess, subproblem);
+    SolverStats sum;
+    for (auto _ : state) {
+        solver.initialize(initialGuess);
+        solver.solve();
+        accumulateStats(sum, solver.getStats());
+    }
+    reportStats(state, sum, solver);
+}
+
+void benchWarmSolve(benchmark::State& state, const ExampleProblem& problem) {
+    OptimizationProblem& optimizationProblem = loadedProblem(problem);
+    const vector_t initialGuess = problem.initialGuess();
+    SolverParameters parameters;
+    SolverInterface solver(optimizationProblem, parameters);
+    setupSolver(solver, problem, initialGuess);
+    solver.initialize(initialGuess);
+    solver.solve();
+    std::mt19937 generator(kSeed);
+    std::normal_distribution<scalar_t> perturbation(0.0, kWarmStartPerturbation);
+    vector_t warmStart(initialGuess.size());
+    SolverStats sum;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (Eigen::Index i = 0; i < warmStart.size(); ++i) {
+            warmStart[i] = solver.getIterate()[i] + perturbation(generator);
+        }
+        state.ResumeTiming();
+        solver.resetProblem(warmStart);
+        solver.solve();
+        accumulateStats(sum, solver.getStats());
+    }
+    reportStats(state, sum, solver);
+}
+
+void registerBenchmarks() {
+    for (const auto& problem : exampleProblems()) {
+        // code generation takes seconds to minutes, a single run is enough to spot a regression
+        benchmark::RegisterBenchmark(("ColdStart/" + problem.name).c_str(), benchColdStart, problem)
+            ->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("WarmLoad/" + problem.name).c_str(), benchWarmLoad, problem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("Solve/" + problem.name).c_str(), benchSolve, problem, kDefaultSubproblem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("SolveStage/" + problem.name).c_str(), benchSolve, problem, kStageSubproblem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("SolveElastic/" + problem.name).c_str(), benchSolve, problem, kElasticSubproblem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        benchmark::RegisterBenchmark(("WarmSolve/" + problem.name).c_str(), benchWarmSolve, problem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+    }
+    for (const auto& name : kSecondOrderExamples) {
+        const ExampleProblem& problem = findExampleProblem(name);
+        benchmark::RegisterBenchmark(("SolveLagrangian/" + problem.name).c_str(), benchSolve, problem, kLagrangianSubproblem)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+    }
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    registerBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <cppad/cppad.hpp>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Sparse>
+#include <cstring>
 #include <vector>
 
 namespace CRISP{
@@ -15,13 +16,23 @@ using ValueVector = std::vector<scalar_t>;
 
 // Eigen vector and matrix types
 using vector_t = Eigen::VectorXd;
+using vector_cref_t = Eigen::Ref<const vector_t>; // read-only view, binds Eigen vectors and numpy arrays without a copy
 using matrix_t = Eigen::MatrixXd;
 using sparse_vector_t = Eigen::SparseVector<scalar_t>;
-using sparse_matrix_t = Eigen::SparseMatrix<scalar_t, Eigen::RowMajor>;
+// Index type of the sparse matrices, the StorageIndex of Eigen and PIQP. CSRSparseMatrix stores the same type, so its buffers
+// are the buffers of an Eigen matrix. Define CRISP_SPARSE_INDEX (e.g. as long) for matrices with more than 2^31 non-zeros.
+#ifndef CRISP_SPARSE_INDEX
+#define CRISP_SPARSE_INDEX int
+#endif
+using sparse_index_t = CRISP_SPARSE_INDEX;
+using IndexVector = std::vector<sparse_index_t>;
+using sparse_matrix_t = Eigen::SparseMatrix<scalar_t, Eigen::RowMajor, sparse_index_t>;
+using sparse_map_t = Eigen::Map<sparse_matrix_t>;             // view over CSR buffers, no copy
+using sparse_const_map_t = Eigen::Map<const sparse_matrix_t>;
 // define a structure with outterIndex, innerIndices and values
 struct CSRSparseMatrix {
-    SizeVector outerIndex;
-    SizeVector innerIndices;
+    IndexVector outerIndex;
+    IndexVector innerIndices;
     ValueVector values;
     CSRSparseMatrix() = default;
     CSRSparseMatrix(const size_t& rows, const size_t& nnz) {
@@ -29,18 +40,40 @@ struct CSRSparseMatrix {
         innerIndices.resize(nnz);
         values.resize(nnz);
     }
-    CSRSparseMatrix(const SizeVector& outer, const SizeVector& inner, const ValueVector& vals) : outerIndex(outer), innerIndices(inner), values(vals) {}
-    CSRSparseMatrix(const CSRSparseMatrix& other) {
-        std::memcpy(outerIndex.data(), other.outerIndex.data(), other.outerIndex.size() * sizeof(int));
-        std::memcpy(innerIndices.data(), other.innerIndices.data(), other.innerIndices.size() * sizeof(int));
-        std::memcpy(values.data(), other.values.data(), other.values.size() * sizeof(scalar_t));
+    CSRSparseMatrix(const IndexVector& outer, const IndexVector& inner, const ValueVector& vals) : outerIndex(outer), innerIndices(inner), values(vals) {}
+    // member-wise copies, the vectors size themselves
+    CSRSparseMatrix(const CSRSparseMatrix& other) = default;
+    CSRSparseMatrix(CSRSparseMatrix&& other) = default;
+    CSRSparseMatrix& operator=(const CSRSparseMatrix& other) = default;
+    CSRSparseMatrix& operator=(CSRSparseMatrix&& other) = default;
+
+    size_t rows() const {
+        return outerIndex.empty() ? 0 : outerIndex.size() - 1;
+    }
+
+    size_t nonZeros() const {
+        return values.size();
+    }
+
+    // the buffers seen as a rows() x cols Eigen matrix, valid until the vectors are resized
+    sparse_map_t map(size_t cols) {
+        return sparse_map_t(rows(), cols, nonZeros(), outerIndex.data(), innerIndices.data(), values.data());
+    }
+
+    sparse_const_map_t map(size_t cols) const {
+        return sparse_const_map_t(rows(), cols, nonZeros(), outerIndex.data(), innerIndices.data(), values.data());
     }
-    
-    void toEigenSparseMatrix(sparse_matrix_t &sparseMatrix) {
-        std::vector<int> outerIndex_int(outerIndex.begin(), outerIndex.end());
-        std::vector<int> innerIndices_int(innerIndices.begin(), innerIndices.end());
-        std::memcpy(sparseMatrix.outerIndexPtr(), outerIndex_int.data(), outerIndex_int.size() * sizeof(int));
-        std::memcpy(sparseMatrix.innerIndexPtr(), innerIndices_int.data(), innerIndices_int.size() * sizeof(int));
+
+    // structure and values into a compressed rows() x cols matrix, plain copies of the buffers
+    void toEigenSparseMatrix(sparse_matrix_t &sparseMatrix, size_t cols) const {
+        sparseMatrix.resize(rows(), cols);
+        sparseMatrix.resizeNonZeros(nonZeros());
+        std::memcpy(sparseMatrix.outerIndexPtr(), outerIndex.data(), outerIndex.size() * sizeof(sparse_index_t));
+        std::memcpy(sparseMatrix.innerIndexPtr(), innerIndices.data(), innerIndices.size() * sizeof(sparse_index_t));
+        std::memcpy(sparseMatrix.valuePtr(), values.data(), values.size() * sizeof(scalar_t));
+    }
+    // refresh the values only, the structure of sparseMatrix has already been set by toEigenSparseMatrix
+    void toEigenSparseMatrixValues(sparse_matrix_t &sparseMatrix) const {
         std::memcpy(sparseMatrix.valuePtr(), values.data(), values.size() * sizeof(scalar_t));
     }
     void print() {
@@ -73,5 +106,16 @@ using ad_matrix_t = Eigen::Matrix<ad_scalar_t, Eigen::Dynamic, Eigen::Dynamic>;
 using ad_function_t = std::function<void(const ad_vector_t&, ad_vector_t&)>;
 using ad_function_with_param_t = std::function<void(const ad_vector_t&, const ad_vector_t&, ad_vector_t&)>;
 using triplet_vector_t = std::vector<Eigen::Triplet<scalar_t>>;
+
+// append the mirror of every entry above the diagonal, the triplets of an upper triangle then hold the full symmetric matrix
+inline void mirrorUpperTriangle(triplet_vector_t& triplets) {
+    const size_t numTriplets = triplets.size();
+    triplets.reserve(2 * numTriplets); // no reallocation while the entries are read
+    for (size_t i = 0; i < numTriplets; ++i) {
+        if (triplets[i].col() > triplets[i].row()) {
+            triplets.emplace_back(triplets[i].col(), triplets[i].row(), triplets[i].value());
+        }
+    }
+}
 }   
 #endif // BASIC_TYPES_H
@@ -4,6 +4,7 @@
 #include "common/BasicTypes.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 
 namespace CRISP {
@@ -11,26 +12,61 @@ class ParametersManager {
 public:
 
     ParametersManager() = default;
-    // Set parameters associated with a specific name
-    void setParameters(const std::string& name, const vector_t& params) {
-        parameters_[name] = params;
+    // Set parameters associated with a specific name, an existing entry of the same size is overwritten in place
+    void setParameters(const std::string& name, const vector_cref_t& params) {
+        const size_t slot = getParameterSlot(name);
+        values_[slot] = params;
+        isSet_[slot] = true;
     }
 
     // Retrieve parameters associated with a specific name
-    vector_t getParameters(const std::string& name) const {
-        auto it = parameters_.find(name);
-        if (it != parameters_.end()) {
-            return it->second;
+    const vector_t& getParameters(const std::string& name) const {
+        auto it = slots_.find(name);
+        if (it != slots_.end() && isSet_[it->second]) {
+            return values_[it->second];
         }
         throw std::runtime_error("Parameters not found for: " + name);
     }
-    
+
+    // Stable handle of a name for the readers on the evaluation path, resolved once so every read is an index instead of a
+    // string lookup. The slot is reserved if the name has no parameters yet, setParameters fills it later. Copies of the
+    // manager keep the slots.
+    size_t getParameterSlot(const std::string& name) {
+        auto it = slots_.find(name);
+        if (it != slots_.end()) {
+            return it->second;
+        }
+        const size_t slot = names_.size();
+        slots_.emplace(name, slot);
+        names_.push_back(name);
+        values_.emplace_back();
+        isSet_.push_back(false);
+        return slot;
+    }
+
+    // the reference stays valid until the next setParameters of a new name
+    const vector_t& getParameters(size_t slot) const {
+        if (!isSet_[slot]) {
+            throw std::runtime_error("Parameters not found for: " + names_[slot]);
+        }
+        return values_[slot];
+    }
+
     std::unordered_map<std::string, vector_t> getParametersMap() const {
-        return parameters_;
+        std::unordered_map<std::string, vector_t> parameters;
+        for (size_t slot = 0; slot < names_.size(); ++slot) {
+            if (isSet_[slot]) {
+                parameters.emplace(names_[slot], values_[slot]);
+            }
+        }
+        return parameters;
     }
 
 private:
-    std::unordered_map<std::string, vector_t> parameters_;
+    std::unordered_map<std::string, size_t> slots_;
+    std::vector<std::string> names_;
+    std::vector<vector_t> values_;
+    std::vector<bool> isSet_;
 };
 }
 
@@ -0,0 +1,144 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace CRISP {
+// Persistent pool of worker threads for evaluating independent blocks (objective, constraints) of a problem in parallel.
+// The workers are created once and sleep between calls, parallelFor does not allocate memory.
+class ThreadPool {
+public:
+    // the calling thread takes part in parallelFor, so numThreads - 1 workers are spawned
+    explicit ThreadPool(size_t numThreads) {
+        for (size_t i = 1; i < numThreads; ++i) {
+            workers_.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeCondition_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return workers_.size() + 1;
+    }
+
+    // run task(i) for all i in [0, numTasks) and block until all of them are done.
+    // The first exception thrown by a task is rethrown in the calling thread. A call from inside a task of the same pool
+    // (e.g. a stage function evaluated by a block task) runs its tasks serially on the calling thread.
+    template <typename Function>
+    void parallelFor(size_t numTasks, Function&& task) {
+        if (workers_.empty() || numTasks < 2 || currentPool() == this) {
+            for (size_t i = 0; i < numTasks; ++i) {
+                task(i);
+            }
+            return;
+        }
+        using FunctionType = typename std::remove_reference<Function>::type;
+        std::unique_lock<std::mutex> lock(mutex_);
+        // workers of the previous call may still be leaving runTasks
+        doneCondition_.wait(lock, [this] { return activeWorkers_ == 0; });
+        context_ = const_cast<void*>(static_cast<const void*>(&task));
+        invoke_ = [](void* context, size_t i) { (*static_cast<FunctionType*>(context))(i); };
+        numTasks_ = numTasks;
+        nextTask_ = 0;
+        pendingTasks_ = numTasks;
+        exception_ = nullptr;
+        ++generation_;
+        lock.unlock();
+        wakeCondition_.notify_all();
+
+        runTasks();
+
+        lock.lock();
+        doneCondition_.wait(lock, [this] { return pendingTasks_ == 0; });
+        context_ = nullptr;
+        if (exception_) {
+            std::exception_ptr exception = exception_;
+            exception_ = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+private:
+    void workerLoop() {
+        size_t seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeCondition_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+                if (stop_) {
+                    return;
+                }
+                seenGeneration = generation_;
+                ++activeWorkers_;
+            }
+            runTasks();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --activeWorkers_;
+            }
+            doneCondition_.notify_all();
+        }
+    }
+
+    // the pool whose tasks the calling thread is running, null outside of a task
+    static const ThreadPool*& currentPool() {
+        static thread_local const ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    void runTasks() {
+        const ThreadPool* previousPool = currentPool();
+        currentPool() = this;
+        size_t i;
+        while ((i = nextTask_.fetch_add(1)) < numTasks_) {
+            try {
+                invoke_(context_, i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!exception_) {
+                    exception_ = std::current_exception();
+                }
+            }
+            if (pendingTasks_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                doneCondition_.notify_all();
+            }
+        }
+        currentPool() = previousPool;
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable doneCondition_;
+    void* context_ = nullptr;
+    void (*invoke_)(void*, size_t) = nullptr;
+    size_t numTasks_ = 0;
+    std::atomic<size_t> nextTask_{0};
+    std::atomic<size_t> pendingTasks_{0};
+    size_t generation_ = 0;
+    size_t activeWorkers_ = 0;
+    bool stop_ = false;
+    std::exception_ptr exception_;
+};
+} // namespace CRISP
+
+#endif // THREAD_POOL_H
@@ -8,7 +8,15 @@ namespace CRISP {
 
 class ValueFunction {
 public:
+    ValueFunction() = default;
     virtual ~ValueFunction() = default;
+
+    // deep copy of the evaluation state, see the copy constructor of CppAdInterface
+    ValueFunction(const ValueFunction& other)
+        : cppadInterface_(other.cppadInterface_ ? std::make_unique<CppAdInterface>(*other.cppadInterface_) : nullptr),
+          valueFunction_(other.valueFunction_), gradientFunction_(other.gradientFunction_),
+          valueFunctionWithParam_(other.valueFunctionWithParam_), gradientFunctionWithParam_(other.gradientFunctionWithParam_) {}
+    ValueFunction& operator=(const ValueFunction&) = delete;
  
     // ------------------------ Get function information ------------------------ //
     // nonparametric
@@ -19,6 +27,16 @@ public:
     virtual vector_t getValue(const vector_t& x, const vector_t& p) = 0;
     virtual sparse_matrix_t getGradient(const vector_t& x, const vector_t& p) = 0;
 
+    // evaluate into preallocated buffers: the jacobian values follow getGradientCSRStructure()
+    virtual void getValue(const vector_t& x, scalar_t* value) = 0;
+    virtual void getValue(const vector_t& x, const vector_t& p, scalar_t* value) = 0;
+    virtual void getGradientCSRValues(const vector_t& x, scalar_t* values) = 0;
+    virtual void getGradientCSRValues(const vector_t& x, const vector_t& p, scalar_t* values) = 0;
+
+    virtual const CSRSparseMatrix& getGradientCSRStructure() const {
+        return cppadInterface_->getJacobianCSRStructure();
+    }
+
 
     // ------------------------ Set user specified function information ------------------------ //
     void setValueFunction(const std::function<vector_t(const vector_t&)>& valueFunction) {
@@ -4,6 +4,8 @@
 #include "common/BasicTypes.h"
 #include <string>
 #include <memory>
+#include <functional>
+#include <vector>
 
 namespace CRISP {
 
@@ -15,6 +17,18 @@ public:
         FIRST_ORDER,
         SECOND_ORDER
     };
+    // compiler and source generation options used whenever a model library is generated
+    struct CodeGenSettings {
+        std::string compiler = "gcc";                        // "gcc" or "clang"
+        std::string compilerPath = "";                       // empty: /usr/bin/<compiler>
+        std::vector<std::string> compileFlags = {"-O2"};     // e.g. {"-O3", "-march=native"}
+        size_t maxAssignmentsPerFunction = 0;                // split large generated functions into several source files, 0: no splitting
+        size_t numThreads = 1;                               // number of functions generated and compiled concurrently
+        bool bundleLibrary = false;                          // generateInParallel builds one library with all functions of a model
+        bool fusedEvaluation = true;                         // also generate the fused value and derivatives model
+        bool upperTriangularHessian = false;                 // generate only the upper triangle (col >= row) of the hessians
+        size_t batchSize = 0;                                // also generate batched models evaluating batchSize points per call, 0: none
+    };
     CppAdInterface(size_t variableDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
                    const ad_function_t& function, ModelInfoLevel infoLevel = ModelInfoLevel::SECOND_ORDER, bool regenerateLibrary = true);
 
@@ -27,12 +41,26 @@ public:
     CppAdInterface(size_t variableDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
                    ModelInfoLevel infoLevel = ModelInfoLevel::SECOND_ORDER, bool regenerateLibrary = true); // for py binding constructor, no need to pass function, read from generated .so file
 
+    // A copy shares the loaded dynamic library, but owns its own model instance and work buffers,
+    // so the copies can be evaluated concurrently on different threads.
+    CppAdInterface(const CppAdInterface& other);
+    CppAdInterface& operator=(const CppAdInterface&) = delete;
+
+    // process-wide settings for the libraries generated from now on
+    static void setCodeGenSettings(const CodeGenSettings& settings);
+    static CodeGenSettings getCodeGenSettings();
+    // Run the builders concurrently on numThreads threads, each builder constructs (tapes, generates and compiles) its functions.
+    // CppAD is switched to its multi-threaded mode for the duration of the call. With bundleLibrary the functions are only
+    // taped by the builders, and then compiled into <folder>/<model>/auto_generated/<model>_cppad_cg_bundle.
+    static void generateInParallel(const std::vector<std::function<void()>>& builders, size_t numThreads);
+
     sparse_matrix_t computeSparseJacobian(const vector_t& x);
     sparse_matrix_t computeSparseJacobian(const vector_t& x, const vector_t& p);
     triplet_vector_t computeSparseJacobianTriplet(const vector_t& x);
     triplet_vector_t computeSparseJacobianTriplet(const vector_t& x, const vector_t& p);
     CSRSparseMatrix computeSparseJacobianCSR(const vector_t& x);
     CSRSparseMatrix computeSparseJacobianCSR(const vector_t& x, const vector_t& p);
+    // the matrix and triplet hessians are full (mirrored for upper triangular libraries), the CSR hessians follow getHessianCSRStructure
     sparse_matrix_t computeSparseHessian(const vector_t& x);
     sparse_matrix_t computeSparseHessian(const vector_t& x, const vector_t& p);
     triplet_vector_t computeSparseHessianTriplet(const vector_t& x);
@@ -42,6 +70,76 @@ public:
 
     vector_t computeFunctionValue(const vector_t& x);
     vector_t computeFunctionValue(const vector_t& x, const vector_t& p);
+
+    // ------------------------ evaluate into caller owned buffers ------------------------ //
+    // The sparsity structure is fixed once the model is generated or loaded, so these overloads only write the values
+    // (in the order of getJacobianCSRStructure/getHessianCSRStructure) and do not allocate any memory.
+    void computeFunctionValue(const vector_t& x, scalar_t* y);
+    void computeFunctionValue(const vector_t& x, const vector_t& p, scalar_t* y);
+    void computeSparseJacobianValues(const vector_t& x, scalar_t* jacValues);
+    void computeSparseJacobianValues(const vector_t& x, const vector_t& p, scalar_t* jacValues);
+    void computeSparseHessianValues(const vector_t& x, scalar_t* hesValues);
+    void computeSparseHessianValues(const vector_t& x, const vector_t& p, scalar_t* hesValues);
+    // hessian of the weighted sum of the components, weights holds one entry per component (getFunDim())
+    void computeSparseHessianValues(const vector_t& x, const scalar_t* weights, scalar_t* hesValues);
+    void computeSparseHessianValues(const vector_t& x, const vector_t& p, const scalar_t* weights, scalar_t* hesValues);
+
+    // value and jacobian values from one call of the fused model, hesValues may be null. The hessian is a separate call
+    // (libraries of an older layout may hold it in the fused model), libraries without a fused model use separate calls.
+    void computeFunctionValueAndDerivatives(const vector_t& x, scalar_t* y, scalar_t* jacValues, scalar_t* hesValues);
+    void computeFunctionValueAndDerivatives(const vector_t& x, const vector_t& p, scalar_t* y, scalar_t* jacValues, scalar_t* hesValues);
+
+    bool hasFusedModel() const {
+        return fusedModel_ != nullptr;
+    }
+
+    // ------------------------ evaluate many points at once ------------------------ //
+    // The K points are the rows of X (K x variableDim), the parameters of each point the rows of P (K x parameterDim).
+    // Row i of Y (K x funDim) receives the value and row i of jacValues (K x nnz) the jacobian values of point i, in the
+    // order of getJacobianCSRStructure. The batched models evaluate getBatchSize() points per call with the points as the
+    // inner loop of the generated code, without them (batchSize 0 or an older library) the points are evaluated one by one.
+    void computeFunctionValueBatch(const matrix_t& X, matrix_t& Y);
+    void computeFunctionValueBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y);
+    void computeFunctionValueAndJacobianBatch(const matrix_t& X, matrix_t& Y, matrix_t& jacValues);
+    void computeFunctionValueAndJacobianBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y, matrix_t& jacValues);
+
+    // points per call of the batched models of the loaded library, 0 if it has none
+    size_t getBatchSize() const {
+        return batchSize_;
+    }
+
+    // CSR structure (outerIndex and innerIndices) of the jacobian/hessian with respect to the variables only.
+    const CSRSparseMatrix& getJacobianCSRStructure() const {
+        return jacobianCSRStructure_;
+    }
+
+    const CSRSparseMatrix& getHessianCSRStructure() const {
+        return hessianCSRStructure_;
+    }
+
+    // the hessian structure (and every hessian output) holds no entry below the diagonal, true for libraries generated
+    // with upperTriangularHessian and for diagonal hessians
+    bool isHessianUpperTriangular() const {
+        return hessianUpperTriangular_;
+    }
+
+    // The derivatives with respect to the variables do not depend on the variables (they may depend on the parameters):
+    // a constant jacobian for linear functions, a constant hessian for quadratic ones (for fixed weights). Classified from
+    // the tape when the library is built and stored in the manifest, a cached library reads it back. False for libraries
+    // loaded without the function and for functions with abs, sign, conditional expressions or comparisons (piecewise
+    // derivatives).
+    bool hasConstantJacobian() const {
+        return constantJacobian_;
+    }
+
+    bool hasConstantHessian() const {
+        return constantHessian_;
+    }
+
+    // the hessian of the weighted components is generated (ModelInfoLevel::SECOND_ORDER)
+    bool hasSecondOrderInformation() const {
+        return infoLevel_ == ModelInfoLevel::SECOND_ORDER;
+    }
     
     void printSparsityPatterns() const;
     void printSparsityMatrix(const sparse_matrix_t& matrix) const;
@@ -77,21 +175,75 @@ private:
     std::string functionName_;
     std::string libraryFolder_;
     std::string libraryName_;
+    std::string libraryModelName_; // name of the model inside the library, modelName_ or <model>_<function> in a bundle
 
     ad_function_t functionNoParam_;
     ad_function_with_param_t functionWithParam_;
 
-    std::unique_ptr<CppAD::cg::DynamicLib<scalar_t>> dynamicLib_;
+    std::shared_ptr<CppAD::cg::DynamicLib<scalar_t>> dynamicLib_; // shared by all functions loaded from the same file
+    std::unique_ptr<CppAD::ADFun<cg_scalar_t>> cgFun_;               // tape and source generator, kept until the library is built
+    std::unique_ptr<CppAD::cg::ModelCSourceGen<scalar_t>> cgen_;
+    bool optimizeTape_ = false;                                       // optimize cgFun_ when the library is rebuilt
+    std::unique_ptr<CppAD::ADFun<cg_scalar_t>> fusedCgFun_;
+    std::unique_ptr<CppAD::cg::ModelCSourceGen<scalar_t>> fusedCgen_;
     std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> model_;
     ModelInfoLevel infoLevel_;
 
     CppAD::sparse_rc<SizeVector> jacobianSparsity_;   // Jacobian Sparsity Pattern
     CppAD::sparse_rc<SizeVector> hessianSparsity_;   // Hessian Sparsity Pattern
 
+    // preallocated work buffers for the evaluate-into overloads
+    ValueVector xpBuffer_;        // [x; p] for the parameterized model
+    ValueVector jacobianBuffer_;  // generated jacobian values, including the parameter columns
+    ValueVector hessianBuffer_;   // generated hessian values, including the parameter rows and columns
+    ValueVector hessianWeights_;  // range weights of the hessian, all ones
+    CSRSparseMatrix jacobianCSRStructure_;
+    CSRSparseMatrix hessianCSRStructure_;
+    SizeVector jacobianGather_;   // CSR slot -> index of the generated jacobian output
+    SizeVector hessianGather_;    // CSR slot -> index of the generated hessian output
+    bool jacobianGatherIdentity_ = false;
+    bool hessianGatherIdentity_ = false;
+    std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> fusedModel_; // [y; jacobian] in one call, null if not generated
+    ValueVector fusedBuffer_;
+    SizeVector fusedJacobianGather_;  // jacobian CSR slot -> index of the fused output
+    SizeVector fusedHessianGather_;   // hessian CSR slot -> index of the fused output
+    bool hasFusedHessian_ = false;
+    std::unique_ptr<CppAD::ADFun<cg_scalar_t>> batchValueCgFun_;
+    std::unique_ptr<CppAD::cg::ModelCSourceGen<scalar_t>> batchValueCgen_;
+    std::unique_ptr<CppAD::ADFun<cg_scalar_t>> batchJacobianCgFun_;
+    std::unique_ptr<CppAD::cg::ModelCSourceGen<scalar_t>> batchJacobianCgen_;
+    std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> batchValueModel_;    // y of batchSize_ points, null if not generated
+    std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> batchJacobianModel_; // [y; jacobian] of batchSize_ points, null if not generated
+    size_t batchSize_ = 0;
+    ValueVector batchInput_;          // input of point k at index i * batchSize_ + k
+    ValueVector batchOutput_;         // output o of point k at index o * batchSize_ + k
+    SizeVector batchJacobianGather_;  // jacobian CSR slot -> output row of the batched jacobian model
+    bool hessianUpperTriangular_ = false;
+    bool constantJacobian_ = false;
+    bool constantHessian_ = false;
+
     void initializeModel();
+    void classifyDerivatives();
+    std::string constantDerivativesEntry(const std::string& manifestFile, bool rebuilt);
+    bool hasPiecewiseOperations() const;
+    void initializeWorkspace();
     bool isLibraryAvailable() const;
     void loadModel();
-    void generateLibrary();
+    CppAD::cg::ModelCSourceGen<scalar_t>& createSourceGenerator();
+    void generateLibrary(); // compile cgen_ with the current CodeGenSettings and load it, or load the cached library
+    static void buildBundles(const CodeGenSettings& settings);
+    std::string libraryKey(const CodeGenSettings& settings) const;
+    std::string bundleLibraryName() const;
+    void loadAvailableModel();
+    void releaseTape();
+    void createDerivedSourceGenerators(const CodeGenSettings& settings); // cache miss only, also optimizes the tape
+    void createFusedSourceGenerator();
+    void initializeFusedModel();
+    void scatterFusedValues(scalar_t* y, scalar_t* jacValues, scalar_t* hesValues) const;
+    void createBatchedSourceGenerators(size_t batchSize);
+    void initializeBatchedModels();
+    void addGeneratedModels(CppAD::cg::ModelLibraryCSourceGen<scalar_t>& libcgen); // the fused and batched models next to cgen_
+    void evaluateBatch(const matrix_t& X, const matrix_t* P, matrix_t& Y, matrix_t* jacValues);
 };
 }
 
@@ -81,7 +81,7 @@ namespace CRISP {
             return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeFunctionValue(x);
         }
 
-        triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) {
+        virtual triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) {
             if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
                 if (gradientFunctionWithParam_ != nullptr) {
                     return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianTriplet(x, params);
@@ -92,7 +92,7 @@ namespace CRISP {
             return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianTriplet(x, params);
         }
 
-        triplet_vector_t getGradientTriplet(const vector_t& x) {
+        virtual triplet_vector_t getGradientTriplet(const vector_t& x) {
             if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
                 if (gradientFunction_ != nullptr) {
                     return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianTriplet(x);
@@ -125,7 +125,7 @@ namespace CRISP {
             return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobian(x);
         }
 
-        CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) {
+        virtual CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) {
             if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
                 if (gradientFunctionWithParam_ != nullptr) {
                     return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianCSR(x, params);
@@ -136,7 +136,7 @@ namespace CRISP {
             return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianCSR(x, params);
         }
 
-        CSRSparseMatrix getGradientCSR(const vector_t& x) {
+        virtual CSRSparseMatrix getGradientCSR(const vector_t& x) {
             if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
                 if (gradientFunction_ != nullptr) {
                     return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianCSR(x);
@@ -147,6 +147,158 @@ namespace CRISP {
             return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianCSR(x);
         }
 
+        //  ------------------------ Evaluate into preallocated buffers, no heap allocation for the ad functions ------------------------ //
+        void getValue(const vector_t& x, const vector_t& params, scalar_t* value) override {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+                if (valueFunctionWithParam_ != nullptr) {
+                    vector_t userValue = valueFunctionWithParam_(x, params);
+                    std::memcpy(value, userValue.data(), funDim_ * sizeof(scalar_t));
+                    return;
+                } else {
+                    throw std::runtime_error("No value function with parameters specified.");
+                }
+            }
+            cppadInterface_->computeFunctionValue(x, params, value);
+        }
+
+        void getValue(const vector_t& x, scalar_t* value) override {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+                if (valueFunction_ != nullptr) {
+                    vector_t userValue = valueFunction_(x);
+                    std::memcpy(value, userValue.data(), funDim_ * sizeof(scalar_t));
+                    return;
+                } else {
+                    throw std::runtime_error("No value function specified.");
+                }
+            }
+            cppadInterface_->computeFunctionValue(x, value);
+        }
+
+        void getGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) override {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            cppadInterface_->computeSparseJacobianValues(x, params, values);
+        }
+
+        void getGradientCSRValues(const vector_t& x, scalar_t* values) override {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            cppadInterface_->computeSparseJacobianValues(x, values);
+        }
+
+        // values and jacobian values from one generated call, see CppAdInterface::computeFunctionValueAndDerivatives
+        virtual void getValueAndGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* value, scalar_t* jacValues) {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+                getValue(x, params, value);
+                getGradientCSRValues(x, params, jacValues);
+                return;
+            }
+            cppadInterface_->computeFunctionValueAndDerivatives(x, params, value, jacValues, nullptr);
+        }
+
+        virtual void getValueAndGradientCSRValues(const vector_t& x, scalar_t* value, scalar_t* jacValues) {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+                getValue(x, value);
+                getGradientCSRValues(x, jacValues);
+                return;
+            }
+            cppadInterface_->computeFunctionValueAndDerivatives(x, value, jacValues, nullptr);
+        }
+
+        // ------------------------ Evaluate many points at once, see CppAdInterface::computeFunctionValueBatch ------------------------ //
+        // The points are the rows of X and their parameters the rows of P, row i of Y receives the value and row i of jacValues the
+        // jacobian values of point i. Functions without a model of their own (or with user functions) evaluate the points one by one.
+        virtual void getValueBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y) {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+                cppadInterface_->computeFunctionValueBatch(X, P, Y);
+                return;
+            }
+            evaluatePointwise(X, &P, Y, nullptr);
+        }
+
+        virtual void getValueBatch(const matrix_t& X, matrix_t& Y) {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+                cppadInterface_->computeFunctionValueBatch(X, Y);
+                return;
+            }
+            evaluatePointwise(X, nullptr, Y, nullptr);
+        }
+
+        virtual void getValueAndGradientCSRValuesBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y, matrix_t& jacValues) {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+                cppadInterface_->computeFunctionValueAndJacobianBatch(X, P, Y, jacValues);
+                return;
+            }
+            evaluatePointwise(X, &P, Y, &jacValues);
+        }
+
+        virtual void getValueAndGradientCSRValuesBatch(const matrix_t& X, matrix_t& Y, matrix_t& jacValues) {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+                cppadInterface_->computeFunctionValueAndJacobianBatch(X, Y, jacValues);
+                return;
+            }
+            evaluatePointwise(X, nullptr, Y, &jacValues);
+        }
+
+        // hessian of the weighted sum of the constraint rows, only available for ModelInfoLevel::SECOND_ORDER models.
+        // weights holds one entry per row, the values follow getHessianCSRStructure()
+        virtual void getHessianCSRValues(const vector_t& x, const vector_t& params, const scalar_t* weights, scalar_t* values) {
+            if (!isParameterized_) {
+                throw std::runtime_error("Parameters are not expected.");
+            }
+            cppadInterface_->computeSparseHessianValues(x, params, weights, values);
+        }
+
+        virtual void getHessianCSRValues(const vector_t& x, const scalar_t* weights, scalar_t* values) {
+            if (isParameterized_) {
+                throw std::runtime_error("Parameters are required.");
+            }
+            cppadInterface_->computeSparseHessianValues(x, weights, values);
+        }
+
+        virtual const CSRSparseMatrix& getHessianCSRStructure() const {
+            return cppadInterface_->getHessianCSRStructure();
+        }
+
+        virtual size_t getNumNonZerosHessian() const {
+            return cppadInterface_->getNumNonZerosHessian();
+        }
+
+        // linear in the variables, see CppAdInterface::hasConstantJacobian
+        virtual bool hasConstantJacobian() const {
+            return cppadInterface_->hasConstantJacobian();
+        }
+
+        virtual bool hasSecondOrderInformation() const {
+            return cppadInterface_->hasSecondOrderInformation();
+        }
+
         SpecifiedFunctionLevel getSpecifiedFunctionLevel() const {
             return specifiedFunctionLevel_;
         }
@@ -176,8 +328,41 @@ namespace CRISP {
             return functionName_;
         }
 
+        // independent copy for another thread, sharing the loaded model library
+        virtual std::shared_ptr<ConstraintFunction> clone() const {
+            return std::make_shared<ConstraintFunction>(*this);
+        }
+
+protected:
+    // functions without a model of their own (see StageConstraintFunction), the derived class sets the dimensions
+    ConstraintFunction(const std::string& functionName, bool isParameterized)
+        : specifiedFunctionLevel_(SpecifiedFunctionLevel::NONE), functionName_(functionName), isParameterized_(isParameterized) {}
+
+    // batch evaluation through the point-wise calls, P and jacValues may be null
+    void evaluatePointwise(const matrix_t& X, const matrix_t* P, matrix_t& Y, matrix_t* jacValues) {
+        if (X.cols() != static_cast<Eigen::Index>(variableDim_) || (P != nullptr && P->rows() != X.rows())) {
+            throw std::runtime_error("The batch of " + functionName_ + " does not match the variable dimension or the number of points.");
+        }
+        Y.resize(X.rows(), funDim_);
+        if (jacValues != nullptr) {
+            jacValues->resize(X.rows(), nnzJacobian_);
+        }
+        vector_t x(variableDim_), p, value(funDim_), jac(nnzJacobian_);
+        for (Eigen::Index i = 0; i < X.rows(); ++i) {
+            x = X.row(i).transpose();
+            if (P != nullptr) {
+                p = P->row(i).transpose();
+            }
+            if (jacValues != nullptr) {
+                P != nullptr ? getValueAndGradientCSRValues(x, p, value.data(), jac.data()) : getValueAndGradientCSRValues(x, value.data(), jac.data());
+                jacValues->row(i) = jac.transpose();
+            } else {
+                P != nullptr ? getValue(x, p, value.data()) : getValue(x, value.data());
+            }
+            Y.row(i) = value.transpose();
+        }
+    }
 
-private:
     SpecifiedFunctionLevel specifiedFunctionLevel_;
     size_t variableDim_ = 0;
     size_t parameterDim_ = 0;
@@ -23,6 +23,7 @@ public:
           isParameterized_ = false;
           nnzJacobian_ = cppadInterface_->getNumNonZerosJacobian();
           nnzHessian_ = cppadInterface_->getNumNonZerosHessian();
+          gradientValues_.resize(nnzJacobian_);
      }
     ObjectiveFunction(size_t variableDim, size_t parameterDim, const std::string& modelName, const std::string& folderName,
                           const std::string& functionName, const ad_function_with_param_t& function,bool regenerateLibrary = false,
@@ -35,6 +36,7 @@ public:
           isParameterized_ = true;
           nnzJacobian_ = cppadInterface_->getNumNonZerosJacobian();
           nnzHessian_ = cppadInterface_->getNumNonZerosHessian();
+          gradientValues_.resize(nnzJacobian_);
             
      }
     //  for pybind
@@ -48,6 +50,7 @@ public:
           isParameterized_ = false;
           nnzJacobian_ = cppadInterface_->getNumNonZerosJacobian();
           nnzHessian_ = cppadInterface_->getNumNonZerosHessian();
+          gradientValues_.resize(nnzJacobian_);
      }
 
     ObjectiveFunction(size_t variableDim, size_t parameterDim, const std::string& modelName, const std::string& folderName,
@@ -61,6 +64,7 @@ public:
           isParameterized_ = true;
           nnzJacobian_ = cppadInterface_->getNumNonZerosJacobian();
           nnzHessian_ = cppadInterface_->getNumNonZerosHessian();
+          gradientValues_.resize(nnzJacobian_);
         }
 
      //  ------------------------ Get function information from ad or user defined functions ------------------------ //
@@ -104,7 +108,7 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobian(x);
     }
 
-    triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) {
+    virtual triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
             if (gradientFunctionWithParam_ != nullptr) {
                 return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianTriplet(x, params);
@@ -114,7 +118,7 @@ public:
         return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianTriplet(x, params);
     }
 
-    triplet_vector_t getGradientTriplet(const vector_t& x) {
+    virtual triplet_vector_t getGradientTriplet(const vector_t& x) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
             if (gradientFunction_ != nullptr) {
                 return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianTriplet(x);
@@ -124,7 +128,7 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianTriplet(x);
     }
 
-    CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) {
+    virtual CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
             if (gradientFunctionWithParam_ != nullptr) {
                 return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianCSR(x, params);
@@ -134,7 +138,7 @@ public:
         return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseJacobianCSR(x, params);
     }
 
-    CSRSparseMatrix getGradientCSR(const vector_t& x) {
+    virtual CSRSparseMatrix getGradientCSR(const vector_t& x) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::GRADIENT) {
             if (gradientFunction_ != nullptr) {
                 return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianCSR(x);
@@ -144,7 +148,7 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseJacobianCSR(x);
     }
 
-    sparse_matrix_t getHessian(const vector_t& x, const vector_t& params) {
+    virtual sparse_matrix_t getHessian(const vector_t& x, const vector_t& params) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunctionWithParam_ != nullptr) {
                 return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : hessianFunctionWithParam_(x, params);
@@ -154,7 +158,7 @@ public:
         return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseHessian(x, params);
     }
 
-    sparse_matrix_t getHessian(const vector_t& x) {
+    virtual sparse_matrix_t getHessian(const vector_t& x) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunction_ != nullptr) {
                 return isParameterized_ ? throw std::runtime_error("Parameters are required.") : hessianFunction_(x);
@@ -164,7 +168,7 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseHessian(x);
     }
 
-    triplet_vector_t getHessianTriplet(const vector_t& x, const vector_t& params) {
+    virtual triplet_vector_t getHessianTriplet(const vector_t& x, const vector_t& params) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunctionWithParam_ != nullptr) {
                 return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseHessianTriplet(x, params);
@@ -174,7 +178,7 @@ public:
         return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseHessianTriplet(x, params);
     }
 
-    triplet_vector_t getHessianTriplet(const vector_t& x) {
+    virtual triplet_vector_t getHessianTriplet(const vector_t& x) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunction_ != nullptr) {
                 return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseHessianTriplet(x);
@@ -184,7 +188,7 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseHessianTriplet(x);
     }
 
-    CSRSparseMatrix getHessianCSR(const vector_t& x, const vector_t& params) {
+    virtual CSRSparseMatrix getHessianCSR(const vector_t& x, const vector_t& params) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunctionWithParam_ != nullptr) {
                 return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseHessianCSR(x, params);
@@ -194,7 +198,7 @@ public:
         return !isParameterized_ ? throw std::runtime_error("Parameters are not expected.") : cppadInterface_->computeSparseHessianCSR(x, params);
     }
 
-    CSRSparseMatrix getHessianCSR(const vector_t& x) {
+    virtual CSRSparseMatrix getHessianCSR(const vector_t& x) {
         if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::HESSIAN) {
             if (hessianFunction_ != nullptr) {
                 return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseHessianCSR(x);
@@ -204,6 +208,173 @@ public:
         return isParameterized_ ? throw std::runtime_error("Parameters are required.") : cppadInterface_->computeSparseHessianCSR(x);
     }
 
+    //  ------------------------ Evaluate into preallocated buffers, no heap allocation for the ad functions ------------------------ //
+    void getValue(const vector_t& x, const vector_t& params, scalar_t* value) override {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+            if (valueFunctionWithParam_ != nullptr) {
+                *value = valueFunctionWithParam_(x, params)(0);
+                return;
+            }
+            else {throw std::runtime_error("No value function with parameters specified.");}
+        }
+        cppadInterface_->computeFunctionValue(x, params, value);
+    }
+
+    void getValue(const vector_t& x, scalar_t* value) override {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+            if (valueFunction_ != nullptr) {
+                *value = valueFunction_(x)(0);
+                return;
+            }
+            else {throw std::runtime_error("No value function specified.");}
+        }
+        cppadInterface_->computeFunctionValue(x, value);
+    }
+
+    void getGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) override {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        cppadInterface_->computeSparseJacobianValues(x, params, values);
+    }
+
+    void getGradientCSRValues(const vector_t& x, scalar_t* values) override {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        cppadInterface_->computeSparseJacobianValues(x, values);
+    }
+
+    virtual void getHessianCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        cppadInterface_->computeSparseHessianValues(x, params, values);
+    }
+
+    virtual void getHessianCSRValues(const vector_t& x, scalar_t* values) {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        cppadInterface_->computeSparseHessianValues(x, values);
+    }
+
+    virtual const CSRSparseMatrix& getHessianCSRStructure() const {
+        return cppadInterface_->getHessianCSRStructure();
+    }
+
+    // quadratic in the variables, see CppAdInterface::hasConstantHessian
+    virtual bool hasConstantHessian() const {
+        return cppadInterface_->hasConstantHessian();
+    }
+
+    // add the dense gradient (row vector of the 1 x n jacobian) to gradient, using the preallocated value buffer
+    void accumulateGradient(const vector_t& x, const vector_t& params, vector_t& gradient) {
+        getGradientCSRValues(x, params, gradientValues_.data());
+        scatterGradient(gradient);
+    }
+
+    void accumulateGradient(const vector_t& x, vector_t& gradient) {
+        getGradientCSRValues(x, gradientValues_.data());
+        scatterGradient(gradient);
+    }
+
+    // value, gradient values and hessian values from one generated call, see CppAdInterface::computeFunctionValueAndDerivatives,
+    // hessianValues may be null
+    virtual void getValueAndDerivativesCSRValues(const vector_t& x, const vector_t& params, scalar_t* value, scalar_t* gradientValues, scalar_t* hessianValues) {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+            getValue(x, params, value);
+            getGradientCSRValues(x, params, gradientValues);
+            if (hessianValues != nullptr) {
+                getHessianCSRValues(x, params, hessianValues);
+            }
+            return;
+        }
+        cppadInterface_->computeFunctionValueAndDerivatives(x, params, value, gradientValues, hessianValues);
+    }
+
+    virtual void getValueAndDerivativesCSRValues(const vector_t& x, scalar_t* value, scalar_t* gradientValues, scalar_t* hessianValues) {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        if (specifiedFunctionLevel_ >= SpecifiedFunctionLevel::VALUE) {
+            getValue(x, value);
+            getGradientCSRValues(x, gradientValues);
+            if (hessianValues != nullptr) {
+                getHessianCSRValues(x, hessianValues);
+            }
+            return;
+        }
+        cppadInterface_->computeFunctionValueAndDerivatives(x, value, gradientValues, hessianValues);
+    }
+
+    // ------------------------ Evaluate many points at once, see CppAdInterface::computeFunctionValueBatch ------------------------ //
+    // The points are the rows of X and their parameters the rows of P, row i of Y (K x 1) receives the value and row i of
+    // gradientValues the gradient values of point i. Functions without a model of their own evaluate the points one by one.
+    virtual void getValueBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y) {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+            cppadInterface_->computeFunctionValueBatch(X, P, Y);
+            return;
+        }
+        evaluatePointwise(X, &P, Y, nullptr);
+    }
+
+    virtual void getValueBatch(const matrix_t& X, matrix_t& Y) {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+            cppadInterface_->computeFunctionValueBatch(X, Y);
+            return;
+        }
+        evaluatePointwise(X, nullptr, Y, nullptr);
+    }
+
+    virtual void getValueAndGradientCSRValuesBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y, matrix_t& gradientValues) {
+        if (!isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+            cppadInterface_->computeFunctionValueAndJacobianBatch(X, P, Y, gradientValues);
+            return;
+        }
+        evaluatePointwise(X, &P, Y, &gradientValues);
+    }
+
+    virtual void getValueAndGradientCSRValuesBatch(const matrix_t& X, matrix_t& Y, matrix_t& gradientValues) {
+        if (isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+        if (cppadInterface_ && specifiedFunctionLevel_ == SpecifiedFunctionLevel::NONE) {
+            cppadInterface_->computeFunctionValueAndJacobianBatch(X, Y, gradientValues);
+            return;
+        }
+        evaluatePointwise(X, nullptr, Y, &gradientValues);
+    }
+
+    // as above, with the gradient added to the dense gradient
+    void accumulateValueAndDerivatives(const vector_t& x, const vector_t& params, scalar_t* value, vector_t& gradient, scalar_t* hessianValues) {
+        getValueAndDerivativesCSRValues(x, params, value, gradientValues_.data(), hessianValues);
+        scatterGradient(gradient);
+    }
+
+    void accumulateValueAndDerivatives(const vector_t& x, scalar_t* value, vector_t& gradient, scalar_t* hessianValues) {
+        getValueAndDerivativesCSRValues(x, value, gradientValues_.data(), hessianValues);
+        scatterGradient(gradient);
+    }
+
     // ------------------------ Set user specified function information ------------------------ //
     void setHessianFunction(const std::function<sparse_matrix_t(const vector_t&)>& hessianFunction) {
         hessianFunction_ = hessianFunction;
@@ -245,7 +416,50 @@ public:
         return functionName_;
     }
 
+    // independent copy for another thread, sharing the loaded model library
+    virtual std::shared_ptr<ObjectiveFunction> clone() const {
+        return std::make_shared<ObjectiveFunction>(*this);
+    }
+
 protected:
+    // functions without a model of their own (see StageObjectiveFunction), the derived class sets the dimensions
+    ObjectiveFunction(const std::string& functionName, bool isParameterized)
+        : specifiedFunctionLevel_(SpecifiedFunctionLevel::NONE), functionName_(functionName), isParameterized_(isParameterized) {}
+
+    void scatterGradient(vector_t& gradient) const {
+        const CSRSparseMatrix& structure = getGradientCSRStructure();
+        for (size_t i = 0; i < gradientValues_.size(); ++i) {
+            gradient[structure.innerIndices[i]] += gradientValues_[i];
+        }
+    }
+
+    // batch evaluation through the point-wise calls, P and gradientValues may be null
+    void evaluatePointwise(const matrix_t& X, const matrix_t* P, matrix_t& Y, matrix_t* gradientValues) {
+        if (X.cols() != static_cast<Eigen::Index>(variableDim_) || (P != nullptr && P->rows() != X.rows())) {
+            throw std::runtime_error("The batch of " + functionName_ + " does not match the variable dimension or the number of points.");
+        }
+        Y.resize(X.rows(), 1);
+        if (gradientValues != nullptr) {
+            gradientValues->resize(X.rows(), nnzJacobian_);
+        }
+        vector_t x(variableDim_), p, gradient(nnzJacobian_);
+        scalar_t value;
+        for (Eigen::Index i = 0; i < X.rows(); ++i) {
+            x = X.row(i).transpose();
+            if (P != nullptr) {
+                p = P->row(i).transpose();
+            }
+            if (gradientValues != nullptr) {
+                P != nullptr ? getValueAndDerivativesCSRValues(x, p, &value, gradient.data(), nullptr)
+                             : getValueAndDerivativesCSRValues(x, &value, gradient.data(), nullptr);
+                gradientValues->row(i) = gradient.transpose();
+            } else {
+                P != nullptr ? getValue(x, p, &value) : getValue(x, &value);
+            }
+            Y(i, 0) = value;
+        }
+    }
+
     SpecifiedFunctionLevel specifiedFunctionLevel_;
     // User specified function information.
     std::function<sparse_matrix_t(const vector_t&)> hessianFunction_;
@@ -257,6 +471,7 @@ protected:
     size_t nnzJacobian_ = 0;
     std::string functionName_;
     bool isParameterized_ = false;
+    ValueVector gradientValues_; // preallocated values of the sparse gradient
 
 };
     
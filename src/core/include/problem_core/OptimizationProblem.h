@@ -3,7 +3,11 @@
 
 #include "problem_core/ObjectiveFunction.h"
 #include "problem_core/ConstraintFunction.h"
+#include "problem_core/StageObjectiveFunction.h"
+#include "problem_core/StageConstraintFunction.h"
 #include "common/ParametersManager.h"
+#include "common/ThreadPool.h"
+#include <algorithm>
 
 
 
@@ -13,92 +17,165 @@ class OptimizationProblem {
 public:
     // Constructor for problems with parameters
     OptimizationProblem(size_t variableDim, std::shared_ptr<ParametersManager> paramManager, const std::string& name = "")
-        : variableDim_(variableDim), parameterManager_(std::move(paramManager)), problemName_(name), numEqualityConstraints_(0), numInequalityConstraints_(0), numNonZerosEqualityJacobian_(0), numNonZerosInequalityJacobian_(0), numNonZerosObjectiveHessian_(0), numNonZerosObjectiveJacobian_(0) {}
+        : variableDim_(variableDim), parameterManager_(std::move(paramManager)), problemName_(name), numEqualityConstraints_(0), numInequalityConstraints_(0), numNonZerosEqualityJacobian_(0), numNonZerosInequalityJacobian_(0), numNonZerosObjectiveHessian_(0), numNonZerosObjectiveJacobian_(0) {
+            equalityJacobianStructure_.outerIndex.assign(1, 0);
+            inequalityJacobianStructure_.outerIndex.assign(1, 0);
+        }
 
     // Non-parametric constructor
     explicit OptimizationProblem(size_t variableDim, const std::string& name = "")
-        : variableDim_(variableDim), parameterManager_(std::make_shared<ParametersManager>()), problemName_(name), numEqualityConstraints_(0), numInequalityConstraints_(0), numNonZerosEqualityJacobian_(0), numNonZerosInequalityJacobian_(0), numNonZerosObjectiveHessian_(0), numNonZerosObjectiveJacobian_(0) {}
+        : variableDim_(variableDim), parameterManager_(std::make_shared<ParametersManager>()), problemName_(name), numEqualityConstraints_(0), numInequalityConstraints_(0), numNonZerosEqualityJacobian_(0), numNonZerosInequalityJacobian_(0), numNonZerosObjectiveHessian_(0), numNonZerosObjectiveJacobian_(0) {
+            equalityJacobianStructure_.outerIndex.assign(1, 0);
+            inequalityJacobianStructure_.outerIndex.assign(1, 0);
+        }
+
+    // Code generation stage of a problem: every builder constructs one or more of its functions, e.g.
+    // [&] { dynamics = std::make_shared<ConstraintFunction>(...); }, and the builders run on settings.numThreads threads.
+    // The settings become the process-wide CppAdInterface::CodeGenSettings. With settings.bundleLibrary all functions of the
+    // problem end up in one library that is opened once. Add the functions to the problem afterwards.
+    static void generateFunctions(const std::vector<std::function<void()>>& builders, const CppAdInterface::CodeGenSettings& settings) {
+        CppAdInterface::setCodeGenSettings(settings);
+        CppAdInterface::generateInParallel(builders, settings.numThreads);
+    }
 
     // Add objective and constraint functions
     void addObjective(const std::shared_ptr<ObjectiveFunction>& objective) {
         std::string name = objective->getFunctionName();
         objectives_.emplace_back(objective);
         objectiveParamNames_.emplace_back(name);
-        numNonZerosObjectiveJacobian_ += objective->getNumNonZerosJacobian();
-        numNonZerosObjectiveHessian_ += objective->getNumNonZerosHessian();
+        objectiveParamSlots_.push_back(parameterManager_->getParameterSlot(name));
+        // merged patterns of all objective terms, overlapping entries share a slot
+        std::vector<const CSRSparseMatrix*> gradientBlocks;
+        std::vector<const CSRSparseMatrix*> hessianBlocks;
+        for (const auto& term : objectives_) {
+            gradientBlocks.push_back(&term->getGradientCSRStructure());
+            hessianBlocks.push_back(&term->getHessianCSRStructure());
+        }
+        buildUnionStructure(gradientBlocks, 1, false, objectiveGradientStructure_, objectiveGradientScatter_);
+        buildUnionStructure(hessianBlocks, variableDim_, false, objectiveHessianStructure_, objectiveHessianScatter_);
+        objectiveHessianUpperTriangular_ = isUpperTriangular(hessianBlocks, variableDim_);
+        objectiveGradientBlockValues_.resize(objectives_.size());
+        objectiveHessianBlockValues_.resize(objectives_.size());
+        objectiveGradientBlockValues_.back().resize(objective->getNumNonZerosJacobian());
+        objectiveHessianBlockValues_.back().resize(objective->getNumNonZerosHessian());
+        singleObjectiveGradient_ = objectives_.size() == 1 && isIdentityScatter(objectiveGradientScatter_[0]);
+        singleObjectiveHessian_ = objectives_.size() == 1 && isIdentityScatter(objectiveHessianScatter_[0]);
+        numNonZerosObjectiveJacobian_ = objectiveGradientStructure_.innerIndices.size();
+        numNonZerosObjectiveHessian_ = objectiveHessianStructure_.innerIndices.size();
     }
 
     void addEqualityConstraint(const std::shared_ptr<ConstraintFunction>& constraint) {
         std::string name = constraint->getFunctionName();
         equalityConstraints_.emplace_back(constraint);
         equalityParamNames_.emplace_back(name);
+        equalityParamSlots_.push_back(parameterManager_->getParameterSlot(name));
+        equalityRowOffsets_.push_back(numEqualityConstraints_);
+        equalityNonZeroOffsets_.push_back(numNonZerosEqualityJacobian_);
         numEqualityConstraints_ += constraint->getFunDim();
         numNonZerosEqualityJacobian_ += constraint->getNumNonZerosJacobian();
+        appendJacobianStructure(constraint->getGradientCSRStructure(), equalityJacobianStructure_);
     }
 
     void addInequalityConstraint(const std::shared_ptr<ConstraintFunction>& constraint) {
         std::string name = constraint->getFunctionName();
         inequalityConstraints_.emplace_back(constraint);
         inequalityParamNames_.emplace_back(name);
+        inequalityParamSlots_.push_back(parameterManager_->getParameterSlot(name));
+        inequalityRowOffsets_.push_back(numInequalityConstraints_);
+        inequalityNonZeroOffsets_.push_back(numNonZerosInequalityJacobian_);
         numInequalityConstraints_ += constraint->getFunDim();
         numNonZerosInequalityJacobian_ += constraint->getNumNonZerosJacobian();
+        appendJacobianStructure(constraint->getGradientCSRStructure(), inequalityJacobianStructure_);
     }
 
-    void setParameters(const std::string& name, const vector_t& params) {
+    void setParameters(const std::string& name, const vector_cref_t& params) {
         parameterManager_->setParameters(name, params);
     }
 
+    // Independent copy of the problem for another thread: every function is cloned (own model instance and buffers, shared library code)
+    // and the parameters are copied, so the copy can be evaluated and re-parameterized concurrently with this one. The thread pool is not copied.
+    OptimizationProblem clone() const {
+        OptimizationProblem problem(variableDim_, std::make_shared<ParametersManager>(*parameterManager_), problemName_);
+        for (const auto& objective : objectives_) {
+            problem.addObjective(objective->clone());
+        }
+        for (const auto& constraint : equalityConstraints_) {
+            problem.addEqualityConstraint(constraint->clone());
+        }
+        for (const auto& constraint : inequalityConstraints_) {
+            problem.addInequalityConstraint(constraint->clone());
+        }
+        problem.stageVariableDims_ = stageVariableDims_;
+        return problem;
+    }
+
+    std::unordered_map<std::string, vector_t> getParametersMap() const {
+        return parameterManager_->getParametersMap();
+    }
+
+    // opt-in parallel evaluation: the blocks (objective, each constraint function) are evaluated by the pool, nullptr for serial evaluation.
+    // Every function owns its own evaluation buffers, so different blocks can be evaluated concurrently.
+    void setThreadPool(const std::shared_ptr<ThreadPool>& threadPool) {
+        threadPool_ = threadPool;
+    }
+
     scalar_t evaluateObjective(const vector_t& x) const {
         scalar_t value = 0.0;
+        scalar_t currentValue;
         for (size_t i = 0; i < objectives_.size(); ++i) {
             if (objectives_[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[i]->getFunctionName());
-                value += objectives_[i]->getValue(x, params)(0);
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
+                objectives_[i]->getValue(x, params, &currentValue);
             } else {
-                value += objectives_[i]->getValue(x)(0);
+                objectives_[i]->getValue(x, &currentValue);
             }
+            value += currentValue;
         }
         return value;
     }
 
     vector_t evaluateEqualityConstraints(const vector_t& x) const {
-        return evaluateConstraints(x, equalityConstraints_, equalityParamNames_, numEqualityConstraints_);
+        return evaluateConstraints(x, equalityConstraints_, equalityParamSlots_, equalityRowOffsets_, numEqualityConstraints_);
     }
 
     vector_t evaluateInequalityConstraints(const vector_t& x) const {
-        return evaluateConstraints(x, inequalityConstraints_, inequalityParamNames_, numInequalityConstraints_);
+        return evaluateConstraints(x, inequalityConstraints_, inequalityParamSlots_, inequalityRowOffsets_, numInequalityConstraints_);
     }
 
     sparse_matrix_t evaluateEqualityConstraintsJacobian(const vector_t& x) const {
-        return evaluateConstraintsJacobian(x, equalityConstraints_, equalityParamNames_, numEqualityConstraints_);
+        return evaluateConstraintsJacobian(x, equalityConstraints_, equalityParamSlots_, numEqualityConstraints_);
     }
 
     triplet_vector_t evaluateEqualityConstraintsJacobianTriplet(const vector_t& x) const {
-        return evaluateConstraintsJacobianTriplet(x, equalityConstraints_, equalityParamNames_);
+        return evaluateConstraintsJacobianTriplet(x, equalityConstraints_, equalityParamSlots_);
     }
 
     CSRSparseMatrix evaluateEqualityConstraintsJacobianCSR(const vector_t& x) const {
-        return evaluateConstraintsJacobianCSR(x, equalityConstraints_, equalityParamNames_, numEqualityConstraints_, numNonZerosEqualityJacobian_);
+        CSRSparseMatrix jacobianCSR(equalityJacobianStructure_.outerIndex, equalityJacobianStructure_.innerIndices, ValueVector(numNonZerosEqualityJacobian_));
+        evaluateConstraintsJacobianValues(x, equalityConstraints_, equalityParamSlots_, equalityNonZeroOffsets_, jacobianCSR.values.data());
+        return jacobianCSR;
     }
 
 
     sparse_matrix_t evaluateInequalityConstraintsJacobian(const vector_t& x) const {
-        return evaluateConstraintsJacobian(x, inequalityConstraints_, inequalityParamNames_, numInequalityConstraints_);
+        return evaluateConstraintsJacobian(x, inequalityConstraints_, inequalityParamSlots_, numInequalityConstraints_);
     }
 
     triplet_vector_t evaluateInequalityConstraintsJacobianTriplet(const vector_t& x) const {
-        return evaluateConstraintsJacobianTriplet(x, inequalityConstraints_, inequalityParamNames_);
+        return evaluateConstraintsJacobianTriplet(x, inequalityConstraints_, inequalityParamSlots_);
     }
 
     CSRSparseMatrix evaluateInequalityConstraintsJacobianCSR(const vector_t& x) const {
-        return evaluateConstraintsJacobianCSR(x, inequalityConstraints_, inequalityParamNames_, numInequalityConstraints_, numNonZerosInequalityJacobian_);
+        CSRSparseMatrix jacobianCSR(inequalityJacobianStructure_.outerIndex, inequalityJacobianStructure_.innerIndices, ValueVector(numNonZerosInequalityJacobian_));
+        evaluateConstraintsJacobianValues(x, inequalityConstraints_, inequalityParamSlots_, inequalityNonZeroOffsets_, jacobianCSR.values.data());
+        return jacobianCSR;
     }
 
     sparse_matrix_t evaluateObjectiveGradient(const vector_t& x) const {
         sparse_matrix_t gradient(1, variableDim_);
         for (size_t i = 0; i < objectives_.size(); ++i) {
             if (objectives_[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
                 gradient += objectives_[i]->getGradient(x, params);
             } else {
                 gradient += objectives_[i]->getGradient(x);
@@ -111,7 +188,7 @@ public:
         triplet_vector_t gradient;
         for (size_t i = 0; i < objectives_.size(); ++i) {
             if (objectives_[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
                 auto gradientTripletCurrent = objectives_[i]->getGradientTriplet(x, params);
                 gradient.insert(gradient.end(), gradientTripletCurrent.begin(), gradientTripletCurrent.end());
             } else {
@@ -123,15 +200,9 @@ public:
     }
 
     CSRSparseMatrix evaluateObjectiveGradientCSR(const vector_t& x) const {
-        CSRSparseMatrix gradients;    
-            if (objectives_[0]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[0]->getFunctionName());
-                gradients = objectives_[0]->getGradientCSR(x, params);
-            } else {
-                gradients = objectives_[0]->getGradientCSR(x);
-            }
-        
-        return gradients;
+        CSRSparseMatrix gradientCSR(objectiveGradientStructure_.outerIndex, objectiveGradientStructure_.innerIndices, ValueVector(numNonZerosObjectiveJacobian_));
+        evaluateObjectiveGradientCSR(x, gradientCSR);
+        return gradientCSR;
     }
 
 
@@ -139,7 +210,7 @@ public:
         sparse_matrix_t hessian(variableDim_, variableDim_);
         for (size_t i = 0; i < objectives_.size(); ++i) {
             if (objectives_[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
                 hessian += objectives_[i]->getHessian(x, params);
             } else {
                 hessian += objectives_[i]->getHessian(x);
@@ -152,7 +223,7 @@ public:
         triplet_vector_t hessian;
         for (size_t i = 0; i < objectives_.size(); ++i) {
             if (objectives_[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
                 auto hessianTripletCurrent = objectives_[i]->getHessianTriplet(x, params);
                 hessian.insert(hessian.end(), hessianTripletCurrent.begin(), hessianTripletCurrent.end());
             } else {
@@ -164,20 +235,322 @@ public:
     }
 
     CSRSparseMatrix evaluateObjectiveHessianCSR(const vector_t& x) const {
-        CSRSparseMatrix hessians;
-            if (objectives_[0]->isParameterized()) {
-                auto params = parameterManager_->getParameters(objectives_[0]->getFunctionName());
-                hessians = objectives_[0]->getHessianCSR(x, params);
+        CSRSparseMatrix hessianCSR(objectiveHessianStructure_.outerIndex, objectiveHessianStructure_.innerIndices, ValueVector(numNonZerosObjectiveHessian_));
+        evaluateObjectiveHessianCSR(x, hessianCSR);
+        return hessianCSR;
+    }
+
+    // ------------------------ Evaluate into preallocated buffers ------------------------ //
+    // values must be sized to the number of constraints; the CSR matrices must be copies of the stacked structures below,
+    // only their values are refreshed.
+    void evaluateEqualityConstraints(const vector_t& x, vector_t& values) const {
+        evaluateConstraints(x, equalityConstraints_, equalityParamSlots_, equalityRowOffsets_, values);
+    }
+
+    void evaluateInequalityConstraints(const vector_t& x, vector_t& values) const {
+        evaluateConstraints(x, inequalityConstraints_, inequalityParamSlots_, inequalityRowOffsets_, values);
+    }
+
+    void evaluateEqualityConstraintsJacobianCSR(const vector_t& x, CSRSparseMatrix& jacobianCSR) const {
+        evaluateConstraintsJacobianValues(x, equalityConstraints_, equalityParamSlots_, equalityNonZeroOffsets_, jacobianCSR.values.data());
+    }
+
+    void evaluateInequalityConstraintsJacobianCSR(const vector_t& x, CSRSparseMatrix& jacobianCSR) const {
+        evaluateConstraintsJacobianValues(x, inequalityConstraints_, inequalityParamSlots_, inequalityNonZeroOffsets_, jacobianCSR.values.data());
+    }
+
+    // dense objective gradient
+    void evaluateObjectiveGradient(const vector_t& x, vector_t& gradient) const {
+        gradient.setZero();
+        for (size_t i = 0; i < objectives_.size(); ++i) {
+            if (objectives_[i]->isParameterized()) {
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[i]);
+                objectives_[i]->accumulateGradient(x, params, gradient);
+            } else {
+                objectives_[i]->accumulateGradient(x, gradient);
+            }
+        }
+    }
+
+    // sparse gradient and hessian of the sum of all objective terms, in the merged structures below.
+    // A single term writes straight into the output, several terms scatter their values into the precomputed slots.
+    void evaluateObjectiveGradientCSR(const vector_t& x, CSRSparseMatrix& gradientCSR) const {
+        if (singleObjectiveGradient_) {
+            evaluateObjectiveGradientValues(*objectives_[0], objectiveParamSlots_[0], x, gradientCSR.values.data());
+            return;
+        }
+        for (size_t k = 0; k < objectives_.size(); ++k) {
+            evaluateObjectiveGradientValues(*objectives_[k], objectiveParamSlots_[k], x, objectiveGradientBlockValues_[k].data());
+        }
+        std::fill(gradientCSR.values.begin(), gradientCSR.values.end(), 0.0);
+        accumulateBlocks(objectiveGradientScatter_, objectiveGradientBlockValues_, 0, objectives_.size(), 1.0, gradientCSR.values);
+    }
+
+    void evaluateObjectiveHessianCSR(const vector_t& x, CSRSparseMatrix& hessianCSR, bool reuseConstantDerivatives = false) const {
+        if (reuseConstantDerivatives && hasConstantObjectiveHessian()) {
+            return;
+        }
+        if (singleObjectiveHessian_) {
+            evaluateObjectiveHessianValues(*objectives_[0], objectiveParamSlots_[0], x, hessianCSR.values.data());
+            return;
+        }
+        for (size_t k = 0; k < objectives_.size(); ++k) {
+            if (!(reuseConstantDerivatives && objectives_[k]->hasConstantHessian())) {
+                evaluateObjectiveHessianValues(*objectives_[k], objectiveParamSlots_[k], x, objectiveHessianBlockValues_[k].data());
+            }
+        }
+        std::fill(hessianCSR.values.begin(), hessianCSR.values.end(), 0.0);
+        accumulateBlocks(objectiveHessianScatter_, objectiveHessianBlockValues_, 0, objectives_.size(), 1.0, hessianCSR.values);
+    }
+
+    // objective value and all constraint values at one point; with a thread pool the objective overlaps the constraint blocks.
+    void evaluateValues(const vector_t& x, scalar_t& objective, vector_t& eqValues, vector_t& ineqValues) const {
+        size_t numEqBlocks = equalityConstraints_.size();
+        size_t numIneqBlocks = inequalityConstraints_.size();
+        forEachBlock(1 + numEqBlocks + numIneqBlocks, [&](size_t i) {
+            if (i == 0) {
+                objective = evaluateObjective(x);
+            } else if (i <= numEqBlocks) {
+                evaluateConstraintValue(*equalityConstraints_[i - 1], equalityParamSlots_[i - 1], x, eqValues.data() + equalityRowOffsets_[i - 1]);
             } else {
-                hessians = objectives_[0]->getHessianCSR(x);
+                size_t j = i - 1 - numEqBlocks;
+                evaluateConstraintValue(*inequalityConstraints_[j], inequalityParamSlots_[j], x, ineqValues.data() + inequalityRowOffsets_[j]);
             }
-        return hessians;
+        });
+    }
+
+    // objective gradient/hessian and all constraint jacobian values at one point, same buffer requirements as above.
+    // The gradient and the hessian share the buffers of the objective function, so they are evaluated by the same task.
+    // With reuseConstantDerivatives the constant blocks are skipped (see hasConstantEqualityJacobian below).
+    void evaluateDerivatives(const vector_t& x, vector_t& objGradient, CSRSparseMatrix& objHessianCSR, CSRSparseMatrix& eqJacobianCSR, CSRSparseMatrix& ineqJacobianCSR,
+                             bool reuseConstantDerivatives = false) const {
+        size_t numEqBlocks = equalityConstraints_.size();
+        size_t numIneqBlocks = inequalityConstraints_.size();
+        forEachBlock(1 + numEqBlocks + numIneqBlocks, [&](size_t i) {
+            if (i == 0) {
+                evaluateObjectiveGradient(x, objGradient);
+                evaluateObjectiveHessianCSR(x, objHessianCSR, reuseConstantDerivatives);
+            } else {
+                evaluateConstraintJacobianBlock(i - 1, x, eqJacobianCSR, ineqJacobianCSR, reuseConstantDerivatives);
+            }
+        });
+    }
+
+    // first derivatives only, for a model hessian that is not evaluated (quasi-Newton) and functions generated at FIRST_ORDER
+    void evaluateDerivatives(const vector_t& x, vector_t& objGradient, CSRSparseMatrix& eqJacobianCSR, CSRSparseMatrix& ineqJacobianCSR,
+                             bool reuseConstantDerivatives = false) const {
+        size_t numEqBlocks = equalityConstraints_.size();
+        size_t numIneqBlocks = inequalityConstraints_.size();
+        forEachBlock(1 + numEqBlocks + numIneqBlocks, [&](size_t i) {
+            if (i == 0) {
+                evaluateObjectiveGradient(x, objGradient);
+            } else {
+                evaluateConstraintJacobianBlock(i - 1, x, eqJacobianCSR, ineqJacobianCSR, reuseConstantDerivatives);
+            }
+        });
+    }
+
+    // values, gradient and constraint jacobians at one point in a single pass: every function is evaluated by one call of
+    // its fused model, which shares the zero order sweep between the values and the jacobian. The objective hessian is
+    // not part of it (evaluateObjectiveHessianCSR), the solver only needs it at accepted points.
+    // Constant blocks only evaluate their values with reuseConstantDerivatives.
+    void evaluateValuesAndDerivatives(const vector_t& x, scalar_t& objective, vector_t& eqValues, vector_t& ineqValues, vector_t& objGradient,
+                                      CSRSparseMatrix& eqJacobianCSR, CSRSparseMatrix& ineqJacobianCSR, bool reuseConstantDerivatives = false) const {
+        size_t numEqBlocks = equalityConstraints_.size();
+        size_t numIneqBlocks = inequalityConstraints_.size();
+        forEachBlock(1 + numEqBlocks + numIneqBlocks, [&](size_t i) {
+            if (i == 0) {
+                evaluateObjectiveValueAndGradient(x, objective, objGradient);
+            } else if (i <= numEqBlocks) {
+                size_t j = i - 1;
+                ConstraintFunction& constraint = *equalityConstraints_[j];
+                if (reuseConstantDerivatives && constraint.hasConstantJacobian()) {
+                    evaluateConstraintValue(constraint, equalityParamSlots_[j], x, eqValues.data() + equalityRowOffsets_[j]);
+                } else {
+                    evaluateConstraintValueAndJacobian(constraint, equalityParamSlots_[j], x, eqValues.data() + equalityRowOffsets_[j],
+                                                       eqJacobianCSR.values.data() + equalityNonZeroOffsets_[j]);
+                }
+            } else {
+                size_t j = i - 1 - numEqBlocks;
+                ConstraintFunction& constraint = *inequalityConstraints_[j];
+                if (reuseConstantDerivatives && constraint.hasConstantJacobian()) {
+                    evaluateConstraintValue(constraint, inequalityParamSlots_[j], x, ineqValues.data() + inequalityRowOffsets_[j]);
+                } else {
+                    evaluateConstraintValueAndJacobian(constraint, inequalityParamSlots_[j], x, ineqValues.data() + inequalityRowOffsets_[j],
+                                                       ineqJacobianCSR.values.data() + inequalityNonZeroOffsets_[j]);
+                }
+            }
+        });
+    }
+
+    // one objective term or constraint function, found by its name, at the rows of X with its current parameters: row i of Y receives
+    // the value and row i of jacValues (if not null) the jacobian values of point i, in the order of the function's own CSR structure.
+    // Generated functions evaluate the points through their batched models, see CppAdInterface::computeFunctionValueBatch.
+    void evaluateFunctionBatch(const std::string& functionName, const matrix_t& X, matrix_t& Y, matrix_t* jacValues = nullptr) const {
+        for (size_t i = 0; i < objectives_.size(); ++i) {
+            if (objectiveParamNames_[i] == functionName) {
+                return evaluateBatch(*objectives_[i], objectiveParamSlots_[i], X, Y, jacValues);
+            }
+        }
+        for (size_t i = 0; i < equalityConstraints_.size(); ++i) {
+            if (equalityParamNames_[i] == functionName) {
+                return evaluateBatch(*equalityConstraints_[i], equalityParamSlots_[i], X, Y, jacValues);
+            }
+        }
+        for (size_t i = 0; i < inequalityConstraints_.size(); ++i) {
+            if (inequalityParamNames_[i] == functionName) {
+                return evaluateBatch(*inequalityConstraints_[i], inequalityParamSlots_[i], X, Y, jacValues);
+            }
+        }
+        throw std::runtime_error("Problem " + problemName_ + " has no function " + functionName + ".");
+    }
+
+    // ------------------------ Lagrangian hessian ------------------------ //
+    // L(x) = f(x) + eqMultipliers' * c_eq(x) - ineqMultipliers' * c_ineq(x), the signs follow the QP multipliers
+    // (A p = b and G p <= h with G = -[J_ineq, I]). Every nonlinear constraint needs its hessian generated (SECOND_ORDER),
+    // otherwise it would silently drop out of the lagrangian; linear constraints have none and may stay FIRST_ORDER.
+    // The structure is the union of all objective and constraint hessians plus the full diagonal, built once.
+    void initializeLagrangianHessian() {
+        for (const auto& constraint : equalityConstraints_) {
+            checkSecondOrderInformation(*constraint);
+        }
+        for (const auto& constraint : inequalityConstraints_) {
+            checkSecondOrderInformation(*constraint);
+        }
+        std::vector<const CSRSparseMatrix*> blocks;
+        for (const auto& objective : objectives_) {
+            blocks.push_back(&objective->getHessianCSRStructure());
+        }
+        for (const auto& constraint : equalityConstraints_) {
+            blocks.push_back(&constraint->getHessianCSRStructure());
+        }
+        for (const auto& constraint : inequalityConstraints_) {
+            blocks.push_back(&constraint->getHessianCSRStructure());
+        }
+        buildUnionStructure(blocks, variableDim_, true, lagrangianHessianStructure_, lagrangianHessianScatter_);
+        lagrangianHessianUpperTriangular_ = isUpperTriangular(blocks, variableDim_);
+        lagrangianHessianBlockValues_.assign(blocks.size(), ValueVector());
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            lagrangianHessianBlockValues_[b].resize(blocks[b]->innerIndices.size());
+        }
+    }
+
+    const CSRSparseMatrix& getLagrangianHessianCSRStructure() const {
+        return lagrangianHessianStructure_;
+    }
+
+    // as evaluateDerivatives, but with the lagrangian hessian (structure above) instead of the objective hessian.
+    // Every block evaluates its hessian into its own buffer, the buffers are summed after the parallel part.
+    // The buffers of constant objective hessians keep their values with reuseConstantDerivatives.
+    void evaluateDerivatives(const vector_t& x, const vector_t& eqMultipliers, const vector_t& ineqMultipliers, vector_t& objGradient,
+                             CSRSparseMatrix& lagrangianHessianCSR, CSRSparseMatrix& eqJacobianCSR, CSRSparseMatrix& ineqJacobianCSR,
+                             bool reuseConstantDerivatives = false) const {
+        size_t numObjectives = objectives_.size();
+        size_t numEqBlocks = equalityConstraints_.size();
+        size_t numIneqBlocks = inequalityConstraints_.size();
+        forEachBlock(1 + numEqBlocks + numIneqBlocks, [&](size_t i) {
+            if (i == 0) {
+                evaluateObjectiveGradient(x, objGradient);
+                for (size_t k = 0; k < numObjectives; ++k) {
+                    if (!(reuseConstantDerivatives && objectives_[k]->hasConstantHessian())) {
+                        evaluateObjectiveHessianValues(*objectives_[k], objectiveParamSlots_[k], x, lagrangianHessianBlockValues_[k].data());
+                    }
+                }
+            } else if (i <= numEqBlocks) {
+                size_t j = i - 1;
+                ConstraintFunction& constraint = *equalityConstraints_[j];
+                if (!(reuseConstantDerivatives && constraint.hasConstantJacobian())) {
+                    evaluateConstraintJacobianValues(constraint, equalityParamSlots_[j], x, eqJacobianCSR.values.data() + equalityNonZeroOffsets_[j]);
+                }
+                if (constraint.getNumNonZerosHessian() > 0) {
+                    evaluateConstraintHessianValues(constraint, equalityParamSlots_[j], x, eqMultipliers.data() + equalityRowOffsets_[j], lagrangianHessianBlockValues_[numObjectives + j].data());
+                }
+            } else {
+                size_t j = i - 1 - numEqBlocks;
+                ConstraintFunction& constraint = *inequalityConstraints_[j];
+                if (!(reuseConstantDerivatives && constraint.hasConstantJacobian())) {
+                    evaluateConstraintJacobianValues(constraint, inequalityParamSlots_[j], x, ineqJacobianCSR.values.data() + inequalityNonZeroOffsets_[j]);
+                }
+                if (constraint.getNumNonZerosHessian() > 0) {
+                    evaluateConstraintHessianValues(constraint, inequalityParamSlots_[j], x, ineqMultipliers.data() + inequalityRowOffsets_[j], lagrangianHessianBlockValues_[numObjectives + numEqBlocks + j].data());
+                }
+            }
+        });
+        std::fill(lagrangianHessianCSR.values.begin(), lagrangianHessianCSR.values.end(), 0.0);
+        accumulateBlocks(lagrangianHessianScatter_, lagrangianHessianBlockValues_, 0, numObjectives + numEqBlocks, 1.0, lagrangianHessianCSR.values);
+        accumulateBlocks(lagrangianHessianScatter_, lagrangianHessianBlockValues_, numObjectives + numEqBlocks, lagrangianHessianScatter_.size(), -1.0, lagrangianHessianCSR.values);
+    }
+
+    // ------------------------ Stacked sparsity structures, computed once when the functions are added ------------------------ //
+    const CSRSparseMatrix& getEqualityConstraintsJacobianCSRStructure() const {
+        return equalityJacobianStructure_;
+    }
+
+    const CSRSparseMatrix& getInequalityConstraintsJacobianCSRStructure() const {
+        return inequalityJacobianStructure_;
+    }
+
+    const CSRSparseMatrix& getObjectiveGradientCSRStructure() const {
+        return objectiveGradientStructure_;
+    }
+
+    const CSRSparseMatrix& getObjectiveHessianCSRStructure() const {
+        return objectiveHessianStructure_;
+    }
+
+    // the hessian structures only hold their upper triangle, the functions were generated with CodeGenSettings::upperTriangularHessian
+    bool isObjectiveHessianUpperTriangular() const {
+        return objectiveHessianUpperTriangular_;
+    }
+
+    bool isLagrangianHessianUpperTriangular() const {
+        return lagrangianHessianUpperTriangular_;
+    }
+
+    // ------------------------ Constant derivatives ------------------------ //
+    // Constraint functions with a constant jacobian and objective terms with a constant hessian are classified from their tapes
+    // (CppAdInterface::hasConstantJacobian). With reuseConstantDerivatives the evaluations above skip them and keep the values
+    // in the output buffers, which must hold an evaluation at the current parameters. True if every block of the matrix is constant.
+    bool hasConstantEqualityJacobian() const {
+        return std::all_of(equalityConstraints_.begin(), equalityConstraints_.end(), [](const std::shared_ptr<ConstraintFunction>& constraint) {
+            return constraint->hasConstantJacobian();
+        });
+    }
+
+    bool hasConstantInequalityJacobian() const {
+        return std::all_of(inequalityConstraints_.begin(), inequalityConstraints_.end(), [](const std::shared_ptr<ConstraintFunction>& constraint) {
+            return constraint->hasConstantJacobian();
+        });
+    }
+
+    bool hasConstantObjectiveHessian() const {
+        return std::all_of(objectives_.begin(), objectives_.end(), [](const std::shared_ptr<ObjectiveFunction>& objective) {
+            return objective->hasConstantHessian();
+        });
     }
 
     size_t getVariableDim() const {
         return variableDim_;
     }
 
+    // Optional stage structure of a trajectory problem: the variables are stored stage by stage, stage k holding
+    // stageVariableDims[k] consecutive variables. Used by the stage-structured QP backend (qpBackend = 1).
+    void setStageStructure(const SizeVector& stageVariableDims) {
+        size_t total = 0;
+        for (size_t dim : stageVariableDims) {
+            total += dim;
+        }
+        if (total != variableDim_) {
+            throw std::runtime_error("The stage dimensions of problem " + problemName_ + " sum to " + std::to_string(total) +
+                                     " instead of the variable dimension " + std::to_string(variableDim_) + ".");
+        }
+        stageVariableDims_ = stageVariableDims;
+    }
+
+    const SizeVector& getStageStructure() const {
+        return stageVariableDims_;
+    }
+
     size_t getNumObjectives() const {
         return objectives_.size();
     }
@@ -223,27 +596,131 @@ public:
     }
 
 private:
-    vector_t evaluateConstraints(const vector_t& x, const std::vector<std::shared_ptr<ConstraintFunction>>& constraints, const std::vector<std::string>& paramNames, size_t totalRows) const {
-        vector_t allConstraints(totalRows);
-        size_t currentRow = 0;
-        for (size_t i = 0; i < constraints.size(); ++i) {
-            vector_t constrValues;
-            if (constraints[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(constraints[i]->getFunctionName());
-                constrValues = constraints[i]->getValue(x, params);
+    // run task(i) for every block, in parallel when a thread pool is set
+    template <typename Function>
+    void forEachBlock(size_t numBlocks, Function&& task) const {
+        if (threadPool_) {
+            threadPool_->parallelFor(numBlocks, task);
+        } else {
+            for (size_t i = 0; i < numBlocks; ++i) {
+                task(i);
+            }
+        }
+    }
+
+    // the parameters of a parameterized function are the same for every point of the batch
+    template <typename Function>
+    void evaluateBatch(Function& function, size_t parameterSlot, const matrix_t& X, matrix_t& Y, matrix_t* jacValues) const {
+        if (function.isParameterized()) {
+            const matrix_t P = parameterManager_->getParameters(parameterSlot).transpose().replicate(X.rows(), 1);
+            jacValues != nullptr ? function.getValueAndGradientCSRValuesBatch(X, P, Y, *jacValues) : function.getValueBatch(X, P, Y);
+        } else {
+            jacValues != nullptr ? function.getValueAndGradientCSRValuesBatch(X, Y, *jacValues) : function.getValueBatch(X, Y);
+        }
+    }
+
+    void evaluateConstraintValue(ConstraintFunction& constraint, size_t parameterSlot, const vector_t& x, scalar_t* values) const {
+        if (constraint.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            constraint.getValue(x, params, values);
+        } else {
+            constraint.getValue(x, values);
+        }
+    }
+
+    void evaluateConstraintJacobianValues(ConstraintFunction& constraint, size_t parameterSlot, const vector_t& x, scalar_t* values) const {
+        if (constraint.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            constraint.getGradientCSRValues(x, params, values);
+        } else {
+            constraint.getGradientCSRValues(x, values);
+        }
+    }
+
+    // jacobian values of constraint block b, the equality blocks first
+    void evaluateConstraintJacobianBlock(size_t b, const vector_t& x, CSRSparseMatrix& eqJacobianCSR, CSRSparseMatrix& ineqJacobianCSR, bool reuseConstantDerivatives) const {
+        if (b < equalityConstraints_.size()) {
+            if (!(reuseConstantDerivatives && equalityConstraints_[b]->hasConstantJacobian())) {
+                evaluateConstraintJacobianValues(*equalityConstraints_[b], equalityParamSlots_[b], x, eqJacobianCSR.values.data() + equalityNonZeroOffsets_[b]);
+            }
+        } else {
+            size_t j = b - equalityConstraints_.size();
+            if (!(reuseConstantDerivatives && inequalityConstraints_[j]->hasConstantJacobian())) {
+                evaluateConstraintJacobianValues(*inequalityConstraints_[j], inequalityParamSlots_[j], x, ineqJacobianCSR.values.data() + inequalityNonZeroOffsets_[j]);
+            }
+        }
+    }
+
+    void evaluateConstraintHessianValues(ConstraintFunction& constraint, size_t parameterSlot, const vector_t& x, const scalar_t* weights, scalar_t* values) const {
+        if (constraint.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            constraint.getHessianCSRValues(x, params, weights, values);
+        } else {
+            constraint.getHessianCSRValues(x, weights, values);
+        }
+    }
+
+    void evaluateConstraintValueAndJacobian(ConstraintFunction& constraint, size_t parameterSlot, const vector_t& x, scalar_t* values, scalar_t* jacobianValues) const {
+        if (constraint.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            constraint.getValueAndGradientCSRValues(x, params, values, jacobianValues);
+        } else {
+            constraint.getValueAndGradientCSRValues(x, values, jacobianValues);
+        }
+    }
+
+    // sum of all objective terms
+    void evaluateObjectiveValueAndGradient(const vector_t& x, scalar_t& value, vector_t& gradient) const {
+        value = 0.0;
+        gradient.setZero();
+        for (size_t k = 0; k < objectives_.size(); ++k) {
+            ObjectiveFunction& objective = *objectives_[k];
+            scalar_t termValue;
+            if (objective.isParameterized()) {
+                const vector_t& params = parameterManager_->getParameters(objectiveParamSlots_[k]);
+                objective.accumulateValueAndDerivatives(x, params, &termValue, gradient, nullptr);
             } else {
-                constrValues = constraints[i]->getValue(x);
+                objective.accumulateValueAndDerivatives(x, &termValue, gradient, nullptr);
             }
-            std::memcpy(allConstraints.data() + currentRow, constrValues.data(), constrValues.size() * sizeof(scalar_t));
-            currentRow += constrValues.size();
+            value += termValue;
+        }
+    }
+
+    void evaluateObjectiveGradientValues(ObjectiveFunction& objective, size_t parameterSlot, const vector_t& x, scalar_t* values) const {
+        if (objective.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            objective.getGradientCSRValues(x, params, values);
+        } else {
+            objective.getGradientCSRValues(x, values);
         }
+    }
+
+    void evaluateObjectiveHessianValues(ObjectiveFunction& objective, size_t parameterSlot, const vector_t& x, scalar_t* values) const {
+        if (objective.isParameterized()) {
+            const vector_t& params = parameterManager_->getParameters(parameterSlot);
+            objective.getHessianCSRValues(x, params, values);
+        } else {
+            objective.getHessianCSRValues(x, values);
+        }
+    }
+
+    vector_t evaluateConstraints(const vector_t& x, const std::vector<std::shared_ptr<ConstraintFunction>>& constraints, const SizeVector& paramSlots, const SizeVector& rowOffsets, size_t totalRows) const {
+        vector_t allConstraints(totalRows);
+        evaluateConstraints(x, constraints, paramSlots, rowOffsets, allConstraints);
         return allConstraints;
     }
 
+    // each constraint writes its values directly at its precomputed row offset of the stacked vector
+    void evaluateConstraints(const vector_t& x, const std::vector<std::shared_ptr<ConstraintFunction>>& constraints, const SizeVector& paramSlots, const SizeVector& rowOffsets, vector_t& allConstraints) const {
+        forEachBlock(constraints.size(), [&](size_t i) {
+            evaluateConstraintValue(*constraints[i], paramSlots[i], x, allConstraints.data() + rowOffsets[i]);
+        });
+    }
+
     sparse_matrix_t evaluateConstraintsJacobian(
         const vector_t& x,
         const std::vector<std::shared_ptr<ConstraintFunction>>& constraints,
-        const std::vector<std::string>& paramNames,
+        const SizeVector& paramSlots,
         size_t totalRows
     ) const {
         std::vector<Eigen::Triplet<double>> tripletList;
@@ -252,7 +729,7 @@ private:
         for (size_t i = 0; i < constraints.size(); ++i) {
             sparse_matrix_t constrJacobian;
             if (constraints[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(constraints[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(paramSlots[i]);
                 constrJacobian = constraints[i]->getGradient(x, params);
             } else {
                 constrJacobian = constraints[i]->getGradient(x);
@@ -274,7 +751,7 @@ private:
     triplet_vector_t evaluateConstraintsJacobianTriplet(
         const vector_t& x,
         const std::vector<std::shared_ptr<ConstraintFunction>>& constraints,
-        const std::vector<std::string>& paramNames
+        const SizeVector& paramSlots
     ) const {
         triplet_vector_t tripletList;
         size_t currentRow = 0;
@@ -282,7 +759,7 @@ private:
         for (size_t i = 0; i < constraints.size(); ++i) {
             triplet_vector_t constrJacobian;
             if (constraints[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(constraints[i]->getFunctionName());
+                const vector_t& params = parameterManager_->getParameters(paramSlots[i]);
                 constrJacobian = constraints[i]->getGradientTriplet(x, params);
             } else {
                 constrJacobian = constraints[i]->getGradientTriplet(x);
@@ -297,44 +774,120 @@ private:
         return tripletList;
     }
 
-    // generated eigen CSR format sparse matrix of all constraints to speed up sparsity computation
-    CSRSparseMatrix evaluateConstraintsJacobianCSR(
+    // each constraint writes its jacobian values directly at its precomputed non-zero offset of the stacked structure
+    void evaluateConstraintsJacobianValues(
         const vector_t& x,
         const std::vector<std::shared_ptr<ConstraintFunction>>& constraints,
-        const std::vector<std::string>& paramNames,
-        const size_t totalRows,
-        const size_t numNonZeros
+        const SizeVector& paramSlots,
+        const SizeVector& nonZeroOffsets,
+        scalar_t* values
     ) const {
-        CSRSparseMatrix jacobianCSR(totalRows, numNonZeros);
-        // fill in the CSR format
-        size_t currentRow = 0;
-        size_t currentNonZero = 0;
-        for (size_t i = 0; i < constraints.size(); ++i) {
-            CSRSparseMatrix constrJacobianCSR;
-            if (constraints[i]->isParameterized()) {
-                auto params = parameterManager_->getParameters(constraints[i]->getFunctionName());
-                constrJacobianCSR = constraints[i]->getGradientCSR(x, params);
-            } else {
-                constrJacobianCSR = constraints[i]->getGradientCSR(x);
+        forEachBlock(constraints.size(), [&](size_t i) {
+            evaluateConstraintJacobianValues(*constraints[i], paramSlots[i], x, values + nonZeroOffsets[i]);
+        });
+    }
+
+    static void checkSecondOrderInformation(const ConstraintFunction& constraint) {
+        if (!constraint.hasSecondOrderInformation() && !constraint.hasConstantJacobian()) {
+            throw std::runtime_error("The lagrangian hessian (hessianType = 1) needs the constraint " + constraint.getFunctionName() +
+                                     " generated with ModelInfoLevel::SECOND_ORDER.");
+        }
+    }
+
+    // A sum of hessians is stored either full or as its upper triangle, the blocks have to agree. Diagonal blocks fit both,
+    // and blocks without a structure are skipped like in buildUnionStructure.
+    static bool isUpperTriangular(const std::vector<const CSRSparseMatrix*>& blocks, size_t rows) {
+        bool anyLower = false;
+        bool anyUpperOnly = false;
+        for (const CSRSparseMatrix* block : blocks) {
+            if (block->outerIndex.size() != rows + 1) {
+                continue;
             }
-            // contatenate the data vertically
-            
-            size_t constrJacNonZeros = constraints[i]->getNumNonZerosJacobian();
-            size_t constrJacRows = constraints[i]->getFunDim();
-            std::memcpy(jacobianCSR.innerIndices.data() + currentNonZero, constrJacobianCSR.innerIndices.data(), constrJacNonZeros * sizeof(size_t));
-            std::memcpy(jacobianCSR.values.data() + currentNonZero, constrJacobianCSR.values.data(), constrJacNonZeros * sizeof(scalar_t));
-            
-            // adding an offset to the outer index
-            for (size_t& val : constrJacobianCSR.outerIndex) {
-                val += currentNonZero;
+            bool lower = false;
+            bool upper = false;
+            for (size_t row = 0; row < rows; ++row) {
+                for (size_t k = block->outerIndex[row]; k < block->outerIndex[row + 1]; ++k) {
+                    lower = lower || block->innerIndices[k] < row;
+                    upper = upper || block->innerIndices[k] > row;
+                }
+            }
+            anyLower = anyLower || lower;
+            anyUpperOnly = anyUpperOnly || (upper && !lower);
+        }
+        if (anyLower && anyUpperOnly) {
+            throw std::runtime_error("Full and upper triangular hessians are mixed, generate all functions with the same upperTriangularHessian setting.");
+        }
+        return !anyLower;
+    }
+
+    // union of the CSR structures row by row, optionally with the full diagonal. scatter[b][k] is the slot of entry k of block b in the union.
+    // Blocks without a structure (e.g. no second order information) are skipped.
+    static void buildUnionStructure(const std::vector<const CSRSparseMatrix*>& blocks, size_t rows, bool includeDiagonal, CSRSparseMatrix& structure,
+                                    std::vector<SizeVector>& scatter) {
+        structure.outerIndex.assign(rows + 1, 0);
+        structure.innerIndices.clear();
+        SizeVector rowColumns;
+        for (size_t row = 0; row < rows; ++row) {
+            rowColumns.clear();
+            if (includeDiagonal) {
+                rowColumns.push_back(row);
+            }
+            for (const CSRSparseMatrix* block : blocks) {
+                if (block->outerIndex.size() == rows + 1) {
+                    rowColumns.insert(rowColumns.end(), block->innerIndices.begin() + block->outerIndex[row], block->innerIndices.begin() + block->outerIndex[row + 1]);
+                }
             }
-            std::memcpy(jacobianCSR.outerIndex.data() + currentRow + 1, constrJacobianCSR.outerIndex.data() + 1, constrJacRows * sizeof(size_t));
-            currentRow += constrJacRows;
-            currentNonZero += constrJacNonZeros;
+            std::sort(rowColumns.begin(), rowColumns.end());
+            rowColumns.erase(std::unique(rowColumns.begin(), rowColumns.end()), rowColumns.end());
+            structure.innerIndices.insert(structure.innerIndices.end(), rowColumns.begin(), rowColumns.end());
+            structure.outerIndex[row + 1] = structure.innerIndices.size();
         }
+        structure.values.assign(structure.innerIndices.size(), 0.0);
+        scatter.assign(blocks.size(), SizeVector());
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            const CSRSparseMatrix* block = blocks[b];
+            scatter[b].resize(block->innerIndices.size());
+            for (size_t row = 0; row + 1 < block->outerIndex.size() && row < rows; ++row) {
+                auto rowBegin = structure.innerIndices.begin() + structure.outerIndex[row];
+                auto rowEnd = structure.innerIndices.begin() + structure.outerIndex[row + 1];
+                for (size_t k = block->outerIndex[row]; k < block->outerIndex[row + 1]; ++k) {
+                    scatter[b][k] = std::lower_bound(rowBegin, rowEnd, block->innerIndices[k]) - structure.innerIndices.begin();
+                }
+            }
+        }
+    }
 
-        return jacobianCSR;
+    static bool isIdentityScatter(const SizeVector& scatter) {
+        for (size_t k = 0; k < scatter.size(); ++k) {
+            if (scatter[k] != k) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // values[scatter[b][k]] += sign * blockValues[b][k] for the blocks [first, last)
+    static void accumulateBlocks(const std::vector<SizeVector>& scatter, const std::vector<ValueVector>& blockValues, size_t first, size_t last, scalar_t sign,
+                                 ValueVector& values) {
+        for (size_t b = first; b < last; ++b) {
+            const SizeVector& slots = scatter[b];
+            const ValueVector& block = blockValues[b];
+            for (size_t k = 0; k < slots.size(); ++k) {
+                values[slots[k]] += sign * block[k];
+            }
+        }
     }
+
+    // concatenate the jacobian structure of a new constraint vertically
+    static void appendJacobianStructure(const CSRSparseMatrix& block, CSRSparseMatrix& stacked) {
+        size_t offset = stacked.innerIndices.size();
+        stacked.innerIndices.insert(stacked.innerIndices.end(), block.innerIndices.begin(), block.innerIndices.end());
+        for (size_t j = 1; j < block.outerIndex.size(); ++j) {
+            stacked.outerIndex.push_back(block.outerIndex[j] + offset);
+        }
+        stacked.values.resize(stacked.innerIndices.size());
+    }
+
     size_t variableDim_;
     size_t numEqualityConstraints_;
     size_t numInequalityConstraints_;
@@ -350,6 +903,34 @@ private:
     std::vector<std::string> objectiveParamNames_;
     std::vector<std::string> equalityParamNames_;
     std::vector<std::string> inequalityParamNames_;
+    // parameter slots of the functions, resolved when they are added
+    SizeVector objectiveParamSlots_;
+    SizeVector equalityParamSlots_;
+    SizeVector inequalityParamSlots_;
+    SizeVector stageVariableDims_; // empty: no stage structure
+    CSRSparseMatrix equalityJacobianStructure_;
+    CSRSparseMatrix inequalityJacobianStructure_;
+    // row and non-zero offsets of each constraint function in the stacked values and jacobians
+    SizeVector equalityRowOffsets_;
+    SizeVector equalityNonZeroOffsets_;
+    SizeVector inequalityRowOffsets_;
+    SizeVector inequalityNonZeroOffsets_;
+    std::shared_ptr<ThreadPool> threadPool_;
+    // lagrangian hessian: union structure, per block (objectives, equalities, inequalities) the slot map and the value buffer
+    CSRSparseMatrix lagrangianHessianStructure_;
+    bool lagrangianHessianUpperTriangular_ = false;
+    std::vector<SizeVector> lagrangianHessianScatter_;
+    mutable std::vector<ValueVector> lagrangianHessianBlockValues_;
+    // merged structures of the objective terms, per term the slot map and the value buffer
+    CSRSparseMatrix objectiveGradientStructure_;
+    CSRSparseMatrix objectiveHessianStructure_;
+    bool objectiveHessianUpperTriangular_ = false;
+    std::vector<SizeVector> objectiveGradientScatter_;
+    std::vector<SizeVector> objectiveHessianScatter_;
+    mutable std::vector<ValueVector> objectiveGradientBlockValues_;
+    mutable std::vector<ValueVector> objectiveHessianBlockValues_;
+    bool singleObjectiveGradient_ = false; // one term whose structure is the merged one, evaluated in place
+    bool singleObjectiveHessian_ = false;
 
 };
 
@@ -0,0 +1,228 @@
+#ifndef STAGE_CONSTRAINT_FUNCTION_H
+#define STAGE_CONSTRAINT_FUNCTION_H
+
+#include "problem_core/ConstraintFunction.h"
+#include "problem_core/StageFunction.h"
+
+namespace CRISP {
+// The constraints of all stages of a layout, c(x) = [c_0(x_window_0); ...; c_{N-1}(x_window_{N-1})] with one kernel c_k = kernel
+// for every stage. To the problem it is a constraint function of variableDim variables and numStages * kernel rows, the jacobian
+// is the block structure of the kernel jacobian shifted to the windows.
+class StageConstraintFunction : public ConstraintFunction {
+public:
+    // kernel: a constraint function of layout.stageDim variables, e.g. generated like any other ConstraintFunction.
+    // The stage function takes over its function name, parameters are set under that name.
+    StageConstraintFunction(size_t variableDim, const StageLayout& layout, const std::shared_ptr<ConstraintFunction>& kernel)
+        : ConstraintFunction(kernel->getFunctionName(), kernel->isParameterized()), stages_(kernel, layout, variableDim) {
+        variableDim_ = variableDim;
+        parameterDim_ = kernel->getParameterDim();
+        funDim_ = layout.numStages * kernel->getFunDim();
+        nnzJacobian_ = layout.numStages * kernel->getNumNonZerosJacobian();
+        jacobianStructure_ = stages_.stackedStructure(kernel->getGradientCSRStructure());
+        stages_.summedStructure(kernel->getHessianCSRStructure(), variableDim_, true, hessianStructure_, hessianScatter_);
+        stageHessianValues_.resize(hessianScatter_.size());
+    }
+
+    // generates the kernel itself, the arguments are those of ConstraintFunction for a kernel of layout.stageDim variables
+    StageConstraintFunction(size_t variableDim, const StageLayout& layout, const std::string& modelName, const std::string& folderName,
+                            const std::string& functionName, const ad_function_t& function, bool regenerateLibrary = false,
+                            CppAdInterface::ModelInfoLevel infoLevel = CppAdInterface::ModelInfoLevel::FIRST_ORDER)
+        : StageConstraintFunction(variableDim, layout, std::make_shared<ConstraintFunction>(layout.stageDim, modelName, folderName, functionName, function, regenerateLibrary, infoLevel)) {}
+
+    StageConstraintFunction(size_t variableDim, const StageLayout& layout, size_t parameterDim, const std::string& modelName, const std::string& folderName,
+                            const std::string& functionName, const ad_function_with_param_t& function, bool regenerateLibrary = false,
+                            CppAdInterface::ModelInfoLevel infoLevel = CppAdInterface::ModelInfoLevel::FIRST_ORDER)
+        : StageConstraintFunction(variableDim, layout, std::make_shared<ConstraintFunction>(layout.stageDim, parameterDim, modelName, folderName, functionName, function, regenerateLibrary, infoLevel)) {}
+
+    // nullptr for serial evaluation, see StageEvaluator::setThreadPool
+    void setThreadPool(const std::shared_ptr<ThreadPool>& threadPool) {
+        stages_.setThreadPool(threadPool);
+    }
+
+    const StageLayout& getLayout() const {
+        return stages_.getLayout();
+    }
+
+    const std::shared_ptr<ConstraintFunction>& getKernel() const {
+        return stages_.getKernelPointer();
+    }
+
+    //  ------------------------ Evaluate into preallocated buffers ------------------------ //
+    void getValue(const vector_t& x, const vector_t& params, scalar_t* value) override {
+        requireParameters(true);
+        evaluateValues(x, &params, value);
+    }
+
+    void getValue(const vector_t& x, scalar_t* value) override {
+        requireParameters(false);
+        evaluateValues(x, nullptr, value);
+    }
+
+    void getGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) override {
+        requireParameters(true);
+        evaluateJacobianValues(x, &params, values);
+    }
+
+    void getGradientCSRValues(const vector_t& x, scalar_t* values) override {
+        requireParameters(false);
+        evaluateJacobianValues(x, nullptr, values);
+    }
+
+    void getValueAndGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* value, scalar_t* jacValues) override {
+        requireParameters(true);
+        evaluateValuesAndJacobianValues(x, &params, value, jacValues);
+    }
+
+    void getValueAndGradientCSRValues(const vector_t& x, scalar_t* value, scalar_t* jacValues) override {
+        requireParameters(false);
+        evaluateValuesAndJacobianValues(x, nullptr, value, jacValues);
+    }
+
+    void getHessianCSRValues(const vector_t& x, const vector_t& params, const scalar_t* weights, scalar_t* values) override {
+        requireParameters(true);
+        evaluateHessianValues(x, &params, weights, values);
+    }
+
+    void getHessianCSRValues(const vector_t& x, const scalar_t* weights, scalar_t* values) override {
+        requireParameters(false);
+        evaluateHessianValues(x, nullptr, weights, values);
+    }
+
+    //  ------------------------ Allocating interface, built on the buffers above ------------------------ //
+    vector_t getValue(const vector_t& x, const vector_t& params) override {
+        vector_t value(funDim_);
+        getValue(x, params, value.data());
+        return value;
+    }
+
+    vector_t getValue(const vector_t& x) override {
+        vector_t value(funDim_);
+        getValue(x, value.data());
+        return value;
+    }
+
+    CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) override {
+        CSRSparseMatrix jacobian = jacobianStructure_;
+        getGradientCSRValues(x, params, jacobian.values.data());
+        return jacobian;
+    }
+
+    CSRSparseMatrix getGradientCSR(const vector_t& x) override {
+        CSRSparseMatrix jacobian = jacobianStructure_;
+        getGradientCSRValues(x, jacobian.values.data());
+        return jacobian;
+    }
+
+    triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) override {
+        return StageEvaluator<ConstraintFunction>::toTriplets(getGradientCSR(x, params));
+    }
+
+    triplet_vector_t getGradientTriplet(const vector_t& x) override {
+        return StageEvaluator<ConstraintFunction>::toTriplets(getGradientCSR(x));
+    }
+
+    sparse_matrix_t getGradient(const vector_t& x, const vector_t& params) override {
+        return toSparseMatrix(getGradientTriplet(x, params));
+    }
+
+    sparse_matrix_t getGradient(const vector_t& x) override {
+        return toSparseMatrix(getGradientTriplet(x));
+    }
+
+    const CSRSparseMatrix& getGradientCSRStructure() const override {
+        return jacobianStructure_;
+    }
+
+    const CSRSparseMatrix& getHessianCSRStructure() const override {
+        return hessianStructure_;
+    }
+
+    size_t getNumNonZerosHessian() const override {
+        return hessianStructure_.innerIndices.size();
+    }
+
+    bool hasConstantJacobian() const override {
+        return stages_.getKernel().hasConstantJacobian();
+    }
+
+    bool hasSecondOrderInformation() const override {
+        return stages_.getKernel().hasSecondOrderInformation();
+    }
+
+    std::shared_ptr<ConstraintFunction> clone() const override {
+        return std::make_shared<StageConstraintFunction>(*this);
+    }
+
+private:
+    void requireParameters(bool withParameters) const {
+        if (withParameters && !isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (!withParameters && isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+    }
+
+    void evaluateValues(const vector_t& x, const vector_t* params, scalar_t* value) {
+        size_t kernelRows = stages_.getKernel().getFunDim();
+        stages_.forEachStage(x, params, [&](ConstraintFunction& kernel, const vector_t& xStage, const vector_t* pStage, size_t k) {
+            if (pStage != nullptr) {
+                kernel.getValue(xStage, *pStage, value + k * kernelRows);
+            } else {
+                kernel.getValue(xStage, value + k * kernelRows);
+            }
+        });
+    }
+
+    void evaluateJacobianValues(const vector_t& x, const vector_t* params, scalar_t* values) {
+        size_t kernelNonZeros = stages_.getKernel().getNumNonZerosJacobian();
+        stages_.forEachStage(x, params, [&](ConstraintFunction& kernel, const vector_t& xStage, const vector_t* pStage, size_t k) {
+            if (pStage != nullptr) {
+                kernel.getGradientCSRValues(xStage, *pStage, values + k * kernelNonZeros);
+            } else {
+                kernel.getGradientCSRValues(xStage, values + k * kernelNonZeros);
+            }
+        });
+    }
+
+    void evaluateValuesAndJacobianValues(const vector_t& x, const vector_t* params, scalar_t* value, scalar_t* jacValues) {
+        size_t kernelRows = stages_.getKernel().getFunDim();
+        size_t kernelNonZeros = stages_.getKernel().getNumNonZerosJacobian();
+        stages_.forEachStage(x, params, [&](ConstraintFunction& kernel, const vector_t& xStage, const vector_t* pStage, size_t k) {
+            if (pStage != nullptr) {
+                kernel.getValueAndGradientCSRValues(xStage, *pStage, value + k * kernelRows, jacValues + k * kernelNonZeros);
+            } else {
+                kernel.getValueAndGradientCSRValues(xStage, value + k * kernelRows, jacValues + k * kernelNonZeros);
+            }
+        });
+    }
+
+    // the stage hessians overlap on the shared variables, every stage writes its own block and the blocks are summed afterwards
+    void evaluateHessianValues(const vector_t& x, const vector_t* params, const scalar_t* weights, scalar_t* values) {
+        size_t kernelRows = stages_.getKernel().getFunDim();
+        size_t kernelNonZeros = stages_.getKernel().getNumNonZerosHessian();
+        stages_.forEachStage(x, params, [&](ConstraintFunction& kernel, const vector_t& xStage, const vector_t* pStage, size_t k) {
+            if (pStage != nullptr) {
+                kernel.getHessianCSRValues(xStage, *pStage, weights + k * kernelRows, stageHessianValues_.data() + k * kernelNonZeros);
+            } else {
+                kernel.getHessianCSRValues(xStage, weights + k * kernelRows, stageHessianValues_.data() + k * kernelNonZeros);
+            }
+        });
+        StageEvaluator<ConstraintFunction>::accumulate(hessianScatter_, stageHessianValues_, values, hessianStructure_.innerIndices.size());
+    }
+
+    sparse_matrix_t toSparseMatrix(const triplet_vector_t& triplets) const {
+        sparse_matrix_t matrix(funDim_, variableDim_);
+        matrix.setFromTriplets(triplets.begin(), triplets.end());
+        return matrix;
+    }
+
+    StageEvaluator<ConstraintFunction> stages_;
+    CSRSparseMatrix jacobianStructure_;
+    CSRSparseMatrix hessianStructure_;      // union of the shifted kernel hessians
+    SizeVector hessianScatter_;             // stage hessian entry -> slot of hessianStructure_
+    ValueVector stageHessianValues_;        // hessian values of every stage, numStages * kernel non-zeros
+};
+} // namespace CRISP
+
+#endif // STAGE_CONSTRAINT_FUNCTION_H
@@ -0,0 +1,210 @@
+// NOTE: stage-template functions. A trajectory constraint or cost is usually one term per time step that only reads the
+// variables of its own stage and of the next one. Instead of taping the whole horizon, the term of a single stage (the
+// kernel) is taped and compiled once, with the variable window of one stage as its input, and then evaluated over all
+// stages. The tape, the generated code and the library therefore keep their size for any number of stages.
+#ifndef STAGE_FUNCTION_H
+#define STAGE_FUNCTION_H
+
+#include "common/ThreadPool.h"
+#include <algorithm>
+#include <tuple>
+
+namespace CRISP {
+// Stage k reads the variables [offset + k * stride, offset + k * stride + stageDim) of the problem, e.g. for variables
+// stored stage by stage as [x_0, u_0, x_1, u_1, ...] the kernel of (x_k, u_k, x_{k+1}) has stageDim = 2 * nx + nu and stride = nx + nu.
+struct StageLayout {
+    size_t numStages = 0;
+    size_t stageDim = 0; // input dimension of the kernel
+    size_t stride = 0;   // distance of the windows of consecutive stages
+    size_t offset = 0;   // first variable of stage 0
+    StageLayout() = default;
+    StageLayout(size_t numStages, size_t stageDim, size_t stride, size_t offset = 0)
+        : numStages(numStages), stageDim(stageDim), stride(stride), offset(offset) {}
+
+    size_t windowOffset(size_t stage) const {
+        return offset + stage * stride;
+    }
+};
+
+// Evaluates a kernel (ConstraintFunction or ObjectiveFunction) over the stages of a layout. The parameters of a parameterized
+// kernel are either shared by all stages (parameterDim values) or given per stage (numStages * parameterDim values, stage k
+// reads the k-th segment). With a thread pool the stages are split into one contiguous chunk per thread, every chunk evaluates
+// its own copy of the kernel.
+template <typename Kernel>
+class StageEvaluator {
+public:
+    StageEvaluator(const std::shared_ptr<Kernel>& kernel, const StageLayout& layout, size_t variableDim) : layout_(layout) {
+        if (layout_.numStages == 0 || kernel->getVariableDim() != layout_.stageDim) {
+            throw std::runtime_error("The kernel " + kernel->getFunctionName() + " has " + std::to_string(kernel->getVariableDim()) +
+                                     " inputs, the stage layout expects " + std::to_string(layout_.stageDim) + ".");
+        }
+        if (layout_.windowOffset(layout_.numStages - 1) + layout_.stageDim > variableDim) {
+            throw std::runtime_error("The last stage of " + kernel->getFunctionName() + " ends after the " + std::to_string(variableDim) + " variables.");
+        }
+        addWorkspace(kernel);
+    }
+
+    // the copies for another thread get their own kernels, like the clone of a function
+    StageEvaluator(const StageEvaluator& other) : layout_(other.layout_), threadPool_(other.threadPool_) {
+        for (const Workspace& workspace : other.workspaces_) {
+            addWorkspace(workspace.kernel->clone());
+        }
+    }
+    StageEvaluator& operator=(const StageEvaluator&) = delete;
+
+    // nullptr for serial evaluation. The pool may be the one of the problem, a stage function evaluated by one of its
+    // tasks then runs its stages serially.
+    void setThreadPool(const std::shared_ptr<ThreadPool>& threadPool) {
+        threadPool_ = threadPool;
+        size_t numChunks = threadPool_ ? std::min(threadPool_->size(), layout_.numStages) : 1;
+        while (workspaces_.size() < numChunks) {
+            addWorkspace(workspaces_[0].kernel->clone());
+        }
+    }
+
+    const StageLayout& getLayout() const {
+        return layout_;
+    }
+
+    Kernel& getKernel() const {
+        return *workspaces_[0].kernel;
+    }
+
+    const std::shared_ptr<Kernel>& getKernelPointer() const {
+        return workspaces_[0].kernel;
+    }
+
+    // task(kernel, xStage, paramsStage, k) for every stage, paramsStage is null for a kernel without parameters
+    template <typename Function>
+    void forEachStage(const vector_t& x, const vector_t* params, Function&& task) {
+        if (params != nullptr && params->size() != parameterDim() && params->size() != layout_.numStages * parameterDim()) {
+            throw std::runtime_error("The parameters of " + getKernel().getFunctionName() + " have size " + std::to_string(params->size()) + ", expected " +
+                                     std::to_string(parameterDim()) + " (shared) or " + std::to_string(layout_.numStages * parameterDim()) + " (per stage).");
+        }
+        size_t numChunks = threadPool_ ? std::min(workspaces_.size(), threadPool_->size()) : 1;
+        auto runChunk = [&](size_t chunk) {
+            Workspace& workspace = workspaces_[chunk];
+            size_t first = layout_.numStages * chunk / numChunks;
+            size_t last = layout_.numStages * (chunk + 1) / numChunks;
+            for (size_t k = first; k < last; ++k) {
+                workspace.x = x.segment(layout_.windowOffset(k), layout_.stageDim);
+                const vector_t* stageParams = params;
+                if (params != nullptr && params->size() != parameterDim()) {
+                    workspace.p = params->segment(k * parameterDim(), parameterDim());
+                    stageParams = &workspace.p;
+                }
+                task(*workspace.kernel, workspace.x, stageParams, k);
+            }
+        };
+        if (numChunks > 1) {
+            threadPool_->parallelFor(numChunks, runChunk);
+        } else {
+            runChunk(0);
+        }
+    }
+
+    // jacobian of the stacked stage functions: the rows of stage k follow the rows of stage k - 1, the columns are shifted to the window
+    CSRSparseMatrix stackedStructure(const CSRSparseMatrix& kernelStructure) const {
+        CSRSparseMatrix structure;
+        size_t kernelRows = kernelStructure.outerIndex.size() - 1;
+        size_t kernelNonZeros = kernelStructure.innerIndices.size();
+        structure.outerIndex.reserve(layout_.numStages * kernelRows + 1);
+        structure.outerIndex.push_back(0);
+        structure.innerIndices.reserve(layout_.numStages * kernelNonZeros);
+        for (size_t k = 0; k < layout_.numStages; ++k) {
+            for (size_t row = 0; row < kernelRows; ++row) {
+                structure.outerIndex.push_back(structure.outerIndex.back() + kernelStructure.outerIndex[row + 1] - kernelStructure.outerIndex[row]);
+            }
+            for (size_t column : kernelStructure.innerIndices) {
+                structure.innerIndices.push_back(column + layout_.windowOffset(k));
+            }
+        }
+        structure.values.assign(structure.innerIndices.size(), 0.0);
+        return structure;
+    }
+
+    // sum of the stage functions, e.g. a hessian (shiftRows, rows = variableDim) or a gradient (rows = 1): the union of the
+    // shifted kernel structures, scatter[k * kernelNonZeros + j] is the slot of entry j of stage k
+    void summedStructure(const CSRSparseMatrix& kernelStructure, size_t rows, bool shiftRows, CSRSparseMatrix& structure, SizeVector& scatter) const {
+        structure.outerIndex.assign(rows + 1, 0);
+        structure.innerIndices.clear();
+        scatter.clear();
+        if (kernelStructure.outerIndex.size() < 2) {
+            structure.values.clear();
+            return; // e.g. no second order information
+        }
+        size_t kernelRows = kernelStructure.outerIndex.size() - 1;
+        size_t kernelNonZeros = kernelStructure.innerIndices.size();
+        std::vector<std::tuple<size_t, size_t, size_t>> entries; // row, column, stage entry
+        entries.reserve(layout_.numStages * kernelNonZeros);
+        for (size_t k = 0; k < layout_.numStages; ++k) {
+            size_t shift = layout_.windowOffset(k);
+            for (size_t row = 0; row < kernelRows; ++row) {
+                for (size_t j = kernelStructure.outerIndex[row]; j < kernelStructure.outerIndex[row + 1]; ++j) {
+                    entries.emplace_back(shiftRows ? row + shift : row, kernelStructure.innerIndices[j] + shift, k * kernelNonZeros + j);
+                }
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+        scatter.resize(entries.size());
+        for (size_t e = 0; e < entries.size(); ++e) {
+            size_t row = std::get<0>(entries[e]);
+            size_t column = std::get<1>(entries[e]);
+            if (e == 0 || row != std::get<0>(entries[e - 1]) || column != std::get<1>(entries[e - 1])) {
+                structure.innerIndices.push_back(column);
+                ++structure.outerIndex[row + 1];
+            }
+            scatter[std::get<2>(entries[e])] = structure.innerIndices.size() - 1;
+        }
+        for (size_t row = 0; row < rows; ++row) {
+            structure.outerIndex[row + 1] += structure.outerIndex[row];
+        }
+        structure.values.assign(structure.innerIndices.size(), 0.0);
+    }
+
+    // values[scatter[i]] += stageValues[i], values is cleared first
+    static void accumulate(const SizeVector& scatter, const ValueVector& stageValues, scalar_t* values, size_t numValues) {
+        std::fill(values, values + numValues, 0.0);
+        for (size_t i = 0; i < scatter.size(); ++i) {
+            values[scatter[i]] += stageValues[i];
+        }
+    }
+
+    // entries of a CSR matrix, for the allocating interfaces
+    static triplet_vector_t toTriplets(const CSRSparseMatrix& matrix) {
+        triplet_vector_t triplets;
+        triplets.reserve(matrix.innerIndices.size());
+        for (size_t row = 0; row + 1 < matrix.outerIndex.size(); ++row) {
+            for (size_t j = matrix.outerIndex[row]; j < matrix.outerIndex[row + 1]; ++j) {
+                triplets.emplace_back(row, matrix.innerIndices[j], matrix.values[j]);
+            }
+        }
+        return triplets;
+    }
+
+private:
+    struct Workspace {
+        std::shared_ptr<Kernel> kernel;
+        vector_t x; // window of the current stage
+        vector_t p; // parameters of the current stage
+    };
+
+    void addWorkspace(const std::shared_ptr<Kernel>& kernel) {
+        Workspace workspace;
+        workspace.kernel = kernel;
+        workspace.x.resize(layout_.stageDim);
+        workspace.p.resize(kernel->getParameterDim());
+        workspaces_.push_back(std::move(workspace));
+    }
+
+    size_t parameterDim() const {
+        return workspaces_[0].kernel->getParameterDim();
+    }
+
+    StageLayout layout_;
+    std::vector<Workspace> workspaces_; // one per chunk, workspaces_[0] holds the kernel given by the user
+    std::shared_ptr<ThreadPool> threadPool_;
+};
+} // namespace CRISP
+
+#endif // STAGE_FUNCTION_H
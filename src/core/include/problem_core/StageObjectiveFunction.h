@@ -0,0 +1,261 @@
+#ifndef STAGE_OBJECTIVE_FUNCTION_H
+#define STAGE_OBJECTIVE_FUNCTION_H
+
+#include "problem_core/ObjectiveFunction.h"
+#include "problem_core/StageFunction.h"
+
+namespace CRISP {
+// The sum of a stage cost over all stages of a layout, f(x) = sum_k kernel(x_window_k). The gradient and the hessian are
+// stored in the union of the shifted kernel structures, overlapping windows share their entries.
+class StageObjectiveFunction : public ObjectiveFunction {
+public:
+    // kernel: an objective function of layout.stageDim variables, the stage function takes over its function name
+    StageObjectiveFunction(size_t variableDim, const StageLayout& layout, const std::shared_ptr<ObjectiveFunction>& kernel)
+        : ObjectiveFunction(kernel->getFunctionName(), kernel->isParameterized()), stages_(kernel, layout, variableDim) {
+        variableDim_ = variableDim;
+        parameterDim_ = kernel->getParameterDim();
+        stages_.summedStructure(kernel->getGradientCSRStructure(), 1, false, gradientStructure_, gradientScatter_);
+        stages_.summedStructure(kernel->getHessianCSRStructure(), variableDim_, true, hessianStructure_, hessianScatter_);
+        nnzJacobian_ = gradientStructure_.innerIndices.size();
+        nnzHessian_ = hessianStructure_.innerIndices.size();
+        // a kernel generated with CodeGenSettings::upperTriangularHessian gives a structure without entries below the diagonal
+        for (size_t row = 0; row + 1 < hessianStructure_.outerIndex.size(); ++row) {
+            for (sparse_index_t j = hessianStructure_.outerIndex[row]; j < hessianStructure_.outerIndex[row + 1]; ++j) {
+                hessianUpperTriangular_ = hessianUpperTriangular_ && static_cast<size_t>(hessianStructure_.innerIndices[j]) >= row;
+            }
+        }
+        gradientValues_.resize(nnzJacobian_);
+        stageValues_.resize(layout.numStages);
+        stageGradientValues_.resize(gradientScatter_.size());
+        stageHessianValues_.resize(hessianScatter_.size());
+    }
+
+    // generates the kernel itself, the arguments are those of ObjectiveFunction for a kernel of layout.stageDim variables
+    StageObjectiveFunction(size_t variableDim, const StageLayout& layout, const std::string& modelName, const std::string& folderName,
+                           const std::string& functionName, const ad_function_t& function, bool regenerateLibrary = false,
+                           CppAdInterface::ModelInfoLevel infoLevel = CppAdInterface::ModelInfoLevel::SECOND_ORDER)
+        : StageObjectiveFunction(variableDim, layout, std::make_shared<ObjectiveFunction>(layout.stageDim, modelName, folderName, functionName, function, regenerateLibrary, infoLevel)) {}
+
+    StageObjectiveFunction(size_t variableDim, const StageLayout& layout, size_t parameterDim, const std::string& modelName, const std::string& folderName,
+                           const std::string& functionName, const ad_function_with_param_t& function, bool regenerateLibrary = false,
+                           CppAdInterface::ModelInfoLevel infoLevel = CppAdInterface::ModelInfoLevel::SECOND_ORDER)
+        : StageObjectiveFunction(variableDim, layout, std::make_shared<ObjectiveFunction>(layout.stageDim, parameterDim, modelName, folderName, functionName, function, regenerateLibrary, infoLevel)) {}
+
+    // nullptr for serial evaluation, see StageEvaluator::setThreadPool
+    void setThreadPool(const std::shared_ptr<ThreadPool>& threadPool) {
+        stages_.setThreadPool(threadPool);
+    }
+
+    const StageLayout& getLayout() const {
+        return stages_.getLayout();
+    }
+
+    const std::shared_ptr<ObjectiveFunction>& getKernel() const {
+        return stages_.getKernelPointer();
+    }
+
+    //  ------------------------ Evaluate into preallocated buffers ------------------------ //
+    void getValue(const vector_t& x, const vector_t& params, scalar_t* value) override {
+        requireParameters(true);
+        evaluate(x, &params, value, nullptr, nullptr);
+    }
+
+    void getValue(const vector_t& x, scalar_t* value) override {
+        requireParameters(false);
+        evaluate(x, nullptr, value, nullptr, nullptr);
+    }
+
+    void getGradientCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) override {
+        requireParameters(true);
+        evaluate(x, &params, nullptr, values, nullptr);
+    }
+
+    void getGradientCSRValues(const vector_t& x, scalar_t* values) override {
+        requireParameters(false);
+        evaluate(x, nullptr, nullptr, values, nullptr);
+    }
+
+    void getHessianCSRValues(const vector_t& x, const vector_t& params, scalar_t* values) override {
+        requireParameters(true);
+        evaluate(x, &params, nullptr, nullptr, values);
+    }
+
+    void getHessianCSRValues(const vector_t& x, scalar_t* values) override {
+        requireParameters(false);
+        evaluate(x, nullptr, nullptr, nullptr, values);
+    }
+
+    void getValueAndDerivativesCSRValues(const vector_t& x, const vector_t& params, scalar_t* value, scalar_t* gradientValues, scalar_t* hessianValues) override {
+        requireParameters(true);
+        evaluate(x, &params, value, gradientValues, hessianValues);
+    }
+
+    void getValueAndDerivativesCSRValues(const vector_t& x, scalar_t* value, scalar_t* gradientValues, scalar_t* hessianValues) override {
+        requireParameters(false);
+        evaluate(x, nullptr, value, gradientValues, hessianValues);
+    }
+
+    //  ------------------------ Allocating interface, built on the buffers above ------------------------ //
+    vector_t getValue(const vector_t& x, const vector_t& params) override {
+        vector_t value(1);
+        getValue(x, params, value.data());
+        return value;
+    }
+
+    vector_t getValue(const vector_t& x) override {
+        vector_t value(1);
+        getValue(x, value.data());
+        return value;
+    }
+
+    CSRSparseMatrix getGradientCSR(const vector_t& x, const vector_t& params) override {
+        CSRSparseMatrix gradient = gradientStructure_;
+        getGradientCSRValues(x, params, gradient.values.data());
+        return gradient;
+    }
+
+    CSRSparseMatrix getGradientCSR(const vector_t& x) override {
+        CSRSparseMatrix gradient = gradientStructure_;
+        getGradientCSRValues(x, gradient.values.data());
+        return gradient;
+    }
+
+    triplet_vector_t getGradientTriplet(const vector_t& x, const vector_t& params) override {
+        return StageEvaluator<ObjectiveFunction>::toTriplets(getGradientCSR(x, params));
+    }
+
+    triplet_vector_t getGradientTriplet(const vector_t& x) override {
+        return StageEvaluator<ObjectiveFunction>::toTriplets(getGradientCSR(x));
+    }
+
+    sparse_matrix_t getGradient(const vector_t& x, const vector_t& params) override {
+        return toSparseMatrix(getGradientTriplet(x, params), 1);
+    }
+
+    sparse_matrix_t getGradient(const vector_t& x) override {
+        return toSparseMatrix(getGradientTriplet(x), 1);
+    }
+
+    CSRSparseMatrix getHessianCSR(const vector_t& x, const vector_t& params) override {
+        CSRSparseMatrix hessian = hessianStructure_;
+        getHessianCSRValues(x, params, hessian.values.data());
+        return hessian;
+    }
+
+    CSRSparseMatrix getHessianCSR(const vector_t& x) override {
+        CSRSparseMatrix hessian = hessianStructure_;
+        getHessianCSRValues(x, hessian.values.data());
+        return hessian;
+    }
+
+    triplet_vector_t getHessianTriplet(const vector_t& x, const vector_t& params) override {
+        triplet_vector_t triplets = StageEvaluator<ObjectiveFunction>::toTriplets(getHessianCSR(x, params));
+        if (hessianUpperTriangular_) {
+            mirrorUpperTriangle(triplets); // the full hessian, only the CSR paths are triangular
+        }
+        return triplets;
+    }
+
+    triplet_vector_t getHessianTriplet(const vector_t& x) override {
+        triplet_vector_t triplets = StageEvaluator<ObjectiveFunction>::toTriplets(getHessianCSR(x));
+        if (hessianUpperTriangular_) {
+            mirrorUpperTriangle(triplets); // the full hessian, only the CSR paths are triangular
+        }
+        return triplets;
+    }
+
+    sparse_matrix_t getHessian(const vector_t& x, const vector_t& params) override {
+        return toSparseMatrix(getHessianTriplet(x, params), variableDim_);
+    }
+
+    sparse_matrix_t getHessian(const vector_t& x) override {
+        return toSparseMatrix(getHessianTriplet(x), variableDim_);
+    }
+
+    const CSRSparseMatrix& getGradientCSRStructure() const override {
+        return gradientStructure_;
+    }
+
+    const CSRSparseMatrix& getHessianCSRStructure() const override {
+        return hessianStructure_;
+    }
+
+    bool hasConstantHessian() const override {
+        return stages_.getKernel().hasConstantHessian();
+    }
+
+    std::shared_ptr<ObjectiveFunction> clone() const override {
+        return std::make_shared<StageObjectiveFunction>(*this);
+    }
+
+private:
+    void requireParameters(bool withParameters) const {
+        if (withParameters && !isParameterized_) {
+            throw std::runtime_error("Parameters are not expected.");
+        }
+        if (!withParameters && isParameterized_) {
+            throw std::runtime_error("Parameters are required.");
+        }
+    }
+
+    // the requested parts (non-null outputs) of all stages, the stages write their own entries and are summed afterwards
+    void evaluate(const vector_t& x, const vector_t* params, scalar_t* value, scalar_t* gradientValues, scalar_t* hessianValues) {
+        const ObjectiveFunction& first = stages_.getKernel();
+        size_t gradientNonZeros = first.getNumNonZerosJacobian();
+        size_t hessianNonZeros = first.getNumNonZerosHessian();
+        bool fused = value != nullptr && gradientValues != nullptr && hessianValues != nullptr;
+        stages_.forEachStage(x, params, [&](ObjectiveFunction& kernel, const vector_t& xStage, const vector_t* pStage, size_t k) {
+            scalar_t* stageValue = stageValues_.data() + k;
+            scalar_t* stageGradient = stageGradientValues_.data() + k * gradientNonZeros;
+            scalar_t* stageHessian = stageHessianValues_.data() + k * hessianNonZeros;
+            if (fused) {
+                if (pStage != nullptr) {
+                    kernel.getValueAndDerivativesCSRValues(xStage, *pStage, stageValue, stageGradient, stageHessian);
+                } else {
+                    kernel.getValueAndDerivativesCSRValues(xStage, stageValue, stageGradient, stageHessian);
+                }
+                return;
+            }
+            if (value != nullptr) {
+                pStage != nullptr ? kernel.getValue(xStage, *pStage, stageValue) : kernel.getValue(xStage, stageValue);
+            }
+            if (gradientValues != nullptr) {
+                pStage != nullptr ? kernel.getGradientCSRValues(xStage, *pStage, stageGradient) : kernel.getGradientCSRValues(xStage, stageGradient);
+            }
+            if (hessianValues != nullptr) {
+                pStage != nullptr ? kernel.getHessianCSRValues(xStage, *pStage, stageHessian) : kernel.getHessianCSRValues(xStage, stageHessian);
+            }
+        });
+        if (value != nullptr) {
+            *value = 0.0;
+            for (scalar_t stageValue : stageValues_) {
+                *value += stageValue;
+            }
+        }
+        if (gradientValues != nullptr) {
+            StageEvaluator<ObjectiveFunction>::accumulate(gradientScatter_, stageGradientValues_, gradientValues, nnzJacobian_);
+        }
+        if (hessianValues != nullptr) {
+            StageEvaluator<ObjectiveFunction>::accumulate(hessianScatter_, stageHessianValues_, hessianValues, nnzHessian_);
+        }
+    }
+
+    sparse_matrix_t toSparseMatrix(const triplet_vector_t& triplets, size_t rows) const {
+        sparse_matrix_t matrix(rows, variableDim_);
+        matrix.setFromTriplets(triplets.begin(), triplets.end());
+        return matrix;
+    }
+
+    StageEvaluator<ObjectiveFunction> stages_;
+    CSRSparseMatrix gradientStructure_;     // union of the shifted kernel gradients, 1 x variableDim
+    CSRSparseMatrix hessianStructure_;      // union of the shifted kernel hessians
+    SizeVector gradientScatter_;            // stage gradient entry -> slot of gradientStructure_
+    SizeVector hessianScatter_;             // stage hessian entry -> slot of hessianStructure_
+    bool hessianUpperTriangular_ = true;    // hessianStructure_ holds the upper triangle only
+    ValueVector stageValues_;               // per stage
+    ValueVector stageGradientValues_;       // numStages * kernel non-zeros
+    ValueVector stageHessianValues_;
+};
+} // namespace CRISP
+
+#endif // STAGE_OBJECTIVE_FUNCTION_H
@@ -0,0 +1,197 @@
+// NOTE: the convex QP solvers behind SolverInterface::solveSubproblem. A backend solves
+//     min 1/2 x'Hx + g'x   s.t.   Aeq x = beq,   G x <= h,   lb <= x <= ub
+// and keeps its symbolic setup between the subproblems of a solve, later subproblems only pass the changed components.
+#ifndef QP_BACKEND_H
+#define QP_BACKEND_H
+#include "common/BasicTypes.h"
+#include "piqp/piqp.hpp" // qp solver
+#include <algorithm>
+#include <stdexcept>
+
+namespace CRISP {
+// standard subproblem format for the QP solver, the inequalities are stored in PIQP's convention G x <= h (G = -[J,I], h = ineqValues).
+// H may be stored full or upper triangular, the backends only read its upper triangle.
+struct SubproblemData {
+    vector_t g;
+    sparse_matrix_t H;
+    sparse_matrix_t Aeq;
+    sparse_matrix_t G;
+    vector_t beq;
+    vector_t h;
+    vector_t lb;
+    vector_t ub;
+    vector_t x0;
+    // elastic mode: l1 penalty weights of the equality residuals and of the inequality violations, the rows become
+    //     min ... + eqPenalty' |Aeq x - beq| + ineqPenalty' max(G x - h, 0)
+    // Empty for hard constraints (the slack-augmented subproblem).
+    vector_t eqPenalty;
+    vector_t ineqPenalty;
+    // components changed since the last upload to the QP solver
+    bool gDirty = true;
+    bool HDirty = true;
+    bool AeqDirty = true;
+    bool beqDirty = true;
+    bool GDirty = true;
+    bool hDirty = true;
+    bool boundsDirty = true;
+    bool penaltyDirty = true;
+    SubproblemData() = default;
+    SubproblemData(size_t totalVars, size_t numEqualityConstraints, size_t numInequalityConstraints, size_t variableDim)
+        : g(totalVars),
+          H(totalVars, totalVars),
+          Aeq(numEqualityConstraints, totalVars),
+          G(numInequalityConstraints, totalVars),
+          beq(numEqualityConstraints),
+          h(numInequalityConstraints),
+          lb(totalVars),
+          ub(totalVars),
+          x0(totalVars)
+          {}
+
+    void clearDirty() {
+        gDirty = HDirty = AeqDirty = beqDirty = false;
+        GDirty = hDirty = boundsDirty = penaltyDirty = false;
+    }
+};
+
+class QPBackend {
+public:
+    virtual ~QPBackend() = default;
+    // symbolic setup and first values, the sparsity of the matrices is fixed afterwards
+    virtual void setup(const SubproblemData& qp) = 0;
+    // refresh the components marked dirty, the others keep their values in the solver
+    virtual void update(const SubproblemData& qp) = 0;
+    // primal start of the next solve, ignored by backends that cannot warm start
+    virtual void warmStart(const vector_t& x) {}
+    // returns whether the QP was solved to tolerance
+    virtual bool solve() = 0;
+    virtual const vector_t& primal() const = 0;
+    virtual const vector_t& equalityDuals() const = 0;   // y of Aeq x = beq
+    virtual const vector_t& inequalityDuals() const = 0; // z >= 0 of G x <= h
+    virtual size_t iterations() const = 0;               // of the last solve
+    virtual size_t maxIterations() const = 0;
+    virtual void setMaxIterations(size_t maxIterations) = 0;
+    // whether the backend handles the penalties of an elastic subproblem
+    virtual bool supportsElastic() const {
+        return false;
+    }
+};
+
+// the default backend: PIQP, a general sparse interior point method
+class PiqpBackend : public QPBackend {
+public:
+    void setup(const SubproblemData& qp) override {
+        setupColumnMajor(qp.H, H_, HSlots_);
+        setupColumnMajor(qp.Aeq, Aeq_, AeqSlots_);
+        setupColumnMajor(qp.G, G_, GSlots_);
+        solver_.setup(H_, qp.g, Aeq_, qp.beq, G_, qp.h, qp.lb, qp.ub);
+    }
+
+    void update(const SubproblemData& qp) override {
+        if (qp.HDirty) {
+            updateValues(qp.H, HSlots_, H_);
+        }
+        if (qp.AeqDirty) {
+            updateValues(qp.Aeq, AeqSlots_, Aeq_);
+        }
+        if (qp.GDirty) {
+            updateValues(qp.G, GSlots_, G_);
+        }
+        solver_.update(
+            qp.HDirty ? qp_matrix_opt_t(H_) : qp_matrix_opt_t(piqp::nullopt),
+            qp.gDirty ? qp_vector_opt_t(qp.g) : qp_vector_opt_t(piqp::nullopt),
+            qp.AeqDirty ? qp_matrix_opt_t(Aeq_) : qp_matrix_opt_t(piqp::nullopt),
+            qp.beqDirty ? qp_vector_opt_t(qp.beq) : qp_vector_opt_t(piqp::nullopt),
+            qp.GDirty ? qp_matrix_opt_t(G_) : qp_matrix_opt_t(piqp::nullopt),
+            qp.hDirty ? qp_vector_opt_t(qp.h) : qp_vector_opt_t(piqp::nullopt),
+            qp.boundsDirty ? qp_vector_opt_t(qp.lb) : qp_vector_opt_t(piqp::nullopt),
+            qp.boundsDirty ? qp_vector_opt_t(qp.ub) : qp_vector_opt_t(piqp::nullopt));
+    }
+
+    bool solve() override {
+        return solver_.solve() == piqp::PIQP_SOLVED;
+    }
+
+    const vector_t& primal() const override {
+        return solver_.result().x;
+    }
+
+    const vector_t& equalityDuals() const override {
+        return solver_.result().y;
+    }
+
+    const vector_t& inequalityDuals() const override {
+        return solver_.result().z;
+    }
+
+    size_t iterations() const override {
+        return solver_.result().info.iter;
+    }
+
+    size_t maxIterations() const override {
+        return solver_.settings().max_iter;
+    }
+
+    void setMaxIterations(size_t maxIterations) override {
+        solver_.settings().max_iter = maxIterations;
+    }
+
+private:
+    using qp_sparse_matrix_t = Eigen::SparseMatrix<scalar_t, Eigen::ColMajor, sparse_index_t>; // storage order of PIQP
+    // optional arguments of the QP solver update, nullopt keeps the data already in the solver. The matrices are passed as
+    // views of the column major copies below, not as converted temporaries.
+    using qp_matrix_opt_t = piqp::optional<Eigen::Ref<const qp_sparse_matrix_t>>;
+    using qp_vector_opt_t = piqp::optional<Eigen::Ref<const vector_t>>;
+
+    // column major copy of a row major matrix, slots[k] is the position in the copy of the k-th stored value of the source
+    static void setupColumnMajor(const sparse_matrix_t& source, qp_sparse_matrix_t& target, IndexVector& slots) {
+        target.resize(source.rows(), source.cols());
+        target.resizeNonZeros(source.nonZeros());
+        sparse_index_t* outer = target.outerIndexPtr();
+        std::fill(outer, outer + source.cols() + 1, 0);
+        for (Eigen::Index row = 0; row < source.outerSize(); ++row) {
+            for (sparse_matrix_t::InnerIterator it(source, row); it; ++it) {
+                ++outer[it.col() + 1];
+            }
+        }
+        for (Eigen::Index col = 0; col < source.cols(); ++col) {
+            outer[col + 1] += outer[col];
+        }
+        // the rows are visited in order, so the entries of every column are sorted by row
+        IndexVector next(outer, outer + source.cols());
+        slots.clear();
+        slots.reserve(source.nonZeros());
+        for (Eigen::Index row = 0; row < source.outerSize(); ++row) {
+            for (sparse_matrix_t::InnerIterator it(source, row); it; ++it) {
+                const sparse_index_t slot = next[it.col()]++;
+                target.innerIndexPtr()[slot] = static_cast<sparse_index_t>(row);
+                target.valuePtr()[slot] = it.value();
+                slots.push_back(slot);
+            }
+        }
+    }
+
+    // scatter the values of the source into the fixed structure of its column major copy, no allocation
+    static void updateValues(const sparse_matrix_t& source, const IndexVector& slots, qp_sparse_matrix_t& target) {
+        if (static_cast<size_t>(source.nonZeros()) != slots.size()) {
+            throw std::runtime_error("PiqpBackend: the sparsity of the QP changed after the setup.");
+        }
+        scalar_t* values = target.valuePtr();
+        size_t k = 0;
+        for (Eigen::Index row = 0; row < source.outerSize(); ++row) {
+            for (sparse_matrix_t::InnerIterator it(source, row); it; ++it) {
+                values[slots[k++]] = it.value();
+            }
+        }
+    }
+
+    qp_sparse_matrix_t H_;
+    qp_sparse_matrix_t Aeq_;
+    qp_sparse_matrix_t G_;
+    IndexVector HSlots_;
+    IndexVector AeqSlots_;
+    IndexVector GSlots_;
+    mutable piqp::SparseSolver<scalar_t, sparse_index_t> solver_;
+};
+} // namespace CRISP
+#endif // QP_BACKEND_H
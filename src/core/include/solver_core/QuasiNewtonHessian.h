@@ -0,0 +1,112 @@
+// NOTE: quasi-Newton model hessian (hessianType = 2). Instead of evaluating second derivatives, the hessian of the lagrangian is
+// approximated from the change of its gradient between accepted iterates, so the functions only need FIRST_ORDER information.
+// The approximation is block diagonal over the stages of the problem (a partitioned BFGS update as in multiple shooting):
+// every stage block is a dense matrix updated with its own segment of the step and of the gradient change. Without a stage
+// structure the approximation is diagonal (a secant update of every variable), a dense variableDim x variableDim block would
+// make the QP dense. Powell's damping keeps every block positive definite, so the QP stays convex without any convexification.
+#ifndef QUASI_NEWTON_HESSIAN_H
+#define QUASI_NEWTON_HESSIAN_H
+#include "common/BasicTypes.h"
+#include <stdexcept>
+
+namespace CRISP {
+class QuasiNewtonHessian {
+public:
+    // blockDims: dimensions of consecutive variable blocks, e.g. the stage structure of the problem, they sum to variableDim.
+    // Without blocks every variable is a block of its own (diagonal approximation). initialScale: diagonal of the blocks
+    // before the first update.
+    void initialize(size_t variableDim, const SizeVector& blockDims, scalar_t initialScale) {
+        blockDims_ = blockDims.empty() ? SizeVector(variableDim, 1) : blockDims;
+        initialScale_ = initialScale;
+        blockOffsets_.clear();
+        blocks_.clear();
+        size_t offset = 0;
+        for (size_t dim : blockDims_) {
+            blockOffsets_.push_back(offset);
+            blocks_.emplace_back(dim, dim);
+            offset += dim;
+        }
+        if (offset != variableDim) {
+            throw std::runtime_error("The quasi-Newton blocks cover " + std::to_string(offset) + " of " + std::to_string(variableDim) + " variables.");
+        }
+        // full storage of the dense blocks, row by row
+        structure_ = CSRSparseMatrix();
+        structure_.outerIndex.reserve(variableDim + 1);
+        structure_.outerIndex.push_back(0);
+        for (size_t b = 0; b < blocks_.size(); ++b) {
+            for (size_t row = 0; row < blockDims_[b]; ++row) {
+                for (size_t column = 0; column < blockDims_[b]; ++column) {
+                    structure_.innerIndices.push_back(blockOffsets_[b] + column);
+                }
+                structure_.outerIndex.push_back(structure_.innerIndices.size());
+            }
+        }
+        structure_.values.assign(structure_.innerIndices.size(), 0.0);
+        reset();
+    }
+
+    // back to the scaled identity, e.g. for a new problem
+    void reset() {
+        for (matrix_t& block : blocks_) {
+            block.setIdentity();
+            block *= initialScale_;
+        }
+        scaled_.assign(blocks_.size(), false);
+    }
+
+    // step s between two accepted iterates and the change y of the lagrangian gradient (same multipliers at both points)
+    void update(const vector_t& s, const vector_t& y) {
+        for (size_t b = 0; b < blocks_.size(); ++b) {
+            updateBlock(b, s.segment(blockOffsets_[b], blockDims_[b]), y.segment(blockOffsets_[b], blockDims_[b]));
+        }
+    }
+
+    const CSRSparseMatrix& getCSRStructure() const {
+        return structure_;
+    }
+
+    // the current approximation in the order of getCSRStructure
+    void getCSRValues(scalar_t* values) const {
+        for (const matrix_t& block : blocks_) {
+            for (Eigen::Index row = 0; row < block.rows(); ++row) {
+                for (Eigen::Index column = 0; column < block.cols(); ++column) {
+                    *values++ = block(row, column);
+                }
+            }
+        }
+    }
+
+private:
+    // damped BFGS update: y is replaced by r = theta y + (1 - theta) B s with s'r >= 0.2 s'B s
+    void updateBlock(size_t b, const vector_t& s, const vector_t& y) {
+        matrix_t& B = blocks_[b];
+        scalar_t sy = s.dot(y);
+        if (!scaled_[b] && sy > kMinCurvature * s.squaredNorm() && y.squaredNorm() > 0.0) {
+            // scale the initial identity to the curvature along the first step
+            B.setIdentity();
+            B *= y.squaredNorm() / sy;
+            scaled_[b] = true;
+        }
+        vector_t Bs = B * s;
+        scalar_t sBs = s.dot(Bs);
+        if (sBs <= kMinCurvature * s.squaredNorm()) {
+            return; // no step in this block
+        }
+        scalar_t theta = sy >= kDamping * sBs ? 1.0 : (1.0 - kDamping) * sBs / (sBs - sy);
+        vector_t r = theta * y + (1.0 - theta) * Bs;
+        B.noalias() += r * r.transpose() / s.dot(r) - Bs * Bs.transpose() / sBs;
+        B = 0.5 * (B + B.transpose()); // remove the rounding asymmetry
+    }
+
+    static constexpr scalar_t kDamping = 0.2;        // Powell's damping threshold
+    static constexpr scalar_t kMinCurvature = 1e-12; // relative to |s|^2, smaller curvatures are skipped
+
+    SizeVector blockDims_;
+    SizeVector blockOffsets_;
+    std::vector<matrix_t> blocks_;
+    std::vector<bool> scaled_; // the initial scaling has been applied
+    scalar_t initialScale_ = 1.0;
+    CSRSparseMatrix structure_;
+};
+} // namespace CRISP
+#endif // QUASI_NEWTON_HESSIAN_H
@@ -0,0 +1,43 @@
+// NOTE: a solve running on its own thread. The caller keeps working (or runs other solvers) meanwhile and
+// stops the solve cooperatively with cancel(), which takes effect at the next SQP iteration.
+#ifndef SOLVE_HANDLE_H
+#define SOLVE_HANDLE_H
+#include "solver_core/SolverInterface.h"
+#include <chrono>
+#include <future>
+
+namespace CRISP {
+class SolveHandle {
+public:
+    // starts solver.solve(), the solver must outlive the handle
+    explicit SolveHandle(SolverInterface& solver)
+        : solver_(solver), result_(std::async(std::launch::async, [&solver] { solver.solve(); }).share()) {}
+
+    bool done() const {
+        return result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // wait at most timeout seconds (negative: until finished), returns whether the solve finished.
+    // An exception thrown by the solve is rethrown here.
+    bool wait(scalar_t timeout = -1.0) const {
+        if (timeout < 0.0) {
+            result_.wait();
+        } else if (result_.wait_for(std::chrono::duration<scalar_t>(timeout)) != std::future_status::ready) {
+            return false;
+        }
+        result_.get();
+        return true;
+    }
+
+    void cancel() {
+        if (!done()) {
+            solver_.requestCancel();
+        }
+    }
+
+private:
+    SolverInterface& solver_;
+    std::shared_future<void> result_; // the last copy of a std::async future waits for the solve on destruction
+};
+} // namespace CRISP
+#endif // SOLVE_HANDLE_H
@@ -5,17 +5,49 @@
 #include "common/BasicTypes.h"
 #include "problem_core/OptimizationProblem.h"
 #include "solver_core/SolverParameters.h"
+#include "solver_core/SolverStats.h"
 #include <boost/filesystem.hpp>
-#include "piqp/piqp.hpp" // qp solver
+#include "solver_core/QPBackend.h"
+#include "solver_core/StageQPBackend.h"
+#include "solver_core/TraceRecorder.h"
+#include "solver_core/QuasiNewtonHessian.h"
+#include <atomic>
+#include <memory>
 #include <ctime>
+#include <limits>
 
 namespace CRISP {
+// how the last solve ended
+enum class SolverStatus {
+    NOT_SOLVED,      // no solve yet, or running
+    CONVERGED,       // merit function converged with the constraints satisfied
+    PENALTY_MAXED,   // merit function converged at the maximum penalty with violated constraints
+    DEADLINE,        // maxWallTime or maxQPTime exhausted, the best iterate is returned
+    ITERATION_LIMIT, // maxIterations reached, the best iterate is returned
+    CANCELLED        // requestCancel, the best iterate is returned
+};
+
+inline const char* toString(SolverStatus status) {
+    switch (status) {
+        case SolverStatus::NOT_SOLVED: return "not solved";
+        case SolverStatus::CONVERGED: return "converged";
+        case SolverStatus::PENALTY_MAXED: return "penalty maxed";
+        case SolverStatus::DEADLINE: return "deadline";
+        case SolverStatus::ITERATION_LIMIT: return "iteration limit";
+        case SolverStatus::CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
 class SolverInterface {
 public:
-    SolverInterface(OptimizationProblem& problem, SolverParameters& parameters) : problem_(problem), solverParameters_(parameters), initialized_(false) {
+    // The solver works on its own clone of the problem (functions, evaluation buffers and parameters), so several solvers
+    // built from one problem can run concurrently. Change the problem parameters of a solver with setProblemParameters.
+    SolverInterface(OptimizationProblem& problem, SolverParameters& parameters) : problem_(problem.clone()), solverParameters_(parameters), initialized_(false) {
         
         }
-    void initialize(const vector_t& initial_guess) {
+    void initialize(const vector_cref_t& initial_guess) {
+        checkNotSolving("initialize");
         if (!initialized_) {
             initializeProblem(initial_guess);
             initialized_ = true;
@@ -24,7 +56,7 @@ public:
         }
     }
 
-    void initializeProblem(const vector_t& initial_guess) {
+    void initializeProblem(const vector_cref_t& initial_guess) {
         // Initialize the problem
         problemName_ = problem_.getProblemName();
         variableDim_ = problem_.getVariableDim();
@@ -43,19 +75,84 @@ public:
         offsetV_ = variableDim_;
         offsetW_ = offsetV_ + numEqualityConstraints_;
         offsetT_ = offsetW_ + numEqualityConstraints_;
-        totalVars_ = variableDim_ + 2 * numEqualityConstraints_ + numInequalityConstraints_;
+        // elastic mode keeps the QP at the problem variables, the l1 penalties of the constraints are handled by the QP backend
+        elasticMode_ = solverParameters_.getParameters("elasticMode")(0) > 0;
+        totalVars_ = elasticMode_ ? variableDim_ : variableDim_ + 2 * numEqualityConstraints_ + numInequalityConstraints_;
         subsolution_.resize(totalVars_); // solution of the subproblem
-        numNonZerosObjHess_ = problem_.getNumNonZeroObjHessian();
+        hessianType_ = solverParameters_.getParameters("hessianType")(0);
+        if (hessianType_ == 1) {
+            problem_.initializeLagrangianHessian();
+            numNonZerosObjHess_ = problem_.getLagrangianHessianCSRStructure().innerIndices.size();
+        } else if (hessianType_ == 2) {
+            quasiNewton_.initialize(variableDim_, problem_.getStageStructure(), solverParameters_.getParameters("quasiNewtonInitScale")(0));
+            numNonZerosObjHess_ = quasiNewton_.getCSRStructure().innerIndices.size();
+            lagrangianGradient_.resize(variableDim_);
+            lagrangianGradientPrevious_.resize(variableDim_);
+        } else {
+            numNonZerosObjHess_ = problem_.getNumNonZeroObjHessian();
+        }
         numNonZerosEqJac_ = problem_.getNumNonZeroEqJacobian();
         numNonZerosIneqJac_ = problem_.getNumNonZeroIneqJacobian();
         // initialize the subproblem data
         subproblem_ = SubproblemData(totalVars_, numEqualityConstraints_, numInequalityConstraints_, variableDim_);
         subproblem_.H.reserve(numNonZerosObjHess_);
-        subproblem_.Aeq.reserve(numNonZerosEqJac_ + 2 * numEqualityConstraints_);
-        subproblem_.Aineq.reserve(numNonZerosIneqJac_ + numInequalityConstraints_);
-        objHessAugCSR_ = CSRSparseMatrix(totalVars_, numNonZerosObjHess_);
-        eqJacAugCSR_ = CSRSparseMatrix(numEqualityConstraints_, numNonZerosEqJac_ + 2 * numEqualityConstraints_);
-        ineqJacAugCSR_ = CSRSparseMatrix(numInequalityConstraints_, numNonZerosIneqJac_ + numInequalityConstraints_);
+        if (elasticMode_) {
+            subproblem_.Aeq.reserve(numNonZerosEqJac_);
+            subproblem_.G.reserve(numNonZerosIneqJac_);
+            subproblem_.eqPenalty.resize(numEqualityConstraints_);
+            subproblem_.ineqPenalty.resize(numInequalityConstraints_);
+        } else {
+            subproblem_.Aeq.reserve(numNonZerosEqJac_ + 2 * numEqualityConstraints_);
+            subproblem_.G.reserve(numNonZerosIneqJac_ + numInequalityConstraints_);
+        }
+        // preallocate the evaluation buffers, the solve loop evaluates the problem in place
+        objJac_.resize(variableDim_);
+        eqValues_.resize(numEqualityConstraints_);
+        ineqValues_.resize(numInequalityConstraints_);
+        eqValuesNext_.resize(numEqualityConstraints_);
+        ineqValuesNext_.resize(numInequalityConstraints_);
+        objHessCSR_ = hessianType_ == 1 ? problem_.getLagrangianHessianCSRStructure()
+                    : hessianType_ == 2 ? quasiNewton_.getCSRStructure() : problem_.getObjectiveHessianCSRStructure();
+        // an upper triangular hessian goes to the QP as it is, the backends only read the upper triangle
+        hessianUpperTriangular_ = hessianType_ == 1 ? problem_.isLagrangianHessianUpperTriangular()
+                                : hessianType_ == 0 && problem_.isObjectiveHessianUpperTriangular();
+        eqMultipliers_ = vector_t::Zero(numEqualityConstraints_);
+        ineqMultipliers_ = vector_t::Zero(numInequalityConstraints_);
+        if (hessianType_ == 1) {
+            // slot of every diagonal entry, the union structure always contains the full diagonal
+            hessianDiagonalSlots_.resize(variableDim_);
+            hessianOffDiagonal_.resize(variableDim_);
+            for (size_t i = 0; i < variableDim_; ++i) {
+                auto rowBegin = objHessCSR_.innerIndices.begin() + objHessCSR_.outerIndex[i];
+                auto rowEnd = objHessCSR_.innerIndices.begin() + objHessCSR_.outerIndex[i + 1];
+                hessianDiagonalSlots_[i] = std::lower_bound(rowBegin, rowEnd, i) - objHessCSR_.innerIndices.begin();
+            }
+        }
+        eqJacCSR_ = problem_.getEqualityConstraintsJacobianCSRStructure();
+        ineqJacCSR_ = problem_.getInequalityConstraintsJacobianCSRStructure();
+        // first derivatives of the trial point, swapped in when the step is accepted
+        objJacNext_.resize(variableDim_);
+        eqJacCSRNext_ = eqJacCSR_;
+        ineqJacCSRNext_ = ineqJacCSR_;
+        derivativesNextPoint_ = vector_t::Constant(variableDim_, std::numeric_limits<scalar_t>::quiet_NaN());
+        fusedEvaluation_ = solverParameters_.getParameters("fusedEvaluation")(0) > 0 && hessianType_ == 0;
+        reuseConstantDerivatives_ = solverParameters_.getParameters("reuseConstantDerivatives")(0) > 0;
+        if (elasticMode_) {
+            // elastic: H, J and -J, with the structures of the problem
+            objHessCSR_.toEigenSparseMatrix(subproblem_.H, variableDim_);
+            eqJacCSR_.toEigenSparseMatrix(subproblem_.Aeq, variableDim_);
+            ineqJacCSR_.toEigenSparseMatrix(subproblem_.G, variableDim_);
+        } else {
+            // the structures of [H,0;0,0], [J,-I,I] and [J,I] never change, only the values are refreshed in the solve loop.
+            // They are built in the QP matrices themselves, the problem derivatives are the only other copy.
+            initializeBlockObjHess(objHessCSR_, subproblem_.H);
+            initializeBlockAeq(eqJacCSR_, subproblem_.Aeq);
+            initializeBlockAin(ineqJacCSR_, subproblem_.G);
+        }
+        // bounds of the slack variables never change, the trust region part is written by buildSubproblemBounds
+        subproblem_.lb.setZero();
+        subproblem_.ub.setConstant(std::numeric_limits<scalar_t>::infinity());
+        subproblem_.x0.setZero();
         
         // Initialize the parameters
         maxIterations_ = solverParameters_.getParameters("maxIterations")(0);
@@ -67,20 +164,44 @@ public:
         mu_ = solverParameters_.getParameters("mu")(0);
         weightedMode_ = solverParameters_.getParameters("WeightedMode")(0);
         weightedTol_ = solverParameters_.getParameters("WeightedTolFactor")(0);
-        // initialize mu_matrix_ with diagnal mu
-        mu_matrix_.resize(numConstraints_, numConstraints_);
-        mu_matrix_.reserve(numConstraints_);
-        mu_matrix_.setIdentity();
-        mu_matrix_ *= mu_;
-        mu_matrix_.makeCompressed();
-        ones_eq_.resize(numEqualityConstraints_);
-        ones_eq_.setOnes();
-        ones_ineq_.resize(numInequalityConstraints_);
-        ones_ineq_.setOnes();
+        // penalty weight of every constraint (equalities first), all equal to mu_ unless the weighted mode raises them per constraint
+        penaltyWeights_ = vector_t::Constant(numConstraints_, mu_);
+        eqJacStep_.resize(numEqualityConstraints_);
+        ineqJacStep_.resize(numInequalityConstraints_);
+        hessStep_.resize(variableDim_);
+        socEqValues_.resize(numEqualityConstraints_);
+        socIneqValues_.resize(numInequalityConstraints_);
         muMax_ = solverParameters_.getParameters("muMax")(0);
         etaLow_ = solverParameters_.getParameters("etaLow")(0);
         etaHigh_ = solverParameters_.getParameters("etaHigh")(0);
         trustRegionRadius_ = trustRegionInitRadius_;
+        mpcMode_ = solverParameters_.getParameters("mpcMode")(0) > 0;
+        qpSetup_ = false;
+        qpSolved_ = false;
+        switch (static_cast<int>(solverParameters_.getParameters("qpBackend")(0))) {
+            case 0:
+                qpBackend_.reset(new PiqpBackend());
+                break;
+            case 1:
+                qpBackend_.reset(new StageQPBackend(problem_.getStageStructure()));
+                break;
+            default:
+                throw std::runtime_error("Unknown qpBackend, use 0 (PIQP) or 1 (stage-structured).");
+        }
+        if (elasticMode_ && !qpBackend_->supportsElastic()) {
+            throw std::runtime_error("elasticMode needs a QP backend that handles the penalties, use qpBackend = 1.");
+        }
+        qpMaxIterations_ = qpBackend_->maxIterations();
+        qpWarmStart_ = solverParameters_.getParameters("qpWarmStart")(0) > 0;
+        qpTimePerIteration_ = 0.0;
+        convexifyHessian_ = solverParameters_.getParameters("convexifyHessian")(0) > 0;
+        hessianRegularization_ = solverParameters_.getParameters("hessianRegularization")(0);
+        // the pool is persistent, it lives as long as the solver and is reused by every solve
+        numThreads_ = solverParameters_.getParameters("numThreads")(0);
+        if (numThreads_ > 1) {
+            threadPool_ = std::make_shared<ThreadPool>(numThreads_);
+            problem_.setThreadPool(threadPool_);
+        }
         // prepareStaticTriplet();
         if (solverParameters_.getParameters("verbose")(0) > 0) {
             //     std::cout << std::string(60, '=') << '\n';
@@ -108,6 +229,9 @@ public:
             std::cout << "|   Eta Low:            " << std::setw(30) << std::left << etaLow_ << "|\n";
             std::cout << "|   Eta High:           " << std::setw(30) << std::left << etaHigh_ << "|\n";
             std::cout << "|   Weighted Mode:      " << std::setw(30) << std::left << weightedMode_ << "|\n";
+            std::cout << "|   Threads:            " << std::setw(30) << std::left << numThreads_ << "|\n";
+            std::cout << "|   MPC Mode:           " << std::setw(30) << std::left << mpcMode_ << "|\n";
+            std::cout << "|   Hessian Type:       " << std::setw(30) << std::left << hessianType_ << "|\n";
             std::cout << std::string(60, '=') << '\n';
         }
     }
@@ -121,9 +245,12 @@ public:
         }
     }
     
-    void resetProblem(const vector_t& initial_guess) {
+    void resetProblem(const vector_cref_t& initial_guess) {
+        checkNotSolving("resetProblem");
         // problem not change, re-solve the problem with different initial_guess and the solver setting
-        // reset the solution
+        // in mpc mode the QP solver stays set up (its sparsity never changes), the adapted penalties and the trust region are kept.
+        // The given initial guess is always used, shiftWarmStart resets with the shifted previous solution instead.
+        mpcMode_ = solverParameters_.getParameters("mpcMode")(0) > 0;
         xInitial_ = initial_guess;
         xIterate_ = initial_guess;
         currentIterate_ = 0;
@@ -134,17 +261,36 @@ public:
         constraintTol_ = solverParameters_.getParameters("constraintTol")(0);
         trustRegionInitRadius_ = solverParameters_.getParameters("trustRegionInitRadius")(0);
         trustRegionMaxRadius_ = solverParameters_.getParameters("trustRegionMaxRadius")(0);
-        mu_ = solverParameters_.getParameters("mu")(0);
         muMax_ = solverParameters_.getParameters("muMax")(0);
         etaLow_ = solverParameters_.getParameters("etaLow")(0);
         etaHigh_ = solverParameters_.getParameters("etaHigh")(0);
-        trustRegionRadius_ = trustRegionInitRadius_;
         weightedMode_ = solverParameters_.getParameters("WeightedMode")(0);
         weightedTol_ = solverParameters_.getParameters("WeightedTolFactor")(0);
         secondOrderCorrection_ = solverParameters_.getParameters("secondOrderCorrection")(0);
-        mu_matrix_.setIdentity();
-        mu_matrix_ *= mu_;
-        mu_matrix_.makeCompressed();
+        convexifyHessian_ = solverParameters_.getParameters("convexifyHessian")(0) > 0;
+        hessianRegularization_ = solverParameters_.getParameters("hessianRegularization")(0);
+        qpWarmStart_ = solverParameters_.getParameters("qpWarmStart")(0) > 0;
+        // the problem parameters may have changed since the last solve, the derivatives of the last trial point are stale
+        fusedEvaluation_ = solverParameters_.getParameters("fusedEvaluation")(0) > 0 && hessianType_ == 0;
+        reuseConstantDerivatives_ = solverParameters_.getParameters("reuseConstantDerivatives")(0) > 0;
+        derivativesNextPoint_.setConstant(std::numeric_limits<scalar_t>::quiet_NaN());
+        if (mpcMode_) {
+            // a radius that collapsed to the stopping tolerance would end the next solve immediately
+            if (trustRegionRadius_ < trustRegionTol_) {
+                trustRegionRadius_ = trustRegionInitRadius_;
+            }
+            trustRegionRadius_ = std::min(trustRegionRadius_, trustRegionMaxRadius_);
+        } else {
+            mu_ = solverParameters_.getParameters("mu")(0);
+            trustRegionRadius_ = trustRegionInitRadius_;
+            penaltyWeights_.setConstant(mu_);
+            qpSetup_ = false;
+            if (hessianType_ == 2) {
+                quasiNewton_.reset();
+            }
+            eqMultipliers_.setZero();
+            ineqMultipliers_.setZero();
+        }
         // clear history
         // xHistory_.clear();
         // meritHistory_.clear();
@@ -155,13 +301,27 @@ public:
         
     }
 
+    // resetProblem with the previous solution shifted by mpcShiftDim variables (one stage) as the initial guess, the last
+    // stage is held. The time-shift warm start of a receding horizon loop.
+    void shiftWarmStart() {
+        checkNotSolving("shiftWarmStart");
+        const size_t shiftDim = solverParameters_.getParameters("mpcShiftDim")(0);
+        if (!initialized_ || shiftDim == 0 || shiftDim >= variableDim_) {
+            throw std::runtime_error("SolverInterface::shiftWarmStart needs an initialized solver and 0 < mpcShiftDim < " + std::to_string(variableDim_) + ".");
+        }
+        std::memmove(xIterate_.data(), xIterate_.data() + shiftDim, (variableDim_ - shiftDim) * sizeof(scalar_t));
+        resetProblem(xIterate_);
+    }
+
     // set the hyperparameters for the solver, like max iterations, trust region radius, etc
-    void setHyperParameters(const std::string& name, const vector_t& params) {
+    void setHyperParameters(const std::string& name, const vector_cref_t& params) {
+        checkNotSolving("setHyperParameters");
         solverParameters_.setParameters(name, params);
     }
 
     // for update problem parameters like initial guess, terminal states, for integrating in MPC framework.
-    void setProblemParameters(const std::string& name, const vector_t& params) {
+    void setProblemParameters(const std::string& name, const vector_cref_t& params) {
+        checkNotSolving("setProblemParameters");
         problem_.setParameters(name, params);
     }
 
@@ -183,72 +343,168 @@ public:
     // print the result
 
     void solve() {
+        if (solving_.exchange(true)) {
+            throw std::runtime_error("SolverInterface::solve is already running on this solver.");
+        }
+        // a cancellation only applies to this solve, the flags are cleared on every exit
+        struct SolveScope {
+            SolverInterface& solver;
+            ~SolveScope() {
+                solver.cancelRequested_ = false;
+                solver.solving_ = false;
+            }
+        } solveScope{*this};
+        cancelled_ = false;
+        status_ = SolverStatus::NOT_SOLVED;
+        // the budget covers the whole solve, the initial evaluation included
+        solveStart_ = std::chrono::high_resolution_clock::now();
+        maxWallTime_ = solverParameters_.getParameters("maxWallTime")(0);
+        maxQPTime_ = solverParameters_.getParameters("maxQPTime")(0);
+        verbose_ = solverParameters_.getParameters("verbose")(0) > 0;
+        bestViolation_ = std::numeric_limits<scalar_t>::infinity();
         // initialization
-        obj_ = problem_.evaluateObjective(xIterate_);
-        objJac_ = problem_.evaluateObjectiveGradient(xIterate_).toDense().row(0).transpose();
-        objHessCSR_ = problem_.evaluateObjectiveHessianCSR(xIterate_);
-        objHessMat_.resize(variableDim_, variableDim_);
-        objHessMat_.reserve(numNonZerosObjHess_);
-        objHessCSR_.toEigenSparseMatrix(objHessMat_);
-
-        // value of the constraints
-        eqValues_ = problem_.evaluateEqualityConstraints(xIterate_);
-        ineqValues_ = problem_.evaluateInequalityConstraints(xIterate_);
-        eqJacCSR_ = problem_.evaluateEqualityConstraintsJacobianCSR(xIterate_);
-        eqJacMat_.resize(numEqualityConstraints_, variableDim_);
-        eqJacMat_.reserve(numNonZerosEqJac_);
-        eqJacCSR_.toEigenSparseMatrix(eqJacMat_);
-        ineqJacCSR_ = problem_.evaluateInequalityConstraintsJacobianCSR(xIterate_);
-        ineqJacMat_.resize(numInequalityConstraints_, variableDim_);
-        ineqJacMat_.reserve(numNonZerosIneqJac_);
-        ineqJacCSR_.toEigenSparseMatrix(ineqJacMat_);
+        statsLevel_ = solverParameters_.getParameters("collectStats")(0);
+        // one cost per iteration and the final one, the loop never reallocates the history
+        costHistory_.reserve(costHistory_.size() + maxIterations_ + 1);
+        stats_.reset();
+        if (statsLevel_ > 1) {
+            stats_.iterationHistory.reserve(maxIterations_);
+        }
+        const bool collectStats = statsLevel_ > 0;
+        if (!traceFileName_.empty() && !traceRecorder_) {
+            traceRecorder_ = std::make_unique<TraceRecorder>(traceFileName_, variableDim_, traceCapacity_);
+        }
+        // the parameters may have changed, the constant blocks are evaluated again by the first evaluation of every solve
+        constantDerivativesEvaluated_ = false;
+        constantMatricesUploaded_ = false;
+        if (fusedEvaluation_) {
+            problem_.evaluateValuesAndDerivatives(xIterate_, obj_, eqValues_, ineqValues_, objJac_, eqJacCSR_, ineqJacCSR_);
+            problem_.evaluateObjectiveHessianCSR(xIterate_, objHessCSR_);
+        } else {
+            problem_.evaluateValues(xIterate_, obj_, eqValues_, ineqValues_);
+            evaluateDerivatives();
+        }
+        if (reuseConstantDerivatives_) {
+            // from here on the constant blocks keep these values, in both sets of derivative buffers
+            if (fusedEvaluation_) {
+                eqJacCSRNext_.values = eqJacCSR_.values;
+                ineqJacCSRNext_.values = ineqJacCSR_.values;
+            }
+            constantDerivativesEvaluated_ = true;
+        }
         secondOrderCorrectionCount = 0;
         phi_ = evaluateMeritFunction(obj_, eqValues_, ineqValues_);
-        q_mu_0_ = evaluateQuadraticModel(obj_, objJac_, eqValues_, ineqValues_, objHessMat_, eqJacMat_, ineqJacMat_);
+        q_mu_0_ = phi_; // the model at a zero step
+        updateBestIterate();
         time_qp = 0.0;
         time_total = 0.0;
+        iterateChanged_ = true;
+        penaltyChanged_ = false;
+        rhsModified_ = false;
+        subproblemRadius_ = -1.0;
         // main loop, reuse data from the previous iteration to improve efficiency.
         auto startsolve = std::chrono::high_resolution_clock::now();
         for (currentIterate_ = 0; currentIterate_ < maxIterations_; ++currentIterate_) {
+            if (cancelRequested_) {
+                cancelled_ = true;
+                status_ = SolverStatus::CANCELLED;
+                break;
+            }
+            if (remainingTime() <= 0.0) {
+                status_ = SolverStatus::DEADLINE;
+                break;
+            }
+            SolverIterationStats iterationStats;
             // store the previous iterate
             costHistory_.push_back(obj_);
-            if (solverParameters_.getParameters("verbose")(0) > 0) {
+            if (verbose_) {
                 std::cout << "Iteration: " << currentIterate_ << " Objective: " << obj_ << " Merit: " << phi_ << " Trust region: " << trustRegionRadius_ << std::endl;
                 std::cout << "Equality violation: " << eqValues_.array().abs().maxCoeff() << " Inequality violation: " << (-ineqValues_).array().maxCoeff() << std::endl;
             }
-            // construct the subproblem
-            constructSubproblem(objJac_, objHessCSR_, eqValues_, ineqValues_, eqJacCSR_, ineqJacCSR_);
-            // auto end = std::chrono::high_resolution_clock::now();
-            // std::cout << "Subproblem construction time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << std::endl;
+            StatsTimer subproblemTimer(collectStats);
+            // construct the subproblem: everything after an accepted step. After a rejected step only the trust region bounds,
+            // and the parts touched by a penalty update or a second order correction, are refreshed.
+            if (iterateChanged_) {
+                constructSubproblem(objJac_, objHessCSR_, eqValues_, ineqValues_, eqJacCSR_, ineqJacCSR_);
+                iterateChanged_ = false;
+                penaltyChanged_ = false;
+                rhsModified_ = false;
+            } else {
+                if (penaltyChanged_) {
+                    buildSubproblemGradient(objJac_);
+                    penaltyChanged_ = false;
+                }
+                if (rhsModified_) {
+                    buildSubproblemRhs(eqValues_, ineqValues_);
+                    rhsModified_ = false;
+                }
+                buildSubproblemBounds();
+            }
+            iterationStats.subproblemTime = subproblemTimer.elapsed();
+            StatsTimer qpTimer(collectStats);
             subsolution_ = solveSubproblem(subproblem_); // solve the subproblem
+            iterationStats.qpTime = qpTimer.elapsed();
+            iterationStats.qpIterations = qpBackend_->iterations();
+            if (remainingTime() <= 0.0) {
+                // the step of a QP cut short by the budget is not evaluated
+                status_ = SolverStatus::DEADLINE;
+                if (collectStats) {
+                    stats_.add(iterationStats, statsLevel_ > 1);
+                }
+                break;
+            }
             std::memcpy(pTrial_.data(), subsolution_.data(), variableDim_ * sizeof(scalar_t));
             // evaluate necessary value at the trial step
             xIterateNext_ = xIterate_ + pTrial_;
-            // auto starteval = std::chrono::high_resolution_clock::now();
-            auto objNext = problem_.evaluateObjective(xIterateNext_);
-            auto eqValuesNext = problem_.evaluateEqualityConstraints(xIterateNext_);
-            auto ineqValuesNext = problem_.evaluateInequalityConstraints(xIterateNext_);
-            // auto endeval = std::chrono::high_resolution_clock::now();
-            // std::cout << "Evaluation time: " << std::chrono::duration_cast<std::chrono::microseconds>(endeval - starteval).count() << "us" << std::endl;
-            phi_pk_ = evaluateMeritFunction(objNext, eqValuesNext, ineqValuesNext); // mertit function at the trial step
-            q_mu_pk_ = evaluateQuadraticModel(obj_, objJac_, eqValues_, ineqValues_, objHessMat_, eqJacMat_, ineqJacMat_, pTrial_); // quadratic model at the trial step
-            // second order correction if actual reduction less than 0;
-            if (phi_ - phi_pk_ < 0) {
+            StatsTimer evaluationTimer(collectStats);
+            scalar_t objNext;
+            evaluateTrialPoint(objNext);
+            iterationStats.evaluationTime = evaluationTimer.elapsed();
+            StatsTimer meritTimer(collectStats);
+            phi_pk_ = evaluateMeritFunction(objNext, eqValuesNext_, ineqValuesNext_); // mertit function at the trial step
+            computeStepProducts(pTrial_);
+            q_mu_pk_ = evaluateQuadraticModel(obj_, objJac_, eqValues_, ineqValues_, pTrial_); // quadratic model at the trial step
+            iterationStats.meritTime = meritTimer.elapsed();
+            // second order correction if actual reduction less than 0, skipped when the budget is exhausted;
+            if (phi_ - phi_pk_ < 0 && remainingTime() > 0.0) {
                 // std::cout << "actual reduction before second order correction: " << phi_ - phi_pk_ << std::endl;
                 // modify the subproblem, resolve for a new trial step to consider the second order correction
                 secondOrderCorrectionCount++;
-                // change subproblem_.beq->-(eqValuesNext-eqconstraintJac*ptrial) and subproblem_.bineq->-(IneqValuesNext-IneqconstraintJac*ptrial) and resolve the problem.
-                subproblem_.beq = -(eqValuesNext - eqJacMat_ * pTrial_);
-                subproblem_.bineq = -(ineqValuesNext - ineqJacMat_ * pTrial_);
+                StatsTimer correctionTimer(collectStats);
+                iterationStats.secondOrderCorrection = true;
+                // change subproblem_.beq->-(eqValuesNext-eqconstraintJac*ptrial) and subproblem_.h->(IneqValuesNext-IneqconstraintJac*ptrial) and resolve the problem.
+                socEqValues_ = eqValuesNext_ - eqJacStep_;
+                socIneqValues_ = ineqValuesNext_ - ineqJacStep_;
+                subproblem_.beq = -socEqValues_;
+                subproblem_.h = socIneqValues_;
+                subproblem_.beqDirty = true;
+                subproblem_.hDirty = true;
+                rhsModified_ = true;
+                StatsTimer correctionQpTimer(collectStats);
                 subsolution_ = solveSubproblem(subproblem_);
+                iterationStats.qpTime += correctionQpTimer.elapsed();
+                iterationStats.qpIterations += qpBackend_->iterations();
+                if (remainingTime() <= 0.0) {
+                    // as for the main QP, the corrected step is not evaluated
+                    status_ = SolverStatus::DEADLINE;
+                    iterationStats.secondOrderCorrectionTime = correctionTimer.elapsed();
+                    if (collectStats) {
+                        stats_.add(iterationStats, statsLevel_ > 1);
+                    }
+                    break;
+                }
                 std::memcpy(pTrial_.data(), subsolution_.data(), variableDim_ * sizeof(scalar_t));
                 xIterateNext_ = xIterate_ + pTrial_;
-                objNext = problem_.evaluateObjective(xIterateNext_);
-                eqValuesNext = problem_.evaluateEqualityConstraints(xIterateNext_);
-                ineqValuesNext = problem_.evaluateInequalityConstraints(xIterateNext_);
-                q_mu_0_ = evaluateQuadraticModel(obj_, objJac_, -subproblem_.beq, -subproblem_.bineq, objHessMat_, eqJacMat_, ineqJacMat_);
-                q_mu_pk_ = evaluateQuadraticModel(obj_, objJac_, -subproblem_.beq, -subproblem_.bineq, objHessMat_, eqJacMat_, ineqJacMat_, pTrial_);
-                phi_pk_ = evaluateMeritFunction(objNext, eqValuesNext, ineqValuesNext); // mertit function at the trial step
+                StatsTimer correctionEvaluationTimer(collectStats);
+                evaluateTrialPoint(objNext);
+                iterationStats.evaluationTime += correctionEvaluationTimer.elapsed();
+                StatsTimer correctionMeritTimer(collectStats);
+                computeStepProducts(pTrial_);
+                q_mu_0_ = evaluateMeritFunction(obj_, socEqValues_, socIneqValues_);
+                q_mu_pk_ = evaluateQuadraticModel(obj_, objJac_, socEqValues_, socIneqValues_, pTrial_);
+                phi_pk_ = evaluateMeritFunction(objNext, eqValuesNext_, ineqValuesNext_); // mertit function at the trial step
+                iterationStats.meritTime += correctionMeritTimer.elapsed();
+                iterationStats.secondOrderCorrectionTime = correctionTimer.elapsed();
             }
  
             reduction_ratio_ = (phi_ - phi_pk_) / (q_mu_0_ - q_mu_pk_);
@@ -257,30 +513,59 @@ public:
                 // if the trial step is accepted, update the iterate
                 xIterate_ = xIterateNext_;
                 obj_ = objNext;
-                eqValues_ = eqValuesNext;
-                ineqValues_ = ineqValuesNext;
+                // copies, not swaps: the python views of get_equality_values/get_inequality_values stay on these buffers
+                eqValues_ = eqValuesNext_;
+                ineqValues_ = ineqValuesNext_;
                 phi_ = phi_pk_;
                 q_mu_0_ = phi_;
-                objJac_ = problem_.evaluateObjectiveGradient(xIterate_).toDense().row(0).transpose();
-                objHessCSR_ = problem_.evaluateObjectiveHessianCSR(xIterate_);
-                objHessCSR_.toEigenSparseMatrix(objHessMat_);
-                eqJacCSR_ = problem_.evaluateEqualityConstraintsJacobianCSR(xIterate_);
-                eqJacCSR_.toEigenSparseMatrix(eqJacMat_);
-                ineqJacCSR_ = problem_.evaluateInequalityConstraintsJacobianCSR(xIterate_);
-                ineqJacCSR_.toEigenSparseMatrix(ineqJacMat_);
+                iterateChanged_ = true;
+                iterationStats.accepted = true;
+                updateBestIterate();
+                StatsTimer derivativeTimer(collectStats);
+                if (hessianType_ >= 1) {
+                    // multipliers of the last subproblem, the one that produced the accepted step
+                    eqMultipliers_ = qpBackend_->equalityDuals();
+                    ineqMultipliers_ = qpBackend_->inequalityDuals();
+                }
+                if (fusedEvaluation_ && xIterate_ == derivativesNextPoint_) {
+                    // first derivatives were evaluated together with the values of the trial point, the hessian only here
+                    objJac_.swap(objJacNext_);
+                    std::swap(eqJacCSR_, eqJacCSRNext_);
+                    std::swap(ineqJacCSR_, ineqJacCSRNext_);
+                    problem_.evaluateObjectiveHessianCSR(xIterate_, objHessCSR_, constantDerivativesEvaluated_);
+                } else if (hessianType_ == 2) {
+                    updateQuasiNewtonDerivatives();
+                } else {
+                    // objective derivatives overlap the constraint jacobians when the thread pool is enabled
+                    evaluateDerivatives();
+                }
+                iterationStats.derivativeTime = derivativeTimer.elapsed();
             }
             else {
                 // if the trial step is rejected, the trust region radius is shrinked but not update the iterate.
                 // std::cout<<"Trial step rejected."<<std::endl;
             }
 
+            if (collectStats) {
+                stats_.add(iterationStats, statsLevel_ > 1);
+            }
+            if (traceRecorder_) {
+                recordTrace(iterationStats);
+            }
             // check the stopping criteria, increase the penalty if necessary.
             if (checkStoppingCriteria()) {
                 break;
             }
         }
+        if (status_ == SolverStatus::NOT_SOLVED) {
+            status_ = SolverStatus::ITERATION_LIMIT;
+        }
+        if (status_ == SolverStatus::DEADLINE || status_ == SolverStatus::ITERATION_LIMIT || status_ == SolverStatus::CANCELLED) {
+            restoreBestIterate();
+        }
         auto endsolve = std::chrono::high_resolution_clock::now();
         time_total = std::chrono::duration_cast<std::chrono::milliseconds>(endsolve - startsolve).count();
+        stats_.totalTime = std::chrono::duration<scalar_t, std::milli>(endsolve - startsolve).count();
         // xHistory_.push_back(xIterate_); // Maintain full state for x
         // meritHistory_.push_back(phi_);
         costHistory_.push_back(obj_);
@@ -288,17 +573,119 @@ public:
         // ineqViolationHistory_.push_back((-ineqValues_).array().maxCoeff());
         // trustRegionRadiusHistory_.push_back(trustRegionRadius_);
         // saveResults(); // save the results to .mat file
+        ++traceSolve_;
+    }
+
+    // Opt-in trace: every iteration of the following solves appends one record (x, step, merit, violations, radius, mu,
+    // phase times) to fileName, an NPY file described in TraceRecorder.h. The records go through a preallocated ring of
+    // capacity records, a writer thread does the file I/O. Not while a solve is running.
+    void setTraceFile(const std::string& fileName, size_t capacity = 1024) {
+        if (solving_) {
+            throw std::runtime_error("The trace file cannot be changed while a solve is running.");
+        }
+        traceRecorder_.reset();
+        traceFileName_ = fileName;
+        traceCapacity_ = capacity;
+        traceSolve_ = 0;
     }
 
+    // writes the pending records and closes the trace file
+    void closeTrace() {
+        setTraceFile("");
+    }
+
+    // copy of the solution, prints the summary of the solve unless printSolution is 0
     vector_t getSolution() {
-        std::cout << "Optimization problem:" << problemName_ << " solved in " << currentIterate_ << " iterations." << std::endl;
+        if (solverParameters_.getParameters("printSolution")(0) > 0) {
+            printSummary();
+        }
+        return xIterate_;
+    }
+
+    void printSummary() const {
+        std::cout << "Optimization problem:" << problemName_ << " solved in " << currentIterate_ << " iterations, status: " << toString(status_) << "." << std::endl;
         std::cout << "Solver time: " << time_total << "ms" << std::endl;
         std::cout << "QP solver time: " << time_qp/1000 << "ms" << std::endl;
-        std::cout << "max constraint violation: equality: " << eqValues_.array().abs().maxCoeff() << " inequality: " << (-ineqValues_).array().maxCoeff() << std::endl;
-        std::cout << "obj from " << costHistory_[0] << " to " << costHistory_.back() << std::endl;
+        std::cout << "max constraint violation: equality: " << getMaxEqualityViolation() << " inequality: " << getMaxInequalityViolation() << std::endl;
+        if (!costHistory_.empty()) {
+            std::cout << "obj from " << costHistory_[0] << " to " << costHistory_.back() << std::endl;
+        }
+    }
+
+    // ------------------------ results of the last solve, without printing ------------------------ //
+    // the references stay valid for the lifetime of the solver, the values are overwritten by the next solve
+    const vector_t& getIterate() const {
         return xIterate_;
     }
 
+    const vector_t& getEqualityValues() const {
+        return eqValues_;
+    }
+
+    const vector_t& getInequalityValues() const { // feasible if >= 0
+        return ineqValues_;
+    }
+
+    const vector_t& getEqualityMultipliers() const {
+        return eqMultipliers_;
+    }
+
+    const vector_t& getInequalityMultipliers() const {
+        return ineqMultipliers_;
+    }
+
+    // objective of every iterate, reallocated while growing
+    const std::vector<scalar_t>& getCostHistory() const {
+        return costHistory_;
+    }
+
+    size_t getNumIterations() const {
+        return currentIterate_;
+    }
+
+    scalar_t getObjectiveValue() const {
+        return obj_;
+    }
+
+    scalar_t getMaxEqualityViolation() const {
+        return hasEqualityConstraints_ ? eqValues_.array().abs().maxCoeff() : 0.0;
+    }
+
+    scalar_t getMaxInequalityViolation() const {
+        return hasInequalityConstraints_ ? std::max((-ineqValues_).array().maxCoeff(), 0.0) : 0.0;
+    }
+
+    scalar_t getSolveTime() const { // ms
+        return time_total;
+    }
+
+    scalar_t getQPTime() const { // ms
+        return time_qp / 1000;
+    }
+
+    // ask the running (or, if called while idle, the next) solve to stop, checked between the SQP iterations.
+    // Thread safe, the solve returns with the last accepted iterate.
+    void requestCancel() {
+        cancelRequested_ = true;
+    }
+
+    SolverStatus getStatus() const {
+        return status_;
+    }
+
+    bool wasCancelled() const {
+        return cancelled_;
+    }
+
+    bool isSolving() const {
+        return solving_;
+    }
+
+    // phase times and counters of the last solve, see the collectStats parameter
+    const SolverStats& getStats() const {
+        return stats_;
+    }
+
     void saveResults(const std::string& folderPrefix) {
         // // Get the current time as a unique identifier
         // std::time_t t = std::time(nullptr);
@@ -356,130 +743,277 @@ public:
     }
 
 private:
-    // standard subproblem format for the QP solver.
-    struct SubproblemData {
-        vector_t g;
-        sparse_matrix_t H;
-        sparse_matrix_t Aeq;
-        sparse_matrix_t Aineq;
-        vector_t beq;
-        vector_t bineq;
-        vector_t lb;
-        vector_t ub;
-        vector_t x0;
-        SubproblemData() = default;
-        SubproblemData(size_t totalVars, size_t numEqualityConstraints, size_t numInequalityConstraints, size_t variableDim)
-            : g(totalVars),
-              H(totalVars, totalVars),
-              Aeq(numEqualityConstraints, totalVars),
-              Aineq(numInequalityConstraints, totalVars),
-              beq(numEqualityConstraints),
-              bineq(numInequalityConstraints),
-              lb(totalVars),
-              ub(totalVars),
-              x0(totalVars) 
-              {}
-    };
-
-
-    // for piqp
+    // the problem, the parameters and the buffers belong to the running solve (e.g. solve_async), changing them is a race
+    void checkNotSolving(const char* operation) const {
+        if (solving_) {
+            throw std::runtime_error(std::string("SolverInterface::") + operation + " is not allowed while a solve is running.");
+        }
+    }
+
+    // values at the trial point, with fused evaluation the gradient and the jacobians are evaluated in the same pass and
+    // cached with the point they belong to, so neither an accepted step nor a second order correction evaluates a point twice.
+    // The hessian is left to the acceptance, rejected and second order correction points never need it.
+    void evaluateTrialPoint(scalar_t& objNext) {
+        if (fusedEvaluation_) {
+            problem_.evaluateValuesAndDerivatives(xIterateNext_, objNext, eqValuesNext_, ineqValuesNext_, objJacNext_, eqJacCSRNext_, ineqJacCSRNext_,
+                                                  constantDerivativesEvaluated_);
+            derivativesNextPoint_ = xIterateNext_;
+        } else {
+            problem_.evaluateValues(xIterateNext_, objNext, eqValuesNext_, ineqValuesNext_);
+        }
+    }
+
+    // derivatives at the current iterate, the hessian of the QP model is the objective or the lagrangian hessian, or its quasi-Newton approximation
+    void evaluateDerivatives() {
+        if (hessianType_ == 1) {
+            problem_.evaluateDerivatives(xIterate_, eqMultipliers_, ineqMultipliers_, objJac_, objHessCSR_, eqJacCSR_, ineqJacCSR_, constantDerivativesEvaluated_);
+            if (convexifyHessian_) {
+                convexifyHessian(objHessCSR_);
+            }
+        } else if (hessianType_ == 2) {
+            problem_.evaluateDerivatives(xIterate_, objJac_, eqJacCSR_, ineqJacCSR_, constantDerivativesEvaluated_);
+            quasiNewton_.getCSRValues(objHessCSR_.values.data());
+        } else {
+            problem_.evaluateDerivatives(xIterate_, objJac_, objHessCSR_, eqJacCSR_, ineqJacCSR_, constantDerivativesEvaluated_);
+        }
+    }
+
+    // first derivatives at the accepted iterate and the quasi-Newton update with the step and the change of the lagrangian gradient,
+    // both gradients with the multipliers of the accepted step. The derivative buffers still hold the previous iterate.
+    void updateQuasiNewtonDerivatives() {
+        computeLagrangianGradient(lagrangianGradientPrevious_);
+        problem_.evaluateDerivatives(xIterate_, objJac_, eqJacCSR_, ineqJacCSR_, constantDerivativesEvaluated_);
+        computeLagrangianGradient(lagrangianGradient_);
+        lagrangianGradient_ -= lagrangianGradientPrevious_;
+        quasiNewton_.update(pTrial_, lagrangianGradient_);
+        quasiNewton_.getCSRValues(objHessCSR_.values.data());
+    }
+
+    // gradient of L = f + eqMultipliers' c_eq - ineqMultipliers' c_ineq (see OptimizationProblem) from the current derivative buffers
+    void computeLagrangianGradient(vector_t& gradient) const {
+        gradient = objJac_;
+        gradient.noalias() += eqJacCSR_.map(variableDim_).transpose() * eqMultipliers_;
+        gradient.noalias() -= ineqJacCSR_.map(variableDim_).transpose() * ineqMultipliers_;
+    }
+
+    // the lagrangian hessian can be indefinite, shift the diagonal until every row is diagonally dominant (Gershgorin), so the QP stays convex
+    // An upper triangular entry (i, j) also counts for row j.
+    void convexifyHessian(CSRSparseMatrix& hessian) {
+        hessianOffDiagonal_.setZero();
+        for (size_t i = 0; i < variableDim_; ++i) {
+            for (size_t k = hessian.outerIndex[i]; k < hessian.outerIndex[i + 1]; ++k) {
+                const size_t j = hessian.innerIndices[k];
+                if (j != i) {
+                    hessianOffDiagonal_[i] += std::abs(hessian.values[k]);
+                    if (hessianUpperTriangular_) {
+                        hessianOffDiagonal_[j] += std::abs(hessian.values[k]);
+                    }
+                }
+            }
+        }
+        for (size_t i = 0; i < variableDim_; ++i) {
+            scalar_t& diagonal = hessian.values[hessianDiagonalSlots_[i]];
+            diagonal += std::max(0.0, hessianRegularization_ + hessianOffDiagonal_[i] - diagonal);
+        }
+    }
+
+    // full construction of the subproblem
     void constructSubproblem(const vector_t& objJac, const CSRSparseMatrix& objHess, const vector_t& eqValues, const vector_t& ineqValues, const CSRSparseMatrix& eqJac, const CSRSparseMatrix& ineqJac) {
-        // construct the subproblem for the QP solver
         // build objecitve gradient and hessian
-        if (weightedMode_ > 0){
-            subproblem_.g.setOnes();
-            subproblem_.g.head(variableDim_) = objJac;
-            // use mu_matrix_ to construct g:[objJac;mu_matrix(1:numEqualityConstraints,1:numEqualityConstraints)*ones(numEqualityConstraints,1);mu_matrix(1:numEqualityConstraints,1:numEqualityConstraints)*ones(numEqualityConstraints,1);mu_matrix(numEq:end,numEq:end)*ones(numInequalityConstraints,1)]
-            vector_t mu_eq(numEqualityConstraints_,1);
-            vector_t mu_ineq(numInequalityConstraints_,1);
-            for (size_t i = 0; i < numEqualityConstraints_; ++i) {
-                mu_eq[i] = mu_matrix_.valuePtr()[i];
+        buildSubproblemGradient(objJac);
+        // matrices built only from constant blocks were passed to the QP solver with the first subproblem of the solve
+        const bool reuseMatrices = constantDerivativesEvaluated_ && constantMatricesUploaded_;
+        subproblem_.HDirty = !(reuseMatrices && hessianType_ == 0 && problem_.hasConstantObjectiveHessian());
+        subproblem_.AeqDirty = !(reuseMatrices && problem_.hasConstantEqualityJacobian());
+        subproblem_.GDirty = !(reuseMatrices && problem_.hasConstantInequalityJacobian());
+        constantMatricesUploaded_ = constantDerivativesEvaluated_;
+        if (elasticMode_) {
+            if (subproblem_.HDirty) {
+                objHess.toEigenSparseMatrixValues(subproblem_.H);
+            }
+            if (subproblem_.AeqDirty) {
+                eqJac.toEigenSparseMatrixValues(subproblem_.Aeq);
+            }
+            if (subproblem_.GDirty) {
+                ineqJac.toEigenSparseMatrixValues(subproblem_.G);
+                scalar_t* ineqValuesG = subproblem_.G.valuePtr();
+                for (Eigen::Index k = 0; k < subproblem_.G.nonZeros(); ++k) {
+                    ineqValuesG[k] = -ineqValuesG[k];
+                }
+            }
+        } else {
+            // [H,0;0,0] shares the value layout of H
+            if (subproblem_.HDirty) {
+                objHess.toEigenSparseMatrixValues(subproblem_.H);
             }
-            for (size_t i = 0; i < numInequalityConstraints_; ++i) {
-                mu_ineq[i] = mu_matrix_.valuePtr()[numEqualityConstraints_ + i];
+            // build equality constraints
+            if (subproblem_.AeqDirty) {
+                buildBlockAeq(eqJac, subproblem_.Aeq);
+            }
+            // build inequality constraints
+            if (subproblem_.GDirty) {
+                buildBlockAin(ineqJac, subproblem_.G);
             }
-            // memory copy
-            std::memcpy(subproblem_.g.data() + variableDim_, mu_eq.data(), numEqualityConstraints_ * sizeof(scalar_t));
-            std::memcpy(subproblem_.g.data() + offsetW_, mu_eq.data(), numEqualityConstraints_ * sizeof(scalar_t));
-            std::memcpy(subproblem_.g.data() + offsetT_, mu_ineq.data(), numInequalityConstraints_ * sizeof(scalar_t));
         }
-        else {
-            subproblem_.g.setConstant(mu_);
+        buildSubproblemRhs(eqValues, ineqValues);
+        buildSubproblemBounds();
+    }
+
+    void buildSubproblemGradient(const vector_t& objJac) {
+        if (elasticMode_) {
+            // the penalties weight the elastic rows instead of the slack columns
+            subproblem_.g = objJac;
+            subproblem_.eqPenalty = penaltyWeights_.head(numEqualityConstraints_);
+            subproblem_.ineqPenalty = penaltyWeights_.tail(numInequalityConstraints_);
+            subproblem_.penaltyDirty = true;
+        } else {
+            // penalties of the slack columns v, w (equalities) and t (inequalities)
             subproblem_.g.head(variableDim_) = objJac;
+            subproblem_.g.segment(offsetV_, numEqualityConstraints_) = penaltyWeights_.head(numEqualityConstraints_);
+            subproblem_.g.segment(offsetW_, numEqualityConstraints_) = penaltyWeights_.head(numEqualityConstraints_);
+            subproblem_.g.segment(offsetT_, numInequalityConstraints_) = penaltyWeights_.tail(numInequalityConstraints_);
         }
+        subproblem_.gDirty = true;
+    }
 
-        buildBlockObjHessCSR(objHess, objHessAugCSR_);
-        objHessAugCSR_.toEigenSparseMatrix(subproblem_.H);
-        // build equality constraints
-        buildBlockAeqCSR(eqJac, eqJacAugCSR_);
-        eqJacAugCSR_.toEigenSparseMatrix(subproblem_.Aeq);
+    void buildSubproblemRhs(const vector_t& eqValues, const vector_t& ineqValues) {
         subproblem_.beq = -eqValues;
-        // build inequality constraints
-        buildBlockAinCSR(ineqJac, ineqJacAugCSR_);
-        ineqJacAugCSR_.toEigenSparseMatrix(subproblem_.Aineq);
-        subproblem_.bineq = -ineqValues;
-        // bounds
-        subproblem_.lb.setZero();
+        subproblem_.h = ineqValues;
+        subproblem_.beqDirty = true;
+        subproblem_.hDirty = true;
+    }
+
+    // trust region bounds of the step, the bounds of the slack variables are set once in initializeProblem
+    void buildSubproblemBounds() {
+        if (trustRegionRadius_ == subproblemRadius_) {
+            return;
+        }
         subproblem_.lb.head(variableDim_).setConstant(-trustRegionRadius_);
-        // inf ub bounds for the slack variables
-        subproblem_.ub.setConstant(std::numeric_limits<scalar_t>::infinity());
         subproblem_.ub.head(variableDim_).setConstant(trustRegionRadius_);
-        subproblem_.x0.setZero();
+        subproblemRadius_ = trustRegionRadius_;
+        subproblem_.boundsDirty = true;
+    }
+
+    // J p, K p and H p of the trial step, computed once per step and shared by the quadratic model,
+    // the right hand side of the second order correction and the trust region update. The products read the derivative buffers in place.
+    void computeStepProducts(const vector_t& p) {
+        const CSRSparseMatrix& objHessCSR = objHessCSR_;
+        const CSRSparseMatrix& eqJacCSR = eqJacCSR_;
+        const CSRSparseMatrix& ineqJacCSR = ineqJacCSR_;
+        eqJacStep_.noalias() = eqJacCSR.map(variableDim_) * p;
+        ineqJacStep_.noalias() = ineqJacCSR.map(variableDim_) * p;
+        if (hessianUpperTriangular_) {
+            hessStep_.noalias() = objHessCSR.map(variableDim_).selfadjointView<Eigen::Upper>() * p;
+        } else {
+            hessStep_.noalias() = objHessCSR.map(variableDim_) * p;
+        }
+        stepInfNorm_ = p.size() > 0 ? p.lpNorm<Eigen::Infinity>() : 0.0;
     }
- 
 
-    scalar_t evaluateMeritFunction(const scalar_t& obj, const vector_t& eqValues, const vector_t& ineqValues)
-    {
-        // return obj + mu_ * (eqValues.array().abs().sum() + ((-ineqValues).array().max(0.0)).sum());
-        // use mu_matrix_ to weight the constraints violation
-        if (weightedMode_ > 0){
-            return obj + ones_eq_.transpose() * mu_matrix_.block(0,0,numEqualityConstraints_,numEqualityConstraints_) * eqValues.array().abs().matrix() + ones_ineq_.transpose() * mu_matrix_.block(numEqualityConstraints_,numEqualityConstraints_,numInequalityConstraints_,numInequalityConstraints_) * (-ineqValues).array().max(0.0).matrix();
+    // weighted l1 violation of the constraints c = eqValues, d = ineqValues (+ J p, K p of the last computeStepProducts when linearized)
+    scalar_t constraintPenalty(const vector_t& eqValues, const vector_t& ineqValues, bool linearized) const {
+        const scalar_t* weights = penaltyWeights_.data();
+        scalar_t penalty = 0.0;
+        for (size_t i = 0; i < numEqualityConstraints_; ++i) {
+            penalty += weights[i] * std::abs(linearized ? eqValues[i] + eqJacStep_[i] : eqValues[i]);
         }
-        else {
-            return obj + mu_ * (eqValues.array().abs().sum() + ((-ineqValues).array().max(0.0)).sum());
+        weights += numEqualityConstraints_;
+        for (size_t i = 0; i < numInequalityConstraints_; ++i) {
+            penalty += weights[i] * std::max(0.0, -(linearized ? ineqValues[i] + ineqJacStep_[i] : ineqValues[i]));
         }
+        return penalty;
+    }
+
+    // with p = 0, the merit function is also the quadratic model at a zero step
+    scalar_t evaluateMeritFunction(const scalar_t& obj, const vector_t& eqValues, const vector_t& ineqValues) const {
+        return obj + constraintPenalty(eqValues, ineqValues, false);
     }
 
-    scalar_t evaluateQuadraticModel(const scalar_t& obj, const vector_t& objJac, const vector_t& eqValues, const vector_t& ineqValues, const sparse_matrix_t& objHessMat, const sparse_matrix_t& eqJacMat, const sparse_matrix_t& ineqJacMat, const vector_t& p)
-    {
-        // return obj + objJac.dot(p) + 0.5 * p.transpose() * objHessMat * p  +  mu_ * ((eqValues + eqJacMat * p).array().abs().sum() + ((-ineqValues - ineqJacMat * p).array().max(0.0)).sum());
-        // use mu_matrix_ to weight the constraints violation
-        if (weightedMode_ > 0){
-            return obj + objJac.dot(p) + 0.5 * p.transpose() * objHessMat * p + ones_eq_.transpose() * mu_matrix_.block(0,0,numEqualityConstraints_,numEqualityConstraints_) * (eqValues + eqJacMat * p).array().abs().matrix() + ones_ineq_.transpose() * mu_matrix_.block(numEqualityConstraints_,numEqualityConstraints_,numInequalityConstraints_,numInequalityConstraints_) * (-ineqValues - ineqJacMat * p).array().max(0.0).matrix();
+    // quadratic model at the step p, whose products have been computed by computeStepProducts(p)
+    scalar_t evaluateQuadraticModel(const scalar_t& obj, const vector_t& objJac, const vector_t& eqValues, const vector_t& ineqValues, const vector_t& p) const {
+        return obj + objJac.dot(p) + 0.5 * p.dot(hessStep_) + constraintPenalty(eqValues, ineqValues, true);
+    }
+
+    // remaining time budget (ms) of the solve, the smaller of the wall time and the QP time budget, infinity without limits.
+    // pendingQPTime (ms) is spent in the running QP call and not yet counted in time_qp.
+    scalar_t remainingTime(scalar_t pendingQPTime = 0.0) const {
+        scalar_t remaining = std::numeric_limits<scalar_t>::infinity();
+        if (maxWallTime_ > 0) {
+            auto elapsed = std::chrono::duration<scalar_t, std::milli>(std::chrono::high_resolution_clock::now() - solveStart_).count();
+            remaining = std::min(remaining, maxWallTime_ - elapsed);
         }
-        else {
-            return obj + objJac.dot(p) + 0.5 * p.transpose() * objHessMat * p  +  mu_ * ((eqValues + eqJacMat * p).array().abs().sum() + ((-ineqValues - ineqJacMat * p).array().max(0.0)).sum());
+        if (maxQPTime_ > 0) {
+            remaining = std::min(remaining, maxQPTime_ - time_qp / 1000 - pendingQPTime);
         }
+        return remaining;
     }
 
-    scalar_t evaluateQuadraticModel(const scalar_t& obj, const vector_t& objJac, const vector_t& eqValues, const vector_t& ineqValues, const sparse_matrix_t& objHessMat, const sparse_matrix_t& eqJacMat, const sparse_matrix_t& ineqJacMat)
-    {   
-        if (weightedMode_ > 0){
-            return obj + ones_eq_.transpose() * mu_matrix_.block(0,0,numEqualityConstraints_,numEqualityConstraints_) * eqValues.array().abs().matrix() + ones_ineq_.transpose() * mu_matrix_.block(numEqualityConstraints_,numEqualityConstraints_,numInequalityConstraints_,numInequalityConstraints_) * (-ineqValues).array().max(0.0).matrix();
-            }
-        else {
-            return obj + mu_ * (eqValues.array().abs().sum() + ((-ineqValues).array().max(0.0)).sum());
-        
+    // keep the best iterate, ranked by the constraint violation (below constraintTol counts as feasible) and then by the merit.
+    // The merit of iterates before and after a penalty increase is compared as is.
+    void updateBestIterate() {
+        scalar_t violation = std::max(getMaxEqualityViolation(), getMaxInequalityViolation());
+        if (violation < constraintTol_) {
+            violation = 0.0;
+        }
+        if (violation < bestViolation_ || (violation == bestViolation_ && phi_ < bestMerit_)) {
+            bestViolation_ = violation;
+            bestMerit_ = phi_;
+            bestObj_ = obj_;
+            bestIterate_ = xIterate_;
+            bestEqValues_ = eqValues_;
+            bestIneqValues_ = ineqValues_;
+        }
+    }
+
+    void restoreBestIterate() {
+        if (bestViolation_ == std::numeric_limits<scalar_t>::infinity()) {
+            return;
         }
+        xIterate_ = bestIterate_;
+        obj_ = bestObj_;
+        phi_ = bestMerit_;
+        eqValues_ = bestEqValues_;
+        ineqValues_ = bestIneqValues_;
     }
 
-    // convex QP solver: now using the piqp.
-    vector_t solveSubproblem(const SubproblemData& subproblem) {
+    // convex QP solver behind the qpBackend parameter. Only the components marked dirty are passed to update, the others keep their values in the solver.
+    const vector_t& solveSubproblem(SubproblemData& subproblem) {
         auto startsol = std::chrono::high_resolution_clock::now();
-        // solve the subproblem using the QP solver
-        if (currentIterate_ == 0) {
-            // piqpSolver_.settings().max_iter = 200;
-            piqpSolver_.setup(subproblem.H, subproblem.g, subproblem.Aeq, subproblem.beq, -subproblem.Aineq, -subproblem.bineq,
-            subproblem.lb, subproblem.ub);
-          } else {
-            piqpSolver_.update(subproblem.H, subproblem.g, subproblem.Aeq, subproblem.beq, -subproblem.Aineq, -subproblem.bineq,
-            subproblem.lb, subproblem.ub);
-          }
-        piqp::Status status = piqpSolver_.solve();     
+        if (!qpSetup_) {
+            qpBackend_->setup(subproblem);
+            qpSetup_ = true;
+            qpSolved_ = false;
+            if (qpTimePerIteration_ <= 0.0) {
+                // no QP iteration measured yet: the setup (scaling, symbolic analysis of the KKT system) takes at least about
+                // one iteration, so it is a conservative seed and the first QP is capped as well
+                qpTimePerIteration_ = std::chrono::duration<scalar_t, std::milli>(std::chrono::high_resolution_clock::now() - startsol).count();
+            }
+        } else {
+            qpBackend_->update(subproblem);
+        }
+        subproblem.clearDirty();
+        // the backends have no time limit of their own: with a budget, their iterations are capped by the remaining time over the measured
+        // time per QP iteration
+        scalar_t remaining = remainingTime(std::chrono::duration<scalar_t, std::milli>(std::chrono::high_resolution_clock::now() - startsol).count());
+        if (qpTimePerIteration_ > 0.0 && remaining < std::numeric_limits<scalar_t>::infinity()) {
+            scalar_t iterations = std::max(remaining / qpTimePerIteration_, 1.0);
+            qpBackend_->setMaxIterations(iterations < qpMaxIterations_ ? static_cast<size_t>(iterations) : qpMaxIterations_);
+        } else {
+            qpBackend_->setMaxIterations(qpMaxIterations_);
+        }
+        // the previous QP solution (of this solve, or of the last one in mpc mode) starts the next one
+        if (qpWarmStart_ && qpSolved_) {
+            qpBackend_->warmStart(subsolution_);
+        }
+        qpBackend_->solve();
+        qpSolved_ = true;
         auto endsol = std::chrono::high_resolution_clock::now();
         time_qp += std::chrono::duration_cast<std::chrono::microseconds>(endsol - startsol).count();
-        return piqpSolver_.result().x;
-
+        if (qpBackend_->iterations() > 0) {
+            scalar_t perIteration = std::chrono::duration<scalar_t, std::milli>(endsol - startsol).count() / qpBackend_->iterations();
+            qpTimePerIteration_ = qpTimePerIteration_ > 0.0 ? 0.5 * (qpTimePerIteration_ + perIteration) : perIteration;
+        }
+        return qpBackend_->primal();
     }
 
     bool updateTrustRegionRadius(const scalar_t& reduction_ratio, const scalar_t& reduction_actual) {
@@ -489,7 +1023,7 @@ private:
             return false; // Step not accepted
         } else if (reduction_ratio < etaLow_) {
             trustRegionRadius_ *= 0.25; // shrink
-        } else if (reduction_ratio > etaHigh_ && pTrial_.array().abs().maxCoeff() > 0.95 * trustRegionRadius_) {
+        } else if (reduction_ratio > etaHigh_ && stepInfNorm_ > 0.95 * trustRegionRadius_) {
             // std::cout << "Increasing the trust region.\n";
             trustRegionRadius_ = std::min(2 * trustRegionRadius_, trustRegionMaxRadius_); // Increase trust region
         } else {
@@ -502,116 +1036,222 @@ private:
     bool checkStoppingCriteria() {
         // check the stopping criteria
         if (trustRegionRadius_ < trustRegionTol_ || pTrial_.norm()/xIterate_.norm() < trailTol_) {
-            std::cout << "current merit function converge, examing the constraints violation.\n" << std::endl;
+            if (verbose_) {
+                std::cout << "current merit function converge, examing the constraints violation.\n" << std::endl;
+            }
             if (eqValues_.array().abs().maxCoeff() < constraintTol_ && (-ineqValues_).array().maxCoeff() < constraintTol_) {
-                std::cout << "Optimization converged.\n" << std::endl;
+                if (verbose_) {
+                    std::cout << "Optimization converged.\n" << std::endl;
+                }
+                status_ = SolverStatus::CONVERGED;
                 return true;
             }
             else {
                 if (weightedMode_ > 0){
-                    scalar_t max_mu = std::numeric_limits<scalar_t>::lowest();
-
-                    // Iterate over diagonal elements only
-                    for (int i = 0; i < numConstraints_; ++i) {
-                        if (mu_matrix_.valuePtr()[i] > max_mu) {
-                            max_mu = mu_matrix_.valuePtr()[i];
-                        }
-                    }
-
+                    scalar_t max_mu = numConstraints_ > 0 ? penaltyWeights_.maxCoeff() : std::numeric_limits<scalar_t>::lowest();
                     if (max_mu == muMax_) {
-                        std::cout << "penalty maxed out, check the solution.\n" << std::endl;
+                        if (verbose_) {
+                            std::cout << "penalty maxed out, check the solution.\n" << std::endl;
+                        }
+                        status_ = SolverStatus::PENALTY_MAXED;
                         return true;
                     }
                     // mu_ = std::min(10 * mu_, muMax_);
-                    // update mu_matrix_ according to which constraints are violated.
+                    // update the penalty weights according to which constraints are violated.
                     for (size_t i = 0; i < numEqualityConstraints_; ++i) {
                         if (eqValues_.array().abs()[i] > weightedTol_*constraintTol_) {
-                            mu_matrix_.valuePtr()[i] = std::min(10 * mu_matrix_.valuePtr()[i], muMax_);
-                            // std::cout << "equality constraint " << i << " violated, increase penalty to " << mu_matrix_.valuePtr()[i] << std::endl;
+                            penaltyWeights_[i] = std::min(10 * penaltyWeights_[i], muMax_);
+                            // std::cout << "equality constraint " << i << " violated, increase penalty to " << penaltyWeights_[i] << std::endl;
                 
                         }
                     }
                     for (size_t i = 0; i < numInequalityConstraints_; ++i) {
                         if (-ineqValues_[i] > weightedTol_*constraintTol_) {
-                            mu_matrix_.valuePtr()[numEqualityConstraints_ + i] = std::min(10 * mu_matrix_.valuePtr()[numEqualityConstraints_ + i], muMax_);
-                            // std::cout << "inequality constraint " << i << " violated, increase penalty to " << mu_matrix_.valuePtr()[numEqualityConstraints_ + i] << std::endl;
+                            penaltyWeights_[numEqualityConstraints_ + i] = std::min(10 * penaltyWeights_[numEqualityConstraints_ + i], muMax_);
+                            // std::cout << "inequality constraint " << i << " violated, increase penalty to " << penaltyWeights_[numEqualityConstraints_ + i] << std::endl;
                         }
                     }
                 }
                 else {
                     if (mu_ == muMax_) {
-                        std::cout << "penalty maxed out, check the solution.\n" << std::endl;
+                        if (verbose_) {
+                            std::cout << "penalty maxed out, check the solution.\n" << std::endl;
+                        }
+                        status_ = SolverStatus::PENALTY_MAXED;
                         return true;
                     }
                     // std::cout << "increase penalty" << std::endl;
                     mu_ = std::min(10 * mu_, muMax_);
+                    penaltyWeights_.setConstant(mu_);
                 }
+                penaltyChanged_ = true;
+                ++stats_.penaltyIncreases;
                 phi_ = evaluateMeritFunction(obj_, eqValues_, ineqValues_);
-                q_mu_0_ = evaluateQuadraticModel(obj_, objJac_, eqValues_, ineqValues_, objHessMat_, eqJacMat_, ineqJacMat_);
+                q_mu_0_ = phi_;
                 // trustRegionRadius_ = trustRegionInitRadius_;
             }
         }
         return false;
     }
 
+    void recordTrace(const SolverIterationStats& iterationStats) {
+        scalar_t* record = traceRecorder_->beginRecord();
+        record[TraceRecorder::SOLVE] = traceSolve_;
+        record[TraceRecorder::ITERATION] = currentIterate_;
+        record[TraceRecorder::ACCEPTED] = iterationStats.accepted ? 1.0 : 0.0;
+        record[TraceRecorder::SECOND_ORDER_CORRECTION] = iterationStats.secondOrderCorrection ? 1.0 : 0.0;
+        record[TraceRecorder::OBJECTIVE] = obj_;
+        record[TraceRecorder::MERIT] = phi_;
+        record[TraceRecorder::TRIAL_MERIT] = phi_pk_;
+        record[TraceRecorder::REDUCTION_RATIO] = reduction_ratio_;
+        record[TraceRecorder::EQ_VIOLATION] = hasEqualityConstraints_ ? eqValues_.lpNorm<Eigen::Infinity>() : 0.0;
+        record[TraceRecorder::INEQ_VIOLATION] = hasInequalityConstraints_ ? std::max(0.0, -ineqValues_.minCoeff()) : 0.0;
+        record[TraceRecorder::TRUST_REGION_RADIUS] = trustRegionRadius_;
+        record[TraceRecorder::MU] = mu_;
+        record[TraceRecorder::STEP_NORM] = stepInfNorm_;
+        record[TraceRecorder::QP_ITERATIONS] = iterationStats.qpIterations;
+        record[TraceRecorder::SUBPROBLEM_TIME] = iterationStats.subproblemTime;
+        record[TraceRecorder::QP_TIME] = iterationStats.qpTime;
+        record[TraceRecorder::EVALUATION_TIME] = iterationStats.evaluationTime;
+        record[TraceRecorder::MERIT_TIME] = iterationStats.meritTime;
+        record[TraceRecorder::DERIVATIVE_TIME] = iterationStats.derivativeTime;
+        record[TraceRecorder::SECOND_ORDER_CORRECTION_TIME] = iterationStats.secondOrderCorrectionTime;
+        std::memcpy(record + TraceRecorder::NUM_FIELDS, xIterate_.data(), variableDim_ * sizeof(scalar_t));
+        std::memcpy(record + TraceRecorder::NUM_FIELDS + variableDim_, pTrial_.data(), variableDim_ * sizeof(scalar_t));
+        traceRecorder_->commitRecord();
+    }
+
     // save the results to a matlab file
 
 
-    // [A:offsetV:-I:offsetW:I:offsetT:0]: needs careful handling.
-    void buildBlockAeqCSR(const CSRSparseMatrix& Aeq, CSRSparseMatrix& Aeq_aug){
+    // [A:offsetV:-I:offsetW:I:offsetT:0]: needs careful handling. Sets the structure and the constant slack entries once.
+    void initializeBlockAeq(const CSRSparseMatrix& Aeq, sparse_matrix_t& Aeq_aug){
+        Aeq_aug.resize(numEqualityConstraints_, totalVars_);
+        Aeq_aug.resizeNonZeros(Aeq.nonZeros() + 2 * numEqualityConstraints_);
+        sparse_index_t* outer = Aeq_aug.outerIndexPtr();
+        sparse_index_t* inner = Aeq_aug.innerIndexPtr();
+        scalar_t* values = Aeq_aug.valuePtr();
         size_t numNonZeroCurrentRow;
         size_t numNonZeroTotal = 0;
         for (size_t i = 0; i < numEqualityConstraints_; ++i) {
-            Aeq_aug.outerIndex[i+1] = Aeq.outerIndex[i+1] + 2 * (i+1); // outer iterator
+            outer[i+1] = Aeq.outerIndex[i+1] + 2 * (i+1); // outer iterator
             numNonZeroCurrentRow = Aeq.outerIndex[i + 1] - Aeq.outerIndex[i];
-            // Aeq_aug[1].segment(numNonZeroTotal, numNonZeroCurrentRow + 2) << Aeq[1].segment(Aeq[0](i), numNonZeroCurrentRow), i + offsetV_, i + offsetW_;
-            std::memcpy(Aeq_aug.innerIndices.data() + numNonZeroTotal, Aeq.innerIndices.data() + Aeq.outerIndex[i], numNonZeroCurrentRow * sizeof(size_t));
-            // add i + offsetV_ and i + offsetW_ to the end of the vector
-            Aeq_aug.innerIndices[numNonZeroTotal + numNonZeroCurrentRow] = i + offsetV_;
-            Aeq_aug.innerIndices[numNonZeroTotal + numNonZeroCurrentRow + 1] = i + offsetW_;
-            // Aeq_aug[2].segment(numNonZeroTotal, numNonZeroCurrentRow + 2) << Aeq[2].segment(Aeq[0](i), numNonZeroCurrentRow), -1.0, 1.0;
-            std::memcpy(Aeq_aug.values.data() + numNonZeroTotal, Aeq.values.data() + Aeq.outerIndex[i], numNonZeroCurrentRow * sizeof(scalar_t));
-            Aeq_aug.values[numNonZeroTotal + numNonZeroCurrentRow] = -1.0;
-            Aeq_aug.values[numNonZeroTotal + numNonZeroCurrentRow + 1] = 1.0;
+            std::memcpy(inner + numNonZeroTotal, Aeq.innerIndices.data() + Aeq.outerIndex[i], numNonZeroCurrentRow * sizeof(sparse_index_t));
+            // add i + offsetV_ and i + offsetW_ to the end of the row
+            inner[numNonZeroTotal + numNonZeroCurrentRow] = i + offsetV_;
+            inner[numNonZeroTotal + numNonZeroCurrentRow + 1] = i + offsetW_;
+            std::memcpy(values + numNonZeroTotal, Aeq.values.data() + Aeq.outerIndex[i], numNonZeroCurrentRow * sizeof(scalar_t));
+            values[numNonZeroTotal + numNonZeroCurrentRow] = -1.0;
+            values[numNonZeroTotal + numNonZeroCurrentRow + 1] = 1.0;
             numNonZeroTotal += numNonZeroCurrentRow + 2;
         }
     }
-    // [A:offsetT:I]: needs careful handling.
-    void buildBlockAinCSR(const CSRSparseMatrix& Aineq, CSRSparseMatrix& Aineq_aug){
+    // -[A:offsetT:I] (PIQP's sign convention): needs careful handling. Sets the structure and the constant slack entries once.
+    void initializeBlockAin(const CSRSparseMatrix& Aineq, sparse_matrix_t& Aineq_aug){
+        Aineq_aug.resize(numInequalityConstraints_, totalVars_);
+        Aineq_aug.resizeNonZeros(Aineq.nonZeros() + numInequalityConstraints_);
+        sparse_index_t* outer = Aineq_aug.outerIndexPtr();
+        sparse_index_t* inner = Aineq_aug.innerIndexPtr();
+        scalar_t* values = Aineq_aug.valuePtr();
         size_t numNonZeroCurrentRow;
         size_t numNonZeroTotal = 0;
         for (size_t i = 0; i < numInequalityConstraints_; ++i) {
-            Aineq_aug.outerIndex[i+1] = Aineq.outerIndex[i+1] + (i+1); // outer iterator
+            outer[i+1] = Aineq.outerIndex[i+1] + (i+1); // outer iterator
             numNonZeroCurrentRow = Aineq.outerIndex[i + 1] - Aineq.outerIndex[i];
-            // Aineq_aug[1].segment(numNonZeroTotal, numNonZeroCurrentRow + 1) << Aineq[1].segment(Aineq[0](i), numNonZeroCurrentRow), i + offsetT_;
-            std::memcpy(Aineq_aug.innerIndices.data() + numNonZeroTotal, Aineq.innerIndices.data() + Aineq.outerIndex[i], numNonZeroCurrentRow * sizeof(size_t));
-            Aineq_aug.innerIndices[numNonZeroTotal + numNonZeroCurrentRow] = i + offsetT_;
-            // Aineq_aug[2].segment(numNonZeroTotal, numNonZeroCurrentRow + 1) << Aineq[2].segment(Aineq[0](i), numNonZeroCurrentRow), 1.0;
-            std::memcpy(Aineq_aug.values.data() + numNonZeroTotal, Aineq.values.data() + Aineq.outerIndex[i], numNonZeroCurrentRow * sizeof(scalar_t));
-            Aineq_aug.values[numNonZeroTotal + numNonZeroCurrentRow] = 1.0;
+            std::memcpy(inner + numNonZeroTotal, Aineq.innerIndices.data() + Aineq.outerIndex[i], numNonZeroCurrentRow * sizeof(sparse_index_t));
+            inner[numNonZeroTotal + numNonZeroCurrentRow] = i + offsetT_;
+            for (size_t k = 0; k < numNonZeroCurrentRow; ++k) {
+                values[numNonZeroTotal + k] = -Aineq.values[Aineq.outerIndex[i] + k];
+            }
+            values[numNonZeroTotal + numNonZeroCurrentRow] = -1.0;
             numNonZeroTotal += numNonZeroCurrentRow + 1;
         }
     }
-    // [H,0;0,0]
-    void buildBlockObjHessCSR(const CSRSparseMatrix& objHess, CSRSparseMatrix& objHess_aug){
-        std::memcpy(objHess_aug.innerIndices.data(), objHess.innerIndices.data(), objHess.innerIndices.size() * sizeof(size_t));
-        std::memcpy(objHess_aug.values.data(), objHess.values.data(), objHess.values.size() * sizeof(scalar_t));
-        // objHess_aug[0].segment(0, variableDim_ + 1) = objHess[0].segment(0, variableDim_ + 1);
-        // objHess_aug[0].segment(variableDim_ + 1, 2 * numEqualityConstraints_ + numInequalityConstraints_) = vector_t::Constant(2 * numEqualityConstraints_ + numInequalityConstraints_, objHess[0](variableDim_));
-        std::memcpy(objHess_aug.outerIndex.data(), objHess.outerIndex.data(), (variableDim_ + 1) * sizeof(size_t));
-        SizeVector temp(2 * numEqualityConstraints_ + numInequalityConstraints_, objHess.outerIndex[variableDim_]);
-        std::memcpy(objHess_aug.outerIndex.data() + variableDim_ + 1, temp.data(), temp.size() * sizeof(size_t));
+    // [H,0;0,0], the rows of the slack variables are empty
+    void initializeBlockObjHess(const CSRSparseMatrix& objHess, sparse_matrix_t& objHess_aug){
+        objHess_aug.resize(totalVars_, totalVars_);
+        objHess_aug.resizeNonZeros(objHess.nonZeros());
+        std::memcpy(objHess_aug.innerIndexPtr(), objHess.innerIndices.data(), objHess.innerIndices.size() * sizeof(sparse_index_t));
+        std::memcpy(objHess_aug.valuePtr(), objHess.values.data(), objHess.values.size() * sizeof(scalar_t));
+        std::memcpy(objHess_aug.outerIndexPtr(), objHess.outerIndex.data(), (variableDim_ + 1) * sizeof(sparse_index_t));
+        std::fill(objHess_aug.outerIndexPtr() + variableDim_ + 1, objHess_aug.outerIndexPtr() + totalVars_ + 1, objHess.outerIndex[variableDim_]);
+    }
+
+    // value-only refreshes of the augmented blocks, each row of A keeps its offset in the augmented matrix
+    void buildBlockAeq(const CSRSparseMatrix& Aeq, sparse_matrix_t& Aeq_aug){
+        scalar_t* values = Aeq_aug.valuePtr();
+        for (size_t i = 0; i < numEqualityConstraints_; ++i) {
+            size_t numNonZeroCurrentRow = Aeq.outerIndex[i + 1] - Aeq.outerIndex[i];
+            std::memcpy(values + Aeq.outerIndex[i] + 2 * i, Aeq.values.data() + Aeq.outerIndex[i], numNonZeroCurrentRow * sizeof(scalar_t));
+        }
+    }
+
+    // negated copy of the jacobian values, G = -[A,I]
+    void buildBlockAin(const CSRSparseMatrix& Aineq, sparse_matrix_t& Aineq_aug){
+        for (size_t i = 0; i < numInequalityConstraints_; ++i) {
+            scalar_t* augRow = Aineq_aug.valuePtr() + Aineq.outerIndex[i] + i;
+            for (sparse_index_t k = Aineq.outerIndex[i]; k < Aineq.outerIndex[i + 1]; ++k) {
+                *augRow++ = -Aineq.values[k];
+            }
+        }
     }
 
     // ----- variables ----- //
     std::string problemName_;
-    piqp::SparseSolver<scalar_t> piqpSolver_;
+    std::unique_ptr<QPBackend> qpBackend_;
     SubproblemData subproblem_;
     OptimizationProblem problem_;
     SolverParameters solverParameters_;
     bool initialized_;
+    bool mpcMode_;
+    bool qpSetup_; // the symbolic setup of the QP solver is done, later subproblems only update the values
+    bool qpWarmStart_; // start every QP but the first after a setup from the previous QP solution
+    bool qpSolved_; // subsolution_ holds a solution of the current QP setup
+    size_t hessianType_; // 0: objective hessian, 1: lagrangian hessian, 2: quasi-Newton approximation of the lagrangian hessian
+    QuasiNewtonHessian quasiNewton_;
+    vector_t lagrangianGradient_; // quasi-Newton: at the accepted iterate, then the change of the gradient
+    vector_t lagrangianGradientPrevious_;
+    bool convexifyHessian_;
+    scalar_t hessianRegularization_;
+    vector_t eqMultipliers_; // QP multipliers of the equality constraints, weights of the lagrangian hessian
+    vector_t ineqMultipliers_; // QP multipliers of the inequality constraints (G p <= h convention)
+    SizeVector hessianDiagonalSlots_;
+    vector_t hessianOffDiagonal_; // convexifyHessian: absolute sum of the off diagonal entries of every row
+    bool hessianUpperTriangular_ = false; // the hessian buffers hold the upper triangle of the symmetric hessian
+    bool fusedEvaluation_; // first derivatives are evaluated with the values of every trial point
+    bool reuseConstantDerivatives_ = false; // constant jacobian and hessian blocks are evaluated by the first evaluation of a solve only
+    bool constantDerivativesEvaluated_ = false; // the derivative buffers hold the constant blocks at the current parameters
+    bool constantMatricesUploaded_ = false; // the QP solver holds the constant matrices of this solve
+    bool elasticMode_; // QP over the problem variables with the l1 penalties in the backend, no slack columns
+    vector_t derivativesNextPoint_; // point of the *Next_ derivative buffers
+    vector_t objJacNext_;
+    CSRSparseMatrix eqJacCSRNext_;
+    CSRSparseMatrix ineqJacCSRNext_;
+    bool iterateChanged_; // the iterate moved, the whole subproblem has to be rebuilt
+    bool penaltyChanged_; // the penalties changed, the gradient of the subproblem has to be rebuilt
+    bool rhsModified_; // the second order correction changed beq/h of the subproblem
+    scalar_t subproblemRadius_; // trust region radius of the bounds in the subproblem
     size_t variableDim_;
     size_t secondOrderCorrectionCount;
+    size_t statsLevel_ = 0; // 0: off, 1: cumulative, 2: cumulative and per iteration
+    bool verbose_ = false;  // read at the start of every solve
+    SolverStatus status_ = SolverStatus::NOT_SOLVED;
+    // time budget (ms, 0: none) and the best iterate, returned when the solve stops early
+    std::chrono::high_resolution_clock::time_point solveStart_;
+    scalar_t maxWallTime_ = 0.0;
+    scalar_t maxQPTime_ = 0.0;
+    size_t qpMaxIterations_ = 0;      // max_iter of the PIQP settings, the cap without a budget
+    scalar_t qpTimePerIteration_ = 0.0; // ms, running average over the solves
+    scalar_t bestViolation_;
+    scalar_t bestMerit_;
+    scalar_t bestObj_;
+    vector_t bestIterate_;
+    vector_t bestEqValues_;
+    vector_t bestIneqValues_;
+    std::atomic<bool> solving_{false};
+    std::atomic<bool> cancelRequested_{false};
+    bool cancelled_ = false; // the last solve stopped on a cancellation
+    SolverStats stats_;
     vector_t subsolution_;
     vector_t xIterate_;
     vector_t xIterateTemp_;
@@ -620,22 +1260,25 @@ private:
     vector_t xIterateNext_;
     vector_t eqValues_;
     vector_t ineqValues_;
+    vector_t eqValuesNext_;
+    vector_t ineqValuesNext_;
     vector_t objJac_;
-    vector_t ones_eq_;
-    vector_t ones_ineq_;
+    vector_t penaltyWeights_; // of the equality constraints, then of the inequality constraints
+    // products of the trial step, see computeStepProducts
+    vector_t eqJacStep_;
+    vector_t ineqJacStep_;
+    vector_t hessStep_;
+    scalar_t stepInfNorm_ = 0.0;
+    // values at the trial step minus their linearization, the constraint values of the second order correction
+    vector_t socEqValues_;
+    vector_t socIneqValues_;
     // triplet_vector_t objHessTriplets_;
     // triplet_vector_t eqJacTriplets_;
     // triplet_vector_t ineqJacTriplets_;
-    sparse_matrix_t objHessMat_;
-    sparse_matrix_t eqJacMat_;
-    sparse_matrix_t ineqJacMat_;
-    sparse_matrix_t mu_matrix_;
+    // derivatives at the iterate, the QP matrices in subproblem_ are built from them
     CSRSparseMatrix objHessCSR_;
     CSRSparseMatrix eqJacCSR_;
     CSRSparseMatrix ineqJacCSR_;
-    CSRSparseMatrix objHessAugCSR_;
-    CSRSparseMatrix eqJacAugCSR_;
-    CSRSparseMatrix ineqJacAugCSR_;
     size_t currentIterate_;
     size_t numEqualityConstraints_;
     size_t numInequalityConstraints_;
@@ -645,6 +1288,8 @@ private:
     size_t numNonZerosObjHess_;
     size_t numNonZerosEqJac_;
     size_t numNonZerosIneqJac_;
+    size_t numThreads_;
+    std::shared_ptr<ThreadPool> threadPool_;
     scalar_t obj_; //objective function
     scalar_t phi_; //merit function
     scalar_t phi_pk_; //merit function at next step
@@ -681,6 +1326,11 @@ private:
     // std::vector<vector_t> xHistory_;
     // std::vector<scalar_t> meritHistory_;
     std::vector<scalar_t> costHistory_;
+    // per-iteration trace, see setTraceFile. The recorder is opened by the first solve after setTraceFile.
+    std::string traceFileName_;
+    size_t traceCapacity_ = 1024;
+    size_t traceSolve_ = 0;
+    std::unique_ptr<TraceRecorder> traceRecorder_;
     // std::vector<scalar_t> eqViolationHistory_;
     // std::vector<scalar_t> ineqViolationHistory_;
     // std::vector<scalar_t> trustRegionRadiusHistory_;
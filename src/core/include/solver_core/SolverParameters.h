@@ -34,6 +34,22 @@ private:
         setParameters("WeightedMode", vector_t::Constant(1, 0)); // 0: no weighted, 1: weighted
         setParameters("WeightedTolFactor", vector_t::Constant(1, 10.0)); // factor for the weighted mode
         setParameters("secondOrderCorrection", vector_t::Constant(1, 1)); // 0: no second order correction, 1: second order correction
+        setParameters("numThreads", vector_t::Constant(1, 1)); // threads for evaluating the problem blocks, 1: serial evaluation
+        setParameters("mpcMode", vector_t::Constant(1, 0)); // 0: every solve starts from scratch, 1: keep the QP setup, penalties and trust region across solves
+        setParameters("mpcShiftDim", vector_t::Constant(1, 0)); // variables per stage that shiftWarmStart time-shifts the previous solution by
+        setParameters("hessianType", vector_t::Constant(1, 0)); // 0: objective hessian, 1: lagrangian hessian with the QP multipliers (needs SECOND_ORDER constraints), 2: damped BFGS approximation, block diagonal over the stages of setStageStructure, diagonal without them (FIRST_ORDER functions suffice)
+        setParameters("quasiNewtonInitScale", vector_t::Constant(1, 1)); // hessianType 2: diagonal of the approximation before its first update
+        setParameters("convexifyHessian", vector_t::Constant(1, 1)); // lagrangian hessian: 0: as evaluated, 1: diagonal shift to a diagonally dominant (convex) hessian
+        setParameters("hessianRegularization", vector_t::Constant(1, 1e-8)); // lagrangian hessian: diagonal margin of the convexified hessian
+        setParameters("maxWallTime", vector_t::Constant(1, 0)); // time budget (ms) of a solve, 0: no limit. When exhausted the best iterate is returned
+        setParameters("maxQPTime", vector_t::Constant(1, 0)); // budget (ms) of the accumulated QP solve time of a solve, 0: no limit
+        setParameters("qpBackend", vector_t::Constant(1, 0)); // 0: PIQP, 1: interior point ordered by the stages of OptimizationProblem::setStageStructure (AMD without)
+        setParameters("qpWarmStart", vector_t::Constant(1, 1)); // 1: every QP starts from the previous QP solution (backends that cannot warm start ignore it), 0: from zero
+        setParameters("elasticMode", vector_t::Constant(1, 0)); // 0: QP with slack columns [J,-I,I] and [J,I], 1: elastic QP over the problem variables (needs qpBackend = 1)
+        setParameters("printSolution", vector_t::Constant(1, 1)); // 1: getSolution prints the summary of the solve, 0: silent
+        setParameters("collectStats", vector_t::Constant(1, 1)); // solver statistics (getStats): 0: off, 1: cumulative phase times and counters, 2: also per iteration
+        setParameters("fusedEvaluation", vector_t::Constant(1, 1)); // 1: evaluate values and first derivatives of the trial point together, the hessian after acceptance (hessianType 0 only), 0: all derivatives after acceptance
+        setParameters("reuseConstantDerivatives", vector_t::Constant(1, 0)); // 1: constant constraint jacobians and objective hessians (classified from the tapes) are evaluated and passed to the QP solver once per solve, 0: every iteration
         // ------------------parameters for inner iterations ------------------ //
         // to be added for inner convex QP solver.
     }
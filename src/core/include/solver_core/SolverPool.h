@@ -0,0 +1,139 @@
+// NOTE: the pool solves batches of independent problems (multi-start, parameter sweeps) over one problem definition on several cores.
+// Every worker owns a clone of the problem and its own SolverInterface, only the loaded model library code is shared.
+#ifndef SOLVER_POOL_H
+#define SOLVER_POOL_H
+#include "solver_core/SolverInterface.h"
+#include "common/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+namespace CRISP {
+// one solve of a batch: the initial guess and the problem parameters that differ from the problem definition
+struct SolverJob {
+    vector_t initialGuess;
+    std::unordered_map<std::string, vector_t> problemParameters;
+    SolverJob() = default;
+    SolverJob(const vector_t& guess, const std::unordered_map<std::string, vector_t>& parameters = {})
+        : initialGuess(guess), problemParameters(parameters) {}
+};
+
+// solution and statistics of one job
+struct SolverJobResult {
+    vector_t solution;
+    size_t iterations = 0;
+    scalar_t objective = 0.0;
+    scalar_t maxEqualityViolation = 0.0;
+    scalar_t maxInequalityViolation = 0.0;
+    scalar_t solveTime = 0.0; // ms
+    scalar_t qpTime = 0.0;    // ms
+    size_t worker = 0;        // index of the worker that solved the job
+    SolverStatus status = SolverStatus::NOT_SOLVED;
+    SolverStats stats;
+};
+
+class SolverPool {
+public:
+    SolverPool(OptimizationProblem& problem, SolverParameters& parameters, size_t numWorkers)
+        : baseParameters_(problem.getParametersMap()), threadPool_(numWorkers) {
+        if (numWorkers == 0) {
+            throw std::runtime_error("SolverPool requires at least one worker.");
+        }
+        SolverParameters workerParameters = parameters;
+        // the workers already run in parallel, the block evaluation inside a worker stays serial
+        workerParameters.setParameters("numThreads", vector_t::Constant(1, 1));
+        for (size_t i = 0; i < numWorkers; ++i) {
+            // every solver clones the problem, the workers share no evaluation state
+            workers_.emplace_back(std::make_unique<SolverInterface>(problem, workerParameters));
+            evaluators_.emplace_back(problem.clone());
+        }
+    }
+
+    // solve all jobs and return the results in the order of the jobs, the jobs are handed out to the workers dynamically
+    std::vector<SolverJobResult> solve(const std::vector<SolverJob>& jobs) {
+        std::vector<SolverJobResult> results(jobs.size());
+        std::atomic<size_t> nextJob(0);
+        threadPool_.parallelFor(workers_.size(), [&](size_t worker) {
+            size_t job;
+            while ((job = nextJob.fetch_add(1)) < jobs.size()) {
+                runJob(*workers_[worker], jobs[job], results[job]);
+                results[job].worker = worker;
+            }
+        });
+        return results;
+    }
+
+    // values (and jacobian values) of the problem function functionName at the rows of X with the parameters of the problem
+    // definition, see OptimizationProblem::evaluateFunctionBatch. The rows are split into one contiguous block per worker,
+    // every block is evaluated through the batched model of the worker's own clone of the problem.
+    void evaluateBatch(const std::string& functionName, const matrix_t& X, matrix_t& Y) {
+        evaluateBatch(functionName, X, Y, nullptr);
+    }
+
+    void evaluateBatch(const std::string& functionName, const matrix_t& X, matrix_t& Y, matrix_t& jacValues) {
+        evaluateBatch(functionName, X, Y, &jacValues);
+    }
+
+    // set a hyperparameter on all workers, like max iterations, trust region radius, etc
+    void setHyperParameters(const std::string& name, const vector_t& params) {
+        for (auto& worker : workers_) {
+            worker->setHyperParameters(name, params);
+        }
+    }
+
+    size_t getNumWorkers() const {
+        return workers_.size();
+    }
+
+private:
+    void runJob(SolverInterface& solver, const SolverJob& job, SolverJobResult& result) {
+        // restore the parameters of the problem definition first, so a job never sees the overrides of a previous job
+        for (const auto& it : baseParameters_) {
+            solver.setProblemParameters(it.first, it.second);
+        }
+        for (const auto& it : job.problemParameters) {
+            solver.setProblemParameters(it.first, it.second);
+        }
+        solver.initialize(job.initialGuess);
+        solver.solve();
+        result.solution = solver.getIterate();
+        result.iterations = solver.getNumIterations();
+        result.objective = solver.getObjectiveValue();
+        result.maxEqualityViolation = solver.getMaxEqualityViolation();
+        result.maxInequalityViolation = solver.getMaxInequalityViolation();
+        result.solveTime = solver.getSolveTime();
+        result.qpTime = solver.getQPTime();
+        result.stats = solver.getStats();
+        result.status = solver.getStatus();
+    }
+
+    void evaluateBatch(const std::string& functionName, const matrix_t& X, matrix_t& Y, matrix_t* jacValues) {
+        const size_t numPoints = X.rows();
+        const size_t numBlocks = std::min(evaluators_.size(), std::max<size_t>(numPoints, 1));
+        std::vector<matrix_t> blockY(numBlocks), blockJac(numBlocks);
+        threadPool_.parallelFor(numBlocks, [&](size_t b) {
+            const size_t begin = b * numPoints / numBlocks;
+            const size_t end = (b + 1) * numPoints / numBlocks;
+            evaluators_[b].evaluateFunctionBatch(functionName, X.middleRows(begin, end - begin), blockY[b], jacValues != nullptr ? &blockJac[b] : nullptr);
+        });
+        // the blocks know the output dimensions, every block has at least one point unless there are none at all
+        Y.resize(numPoints, blockY[0].cols());
+        if (jacValues != nullptr) {
+            jacValues->resize(numPoints, blockJac[0].cols());
+        }
+        for (size_t b = 0; b < numBlocks; ++b) {
+            const size_t begin = b * numPoints / numBlocks;
+            Y.middleRows(begin, blockY[b].rows()) = blockY[b];
+            if (jacValues != nullptr) {
+                jacValues->middleRows(begin, blockJac[b].rows()) = blockJac[b];
+            }
+        }
+    }
+
+    std::unordered_map<std::string, vector_t> baseParameters_;
+    std::vector<std::unique_ptr<SolverInterface>> workers_;
+    std::vector<OptimizationProblem> evaluators_; // clones of the problem definition for evaluateBatch, one per worker
+    ThreadPool threadPool_;
+};
+} // namespace CRISP
+#endif // SOLVER_POOL_H
@@ -0,0 +1,87 @@
+#ifndef SOLVER_STATS_H
+#define SOLVER_STATS_H
+
+#include "common/BasicTypes.h"
+#include <chrono>
+
+namespace CRISP {
+// wall time (ms) of the phases of one iteration.
+// The second order correction time covers its whole re-solve and re-evaluation, which are also counted in qp/evaluation time.
+struct SolverIterationStats {
+    scalar_t evaluationTime = 0.0;            // values at the trial points, with fused evaluation including their derivatives
+    scalar_t derivativeTime = 0.0;            // gradient, jacobians and hessian of an accepted step, evaluated in one (parallel) pass
+    scalar_t subproblemTime = 0.0;            // assembly of the QP
+    scalar_t qpTime = 0.0;
+    scalar_t meritTime = 0.0;                 // merit function and quadratic model
+    scalar_t secondOrderCorrectionTime = 0.0;
+    size_t qpIterations = 0;                  // QP solver iterations, the correction re-solve included
+    bool accepted = false;
+    bool secondOrderCorrection = false;
+};
+
+// cumulative phase times (ms) and counters of the last solve
+struct SolverStats {
+    scalar_t evaluationTime = 0.0;
+    scalar_t derivativeTime = 0.0;
+    scalar_t subproblemTime = 0.0;
+    scalar_t qpTime = 0.0;
+    scalar_t meritTime = 0.0;
+    scalar_t secondOrderCorrectionTime = 0.0;
+    scalar_t totalTime = 0.0;
+    size_t iterations = 0;
+    size_t acceptedSteps = 0;
+    size_t rejectedSteps = 0;
+    size_t secondOrderCorrections = 0;
+    size_t penaltyIncreases = 0;
+    size_t qpIterations = 0;
+    std::vector<SolverIterationStats> iterationHistory; // filled with collectStats = 2
+
+    // clear for the next solve, the history keeps its memory
+    void reset() {
+        std::vector<SolverIterationStats> history;
+        history.swap(iterationHistory);
+        *this = SolverStats();
+        iterationHistory.swap(history);
+        iterationHistory.clear();
+    }
+
+    void add(const SolverIterationStats& iteration, bool keepHistory) {
+        evaluationTime += iteration.evaluationTime;
+        derivativeTime += iteration.derivativeTime;
+        subproblemTime += iteration.subproblemTime;
+        qpTime += iteration.qpTime;
+        meritTime += iteration.meritTime;
+        secondOrderCorrectionTime += iteration.secondOrderCorrectionTime;
+        qpIterations += iteration.qpIterations;
+        ++iterations;
+        iteration.accepted ? ++acceptedSteps : ++rejectedSteps;
+        secondOrderCorrections += iteration.secondOrderCorrection ? 1 : 0;
+        if (keepHistory) {
+            iterationHistory.push_back(iteration);
+        }
+    }
+};
+
+// reads the clock only when the statistics are enabled
+class StatsTimer {
+public:
+    explicit StatsTimer(bool enabled) : enabled_(enabled) {
+        if (enabled_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    scalar_t elapsed() const { // ms
+        if (!enabled_) {
+            return 0.0;
+        }
+        return std::chrono::duration<scalar_t, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    bool enabled_;
+    std::chrono::steady_clock::time_point start_;
+};
+} // namespace CRISP
+
+#endif // SOLVER_STATS_H
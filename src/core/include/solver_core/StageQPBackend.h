@@ -0,0 +1,651 @@
+// NOTE: QP backend for trajectory problems. The SQP subproblems of a problem over N stages are block-banded: a constraint row couples
+// the variables of one stage with the next. The backend is a primal-dual interior point method (Mehrotra predictor-corrector) whose
+// reduced KKT system
+//     [H + G'WG + D   Aeq'] [dx]
+//     [Aeq            -E  ] [dy]
+// is ordered stage by stage (the variables of a stage, the slacks of its constraint rows, then the multipliers of its equality rows)
+// and factorized by a sparse LDL' without fill-reducing reordering. Like a Riccati recursion, the fill stays within the band,
+// so the cost of an iteration grows linearly with the number of stages. Without a stage structure an AMD ordering is used.
+// In elastic mode the l1 penalty slacks of the rows are eliminated analytically: they only change the diagonal weights W and E,
+// the system keeps the dimension and the pattern of the hard-constrained one.
+#ifndef STAGE_QP_BACKEND_H
+#define STAGE_QP_BACKEND_H
+#include "solver_core/QPBackend.h"
+#include <eigen3/Eigen/SparseCholesky>
+#include <eigen3/Eigen/OrderingMethods>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+namespace CRISP {
+class StageQPBackend : public QPBackend {
+public:
+    // stageVariableDims: sizes of the consecutive stages of the leading QP variables (the variables of the optimization problem).
+    // The remaining variables (the slacks of the subproblem) and the constraint rows are assigned to the first stage they touch.
+    // Empty: no stage structure, the KKT system is ordered by AMD.
+    explicit StageQPBackend(const SizeVector& stageVariableDims = SizeVector()) : stageVariableDims_(stageVariableDims) {}
+
+    void setup(const SubproblemData& qp) override {
+        numVariables_ = qp.g.size();
+        numEqualities_ = qp.Aeq.rows();
+        numInequalities_ = qp.G.rows();
+        size_t numStaged = std::accumulate(stageVariableDims_.begin(), stageVariableDims_.end(), size_t(0));
+        if (numStaged > numVariables_) {
+            throw std::runtime_error("StageQPBackend: the stage structure has more variables than the QP.");
+        }
+        elastic_ = qp.eqPenalty.size() > 0 || qp.ineqPenalty.size() > 0;
+        if (elastic_ && (static_cast<size_t>(qp.eqPenalty.size()) != numEqualities_ || static_cast<size_t>(qp.ineqPenalty.size()) != numInequalities_)) {
+            throw std::runtime_error("StageQPBackend: the elastic penalties do not match the constraint rows.");
+        }
+        H_ = qp.H;
+        Aeq_ = qp.Aeq;
+        G_ = qp.G;
+        H_.makeCompressed();
+        Aeq_.makeCompressed();
+        G_.makeCompressed();
+        g_ = qp.g;
+        beq_ = qp.beq;
+        h_ = qp.h;
+        lb_ = qp.lb;
+        ub_ = qp.ub;
+        eqPenalty_ = qp.eqPenalty;
+        ineqPenalty_ = qp.ineqPenalty;
+        // the finite bounds are fixed by the setup, an update may only change their values
+        lowerIndices_.clear();
+        upperIndices_.clear();
+        for (size_t i = 0; i < numVariables_; ++i) {
+            if (lb_[i] > -kInfinity) {
+                lowerIndices_.push_back(i);
+            }
+            if (ub_[i] < kInfinity) {
+                upperIndices_.push_back(i);
+            }
+        }
+        buildKKTStructure(numStaged);
+        allocateWorkspace();
+        hasWarmStart_ = false;
+    }
+
+    void update(const SubproblemData& qp) override {
+        if (qp.HDirty) {
+            copyValues(qp.H, H_);
+        }
+        if (qp.AeqDirty) {
+            copyValues(qp.Aeq, Aeq_);
+        }
+        if (qp.GDirty) {
+            copyValues(qp.G, G_);
+        }
+        if (qp.gDirty) {
+            g_ = qp.g;
+        }
+        if (qp.beqDirty) {
+            beq_ = qp.beq;
+        }
+        if (qp.hDirty) {
+            h_ = qp.h;
+        }
+        if (qp.boundsDirty) {
+            lb_ = qp.lb;
+            ub_ = qp.ub;
+        }
+        if (qp.penaltyDirty && elastic_) {
+            eqPenalty_ = qp.eqPenalty;
+            ineqPenalty_ = qp.ineqPenalty;
+        }
+    }
+
+    void warmStart(const vector_t& x) override {
+        x_ = x;
+        hasWarmStart_ = true;
+    }
+
+    bool solve() override {
+        initializeIterate();
+        const scalar_t primalScale = 1.0 + std::max(infNorm(beq_), infNorm(h_));
+        const scalar_t dualScale = 1.0 + std::max(infNorm(g_), std::max(infNorm(eqPenalty_), infNorm(ineqPenalty_)));
+        const size_t numComplementarity = numInequalities_ + lowerIndices_.size() + upperIndices_.size() + (elastic_ ? 2 * numEqualities_ + numInequalities_ : 0);
+        for (iterations_ = 0; iterations_ < maxIterations_; ++iterations_) {
+            computeResiduals();
+            scalar_t mu = numComplementarity > 0 ? complementarity(0.0) / numComplementarity : 0.0;
+            scalar_t primalResidual = std::max(std::max(infNorm(rp_), infNorm(ri_)), std::max(infNorm(rl_), infNorm(ru_)));
+            scalar_t dualResidual = std::max(infNorm(rd_), std::max(std::max(infNorm(rv_), infNorm(rw_)), infNorm(rt_)));
+            if (primalResidual < epsAbs_ + epsRel_ * primalScale && dualResidual < epsAbs_ + epsRel_ * dualScale && mu < epsAbs_) {
+                return true;
+            }
+            if (!factorizeKKT()) {
+                return false;
+            }
+            // predictor: affine scaling direction
+            setComplementarityTargets(0.0, false);
+            solveNewtonSystem();
+            scalar_t alpha = maxStepLength(1.0);
+            scalar_t sigma = numComplementarity > 0 ? std::pow(complementarity(alpha) / numComplementarity / mu, 3) : 0.0;
+            // corrector: centering and second order term of the affine direction
+            setComplementarityTargets(sigma * mu, true);
+            solveNewtonSystem();
+            alpha = std::min(1.0, kStepFraction * maxStepLength(1.0 / kStepFraction));
+            x_ += alpha * dx_;
+            y_ += alpha * dy_;
+            z_ += alpha * dz_;
+            s_ += alpha * ds_;
+            zl_ += alpha * dzl_;
+            sl_ += alpha * dsl_;
+            zu_ += alpha * dzu_;
+            su_ += alpha * dsu_;
+            if (elastic_) {
+                v_ += alpha * dv_;
+                zv_ += alpha * dzv_;
+                w_ += alpha * dw_;
+                zw_ += alpha * dzw_;
+                t_ += alpha * dt_;
+                zt_ += alpha * dzt_;
+            }
+        }
+        return false;
+    }
+
+    const vector_t& primal() const override {
+        return x_;
+    }
+
+    const vector_t& equalityDuals() const override {
+        return y_;
+    }
+
+    const vector_t& inequalityDuals() const override {
+        return z_;
+    }
+
+    size_t iterations() const override {
+        return iterations_;
+    }
+
+    size_t maxIterations() const override {
+        return maxIterations_;
+    }
+
+    void setMaxIterations(size_t maxIterations) override {
+        maxIterations_ = maxIterations;
+    }
+
+    bool supportsElastic() const override {
+        return true;
+    }
+
+private:
+    using kkt_matrix_t = Eigen::SparseMatrix<scalar_t, Eigen::ColMajor, int>;
+    static constexpr scalar_t kInfinity = 1e20;    // bounds beyond are treated as absent
+    static constexpr scalar_t kStepFraction = 0.995; // fraction to the boundary
+    static constexpr scalar_t kPrimalRegularization = 1e-9;
+    static constexpr scalar_t kDualRegularization = 1e-9;
+    static constexpr scalar_t kMinElasticMultiplier = 1e-8;
+
+    static scalar_t infNorm(const vector_t& v) {
+        return v.size() > 0 ? v.lpNorm<Eigen::Infinity>() : 0.0;
+    }
+
+    static void copyValues(const sparse_matrix_t& source, sparse_matrix_t& target) {
+        if (source.nonZeros() != target.nonZeros()) {
+            throw std::runtime_error("StageQPBackend: the sparsity of the QP changed after the setup.");
+        }
+        std::copy(source.valuePtr(), source.valuePtr() + source.nonZeros(), target.valuePtr());
+    }
+
+    // position of every variable and equality multiplier in the KKT system, ordered by (stage, variable before multiplier, index)
+    void computeStageOrdering(size_t numStaged) {
+        const size_t numStages = stageVariableDims_.size();
+        SizeVector variableStage(numVariables_, numStages);
+        for (size_t k = 0, offset = 0; k < numStages; offset += stageVariableDims_[k], ++k) {
+            std::fill(variableStage.begin() + offset, variableStage.begin() + offset + stageVariableDims_[k], k);
+        }
+        auto rowStages = [&](const sparse_matrix_t& matrix) {
+            SizeVector stages(matrix.rows(), numStages - 1);
+            for (Eigen::Index r = 0; r < matrix.rows(); ++r) {
+                for (sparse_matrix_t::InnerIterator it(matrix, r); it; ++it) {
+                    if (static_cast<size_t>(it.col()) < numStaged) {
+                        stages[r] = std::min(stages[r], variableStage[it.col()]);
+                    }
+                }
+            }
+            return stages;
+        };
+        SizeVector equalityStage = rowStages(Aeq_);
+        SizeVector inequalityStage = rowStages(G_);
+        // the variables beyond the staged ones belong to the first row they appear in
+        SizeVector stage(variableStage);
+        auto assignColumns = [&](const sparse_matrix_t& matrix, const SizeVector& rowStage) {
+            for (Eigen::Index r = 0; r < matrix.rows(); ++r) {
+                for (sparse_matrix_t::InnerIterator it(matrix, r); it; ++it) {
+                    if (static_cast<size_t>(it.col()) >= numStaged) {
+                        stage[it.col()] = std::min(stage[it.col()], rowStage[r]);
+                    }
+                }
+            }
+        };
+        assignColumns(Aeq_, equalityStage);
+        assignColumns(G_, inequalityStage);
+        std::vector<std::tuple<size_t, size_t, size_t>> keys;
+        keys.reserve(numVariables_ + numEqualities_);
+        for (size_t j = 0; j < numVariables_; ++j) {
+            keys.emplace_back(std::min(stage[j], numStages - 1), 0, j);
+        }
+        for (size_t r = 0; r < numEqualities_; ++r) {
+            keys.emplace_back(equalityStage[r], 1, numVariables_ + r);
+        }
+        std::sort(keys.begin(), keys.end());
+        permutation_.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            permutation_[std::get<2>(keys[i])] = i;
+        }
+    }
+
+    // lower triangle pattern of the KKT system in the numbering of permutation_
+    kkt_matrix_t kktPattern() const {
+        std::vector<Eigen::Triplet<scalar_t, int>> triplets;
+        auto addEntry = [&](size_t i, size_t j) {
+            int row = permutation_[i];
+            int col = permutation_[j];
+            triplets.emplace_back(std::max(row, col), std::min(row, col), 0.0);
+        };
+        for (size_t i = 0; i < numVariables_ + numEqualities_; ++i) {
+            addEntry(i, i);
+        }
+        for (Eigen::Index r = 0; r < H_.rows(); ++r) {
+            for (sparse_matrix_t::InnerIterator it(H_, r); it; ++it) {
+                if (it.col() >= r) {
+                    addEntry(r, it.col());
+                }
+            }
+        }
+        for (Eigen::Index r = 0; r < Aeq_.rows(); ++r) {
+            for (sparse_matrix_t::InnerIterator it(Aeq_, r); it; ++it) {
+                addEntry(numVariables_ + r, it.col());
+            }
+        }
+        for (Eigen::Index r = 0; r < G_.rows(); ++r) {
+            for (int a = G_.outerIndexPtr()[r]; a < G_.outerIndexPtr()[r + 1]; ++a) {
+                for (int b = a; b < G_.outerIndexPtr()[r + 1]; ++b) {
+                    addEntry(G_.innerIndexPtr()[a], G_.innerIndexPtr()[b]);
+                }
+            }
+        }
+        kkt_matrix_t pattern(numVariables_ + numEqualities_, numVariables_ + numEqualities_);
+        pattern.setFromTriplets(triplets.begin(), triplets.end());
+        pattern.makeCompressed();
+        return pattern;
+    }
+
+    // slot of the lower triangle entry (i, j) of the permuted KKT matrix, i and j in the original numbering
+    int kktSlot(size_t i, size_t j) const {
+        int row = permutation_[i];
+        int col = permutation_[j];
+        if (row < col) {
+            std::swap(row, col);
+        }
+        const int* begin = kkt_.innerIndexPtr() + kkt_.outerIndexPtr()[col];
+        const int* end = kkt_.innerIndexPtr() + kkt_.outerIndexPtr()[col + 1];
+        return static_cast<int>(std::lower_bound(begin, end, row) - kkt_.innerIndexPtr());
+    }
+
+    // the ordering and pattern of the KKT matrix and the slot of every contribution, the values are assembled by factorizeKKT
+    void buildKKTStructure(size_t numStaged) {
+        const size_t dim = numVariables_ + numEqualities_;
+        if (!stageVariableDims_.empty()) {
+            computeStageOrdering(numStaged);
+        } else {
+            // AMD on the pattern in the natural numbering
+            permutation_.resize(dim);
+            std::iota(permutation_.begin(), permutation_.end(), 0);
+            Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inversePermutation;
+            Eigen::AMDOrdering<int> ordering;
+            ordering(kktPattern().selfadjointView<Eigen::Lower>(), inversePermutation);
+            Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> amdPermutation = inversePermutation.inverse();
+            for (size_t i = 0; i < dim; ++i) {
+                permutation_[i] = amdPermutation.indices()[i];
+            }
+        }
+        kkt_ = kktPattern();
+
+        diagonalSlots_.resize(dim);
+        for (size_t i = 0; i < dim; ++i) {
+            diagonalSlots_[i] = kktSlot(i, i);
+        }
+        hessianSlots_.assign(H_.nonZeros(), -1);
+        for (Eigen::Index r = 0; r < H_.rows(); ++r) {
+            for (int k = H_.outerIndexPtr()[r]; k < H_.outerIndexPtr()[r + 1]; ++k) {
+                if (H_.innerIndexPtr()[k] >= r) {
+                    hessianSlots_[k] = kktSlot(r, H_.innerIndexPtr()[k]);
+                }
+            }
+        }
+        equalitySlots_.resize(Aeq_.nonZeros());
+        for (Eigen::Index r = 0; r < Aeq_.rows(); ++r) {
+            for (int k = Aeq_.outerIndexPtr()[r]; k < Aeq_.outerIndexPtr()[r + 1]; ++k) {
+                equalitySlots_[k] = kktSlot(numVariables_ + r, Aeq_.innerIndexPtr()[k]);
+            }
+        }
+        gramSlots_.clear();
+        gramRows_.clear();
+        gramFirst_.clear();
+        gramSecond_.clear();
+        for (Eigen::Index r = 0; r < G_.rows(); ++r) {
+            for (int a = G_.outerIndexPtr()[r]; a < G_.outerIndexPtr()[r + 1]; ++a) {
+                for (int b = a; b < G_.outerIndexPtr()[r + 1]; ++b) {
+                    gramSlots_.push_back(kktSlot(G_.innerIndexPtr()[a], G_.innerIndexPtr()[b]));
+                    gramRows_.push_back(r);
+                    gramFirst_.push_back(a);
+                    gramSecond_.push_back(b);
+                }
+            }
+        }
+        ldlt_.analyzePattern(kkt_);
+    }
+
+    void allocateWorkspace() {
+        const size_t numLower = lowerIndices_.size();
+        const size_t numUpper = upperIndices_.size();
+        const size_t numElasticEq = elastic_ ? numEqualities_ : 0;
+        const size_t numElasticIneq = elastic_ ? numInequalities_ : 0;
+        x_ = vector_t::Zero(numVariables_);
+        rd_.resize(numVariables_);
+        dx_.resize(numVariables_);
+        work_.resize(numVariables_);
+        y_.resize(numEqualities_);
+        rp_.resize(numEqualities_);
+        dy_.resize(numEqualities_);
+        z_.resize(numInequalities_);
+        s_.resize(numInequalities_);
+        ri_.resize(numInequalities_);
+        rc_.resize(numInequalities_);
+        dz_.resize(numInequalities_);
+        ds_.resize(numInequalities_);
+        weights_.resize(numInequalities_);
+        inequalityTerm_.resize(numInequalities_);
+        for (vector_t* bound : {&zl_, &sl_, &rl_, &rcl_, &dzl_, &dsl_}) {
+            bound->resize(numLower);
+        }
+        for (vector_t* bound : {&zu_, &su_, &ru_, &rcu_, &dzu_, &dsu_}) {
+            bound->resize(numUpper);
+        }
+        for (vector_t* elastic : {&v_, &zv_, &w_, &zw_, &rv_, &rw_, &rcv_, &rcw_, &dv_, &dzv_, &dw_, &dzw_}) {
+            elastic->resize(numElasticEq);
+        }
+        for (vector_t* elastic : {&t_, &zt_, &rt_, &rct_, &dt_, &dzt_}) {
+            elastic->resize(numElasticIneq);
+        }
+        kktRhs_.resize(numVariables_ + numEqualities_);
+        kktSolution_.resize(numVariables_ + numEqualities_);
+    }
+
+    // start from the warm start (or zero), with the slacks pushed into the interior.
+    // The elastic multipliers start halfway between zero and their penalty.
+    void initializeIterate() {
+        if (!hasWarmStart_ || x_.size() != static_cast<Eigen::Index>(numVariables_)) {
+            x_.setZero(numVariables_);
+        }
+        hasWarmStart_ = false;
+        y_.setZero();
+        s_.noalias() = h_ - G_ * x_;
+        s_ = s_.cwiseMax(1.0);
+        z_.setOnes();
+        for (size_t k = 0; k < lowerIndices_.size(); ++k) {
+            sl_[k] = std::max(x_[lowerIndices_[k]] - lb_[lowerIndices_[k]], 1.0);
+        }
+        for (size_t k = 0; k < upperIndices_.size(); ++k) {
+            su_[k] = std::max(ub_[upperIndices_[k]] - x_[upperIndices_[k]], 1.0);
+        }
+        zl_.setOnes();
+        zu_.setOnes();
+        if (elastic_) {
+            v_.setOnes();
+            w_.setOnes();
+            t_.setOnes();
+            zv_ = (0.5 * eqPenalty_).cwiseMax(scalar_t(kMinElasticMultiplier));
+            zw_ = zv_;
+            z_ = (0.5 * ineqPenalty_).cwiseMax(scalar_t(kMinElasticMultiplier));
+            zt_ = z_;
+        }
+    }
+
+    // y += Hsym x from the upper triangle of H
+    void addSymmetricHessianProduct(const vector_t& x, vector_t& y) const {
+        for (Eigen::Index r = 0; r < H_.rows(); ++r) {
+            for (sparse_matrix_t::InnerIterator it(H_, r); it; ++it) {
+                if (it.col() > r) {
+                    y[r] += it.value() * x[it.col()];
+                    y[it.col()] += it.value() * x[r];
+                } else if (it.col() == r) {
+                    y[r] += it.value() * x[r];
+                }
+            }
+        }
+    }
+
+    void computeResiduals() {
+        rd_ = g_;
+        addSymmetricHessianProduct(x_, rd_);
+        rd_.noalias() += Aeq_.transpose() * y_;
+        rd_.noalias() += G_.transpose() * z_;
+        for (size_t k = 0; k < lowerIndices_.size(); ++k) {
+            rd_[lowerIndices_[k]] -= zl_[k];
+            rl_[k] = x_[lowerIndices_[k]] - sl_[k] - lb_[lowerIndices_[k]];
+        }
+        for (size_t k = 0; k < upperIndices_.size(); ++k) {
+            rd_[upperIndices_[k]] += zu_[k];
+            ru_[k] = ub_[upperIndices_[k]] - x_[upperIndices_[k]] - su_[k];
+        }
+        rp_.noalias() = Aeq_ * x_;
+        rp_ -= beq_;
+        ri_.noalias() = G_ * x_;
+        ri_ += s_ - h_;
+        if (elastic_) {
+            // Aeq x - beq = v - w and G x + s - t = h, with the penalties as the costs of v, w and t
+            rp_ += w_ - v_;
+            ri_ -= t_;
+            rv_ = eqPenalty_ - y_ - zv_;
+            rw_ = eqPenalty_ + y_ - zw_;
+            rt_ = ineqPenalty_ - z_ - zt_;
+        }
+    }
+
+    // sum of the complementarity products after a step of length alpha along the current direction
+    scalar_t complementarity(scalar_t alpha) const {
+        scalar_t sum = (s_ + alpha * ds_).dot(z_ + alpha * dz_) + (sl_ + alpha * dsl_).dot(zl_ + alpha * dzl_) + (su_ + alpha * dsu_).dot(zu_ + alpha * dzu_);
+        if (elastic_) {
+            sum += (v_ + alpha * dv_).dot(zv_ + alpha * dzv_) + (w_ + alpha * dw_).dot(zw_ + alpha * dzw_) + (t_ + alpha * dt_).dot(zt_ + alpha * dzt_);
+        }
+        return sum;
+    }
+
+    // targets of the complementarity products: the current products, for the corrector with the second order term
+    // of the affine direction and minus the centering term
+    void setComplementarityTargets(scalar_t centering, bool corrector) {
+        auto target = [&](const vector_t& slack, const vector_t& multiplier, const vector_t& dSlack, const vector_t& dMultiplier, vector_t& rc) {
+            rc = slack.cwiseProduct(multiplier);
+            if (corrector) {
+                rc += dSlack.cwiseProduct(dMultiplier);
+                rc.array() -= centering;
+            }
+        };
+        target(s_, z_, ds_, dz_, rc_);
+        target(sl_, zl_, dsl_, dzl_, rcl_);
+        target(su_, zu_, dsu_, dzu_, rcu_);
+        if (elastic_) {
+            target(v_, zv_, dv_, dzv_, rcv_);
+            target(w_, zw_, dw_, dzw_, rcw_);
+            target(t_, zt_, dt_, dzt_, rct_);
+        }
+    }
+
+    // largest step (up to maxStep) that keeps the slacks and the multipliers of the inequalities and bounds nonnegative
+    scalar_t maxStepLength(scalar_t maxStep) const {
+        scalar_t alpha = maxStep;
+        auto limit = [&alpha](const vector_t& v, const vector_t& dv) {
+            for (Eigen::Index i = 0; i < v.size(); ++i) {
+                if (dv[i] < 0.0) {
+                    alpha = std::min(alpha, -v[i] / dv[i]);
+                }
+            }
+        };
+        limit(s_, ds_);
+        limit(z_, dz_);
+        limit(sl_, dsl_);
+        limit(zl_, dzl_);
+        limit(su_, dsu_);
+        limit(zu_, dzu_);
+        if (elastic_) {
+            limit(v_, dv_);
+            limit(zv_, dzv_);
+            limit(w_, dw_);
+            limit(zw_, dzw_);
+            limit(t_, dt_);
+            limit(zt_, dzt_);
+        }
+        return alpha;
+    }
+
+    // assemble [H + G'WG + D, Aeq'; Aeq, -E] in the fixed pattern and factorize, the regularization grows on a failed pivot.
+    // Hard rows: W = z/s, E = delta. Elastic rows: W = 1/(s/z + t/zt), E = delta + v/zv + w/zw.
+    bool factorizeKKT() {
+        if (elastic_) {
+            weights_ = (s_.cwiseQuotient(z_) + t_.cwiseQuotient(zt_)).cwiseInverse();
+        } else {
+            weights_ = z_.cwiseQuotient(s_);
+        }
+        for (scalar_t regularization = 1.0; regularization <= 1e6; regularization *= 100.0) {
+            scalar_t* values = kkt_.valuePtr();
+            std::fill(values, values + kkt_.nonZeros(), 0.0);
+            for (size_t i = 0; i < numVariables_; ++i) {
+                values[diagonalSlots_[i]] = regularization * kPrimalRegularization;
+            }
+            for (size_t r = 0; r < numEqualities_; ++r) {
+                values[diagonalSlots_[numVariables_ + r]] = -regularization * kDualRegularization - (elastic_ ? v_[r] / zv_[r] + w_[r] / zw_[r] : 0.0);
+            }
+            for (size_t k = 0; k < lowerIndices_.size(); ++k) {
+                values[diagonalSlots_[lowerIndices_[k]]] += zl_[k] / sl_[k];
+            }
+            for (size_t k = 0; k < upperIndices_.size(); ++k) {
+                values[diagonalSlots_[upperIndices_[k]]] += zu_[k] / su_[k];
+            }
+            for (size_t k = 0; k < hessianSlots_.size(); ++k) {
+                if (hessianSlots_[k] >= 0) {
+                    values[hessianSlots_[k]] += H_.valuePtr()[k];
+                }
+            }
+            for (size_t k = 0; k < equalitySlots_.size(); ++k) {
+                values[equalitySlots_[k]] += Aeq_.valuePtr()[k];
+            }
+            const scalar_t* gValues = G_.valuePtr();
+            for (size_t k = 0; k < gramSlots_.size(); ++k) {
+                values[gramSlots_[k]] += weights_[gramRows_[k]] * gValues[gramFirst_[k]] * gValues[gramSecond_[k]];
+            }
+            ldlt_.factorize(kkt_);
+            if (ldlt_.info() == Eigen::Success) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Newton direction for the complementarity targets: solve the reduced system, then recover the eliminated parts
+    void solveNewtonSystem() {
+        // the inequality multipliers follow from dz = W G dx + inequalityTerm_
+        if (elastic_) {
+            inequalityTerm_ = weights_.cwiseProduct(ri_ - rc_.cwiseQuotient(z_) + (t_.cwiseProduct(rt_) + rct_).cwiseQuotient(zt_));
+        } else {
+            inequalityTerm_ = (z_.cwiseProduct(ri_) - rc_).cwiseQuotient(s_);
+        }
+        work_ = -rd_;
+        work_.noalias() -= G_.transpose() * inequalityTerm_;
+        for (size_t k = 0; k < lowerIndices_.size(); ++k) {
+            work_[lowerIndices_[k]] -= (rcl_[k] + zl_[k] * rl_[k]) / sl_[k];
+        }
+        for (size_t k = 0; k < upperIndices_.size(); ++k) {
+            work_[upperIndices_[k]] -= (-rcu_[k] - zu_[k] * ru_[k]) / su_[k];
+        }
+        for (size_t i = 0; i < numVariables_; ++i) {
+            kktRhs_[permutation_[i]] = work_[i];
+        }
+        for (size_t r = 0; r < numEqualities_; ++r) {
+            scalar_t rhs = -rp_[r];
+            if (elastic_) {
+                rhs += -(v_[r] * rv_[r] + rcv_[r]) / zv_[r] + (w_[r] * rw_[r] + rcw_[r]) / zw_[r];
+            }
+            kktRhs_[permutation_[numVariables_ + r]] = rhs;
+        }
+        kktSolution_ = ldlt_.solve(kktRhs_);
+        for (size_t i = 0; i < numVariables_; ++i) {
+            dx_[i] = kktSolution_[permutation_[i]];
+        }
+        for (size_t r = 0; r < numEqualities_; ++r) {
+            dy_[r] = kktSolution_[permutation_[numVariables_ + r]];
+        }
+        if (elastic_) {
+            dz_.noalias() = G_ * dx_;
+            dz_ = weights_.cwiseProduct(dz_) + inequalityTerm_;
+            ds_ = -(rc_ + s_.cwiseProduct(dz_)).cwiseQuotient(z_);
+            dt_ = (t_.cwiseProduct(dz_ - rt_) - rct_).cwiseQuotient(zt_);
+            dzt_ = -(rct_ + zt_.cwiseProduct(dt_)).cwiseQuotient(t_);
+            dv_ = (v_.cwiseProduct(dy_ - rv_) - rcv_).cwiseQuotient(zv_);
+            dzv_ = -(rcv_ + zv_.cwiseProduct(dv_)).cwiseQuotient(v_);
+            dw_ = (w_.cwiseProduct(-rw_ - dy_) - rcw_).cwiseQuotient(zw_);
+            dzw_ = -(rcw_ + zw_.cwiseProduct(dw_)).cwiseQuotient(w_);
+        } else {
+            ds_ = -ri_;
+            ds_.noalias() -= G_ * dx_;
+            dz_ = -(rc_ + z_.cwiseProduct(ds_)).cwiseQuotient(s_);
+        }
+        for (size_t k = 0; k < lowerIndices_.size(); ++k) {
+            dsl_[k] = dx_[lowerIndices_[k]] + rl_[k];
+            dzl_[k] = -(rcl_[k] + zl_[k] * dsl_[k]) / sl_[k];
+        }
+        for (size_t k = 0; k < upperIndices_.size(); ++k) {
+            dsu_[k] = ru_[k] - dx_[upperIndices_[k]];
+            dzu_[k] = -(rcu_[k] + zu_[k] * dsu_[k]) / su_[k];
+        }
+    }
+
+    SizeVector stageVariableDims_;
+    size_t numVariables_ = 0;
+    size_t numEqualities_ = 0;
+    size_t numInequalities_ = 0;
+    size_t maxIterations_ = 250;
+    size_t iterations_ = 0;
+    scalar_t epsAbs_ = 1e-8;
+    scalar_t epsRel_ = 1e-9;
+    bool hasWarmStart_ = false;
+    bool elastic_ = false;
+    // QP data, the patterns are fixed by the setup
+    sparse_matrix_t H_;
+    sparse_matrix_t Aeq_;
+    sparse_matrix_t G_;
+    vector_t g_, beq_, h_, lb_, ub_, eqPenalty_, ineqPenalty_;
+    SizeVector lowerIndices_; // variables with a finite lower bound
+    SizeVector upperIndices_; // variables with a finite upper bound
+    // ordered KKT system and the slots of its contributions
+    std::vector<int> permutation_;
+    kkt_matrix_t kkt_;
+    std::vector<int> diagonalSlots_;
+    std::vector<int> hessianSlots_;  // -1 for the lower triangle of H
+    std::vector<int> equalitySlots_;
+    std::vector<int> gramSlots_;     // G'WG: slot, row of G and the two entries of the row
+    std::vector<int> gramRows_;
+    std::vector<int> gramFirst_;
+    std::vector<int> gramSecond_;
+    Eigen::SimplicialLDLT<kkt_matrix_t, Eigen::Lower, Eigen::NaturalOrdering<int>> ldlt_;
+    // iterate: primal, multipliers, inequality slacks, the slacks and multipliers of the bounds and of the elastic rows
+    vector_t x_, y_, z_, s_, zl_, sl_, zu_, su_;
+    vector_t v_, zv_, w_, zw_, t_, zt_;
+    // residuals, complementarity targets and the Newton direction
+    vector_t rd_, rp_, ri_, rl_, ru_, rv_, rw_, rt_;
+    vector_t rc_, rcl_, rcu_, rcv_, rcw_, rct_;
+    vector_t dx_, dy_, dz_, ds_, dzl_, dsl_, dzu_, dsu_;
+    vector_t dv_, dzv_, dw_, dzw_, dt_, dzt_;
+    vector_t weights_, inequalityTerm_, kktRhs_, kktSolution_, work_;
+};
+} // namespace CRISP
+#endif // STAGE_QP_BACKEND_H
@@ -0,0 +1,204 @@
+// NOTE: opt-in per-iteration trace of the solver, see SolverInterface::setTraceFile.
+// The file is a plain NPY (version 1.0) file holding a one dimensional array of structured records, all fields little
+// endian float64: the scalar fields of TraceRecorder::Field (named by fieldName), then x (the iterate after the iteration) and step (the
+// trial step), both of length variableDim. It can be opened without conversion, e.g. np.load(file, mmap_mode="r")["merit"].
+// The header is rewritten with the record count after every flush, so the file is readable while the solver runs.
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include "common/BasicTypes.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace CRISP {
+class TraceRecorder {
+public:
+    // scalar fields of a record, in file order
+    enum Field {
+        SOLVE,                    // index of the solve since the trace was opened
+        ITERATION,
+        ACCEPTED,                 // 1: the trial step was accepted
+        SECOND_ORDER_CORRECTION,  // 1: the step is the one of the correction re-solve
+        OBJECTIVE,
+        MERIT,
+        TRIAL_MERIT,
+        REDUCTION_RATIO,
+        EQ_VIOLATION,             // max |eq|
+        INEQ_VIOLATION,           // max(-ineq, 0)
+        TRUST_REGION_RADIUS,      // after the update of the iteration
+        MU,
+        STEP_NORM,                // infinity norm of the trial step
+        QP_ITERATIONS,
+        SUBPROBLEM_TIME,          // ms, the times are 0 with collectStats = 0
+        QP_TIME,
+        EVALUATION_TIME,
+        MERIT_TIME,
+        DERIVATIVE_TIME,
+        SECOND_ORDER_CORRECTION_TIME,
+        NUM_FIELDS
+    };
+
+    static const char* fieldName(size_t field) {
+        static const char* names[NUM_FIELDS] = {"solve", "iteration", "accepted", "second_order_correction", "objective", "merit", "trial_merit",
+                                                "reduction_ratio", "eq_violation", "ineq_violation", "trust_region_radius", "mu", "step_norm",
+                                                "qp_iterations", "subproblem_time", "qp_time", "evaluation_time", "merit_time", "derivative_time",
+                                                "second_order_correction_time"};
+        return names[field];
+    }
+
+    // capacity: records of the ring buffer, the solver only waits for the writer when all of them are pending
+    TraceRecorder(const std::string& fileName, size_t variableDim, size_t capacity = 1024)
+        : variableDim_(variableDim), recordSize_(NUM_FIELDS + 2 * variableDim), capacity_(std::max<size_t>(capacity, 2)),
+          ring_(capacity_ * recordSize_), file_(fileName, std::ios::binary | std::ios::trunc) {
+        if (!file_) {
+            throw std::runtime_error("Failed to open trace file " + fileName + ".");
+        }
+        // room for the digits of any record count, the header keeps its length when it is rewritten
+        headerLength_ = describe(0).size() + 24;
+        headerLength_ += (64 - (kPreambleSize + headerLength_) % 64) % 64;
+        writeHeader(0);
+        writer_ = std::thread([this] { writerLoop(); });
+    }
+
+    // the pending records are written before the file is closed
+    ~TraceRecorder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        pendingCondition_.notify_one();
+        writer_.join();
+    }
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // the record of the next iteration, NUM_FIELDS scalars, then x and step. Published by commitRecord.
+    scalar_t* beginRecord() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= capacity_) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pendingCondition_.notify_one();
+            freeCondition_.wait(lock, [&] { return head - tail_.load(std::memory_order_acquire) < capacity_; });
+        }
+        return ring_.data() + (head % capacity_) * recordSize_;
+    }
+
+    void commitRecord() {
+        const size_t head = head_.load(std::memory_order_relaxed) + 1;
+        head_.store(head, std::memory_order_release);
+        if (head - tail_.load(std::memory_order_acquire) >= capacity_ / 2) {
+            pendingCondition_.notify_one();
+        }
+    }
+
+    size_t getVariableDim() const {
+        return variableDim_;
+    }
+
+    // records written to the file so far
+    size_t getNumWritten() const {
+        return tail_.load(std::memory_order_acquire);
+    }
+
+    // false after a failed write, the remaining records are dropped
+    bool good() const {
+        return !failed_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t kPreambleSize = 10; // magic string, version and header length
+
+    // the NPY header dictionary of numRecords records
+    std::string describe(size_t numRecords) const {
+        std::string descr = "[";
+        for (size_t field = 0; field < NUM_FIELDS; ++field) {
+            descr += std::string("('") + fieldName(field) + "', '<f8'), ";
+        }
+        descr += "('x', '<f8', (" + std::to_string(variableDim_) + ",)), ('step', '<f8', (" + std::to_string(variableDim_) + ",))]";
+        return "{'descr': " + descr + ", 'fortran_order': False, 'shape': (" + std::to_string(numRecords) + ",), }";
+    }
+
+    void writeHeader(size_t numRecords) {
+        std::string header = describe(numRecords);
+        header.resize(headerLength_ - 1, ' ');
+        header += '\n';
+        const char preamble[8] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+        const unsigned char length[2] = {static_cast<unsigned char>(headerLength_ & 0xff), static_cast<unsigned char>(headerLength_ >> 8)};
+        file_.seekp(0);
+        file_.write(preamble, sizeof(preamble));
+        file_.write(reinterpret_cast<const char*>(length), sizeof(length));
+        file_.write(header.data(), header.size());
+    }
+
+    // writes in batches of at least half the ring, or whatever is pending every 100 ms and at the end
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            pendingCondition_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+                return stop_ || head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed) >= capacity_ / 2;
+            });
+            const bool stop = stop_;
+            const size_t head = head_.load(std::memory_order_acquire);
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (head != tail) {
+                lock.unlock();
+                writeRecords(tail, head);
+                lock.lock();
+                tail_.store(head, std::memory_order_release);
+                freeCondition_.notify_one();
+            }
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    // records [begin, end) of the ring, in at most two contiguous pieces
+    void writeRecords(size_t begin, size_t end) {
+        if (failed_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        while (begin != end) {
+            const size_t slot = begin % capacity_;
+            const size_t count = std::min(end - begin, capacity_ - slot);
+            file_.seekp(0, std::ios::end);
+            file_.write(reinterpret_cast<const char*>(ring_.data() + slot * recordSize_), count * recordSize_ * sizeof(scalar_t));
+            begin += count;
+        }
+        numRecords_ = end;
+        writeHeader(numRecords_);
+        file_.flush();
+        if (!file_) {
+            failed_.store(true, std::memory_order_release);
+        }
+    }
+
+    size_t variableDim_;
+    size_t recordSize_; // scalars per record
+    size_t capacity_;
+    std::vector<scalar_t> ring_;
+    std::ofstream file_;
+    size_t headerLength_ = 0;
+    size_t numRecords_ = 0;
+    std::atomic<size_t> head_{0}; // records committed by the solver
+    std::atomic<size_t> tail_{0}; // records written by the writer thread
+    std::atomic<bool> failed_{false};
+    std::mutex mutex_;
+    std::condition_variable pendingCondition_;
+    std::condition_variable freeCondition_;
+    bool stop_ = false;
+    std::thread writer_;
+};
+} // namespace CRISP
+
+#endif // TRACE_RECORDER_H
@@ -3,6 +3,8 @@
 #include <pybind11/stl.h>
 #include <pybind11/functional.h>
 #include "solver_core/SolverInterface.h"
+#include "solver_core/SolverPool.h"
+#include "solver_core/SolveHandle.h"
 #include "common/BasicTypes.h"
 // #include "common/MatlabHelper.h"
 
@@ -26,30 +28,142 @@ PYBIND11_MODULE(pyCRISP, m) {
     py::enum_<ConstraintFunction::SpecifiedFunctionLevel>(m, "ConstraintFunction_SpecifiedFunctionLevel")
         .value("NONE", ConstraintFunction::SpecifiedFunctionLevel::NONE)
         .export_values();
+    py::enum_<SolverStatus>(m, "SolverStatus")
+        .value("NOT_SOLVED", SolverStatus::NOT_SOLVED)
+        .value("CONVERGED", SolverStatus::CONVERGED)
+        .value("PENALTY_MAXED", SolverStatus::PENALTY_MAXED)
+        .value("DEADLINE", SolverStatus::DEADLINE)
+        .value("ITERATION_LIMIT", SolverStatus::ITERATION_LIMIT)
+        .value("CANCELLED", SolverStatus::CANCELLED);
+
     // expose the solver interface
     py::class_<SolverInterface>(m, "SolverInterface")
         .def(py::init<OptimizationProblem&, SolverParameters&>())
-        .def("initialize", &SolverInterface::initialize)
-        .def("reset_problem", &SolverInterface::resetProblem) // reset problem with new initial guess
+        // the compute-heavy calls release the GIL, so other python threads (and solvers) run meanwhile
+        .def("initialize", &SolverInterface::initialize, py::call_guard<py::gil_scoped_release>())
+        .def("reset_problem", &SolverInterface::resetProblem, py::call_guard<py::gil_scoped_release>()) // reset problem with new initial guess
+        .def("shift_warm_start", &SolverInterface::shiftWarmStart, py::call_guard<py::gil_scoped_release>()) // reset with the previous solution shifted by mpcShiftDim
         .def("set_problem_parameters", &SolverInterface::setProblemParameters) // problem related data, related to your obj, constraints, like the tracking reference, terminal states, etc
         .def("set_hyper_parameters", &SolverInterface::setHyperParameters) // hyperparameters for the solver, like max iterations, trust region radius, etc
-        .def("solve", &SolverInterface::solve)
-        .def("get_solution", &SolverInterface::getSolution);
+        .def("solve", &SolverInterface::solve, py::call_guard<py::gil_scoped_release>())
+        // solve on a background thread, the handle keeps the solver alive
+        .def("solve_async", [](SolverInterface& solver) {
+            return std::make_unique<SolveHandle>(solver);
+        }, py::keep_alive<0, 1>())
+        .def("cancel", &SolverInterface::requestCancel) // stop the running solve at the next SQP iteration
+        .def("get_status", &SolverInterface::getStatus)
+        .def("was_cancelled", &SolverInterface::wasCancelled)
+        .def("is_solving", &SolverInterface::isSolving)
+        .def("get_solution", &SolverInterface::getSolution) // copy, prints the summary unless printSolution is 0
+        .def("print_summary", &SolverInterface::printSummary)
+        // read-only numpy views of the solver-owned results, valid while the solver lives and overwritten by the next solve
+        .def("get_iterate", &SolverInterface::getIterate, py::return_value_policy::reference_internal)
+        .def("get_equality_values", &SolverInterface::getEqualityValues, py::return_value_policy::reference_internal)
+        .def("get_inequality_values", &SolverInterface::getInequalityValues, py::return_value_policy::reference_internal)
+        .def("get_equality_multipliers", &SolverInterface::getEqualityMultipliers, py::return_value_policy::reference_internal)
+        .def("get_inequality_multipliers", &SolverInterface::getInequalityMultipliers, py::return_value_policy::reference_internal)
+        // the history grows (and may move) with every iteration, take the view after the solve
+        .def("get_cost_history", [](const SolverInterface& solver) {
+            const auto& history = solver.getCostHistory();
+            return Eigen::Map<const vector_t>(history.data(), history.size());
+        }, py::return_value_policy::reference_internal)
+        .def("get_num_iterations", &SolverInterface::getNumIterations)
+        .def("get_objective_value", &SolverInterface::getObjectiveValue)
+        .def("get_stats", &SolverInterface::getStats, py::return_value_policy::reference_internal)
+        // per-iteration NPY trace of the following solves, read it with np.load(fileName, mmap_mode="r")
+        .def("set_trace_file", &SolverInterface::setTraceFile, py::arg("fileName"), py::arg("capacity") = 1024)
+        .def("close_trace", &SolverInterface::closeTrace);
         // .def("save_results", &SolverInterface::saveResults);
 
+    // expose the solver statistics, all times in ms
+    py::class_<SolverIterationStats>(m, "SolverIterationStats")
+        .def_readonly("evaluation_time", &SolverIterationStats::evaluationTime)
+        .def_readonly("derivative_time", &SolverIterationStats::derivativeTime)
+        .def_readonly("subproblem_time", &SolverIterationStats::subproblemTime)
+        .def_readonly("qp_time", &SolverIterationStats::qpTime)
+        .def_readonly("merit_time", &SolverIterationStats::meritTime)
+        .def_readonly("second_order_correction_time", &SolverIterationStats::secondOrderCorrectionTime)
+        .def_readonly("qp_iterations", &SolverIterationStats::qpIterations)
+        .def_readonly("accepted", &SolverIterationStats::accepted)
+        .def_readonly("second_order_correction", &SolverIterationStats::secondOrderCorrection);
+
+    py::class_<SolverStats>(m, "SolverStats")
+        .def_readonly("evaluation_time", &SolverStats::evaluationTime)
+        .def_readonly("derivative_time", &SolverStats::derivativeTime)
+        .def_readonly("subproblem_time", &SolverStats::subproblemTime)
+        .def_readonly("qp_time", &SolverStats::qpTime)
+        .def_readonly("merit_time", &SolverStats::meritTime)
+        .def_readonly("second_order_correction_time", &SolverStats::secondOrderCorrectionTime)
+        .def_readonly("total_time", &SolverStats::totalTime)
+        .def_readonly("iterations", &SolverStats::iterations)
+        .def_readonly("accepted_steps", &SolverStats::acceptedSteps)
+        .def_readonly("rejected_steps", &SolverStats::rejectedSteps)
+        .def_readonly("second_order_corrections", &SolverStats::secondOrderCorrections)
+        .def_readonly("penalty_increases", &SolverStats::penaltyIncreases)
+        .def_readonly("qp_iterations", &SolverStats::qpIterations)
+        .def_readonly("iteration_history", &SolverStats::iterationHistory);
+
+    py::class_<SolveHandle>(m, "SolveHandle")
+        .def("done", &SolveHandle::done)
+        .def("wait", &SolveHandle::wait, py::arg("timeout") = -1.0, py::call_guard<py::gil_scoped_release>()) // seconds, negative: until finished
+        .def("cancel", &SolveHandle::cancel);
+
+    // expose the batch solver, solves independent jobs (initial guess, problem parameters) concurrently
+    py::class_<SolverJob>(m, "SolverJob")
+        .def(py::init<>())
+        .def(py::init<const vector_t&, const std::unordered_map<std::string, vector_t>&>(),
+            py::arg("initialGuess"),
+            py::arg("problemParameters") = std::unordered_map<std::string, vector_t>())
+        .def_readwrite("initial_guess", &SolverJob::initialGuess)
+        .def_readwrite("problem_parameters", &SolverJob::problemParameters);
+
+    py::class_<SolverJobResult>(m, "SolverJobResult")
+        .def_readonly("solution", &SolverJobResult::solution)
+        .def_readonly("iterations", &SolverJobResult::iterations)
+        .def_readonly("objective", &SolverJobResult::objective)
+        .def_readonly("max_equality_violation", &SolverJobResult::maxEqualityViolation)
+        .def_readonly("max_inequality_violation", &SolverJobResult::maxInequalityViolation)
+        .def_readonly("solve_time", &SolverJobResult::solveTime)
+        .def_readonly("qp_time", &SolverJobResult::qpTime)
+        .def_readonly("stats", &SolverJobResult::stats)
+        .def_readonly("status", &SolverJobResult::status)
+        .def_readonly("worker", &SolverJobResult::worker);
+
+    py::class_<SolverPool>(m, "SolverPool")
+        .def(py::init<OptimizationProblem&, SolverParameters&, size_t>(),
+            py::arg("problem"),
+            py::arg("parameters"),
+            py::arg("numWorkers"))
+        .def("solve", &SolverPool::solve, py::call_guard<py::gil_scoped_release>())
+        .def("set_hyper_parameters", &SolverPool::setHyperParameters)
+        // values (rows: points) and jacobian values of one problem function at the rows of X, split over the workers
+        .def("evaluate_batch", [](SolverPool& pool, const std::string& functionName, const matrix_t& X) {
+            matrix_t Y;
+            pool.evaluateBatch(functionName, X, Y);
+            return Y;
+        }, py::arg("functionName"), py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("evaluate_batch_with_jacobian", [](SolverPool& pool, const std::string& functionName, const matrix_t& X) {
+            std::pair<matrix_t, matrix_t> result;
+            pool.evaluateBatch(functionName, X, result.first, result.second);
+            return result;
+        }, py::arg("functionName"), py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("get_num_workers", &SolverPool::getNumWorkers);
+
     // expose optimization problem
     py::class_<OptimizationProblem>(m, "OptimizationProblem")
         .def(py::init<size_t, const std::string&>())
         .def("add_objective", &OptimizationProblem::addObjective)
         .def("add_equality_constraint", &OptimizationProblem::addEqualityConstraint)
         .def("add_inequality_constraint", &OptimizationProblem::addInequalityConstraint)
-        .def("set_parameters", &OptimizationProblem::setParameters);
+        .def("set_parameters", &OptimizationProblem::setParameters)
+        .def("set_stage_structure", &OptimizationProblem::setStageStructure, py::arg("stageVariableDims"))
+        .def("get_stage_structure", &OptimizationProblem::getStageStructure);
     
     // expose solver parameters
     py::class_<SolverParameters>(m, "SolverParameters")
         .def(py::init<>())
         .def("set_parameters", &SolverParameters::setParameters)
-        .def("get_parameters", &SolverParameters::getParameters);
+        .def("get_parameters", py::overload_cast<const std::string&>(&SolverParameters::getParameters, py::const_));
     
     // expose matlab helper
     // py::class_<MatlabHelper>(m, "MatlabHelper")
@@ -77,7 +191,28 @@ PYBIND11_MODULE(pyCRISP, m) {
             py::arg("regenerateLibrary") = false,
             py::arg("infoLevel") = CppAdInterface::ModelInfoLevel::SECOND_ORDER,
             py::arg("specifiedFunctionLevel") = ObjectiveFunction::SpecifiedFunctionLevel::NONE
-            ); 
+            )
+        // the points are the rows of X (and their parameters the rows of P), the results have one row per point
+        .def("get_value_batch", [](ObjectiveFunction& function, const matrix_t& X) {
+            matrix_t Y;
+            function.getValueBatch(X, Y);
+            return Y;
+        }, py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_batch", [](ObjectiveFunction& function, const matrix_t& X, const matrix_t& P) {
+            matrix_t Y;
+            function.getValueBatch(X, P, Y);
+            return Y;
+        }, py::arg("X"), py::arg("P"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_and_gradient_batch", [](ObjectiveFunction& function, const matrix_t& X) {
+            std::pair<matrix_t, matrix_t> result;
+            function.getValueAndGradientCSRValuesBatch(X, result.first, result.second);
+            return result;
+        }, py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_and_gradient_batch", [](ObjectiveFunction& function, const matrix_t& X, const matrix_t& P) {
+            std::pair<matrix_t, matrix_t> result;
+            function.getValueAndGradientCSRValuesBatch(X, P, result.first, result.second);
+            return result;
+        }, py::arg("X"), py::arg("P"), py::call_guard<py::gil_scoped_release>());
         
 
     // expose ConstraintFunction
@@ -99,6 +234,41 @@ PYBIND11_MODULE(pyCRISP, m) {
             py::arg("functionName"),
             py::arg("regenerateLibrary") = false,
             py::arg("infoLevel") = CppAdInterface::ModelInfoLevel::FIRST_ORDER,
-            py::arg("specifiedFunctionLevel") = ConstraintFunction::SpecifiedFunctionLevel::NONE);
+            py::arg("specifiedFunctionLevel") = ConstraintFunction::SpecifiedFunctionLevel::NONE)
+        // the points are the rows of X (and their parameters the rows of P), the results have one row per point
+        .def("get_value_batch", [](ConstraintFunction& function, const matrix_t& X) {
+            matrix_t Y;
+            function.getValueBatch(X, Y);
+            return Y;
+        }, py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_batch", [](ConstraintFunction& function, const matrix_t& X, const matrix_t& P) {
+            matrix_t Y;
+            function.getValueBatch(X, P, Y);
+            return Y;
+        }, py::arg("X"), py::arg("P"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_and_gradient_batch", [](ConstraintFunction& function, const matrix_t& X) {
+            std::pair<matrix_t, matrix_t> result;
+            function.getValueAndGradientCSRValuesBatch(X, result.first, result.second);
+            return result;
+        }, py::arg("X"), py::call_guard<py::gil_scoped_release>())
+        .def("get_value_and_gradient_batch", [](ConstraintFunction& function, const matrix_t& X, const matrix_t& P) {
+            std::pair<matrix_t, matrix_t> result;
+            function.getValueAndGradientCSRValuesBatch(X, P, result.first, result.second);
+            return result;
+        }, py::arg("X"), py::arg("P"), py::call_guard<py::gil_scoped_release>());
+
+    // expose the stage-template functions, the kernel is a function of layout.stageDim variables loaded like any other
+    py::class_<StageLayout>(m, "StageLayout")
+        .def(py::init<size_t, size_t, size_t, size_t>(), py::arg("numStages"), py::arg("stageDim"), py::arg("stride"), py::arg("offset") = 0)
+        .def_readwrite("numStages", &StageLayout::numStages)
+        .def_readwrite("stageDim", &StageLayout::stageDim)
+        .def_readwrite("stride", &StageLayout::stride)
+        .def_readwrite("offset", &StageLayout::offset);
+
+    py::class_<StageObjectiveFunction, ObjectiveFunction, std::shared_ptr<StageObjectiveFunction>>(m, "StageObjectiveFunction")
+        .def(py::init<size_t, const StageLayout&, const std::shared_ptr<ObjectiveFunction>&>(), py::arg("variableDim"), py::arg("layout"), py::arg("kernel"));
+
+    py::class_<StageConstraintFunction, ConstraintFunction, std::shared_ptr<StageConstraintFunction>>(m, "StageConstraintFunction")
+        .def(py::init<size_t, const StageLayout&, const std::shared_ptr<ConstraintFunction>&>(), py::arg("variableDim"), py::arg("layout"), py::arg("kernel"));
     
 }
\ No newline at end of file
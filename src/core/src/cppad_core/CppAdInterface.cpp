@@ -1,19 +1,259 @@
 #include "cppad_core/CppAdInterface.h"
 #include <boost/filesystem.hpp>
+#include "common/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
 
 namespace CRISP {
+namespace {
+// symbolic phase: build the CSR structure of the generated sparse entries that belong to the variables only,
+// and the gather map from the generated output to the CSR slots, gather[k] is the generated index of slot k.
+void buildCSRStructure(const SizeVector& row, const SizeVector& col, size_t rows, size_t variableDim, CSRSparseMatrix& structure, SizeVector& gather) {
+    structure.outerIndex.assign(rows + 1, 0);
+    for (size_t i = 0; i < row.size(); ++i) {
+        if (row[i] < rows && col[i] < variableDim) {
+            structure.outerIndex[row[i] + 1]++;
+        }
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        structure.outerIndex[i + 1] += structure.outerIndex[i];
+    }
+    size_t numNonZeros = structure.outerIndex[rows];
+    structure.innerIndices.resize(numNonZeros);
+    structure.values.resize(numNonZeros);
+    gather.resize(numNonZeros);
+    SizeVector nextSlot(structure.outerIndex.begin(), structure.outerIndex.end() - 1);
+    for (size_t i = 0; i < row.size(); ++i) {
+        if (row[i] < rows && col[i] < variableDim) {
+            size_t slot = nextSlot[row[i]]++;
+            structure.innerIndices[slot] = col[i];
+            gather[slot] = i;
+        }
+    }
+}
+
+// the generated output can be written straight to the CSR values if the gather map is the identity
+bool isIdentityGather(const SizeVector& gather, size_t numGenerated) {
+    if (gather.size() != numGenerated) {
+        return false;
+    }
+    for (size_t k = 0; k < gather.size(); ++k) {
+        if (gather[k] != k) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// version of the set of generated models and their output layout, part of every library key
+const std::string kGeneratedModelsVersion = "2"; // 2: the fused model holds [y; jacobian] only
+
+// FNV-1a, the library keys only have to detect changes, not resist collisions on purpose
+const uint64_t kHashOffset = 14695981039346656037ULL;
+uint64_t hashString(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    // separator, so that the concatenation of the hashed strings is unambiguous
+    return (hash ^ 0xff) * 1099511628211ULL;
+}
+
+std::string toHex(uint64_t hash) {
+    std::ostringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+}
+
+// The manifest of a model holds one "<function name> <library key>" line per function (and the entries below). Functions of a model may be
+// generated concurrently, the updates are serialized and the file is replaced atomically.
+std::mutex manifestMutex;
+std::unordered_map<std::string, std::string> readManifest(const std::string& manifestFile) {
+    std::unordered_map<std::string, std::string> entries;
+    std::ifstream file(manifestFile);
+    std::string function, key;
+    while (file >> function >> key) {
+        entries[function] = key;
+    }
+    return entries;
+}
+
+std::string readManifestEntry(const std::string& manifestFile, const std::string& functionName) {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    auto entries = readManifest(manifestFile);
+    auto it = entries.find(functionName);
+    return it == entries.end() ? std::string() : it->second;
+}
+
+void writeManifestEntries(const std::string& manifestFile, const std::map<std::string, std::string>& updates) {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    auto entries = readManifest(manifestFile);
+    for (const auto& update : updates) {
+        entries[update.first] = update.second;
+    }
+    std::map<std::string, std::string> sorted(entries.begin(), entries.end());
+    const std::string tmpFile = manifestFile + ".tmp";
+    {
+        std::ofstream file(tmpFile, std::ios::trunc);
+        for (const auto& entry : sorted) {
+            file << entry.first << ' ' << entry.second << '\n';
+        }
+    }
+    boost::filesystem::rename(tmpFile, manifestFile);
+}
+
+// manifest entries of a bundled library: the key of the bundle, and this marker for each function it contains
+const std::string kBundleEntry = "__bundle__";
+const std::string kBundledFunction = "bundle";
+// manifest entry "<function name>@constant" next to the key: the constant derivative classification of the function,
+// one character each ('0' or '1') for the jacobian and the hessian
+const std::string kConstantDerivativesSuffix = "@constant";
+
+// The libraries are opened once per process, functions and copies of the same library share the handle.
+std::mutex libraryMutex;
+std::unordered_map<std::string, std::weak_ptr<CppAD::cg::DynamicLib<scalar_t>>> openLibraries;
+
+std::shared_ptr<CppAD::cg::DynamicLib<scalar_t>> openLibrary(const std::string& file) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    auto library = openLibraries[file].lock();
+    if (!library) {
+        library = std::make_shared<CppAD::cg::LinuxDynamicLib<scalar_t>>(file);
+        openLibraries[file] = library;
+    }
+    return library;
+}
+
+// a freshly compiled library replaces the handle of the file it overwrote
+void registerLibrary(const std::string& file, const std::shared_ptr<CppAD::cg::DynamicLib<scalar_t>>& library) {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    openLibraries[file] = library;
+}
+
+// functions taped while a bundle is built, they are compiled together by buildBundles
+std::mutex bundleMutex;
+std::atomic<bool> bundleGeneration(false);
+std::vector<CppAdInterface*> pendingBundle;
+
+// process-wide code generation settings
+std::mutex codeGenSettingsMutex;
+CppAdInterface::CodeGenSettings& codeGenSettings() {
+    static CppAdInterface::CodeGenSettings settings;
+    return settings;
+}
+
+std::shared_ptr<CppAD::cg::DynamicLib<scalar_t>> compileLibrary(CppAD::cg::ModelLibraryCSourceGen<scalar_t>& libcgen, const std::string& libraryFolder,
+                                                                const std::string& libraryName, const CppAdInterface::CodeGenSettings& settings) {
+    CppAD::cg::DynamicModelLibraryProcessor<scalar_t> proc(libcgen, libraryName);
+
+    // several functions of one model may be built at the same time, an existing folder is not an error
+    boost::system::error_code error;
+    boost::filesystem::create_directories(libraryFolder, error);
+
+    std::unique_ptr<CppAD::cg::AbstractCCompiler<scalar_t>> compiler;
+    if (settings.compiler == "gcc") {
+        compiler = std::make_unique<CppAD::cg::GccCompiler<scalar_t>>(settings.compilerPath.empty() ? "/usr/bin/gcc" : settings.compilerPath);
+    } else if (settings.compiler == "clang") {
+        compiler = std::make_unique<CppAD::cg::ClangCompiler<scalar_t>>(settings.compilerPath.empty() ? "/usr/bin/clang" : settings.compilerPath);
+    } else {
+        throw std::runtime_error("Unknown compiler " + settings.compiler + ", use gcc or clang.");
+    }
+    std::vector<std::string> libraryFlags = settings.compileFlags;
+    libraryFlags.push_back("-shared");
+    libraryFlags.push_back("-rdynamic");
+    compiler->setCompileFlags(settings.compileFlags);
+    compiler->setCompileLibFlags(libraryFlags);
+    // the generated sources are named after the model, keep the object files of each library apart
+    compiler->setTemporaryFolder(libraryName + "_tmp");
+
+    return std::shared_ptr<CppAD::cg::DynamicLib<scalar_t>>(proc.createDynamicLibrary(*compiler));
+}
+
+// thread information handed to CppAD while functions are generated in parallel, the calling thread is thread 0
+std::atomic<bool> parallelGeneration(false);
+std::atomic<size_t> nextGenerationThread(1);
+thread_local size_t generationThreadIndex = std::numeric_limits<size_t>::max();
+
+bool inParallelGeneration() {
+    return parallelGeneration;
+}
+
+size_t generationThreadNum() {
+    if (generationThreadIndex == std::numeric_limits<size_t>::max()) {
+        generationThreadIndex = nextGenerationThread++;
+    }
+    return generationThreadIndex;
+}
+
+// entries of a sparsity pattern inside the variable block (rows too for a hessian), in row major order,
+// optionally only the upper triangle (col >= row) of a hessian
+CppAD::sparse_rc<SizeVector> restrictToVariables(const CppAD::sparse_rc<SizeVector>& pattern, size_t variableDim, bool square, bool upperTriangle = false) {
+    SizeVector order = pattern.row_major();
+    SizeVector kept;
+    for (size_t k : order) {
+        if (pattern.col()[k] < variableDim && (!square || pattern.row()[k] < variableDim) && (!upperTriangle || pattern.col()[k] >= pattern.row()[k])) {
+            kept.push_back(k);
+        }
+    }
+    CppAD::sparse_rc<SizeVector> subset(pattern.nr(), pattern.nc(), kept.size());
+    for (size_t k = 0; k < kept.size(); ++k) {
+        subset.set(k, pattern.row()[kept[k]], pattern.col()[kept[k]]);
+    }
+    return subset;
+}
+
+// gather[slot] = offset + row major rank of the (row, col) entry of the slot, the order of the fused model outputs
+void rowMajorRanks(const CSRSparseMatrix& structure, size_t offset, SizeVector& gather) {
+    const size_t rows = structure.outerIndex.size() - 1;
+    SizeVector slots(structure.innerIndices.size());
+    SizeVector slotRows(structure.innerIndices.size());
+    for (size_t i = 0; i < rows; ++i) {
+        for (size_t k = structure.outerIndex[i]; k < structure.outerIndex[i + 1]; ++k) {
+            slotRows[k] = i;
+        }
+    }
+    for (size_t k = 0; k < slots.size(); ++k) {
+        slots[k] = k;
+    }
+    std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+        return slotRows[a] != slotRows[b] ? slotRows[a] < slotRows[b] : structure.innerIndices[a] < structure.innerIndices[b];
+    });
+    gather.resize(slots.size());
+    for (size_t rank = 0; rank < slots.size(); ++rank) {
+        gather[slots[rank]] = offset + rank;
+    }
+}
+
+void gatherValues(const ValueVector& generated, const SizeVector& gather, scalar_t* values) {
+    for (size_t k = 0; k < gather.size(); ++k) {
+        values[k] = generated[gather[k]];
+    }
+}
+
+// copy the n points of one component into its lanes of a batched input, the unused lanes of a partial batch repeat the last point
+void fillLanes(const scalar_t* points, size_t n, size_t batchSize, scalar_t* lanes) {
+    std::memcpy(lanes, points, n * sizeof(scalar_t));
+    std::fill(lanes + n, lanes + batchSize, points[n - 1]);
+}
+} // namespace
+
 CppAdInterface::CppAdInterface(size_t variableDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
                                const ad_function_t& function, ModelInfoLevel infoLevel, bool regenerateLibrary)
     : variableDim_(variableDim), parameterDim_(0), modelName_(modelName), folderName_(folderName), functionName_(functionName),
       functionNoParam_(function), isParameterized_(false), infoLevel_(infoLevel), regenerateLibrary_(regenerateLibrary) {
     libraryFolder_ = folderName_ + '/' + modelName_ + '/' + "auto_generated";
     libraryName_ = libraryFolder_ + '/' + modelName_ + "_" + functionName_ + "_cppad_cg_model"; 
-    if (isLibraryAvailable() && !regenerateLibrary_) {
-        loadModel();
-    } else {
-        initializeModel();
-    }
+    libraryModelName_ = modelName_;
+    // the function is always taped, generateLibrary only generates the sources and compiles if the cached library does not match
+    initializeModel();
 }
 
 CppAdInterface::CppAdInterface(size_t variableDim, size_t parameterDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
@@ -22,11 +262,9 @@ CppAdInterface::CppAdInterface(size_t variableDim, size_t parameterDim, const st
       functionWithParam_(function), isParameterized_(true), infoLevel_(infoLevel), regenerateLibrary_(regenerateLibrary) {
     libraryFolder_ = folderName_ + '/' + modelName_ + '/' + "auto_generated";
     libraryName_ = libraryFolder_ + '/' + modelName_ + "_" + functionName_ + "_cppad_cg_model"; 
-    if (isLibraryAvailable() && !regenerateLibrary_) {
-        loadModel();
-    } else {
-        initializeModel();
-    }
+    libraryModelName_ = modelName_;
+    // the function is always taped, generateLibrary only generates the sources and compiles if the cached library does not match
+    initializeModel();
 }
 
 CppAdInterface::CppAdInterface(size_t variableDim, size_t parameterDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
@@ -34,11 +272,8 @@ CppAdInterface::CppAdInterface(size_t variableDim, size_t parameterDim, const st
                      isParameterized_(true), infoLevel_(infoLevel), regenerateLibrary_(regenerateLibrary) {
     libraryFolder_ = folderName_ + '/' + modelName_ + '/' + "auto_generated";
     libraryName_ = libraryFolder_ + '/' + modelName_ + "_" + functionName_ + "_cppad_cg_model";
-    if (isLibraryAvailable()) {
-        loadModel();
-    } else {
-        std::cerr << "Model " << modelName_ << '_' << functionName_ << " is not available, " << "check your function name or you should generate the auto differential library with cppad first." << std::endl;
-    }
+    libraryModelName_ = modelName_;
+    loadAvailableModel();
 }
 
 CppAdInterface::CppAdInterface(size_t variableDim, const std::string& modelName, const std::string& folderName, const std::string& functionName,
@@ -46,6 +281,48 @@ CppAdInterface::CppAdInterface(size_t variableDim, const std::string& modelName,
                      isParameterized_(false), infoLevel_(infoLevel), regenerateLibrary_(regenerateLibrary) {
     libraryFolder_ = folderName_ + '/' + modelName_ + '/' + "auto_generated";
     libraryName_ = libraryFolder_ + '/' + modelName_ + "_" + functionName_ + "_cppad_cg_model";
+    libraryModelName_ = modelName_;
+    loadAvailableModel();
+}
+
+CppAdInterface::CppAdInterface(const CppAdInterface& other)
+    : isParameterized_(other.isParameterized_), regenerateLibrary_(false), variableDim_(other.variableDim_), parameterDim_(other.parameterDim_),
+      funDim_(other.funDim_), nnzJacobian_(other.nnzJacobian_), nnzHessian_(other.nnzHessian_), modelName_(other.modelName_),
+      folderName_(other.folderName_), functionName_(other.functionName_), libraryFolder_(other.libraryFolder_), libraryName_(other.libraryName_),
+      libraryModelName_(other.libraryModelName_),
+      functionNoParam_(other.functionNoParam_), functionWithParam_(other.functionWithParam_), dynamicLib_(other.dynamicLib_),
+      infoLevel_(other.infoLevel_), jacobianSparsity_(other.jacobianSparsity_), hessianSparsity_(other.hessianSparsity_),
+      xpBuffer_(other.xpBuffer_), jacobianBuffer_(other.jacobianBuffer_), hessianBuffer_(other.hessianBuffer_), hessianWeights_(other.hessianWeights_),
+      jacobianGather_(other.jacobianGather_), hessianGather_(other.hessianGather_),
+      jacobianGatherIdentity_(other.jacobianGatherIdentity_), hessianGatherIdentity_(other.hessianGatherIdentity_),
+      fusedBuffer_(other.fusedBuffer_), fusedJacobianGather_(other.fusedJacobianGather_), fusedHessianGather_(other.fusedHessianGather_),
+      hasFusedHessian_(other.hasFusedHessian_), batchSize_(other.batchSize_), batchInput_(other.batchInput_), batchOutput_(other.batchOutput_),
+      batchJacobianGather_(other.batchJacobianGather_), hessianUpperTriangular_(other.hessianUpperTriangular_),
+      constantJacobian_(other.constantJacobian_), constantHessian_(other.constantHessian_) {
+    jacobianCSRStructure_ = other.jacobianCSRStructure_;
+    hessianCSRStructure_ = other.hessianCSRStructure_;
+    // the generated model keeps per-call state, every copy gets its own instance of the shared library code
+    if (dynamicLib_) {
+        model_ = dynamicLib_->model(libraryModelName_);
+        if (other.fusedModel_) {
+            fusedModel_ = dynamicLib_->model(libraryModelName_ + "_fused");
+        }
+        if (other.batchValueModel_) {
+            batchValueModel_ = dynamicLib_->model(libraryModelName_ + "_batch");
+        }
+        if (other.batchJacobianModel_) {
+            batchJacobianModel_ = dynamicLib_->model(libraryModelName_ + "_batch_jacobian");
+        }
+    }
+}
+
+// load only: the manifest tells if the function was last built into the bundle of its model or into its own library
+void CppAdInterface::loadAvailableModel() {
+    const std::string manifestFile = folderName_ + '/' + modelName_ + "/manifest.txt";
+    if (readManifestEntry(manifestFile, functionName_) == kBundledFunction) {
+        libraryName_ = bundleLibraryName();
+        libraryModelName_ = modelName_ + "_" + functionName_;
+    }
     if (isLibraryAvailable()) {
         loadModel();
     } else {
@@ -53,6 +330,10 @@ CppAdInterface::CppAdInterface(size_t variableDim, const std::string& modelName,
     }
 }
 
+std::string CppAdInterface::bundleLibraryName() const {
+    return libraryFolder_ + '/' + modelName_ + "_cppad_cg_bundle";
+}
+
 bool CppAdInterface::isLibraryAvailable() const {
     std::string file_name_ext = libraryName_ + CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION;
     return boost::filesystem::exists(file_name_ext);
@@ -61,46 +342,10 @@ bool CppAdInterface::isLibraryAvailable() const {
 void CppAdInterface::loadModel() {
     // Load the dynamic library
     std::string file_name_ext = libraryName_ + CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION;
-    dynamicLib_ = std::make_unique<CppAD::cg::LinuxDynamicLib<scalar_t>>(file_name_ext);
-    model_ = dynamicLib_->model(modelName_);
+    dynamicLib_ = openLibrary(file_name_ext);
+    model_ = dynamicLib_->model(libraryModelName_);
     funDim_ = model_->Range();
-    // get non-zero numbers of the jacobian and hessian
-    if (model_->isJacobianSparsityAvailable()) {
-        auto jacobianSparsityPattern = model_->JacobianSparsitySet();
-        nnzJacobian_ = 0;
-        if (isParameterized_){
-            for (size_t i = 0; i < jacobianSparsityPattern.size(); ++i) {
-                for (const auto& col : jacobianSparsityPattern[i]) {
-                    if (col < variableDim_) {
-                        ++nnzJacobian_;
-                    }
-                }
-            }
-        }
-        else {
-            for (const auto& row : jacobianSparsityPattern) {
-                nnzJacobian_ += row.size();
-            }
-        }
-    }
-    if (model_->isHessianSparsityAvailable()) {
-        auto hessianSparsityPattern = model_->HessianSparsitySet();
-        nnzHessian_ = 0;
-        if (isParameterized_){
-            for (size_t i = 0; i < hessianSparsityPattern.size(); ++i) {
-                for (const auto& col : hessianSparsityPattern[i]) {
-                    if (col < variableDim_ && i < variableDim_) {
-                        ++nnzHessian_;
-                    }
-                }
-            }
-        }
-        else {
-            for (const auto& row : hessianSparsityPattern) {
-                nnzHessian_ += row.size();
-            }
-        }
-    }
+    initializeWorkspace(); // also sets nnzJacobian_ and nnzHessian_ from the CSR structures
 
     // print if the model named modelName_ is loaded
     std::cout<<"Model "<<modelName_<<'_'<< functionName_ <<" is loaded."<<std::endl;
@@ -128,10 +373,11 @@ void CppAdInterface::initializeModel() {
         functionWithParam_(axp.segment(0, variableDim_), axp.segment(variableDim_, parameterDim_), ay);
         funDim_ = ay.size();
 
-        CppAD::ADFun<cg_scalar_t> cg_fun(axp, ay);
-        cg_fun.optimize();
+        cgFun_ = std::make_unique<CppAD::ADFun<cg_scalar_t>>(axp, ay);
+        CppAD::ADFun<cg_scalar_t>& cg_fun = *cgFun_;
+        optimizeTape_ = true; // before the sources are generated, a cached library does not need it
 
-        CppAD::cg::ModelCSourceGen<scalar_t> cgen(cg_fun, modelName_);
+        CppAD::cg::ModelCSourceGen<scalar_t>& cgen = createSourceGenerator();
         
         // Set options based on infoLevel_
         switch (infoLevel_) {
@@ -153,6 +399,9 @@ void CppAdInterface::initializeModel() {
                             ++nnzJacobian_;
                         }
                     }
+                    // the parameters are inputs without derivatives, only the entries of the variable columns are generated
+                    CppAD::sparse_rc<SizeVector> jacobianElements = restrictToVariables(jacobianSparsity_, variableDim_, false);
+                    cgen.setCustomSparseJacobianElements(jacobianElements.row(), jacobianElements.col());
                 }
                 break;
             case ModelInfoLevel::SECOND_ORDER:
@@ -175,6 +424,9 @@ void CppAdInterface::initializeModel() {
                             ++nnzJacobian_;
                         }
                     }
+                    // the parameters are inputs without derivatives, only the entries of the variable columns are generated
+                    CppAD::sparse_rc<SizeVector> jacobianElements = restrictToVariables(jacobianSparsity_, variableDim_, false);
+                    cgen.setCustomSparseJacobianElements(jacobianElements.row(), jacobianElements.col());
                     // Compute the sparsity pattern of the Hessian for the first component
                     std::vector<bool> select_range(ay.size(), false);
                     select_range[0] = true;  // Only the first element for (F_1)
@@ -185,6 +437,12 @@ void CppAdInterface::initializeModel() {
                             ++nnzHessian_;
                         }
                     }
+                    // the generated hessian is the one of the weighted sum of all components, restricted to the variable block
+                    std::vector<bool> all_range(ay.size(), true);
+                    CppAD::sparse_rc<SizeVector> weightedHessianSparsity;
+                    cg_fun.rev_hes_sparsity(all_range, transpose, internal_bool, weightedHessianSparsity);
+                    CppAD::sparse_rc<SizeVector> hessianElements = restrictToVariables(weightedHessianSparsity, variableDim_, true, getCodeGenSettings().upperTriangularHessian);
+                    cgen.setCustomSparseHessianElements(hessianElements.row(), hessianElements.col());
                 }
                 break;
             case ModelInfoLevel::ZERO_ORDER:
@@ -193,16 +451,7 @@ void CppAdInterface::initializeModel() {
                 break;
         }
 
-        CppAD::cg::ModelLibraryCSourceGen<scalar_t> libcgen(cgen);
-        CppAD::cg::GccCompiler<scalar_t> compiler;
-        CppAD::cg::DynamicModelLibraryProcessor<scalar_t> proc(libcgen, libraryName_);
-
-        if (!boost::filesystem::exists(libraryFolder_)) {
-            boost::filesystem::create_directories(libraryFolder_);
-        }
-
-        dynamicLib_ = proc.createDynamicLibrary(compiler);
-        model_ = dynamicLib_->model(modelName_);
+        generateLibrary();
     } else {
         ad_vector_t ax(variableDim_);
         // Initialize these vectors with ones to avoid division by zero in the function
@@ -212,9 +461,10 @@ void CppAdInterface::initializeModel() {
         ad_vector_t ay;
         functionNoParam_(ax, ay);
         funDim_ = ay.size();
-        CppAD::ADFun<cg_scalar_t> cg_fun(ax, ay);
+        cgFun_ = std::make_unique<CppAD::ADFun<cg_scalar_t>>(ax, ay);
+        CppAD::ADFun<cg_scalar_t>& cg_fun = *cgFun_;
 
-        CppAD::cg::ModelCSourceGen<scalar_t> cgen(cg_fun, modelName_);
+        CppAD::cg::ModelCSourceGen<scalar_t>& cgen = createSourceGenerator();
         
         // Set options based on infoLevel_
         switch (infoLevel_) {
@@ -251,6 +501,14 @@ void CppAdInterface::initializeModel() {
                     select_range[0] = true;  // Only the first element for (F_1)
                     cg_fun.rev_hes_sparsity(select_range, transpose, internal_bool, hessianSparsity_);
                     nnzHessian_ = hessianSparsity_.nnz();
+                    if (getCodeGenSettings().upperTriangularHessian) {
+                        // only the upper triangle of the weighted hessian of all components is generated
+                        std::vector<bool> all_range(ay.size(), true);
+                        CppAD::sparse_rc<SizeVector> weightedHessianSparsity;
+                        cg_fun.rev_hes_sparsity(all_range, transpose, internal_bool, weightedHessianSparsity);
+                        CppAD::sparse_rc<SizeVector> hessianElements = restrictToVariables(weightedHessianSparsity, variableDim_, true, true);
+                        cgen.setCustomSparseHessianElements(hessianElements.row(), hessianElements.col());
+                    }
                 }
                 break;
             case ModelInfoLevel::ZERO_ORDER:
@@ -259,19 +517,580 @@ void CppAdInterface::initializeModel() {
                 break;
         }
 
-        CppAD::cg::ModelLibraryCSourceGen<scalar_t> libcgen(cgen);
-        CppAD::cg::GccCompiler<scalar_t> compiler;
-        CppAD::cg::DynamicModelLibraryProcessor<scalar_t> proc(libcgen, libraryName_);
+        generateLibrary();
+    }
+}
+
+// the functions of a bundle are models of one library, so they need distinct names there
+CppAD::cg::ModelCSourceGen<scalar_t>& CppAdInterface::createSourceGenerator() {
+    if (bundleGeneration) {
+        libraryName_ = bundleLibraryName();
+        libraryModelName_ = modelName_ + "_" + functionName_;
+    }
+    cgen_ = std::make_unique<CppAD::cg::ModelCSourceGen<scalar_t>>(*cgFun_, libraryModelName_);
+    const CodeGenSettings settings = getCodeGenSettings();
+    if (settings.maxAssignmentsPerFunction > 0) {
+        cgen_->setMaxAssignmentsPerFunc(settings.maxAssignmentsPerFunction);
+    }
+    return *cgen_;
+}
+
+void CppAdInterface::generateLibrary() {
+    if (bundleGeneration) {
+        // compiled together with the other functions of the model in buildBundles
+        std::lock_guard<std::mutex> lock(bundleMutex);
+        pendingBundle.push_back(this);
+        return;
+    }
+    const CodeGenSettings settings = getCodeGenSettings();
+    const std::string manifestFile = folderName_ + '/' + modelName_ + "/manifest.txt";
+    const std::string key = libraryKey(settings);
+    if (regenerateLibrary_ || !isLibraryAvailable() || readManifestEntry(manifestFile, functionName_) != key) {
+        createDerivedSourceGenerators(settings);
+        CppAD::cg::ModelLibraryCSourceGen<scalar_t> libcgen(*cgen_);
+        addGeneratedModels(libcgen);
+        registerLibrary(libraryName_ + CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION,
+                        compileLibrary(libcgen, libraryFolder_, libraryName_, settings));
+        writeManifestEntries(manifestFile, {{functionName_, key}, {functionName_ + kConstantDerivativesSuffix, constantDerivativesEntry(manifestFile, true)}});
+    } else {
+        const std::string stored = readManifestEntry(manifestFile, functionName_ + kConstantDerivativesSuffix);
+        const std::string entry = constantDerivativesEntry(manifestFile, false);
+        if (entry != stored) {
+            writeManifestEntries(manifestFile, {{functionName_ + kConstantDerivativesSuffix, entry}});
+        }
+    }
+    loadModel();
+    releaseTape();
+}
+
+void CppAdInterface::buildBundles(const CodeGenSettings& settings) {
+    std::vector<CppAdInterface*> functions;
+    {
+        std::lock_guard<std::mutex> lock(bundleMutex);
+        functions.swap(pendingBundle);
+    }
+    std::map<std::string, std::vector<CppAdInterface*>> bundles;
+    for (CppAdInterface* function : functions) {
+        bundles[function->libraryName_].push_back(function);
+    }
+    for (auto& bundle : bundles) {
+        // in name order, so the key of the bundle does not depend on the order the functions were built
+        std::vector<CppAdInterface*>& members = bundle.second;
+        std::sort(members.begin(), members.end(), [](const CppAdInterface* a, const CppAdInterface* b) { return a->functionName_ < b->functionName_; });
+        const CppAdInterface& head = *members.front();
+        const std::string manifestFile = head.folderName_ + '/' + head.modelName_ + "/manifest.txt";
+        std::map<std::string, std::string> entries;
+        uint64_t hash = kHashOffset;
+        bool regenerate = false;
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (i > 0 && members[i]->functionName_ == members[i - 1]->functionName_) {
+                throw std::runtime_error("Function " + members[i]->functionName_ + " is added twice to the bundle of model " + head.modelName_ + ".");
+            }
+            hash = hashString(hash, members[i]->functionName_);
+            hash = hashString(hash, members[i]->libraryKey(settings));
+            regenerate = regenerate || members[i]->regenerateLibrary_;
+            entries[members[i]->functionName_] = kBundledFunction;
+        }
+        entries[kBundleEntry] = toHex(hash);
+        const bool rebuild = regenerate || !head.isLibraryAvailable() || readManifestEntry(manifestFile, kBundleEntry) != entries[kBundleEntry];
+        for (CppAdInterface* member : members) {
+            entries[member->functionName_ + kConstantDerivativesSuffix] = member->constantDerivativesEntry(manifestFile, rebuild);
+        }
+        if (rebuild) {
+            for (CppAdInterface* member : members) {
+                member->createDerivedSourceGenerators(settings);
+            }
+            CppAD::cg::ModelLibraryCSourceGen<scalar_t> libcgen(*head.cgen_);
+            for (size_t i = 0; i < members.size(); ++i) {
+                if (i > 0) {
+                    libcgen.addModel(*members[i]->cgen_);
+                }
+                members[i]->addGeneratedModels(libcgen);
+            }
+            registerLibrary(bundle.first + CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION,
+                            compileLibrary(libcgen, head.libraryFolder_, bundle.first, settings));
+        }
+        writeManifestEntries(manifestFile, entries);
+        for (CppAdInterface* member : members) {
+            member->loadModel();
+            member->releaseTape();
+        }
+    }
+}
+
+// The constant derivative classification is stored in the manifest next to the library key: a cache hit reads it back,
+// only a rebuilt library (or a manifest written before the classification existed) analyzes the tape. Returns the entry.
+std::string CppAdInterface::constantDerivativesEntry(const std::string& manifestFile, bool rebuilt) {
+    const std::string stored = rebuilt ? std::string() : readManifestEntry(manifestFile, functionName_ + kConstantDerivativesSuffix);
+    if (stored.size() == 2) {
+        constantJacobian_ = stored[0] == '1';
+        constantHessian_ = stored[1] == '1';
+        return stored;
+    }
+    if (infoLevel_ != ModelInfoLevel::ZERO_ORDER) {
+        classifyDerivatives();
+    }
+    return std::string(1, constantJacobian_ ? '1' : '0') + (constantHessian_ ? '1' : '0');
+}
+
+// the tape is only needed until the library is built
+void CppAdInterface::releaseTape() {
+    batchJacobianCgen_.reset();
+    batchJacobianCgFun_.reset();
+    batchValueCgen_.reset();
+    batchValueCgFun_.reset();
+    fusedCgen_.reset();
+    fusedCgFun_.reset();
+    cgen_.reset();
+    cgFun_.reset();
+}
+
+// Whether the tape holds operations the sparsity sweeps below do not see through. CppAD treats abs and sign as linear and
+// ignores the comparison operands of conditional expressions, and a comparison recorded while taping fixes the branch of
+// the tape. The derivatives of such functions are piecewise, whatever their sparsity pattern says.
+bool CppAdInterface::hasPiecewiseOperations() const {
+    // the comparison operators are the only ones dropped by the no_compare_op optimization
+    CppAD::ADFun<cg_scalar_t> withComparisons;
+    CppAD::ADFun<cg_scalar_t> withoutComparisons;
+    withComparisons = *cgFun_;
+    withoutComparisons = *cgFun_;
+    withComparisons.optimize();
+    withoutComparisons.optimize("no_compare_op");
+    if (withComparisons.size_op() != withoutComparisons.size_op()) {
+        return true;
+    }
+
+    // abs, sign and the conditional expressions (CppADCG's comparison nodes) in the operation graph of the outputs
+    CppAD::cg::CodeHandler<scalar_t> handler;
+    std::vector<cg_scalar_t> input(variableDim_ + parameterDim_);
+    handler.makeVariables(input);
+    std::vector<cg_scalar_t> output = cgFun_->Forward(0, input);
+    cgFun_->capacity_order(0);
+    std::vector<CppAD::cg::OperationNode<scalar_t>*> pending;
+    std::set<const CppAD::cg::OperationNode<scalar_t>*> visited;
+    for (const cg_scalar_t& y : output) {
+        if (y.getOperationNode() != nullptr) {
+            pending.push_back(y.getOperationNode());
+        }
+    }
+    while (!pending.empty()) {
+        CppAD::cg::OperationNode<scalar_t>* node = pending.back();
+        pending.pop_back();
+        if (!visited.insert(node).second) {
+            continue;
+        }
+        switch (node->getOperationType()) {
+            case CppAD::cg::CGOpCode::Abs:
+            case CppAD::cg::CGOpCode::Sign:
+            case CppAD::cg::CGOpCode::ComLt:
+            case CppAD::cg::CGOpCode::ComLe:
+            case CppAD::cg::CGOpCode::ComEq:
+            case CppAD::cg::CGOpCode::ComGe:
+            case CppAD::cg::CGOpCode::ComGt:
+            case CppAD::cg::CGOpCode::ComNe:
+                return true;
+            default:
+                break;
+        }
+        for (const CppAD::cg::Argument<scalar_t>& argument : node->getArguments()) {
+            if (argument.getOperation() != nullptr) {
+                pending.push_back(argument.getOperation());
+            }
+        }
+    }
+    return false;
+}
+
+// Constant derivatives from the structural sparsity of the tape. A pattern may hold entries that are always zero and,
+// without the piecewise operations above, never misses one, so a function is only classified constant if it is. The
+// jacobian is constant if no component has a second derivative in the variables. The hessian is constant if the gradient
+// of the sum of the components is affine in the variables, the gradient is recorded from the reverse sweep of the tape
+// (base2ad) like the fused model.
+void CppAdInterface::classifyDerivatives() {
+    constantJacobian_ = false;
+    constantHessian_ = false;
+    if (hasPiecewiseOperations()) {
+        return;
+    }
+    const size_t inputDim = variableDim_ + parameterDim_;
+    CppAD::sparse_rc<SizeVector> eye_sparsity(inputDim, inputDim, inputDim);
+    for (size_t k = 0; k < inputDim; ++k) {
+        eye_sparsity.set(k, k, k);
+    }
+    bool transpose = false;
+    bool dependency = false;
+    bool internal_bool = false;
+    // rev_hes_sparsity continues from the jacobian sparsity of the last for_jac_sparsity sweep
+    CppAD::sparse_rc<SizeVector> jacobianPattern;
+    CppAD::sparse_rc<SizeVector> hessianPattern;
+    cgFun_->for_jac_sparsity(eye_sparsity, transpose, dependency, internal_bool, jacobianPattern);
+    std::vector<bool> all_range(funDim_, true);
+    cgFun_->rev_hes_sparsity(all_range, transpose, internal_bool, hessianPattern);
+    constantJacobian_ = restrictToVariables(hessianPattern, variableDim_, true).nnz() == 0;
+    constantHessian_ = constantJacobian_;
+    if (constantJacobian_ || infoLevel_ != ModelInfoLevel::SECOND_ORDER) {
+        return;
+    }
+
+    CppAD::ADFun<ad_scalar_t, cg_scalar_t> adFun = cgFun_->base2ad();
+    ad_vector_std ax(inputDim, ad_scalar_t(1.0));
+    CppAD::Independent(ax);
+    adFun.Forward(0, ax);
+    ad_vector_std weights(funDim_, ad_scalar_t(1.0));
+    ad_vector_std gradient = adFun.Reverse(1, weights);
+    CppAD::ADFun<cg_scalar_t> gradientFun(ax, gradient);
+    gradientFun.for_jac_sparsity(eye_sparsity, transpose, dependency, internal_bool, jacobianPattern);
+    // only the gradient with respect to the variables, the parameter derivatives are never used
+    std::vector<bool> variable_range(inputDim, false);
+    std::fill(variable_range.begin(), variable_range.begin() + variableDim_, true);
+    gradientFun.rev_hes_sparsity(variable_range, transpose, internal_bool, hessianPattern);
+    constantHessian_ = restrictToVariables(hessianPattern, variableDim_, true).nnz() == 0;
+}
+
+// The fused model returns [y; jacobian values] with respect to the variables from one generated call. It is recorded
+// from the derivative sweep of the tape itself (base2ad), so the generated code shares the zero order part between all
+// outputs. The jacobian entries follow the row major order of the sparsity pattern. Hessians stay separate calls: the
+// solver evaluates the hessian at accepted iterates only, not at every trial point.
+void CppAdInterface::createFusedSourceGenerator() {
+    const size_t inputDim = variableDim_ + parameterDim_;
+    CppAD::ADFun<ad_scalar_t, cg_scalar_t> adFun = cgFun_->base2ad();
+    ad_vector_std ax(inputDim, ad_scalar_t(1.0));
+    CppAD::Independent(ax);
+    ad_vector_std ay = adFun.Forward(0, ax);
+
+    CppAD::sparse_rcv<SizeVector, ad_vector_std> jacobianValues(restrictToVariables(jacobianSparsity_, variableDim_, false));
+    CppAD::sparse_jac_work jacobianWork;
+    adFun.sparse_jac_rev(ax, jacobianValues, jacobianSparsity_, "cppad", jacobianWork);
+    ay.insert(ay.end(), jacobianValues.val().begin(), jacobianValues.val().end());
+    fusedCgFun_ = std::make_unique<CppAD::ADFun<cg_scalar_t>>(ax, ay);
+    fusedCgFun_->optimize();
+    fusedCgen_ = std::make_unique<CppAD::cg::ModelCSourceGen<scalar_t>>(*fusedCgFun_, libraryModelName_ + "_fused");
+    const CodeGenSettings settings = getCodeGenSettings();
+    if (settings.maxAssignmentsPerFunction > 0) {
+        fusedCgen_->setMaxAssignmentsPerFunc(settings.maxAssignmentsPerFunction);
+    }
+}
 
-        if (!boost::filesystem::exists(libraryFolder_)) {
-            boost::filesystem::create_directories(libraryFolder_);
+// The batched models evaluate the tape at batchSize points per call, the value model returns y and the jacobian model
+// [y; jacobian values] in the row major order of the fused model. They are recorded from batchSize copies of the tape
+// on interleaved inputs and outputs, index i * batchSize + k holds component i of point k. The copies of an output are
+// passed to the source generator as related dependents, so CppADCG emits one loop over the points instead of batchSize
+// unrolled copies, the point loop runs over contiguous memory and is vectorized by the C compiler (e.g. -O3 -march=native).
+void CppAdInterface::createBatchedSourceGenerators(size_t batchSize) {
+    const size_t inputDim = variableDim_ + parameterDim_;
+    CppAD::ADFun<ad_scalar_t, cg_scalar_t> adFun = cgFun_->base2ad();
+    const CodeGenSettings settings = getCodeGenSettings();
+    auto record = [&](bool withJacobian, const std::string& name, std::unique_ptr<CppAD::ADFun<cg_scalar_t>>& cgFun,
+                      std::unique_ptr<CppAD::cg::ModelCSourceGen<scalar_t>>& cgen) {
+        CppAD::sparse_rcv<SizeVector, ad_vector_std> jacobianValues;
+        if (withJacobian) {
+            jacobianValues = CppAD::sparse_rcv<SizeVector, ad_vector_std>(restrictToVariables(jacobianSparsity_, variableDim_, false));
+        }
+        CppAD::sparse_jac_work jacobianWork; // the coloring is computed once and reused by the other points
+        const size_t outputDim = funDim_ + jacobianValues.nnz();
+        ad_vector_std ax(inputDim * batchSize, ad_scalar_t(1.0));
+        CppAD::Independent(ax);
+        ad_vector_std ay(outputDim * batchSize);
+        ad_vector_std axPoint(inputDim);
+        for (size_t k = 0; k < batchSize; ++k) {
+            for (size_t i = 0; i < inputDim; ++i) {
+                axPoint[i] = ax[i * batchSize + k];
+            }
+            ad_vector_std ayPoint = adFun.Forward(0, axPoint);
+            if (withJacobian) {
+                adFun.sparse_jac_rev(axPoint, jacobianValues, jacobianSparsity_, "cppad", jacobianWork);
+                ayPoint.insert(ayPoint.end(), jacobianValues.val().begin(), jacobianValues.val().end());
+            }
+            for (size_t o = 0; o < outputDim; ++o) {
+                ay[o * batchSize + k] = ayPoint[o];
+            }
         }
+        cgFun = std::make_unique<CppAD::ADFun<cg_scalar_t>>(ax, ay);
+        cgFun->optimize();
+        cgen = std::make_unique<CppAD::cg::ModelCSourceGen<scalar_t>>(*cgFun, name);
+        std::vector<std::set<size_t>> related(outputDim);
+        for (size_t o = 0; o < outputDim; ++o) {
+            for (size_t k = 0; k < batchSize; ++k) {
+                related[o].insert(o * batchSize + k);
+            }
+        }
+        cgen->setRelatedDependents(related);
+        if (settings.maxAssignmentsPerFunction > 0) {
+            cgen->setMaxAssignmentsPerFunc(settings.maxAssignmentsPerFunction);
+        }
+    };
+    record(false, libraryModelName_ + "_batch", batchValueCgFun_, batchValueCgen_);
+    if (infoLevel_ != ModelInfoLevel::ZERO_ORDER) {
+        record(true, libraryModelName_ + "_batch_jacobian", batchJacobianCgFun_, batchJacobianCgen_);
+    }
+}
 
-        dynamicLib_ = proc.createDynamicLibrary(compiler);
-        model_ = dynamicLib_->model(modelName_);
+// the fused and batched models are recorded from the tape, only needed when the library is (re)built
+void CppAdInterface::createDerivedSourceGenerators(const CodeGenSettings& settings) {
+    if (optimizeTape_) {
+        cgFun_->optimize();
+    }
+    if (settings.fusedEvaluation && infoLevel_ != ModelInfoLevel::ZERO_ORDER) {
+        createFusedSourceGenerator();
+    }
+    if (settings.batchSize > 0) {
+        createBatchedSourceGenerators(settings.batchSize);
     }
 }
 
+void CppAdInterface::addGeneratedModels(CppAD::cg::ModelLibraryCSourceGen<scalar_t>& libcgen) {
+    for (auto* generator : {fusedCgen_.get(), batchValueCgen_.get(), batchJacobianCgen_.get()}) {
+        if (generator) {
+            libcgen.addModel(*generator);
+        }
+    }
+}
+
+// the batch size is read from the domain of the batched models (if the library has them), models that do not match the
+// generated derivatives are ignored and the batches are evaluated point by point
+void CppAdInterface::initializeBatchedModels() {
+    batchValueModel_.reset();
+    batchJacobianModel_.reset();
+    batchSize_ = 0;
+    const std::set<std::string>& names = dynamicLib_->getModelNames();
+    const std::string valueName = libraryModelName_ + "_batch";
+    const std::string jacobianName = libraryModelName_ + "_batch_jacobian";
+    if (names.count(valueName) == 0) {
+        return;
+    }
+    const size_t inputDim = variableDim_ + parameterDim_;
+    std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> valueModel = dynamicLib_->model(valueName);
+    if (valueModel->Domain() == 0 || valueModel->Domain() % inputDim != 0) {
+        return;
+    }
+    const size_t batchSize = valueModel->Domain() / inputDim;
+    if (valueModel->Range() != batchSize * funDim_) {
+        return;
+    }
+    batchValueModel_ = std::move(valueModel);
+    batchSize_ = batchSize;
+    size_t outputDim = funDim_;
+    if (names.count(jacobianName) > 0) {
+        std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> jacobianModel = dynamicLib_->model(jacobianName);
+        const size_t nnzJacobian = jacobianCSRStructure_.innerIndices.size();
+        if (jacobianModel->Domain() == batchSize * inputDim && jacobianModel->Range() == batchSize * (funDim_ + nnzJacobian)) {
+            batchJacobianModel_ = std::move(jacobianModel);
+            rowMajorRanks(jacobianCSRStructure_, funDim_, batchJacobianGather_);
+            outputDim += nnzJacobian;
+        }
+    }
+    batchInput_.resize(batchSize * inputDim);
+    batchOutput_.resize(batchSize * outputDim);
+}
+
+// map the outputs of the fused model (if the library has one) to the CSR slots of the jacobian and the hessian
+void CppAdInterface::initializeFusedModel() {
+    fusedModel_.reset();
+    const std::string fusedName = libraryModelName_ + "_fused";
+    if (dynamicLib_->getModelNames().count(fusedName) == 0) {
+        return;
+    }
+    std::unique_ptr<CppAD::cg::GenericModel<scalar_t>> fusedModel = dynamicLib_->model(fusedName);
+    const size_t nnzJacobian = jacobianCSRStructure_.innerIndices.size();
+    const size_t nnzHessian = hessianCSRStructure_.innerIndices.size();
+    if (fusedModel->Range() == funDim_ + nnzJacobian + nnzHessian && nnzHessian > 0) {
+        hasFusedHessian_ = true;
+    } else if (fusedModel->Range() == funDim_ + nnzJacobian) {
+        hasFusedHessian_ = false;
+    } else {
+        return; // does not match the generated derivatives, use the separate calls
+    }
+    fusedModel_ = std::move(fusedModel);
+    fusedBuffer_.resize(fusedModel_->Range());
+    rowMajorRanks(jacobianCSRStructure_, funDim_, fusedJacobianGather_);
+    if (hasFusedHessian_) {
+        rowMajorRanks(hessianCSRStructure_, funDim_ + nnzJacobian, fusedHessianGather_);
+    }
+}
+
+// The key of a library hashes everything that determines the generated code without generating any source: the
+// dimensions, the info level, the code generation settings, the size of the tape, the derivative sparsity patterns and
+// the operation graph of the outputs. The graph holds every operator with its arguments and the exact bits of every
+// constant (both branches of a conditional expression included), and all sources are generated from it, so two tapes
+// only share a key if they generate the same library. A zero order sweep builds the graph, a cache hit costs the taping,
+// the sparsity patterns and this sweep. It does not depend on paths or time stamps, so a cache folder can be copied to
+// other machines.
+std::string CppAdInterface::libraryKey(const CodeGenSettings& settings) const {
+    const bool derivatives = infoLevel_ != ModelInfoLevel::ZERO_ORDER;
+    uint64_t hash = hashString(kHashOffset, kGeneratedModelsVersion + ' ' + std::to_string(variableDim_) + ' ' + std::to_string(parameterDim_) + ' ' + std::to_string(funDim_) + ' ' +
+                                            std::to_string(static_cast<int>(infoLevel_)) + ' ' + settings.compiler + ' ' + settings.compilerPath + ' ' +
+                                            std::to_string(settings.maxAssignmentsPerFunction) + ' ' +
+                                            std::to_string(settings.fusedEvaluation && derivatives) + ' ' +
+                                            std::to_string(settings.upperTriangularHessian) + ' ' + std::to_string(settings.batchSize));
+    for (const auto& flag : settings.compileFlags) {
+        hash = hashString(hash, flag);
+    }
+    hash = hashString(hash, std::to_string(cgFun_->size_op()) + ' ' + std::to_string(cgFun_->size_var()) + ' ' + std::to_string(cgFun_->size_par()));
+    auto hashPattern = [&hash](const CppAD::sparse_rc<SizeVector>& pattern) {
+        std::ostringstream entries;
+        for (size_t k = 0; k < pattern.nnz(); ++k) {
+            entries << pattern.row()[k] << ',' << pattern.col()[k] << ' ';
+        }
+        hash = hashString(hash, entries.str());
+    };
+    if (derivatives) {
+        hashPattern(jacobianSparsity_);
+    }
+    if (infoLevel_ == ModelInfoLevel::SECOND_ORDER) {
+        hashPattern(hessianSparsity_);
+    }
+    using Node = CppAD::cg::OperationNode<scalar_t>;
+    CppAD::cg::CodeHandler<scalar_t> handler;
+    std::vector<cg_scalar_t> input(variableDim_ + parameterDim_);
+    handler.makeVariables(input);
+    // the inputs are numbered first, then the operators in the order they are completed
+    std::unordered_map<const Node*, size_t> ids;
+    for (size_t i = 0; i < input.size(); ++i) {
+        ids[input[i].getOperationNode()] = i;
+    }
+    std::vector<cg_scalar_t> output = cgFun_->Forward(0, input);
+    cgFun_->capacity_order(0); // the taylor coefficients of the sweep are not needed
+    auto bits = [](scalar_t value) {
+        uint64_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        return word;
+    };
+    std::ostringstream graph;
+    graph << std::hex;
+    // depth first from every output, an operator is written after its arguments: "<opcode> i<info>... n<id>|c<bits>..."
+    std::vector<std::pair<Node*, bool>> pending; // operator, arguments pushed
+    for (const cg_scalar_t& y : output) {
+        if (y.getOperationNode() == nullptr) {
+            graph << "y c" << bits(y.getValue()) << '\n';
+            continue;
+        }
+        pending.emplace_back(y.getOperationNode(), false);
+        while (!pending.empty()) {
+            Node* node = pending.back().first;
+            const bool expanded = pending.back().second;
+            pending.pop_back();
+            if (ids.count(node) > 0) {
+                continue;
+            }
+            const std::vector<CppAD::cg::Argument<scalar_t>>& arguments = node->getArguments();
+            if (!expanded) {
+                pending.emplace_back(node, true);
+                for (auto argument = arguments.rbegin(); argument != arguments.rend(); ++argument) {
+                    if (argument->getOperation() != nullptr && ids.count(argument->getOperation()) == 0) {
+                        pending.emplace_back(argument->getOperation(), false);
+                    }
+                }
+                continue;
+            }
+            const size_t id = ids.size();
+            ids[node] = id;
+            graph << static_cast<int>(node->getOperationType());
+            for (size_t info : node->getInfo()) {
+                graph << " i" << info;
+            }
+            for (const CppAD::cg::Argument<scalar_t>& argument : arguments) {
+                if (argument.getOperation() != nullptr) {
+                    graph << " n" << ids.at(argument.getOperation());
+                } else {
+                    graph << " c" << bits(*argument.getParameter());
+                }
+            }
+            graph << '\n';
+        }
+        graph << "y n" << ids.at(y.getOperationNode()) << '\n';
+    }
+    hash = hashString(hash, graph.str());
+    return toHex(hash);
+}
+
+void CppAdInterface::setCodeGenSettings(const CodeGenSettings& settings) {
+    std::lock_guard<std::mutex> lock(codeGenSettingsMutex);
+    codeGenSettings() = settings;
+}
+
+CppAdInterface::CodeGenSettings CppAdInterface::getCodeGenSettings() {
+    std::lock_guard<std::mutex> lock(codeGenSettingsMutex);
+    return codeGenSettings();
+}
+
+void CppAdInterface::generateInParallel(const std::vector<std::function<void()>>& builders, size_t numThreads) {
+    const CodeGenSettings settings = getCodeGenSettings();
+    numThreads = std::max<size_t>(1, std::min({numThreads, builders.size(), static_cast<size_t>(CPPAD_MAX_NUM_THREADS)}));
+    const bool parallel = numThreads > 1;
+    ThreadPool threadPool(numThreads);
+    if (parallel) {
+        // CppAD records on a per thread tape and allocates per thread memory, see CppAD::thread_alloc::parallel_setup
+        generationThreadIndex = 0;
+        nextGenerationThread = 1;
+        CppAD::thread_alloc::parallel_setup(numThreads, inParallelGeneration, generationThreadNum);
+        CppAD::thread_alloc::hold_memory(true);
+        CppAD::parallel_ad<scalar_t>();
+        CppAD::parallel_ad<cg_scalar_t>();
+    }
+    std::exception_ptr exception;
+    bundleGeneration = settings.bundleLibrary;
+    try {
+        parallelGeneration = parallel;
+        threadPool.parallelFor(builders.size(), [&](size_t i) { builders[i](); });
+        parallelGeneration = false;
+        bundleGeneration = false;
+        // sequential, but CppAD still knows all threads, so the tapes recorded by the workers can be released here
+        buildBundles(settings);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    parallelGeneration = false;
+    bundleGeneration = false;
+    {
+        std::lock_guard<std::mutex> lock(bundleMutex);
+        pendingBundle.clear();
+    }
+    if (parallel) {
+        // back to sequential mode, the memory cached for the other threads is released first
+        for (size_t thread = 0; thread < numThreads; ++thread) {
+            CppAD::thread_alloc::free_available(thread);
+        }
+        CppAD::thread_alloc::hold_memory(false);
+        CppAD::thread_alloc::parallel_setup(1, nullptr, nullptr);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+// one time set up of the CSR structures and the work buffers used by the evaluate-into overloads
+void CppAdInterface::initializeWorkspace() {
+    xpBuffer_.resize(variableDim_ + parameterDim_);
+    hessianWeights_.assign(funDim_, 1.0); // We only need the objective hessian, so range would be 1.
+    SizeVector row, col;
+    nnzJacobian_ = 0;
+    if (model_->isJacobianSparsityAvailable()) {
+        model_->JacobianSparsity(row, col); // same order as the generated sparse jacobian
+        jacobianBuffer_.resize(row.size());
+        buildCSRStructure(row, col, funDim_, variableDim_, jacobianCSRStructure_, jacobianGather_);
+        jacobianGatherIdentity_ = isIdentityGather(jacobianGather_, row.size());
+        // parameter columns are dropped by buildCSRStructure, so this counts the variable block only
+        nnzJacobian_ = jacobianCSRStructure_.innerIndices.size();
+    }
+    nnzHessian_ = 0;
+    if (model_->isHessianSparsityAvailable()) {
+        model_->HessianSparsity(row, col); // same order as the generated sparse hessian
+        hessianBuffer_.resize(row.size());
+        buildCSRStructure(row, col, variableDim_, variableDim_, hessianCSRStructure_, hessianGather_);
+        hessianGatherIdentity_ = isIdentityGather(hessianGather_, row.size());
+        // the generated hessian is the one of the weighted sum of all components, not only of the first one
+        nnzHessian_ = hessianCSRStructure_.innerIndices.size();
+        hessianUpperTriangular_ = true;
+        for (size_t i = 0; i < variableDim_; ++i) {
+            for (size_t k = hessianCSRStructure_.outerIndex[i]; k < hessianCSRStructure_.outerIndex[i + 1]; ++k) {
+                hessianUpperTriangular_ = hessianUpperTriangular_ && hessianCSRStructure_.innerIndices[k] >= i;
+            }
+        }
+    }
+    initializeFusedModel();
+    initializeBatchedModels();
+}
+
 sparse_matrix_t CppAdInterface::computeSparseJacobian(const vector_t& x) {
     if (isParameterized_) {
         throw std::runtime_error("Parameter vector required.");
@@ -316,43 +1135,9 @@ triplet_vector_t CppAdInterface::computeSparseJacobianTriplet(const vector_t& x)
 }
 
 CSRSparseMatrix CppAdInterface::computeSparseJacobianCSR(const vector_t& x) {
-    if (isParameterized_) {
-        throw std::runtime_error("Parameter vector required.");
-    } else {
-        // initialize the eigen vector, but check size first
-        if (x.size() != variableDim_) {
-            throw std::runtime_error("Input vector size does not match the variable dimension.");
-        }
-    }
-    ValueVector x_std(x.data(), x.data() + x.size());
-    ValueVector jac;
-    SizeVector row, col;
-    model_->SparseJacobian(x_std, jac, row, col); // automatically in row major format
-    CSRSparseMatrix jacobianCSR(funDim_, row.size());
-    // copy the data to the eigen csr format for fast processing of sparse matrix
-    size_t numNonZeros = 0;
-    size_t currentRow = 0;
-
-
-    for (size_t i = 0; i < row.size(); ++i) {
-        numNonZeros++;
-        if (row[i] != currentRow) {
-            while (currentRow < row[i]) {
-                jacobianCSR.outerIndex[currentRow + 1] = numNonZeros - 1;
-                currentRow++;
-            }
-        }
-    }
-    while (currentRow < funDim_) {
-        jacobianCSR.outerIndex[currentRow + 1] = numNonZeros;
-        currentRow++;
-    }
-
-    // directly copy the std::vector col to jacobianCSR.innerIndices
-    std::memcpy(jacobianCSR.innerIndices.data(), col.data(), col.size() * sizeof(size_t));
-    // directly copy the std::vector jac to jacobianCSR.values
-    std::memcpy(jacobianCSR.values.data(), jac.data(), jac.size() * sizeof(scalar_t));
-
+    // the structure is computed once in the symbolic phase, only the values are evaluated
+    CSRSparseMatrix jacobianCSR(jacobianCSRStructure_.outerIndex, jacobianCSRStructure_.innerIndices, ValueVector(nnzJacobian_));
+    computeSparseJacobianValues(x, jacobianCSR.values.data());
     return jacobianCSR;
 }
 
@@ -424,51 +1209,8 @@ triplet_vector_t CppAdInterface::computeSparseJacobianTriplet(const vector_t& x,
 }
 
 CSRSparseMatrix CppAdInterface::computeSparseJacobianCSR(const vector_t& x, const vector_t& p) {
-    if (!isParameterized_) {
-        throw std::runtime_error("This model is not parameterized.");
-    }
-
-    if (x.size() != variableDim_) {
-        throw std::runtime_error("Input vector size does not match the variable dimension.");
-    }
-
-    if (p.size() != parameterDim_) {
-        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
-    }
-
-    ValueVector xp_std;
-    xp_std.reserve(variableDim_ + parameterDim_);
-    xp_std.insert(xp_std.end(), x.data(), x.data() + x.size());
-    xp_std.insert(xp_std.end(), p.data(), p.data() + p.size());
-
-    ValueVector jac;
-    SizeVector row, col;
-    model_->SparseJacobian(xp_std, jac, row, col); // automatically in row major format
-    CSRSparseMatrix jacobianCSR(funDim_, nnzJacobian_); // nnzJacobian_ is already computed in the constructor to preclude the parameter part
-    // copy the data to the CSR format
-    size_t numNonZeros = 0;
-    size_t currentRow = 0;
-    for (size_t i = 0; i < row.size(); ++i) {
-        if (col[i] < variableDim_) {  // Only include entries with respect to the variables
-            numNonZeros++;
-            if (row[i] == currentRow) {
-                jacobianCSR.innerIndices[numNonZeros - 1] = col[i];
-                jacobianCSR.values[numNonZeros - 1] = jac[i];
-            } else {
-                while (currentRow < row[i]) {
-                    jacobianCSR.outerIndex[currentRow + 1] = numNonZeros - 1;
-                    currentRow++;
-                }
-                jacobianCSR.innerIndices[numNonZeros - 1] = col[i];
-                jacobianCSR.values[numNonZeros - 1] = jac[i];
-            }
-        }
-    }
-    while (currentRow < funDim_) {
-        jacobianCSR.outerIndex[currentRow + 1] = numNonZeros;
-        currentRow++;
-    }
-
+    CSRSparseMatrix jacobianCSR(jacobianCSRStructure_.outerIndex, jacobianCSRStructure_.innerIndices, ValueVector(nnzJacobian_));
+    computeSparseJacobianValues(x, p, jacobianCSR.values.data());
     return jacobianCSR;
 }
 
@@ -492,6 +1234,9 @@ sparse_matrix_t CppAdInterface::computeSparseHessian(const vector_t& x) {
     for (size_t i = 0; i < row.size(); ++i) {
         tripletList.emplace_back(row[i], col[i], hes[i]);
     }
+    if (hessianUpperTriangular_) {
+        mirrorUpperTriangle(tripletList); // the full hessian, only the CSR paths are triangular
+    }
     sparse_matrix_t sparseHessian(variableDim_, variableDim_);
     sparseHessian.setFromTriplets(tripletList.begin(), tripletList.end());
     return sparseHessian;
@@ -515,46 +1260,15 @@ triplet_vector_t CppAdInterface::computeSparseHessianTriplet(const vector_t& x)
     for (size_t i = 0; i < row.size(); ++i) {
         tripletList.emplace_back(row[i], col[i], hes[i]);
     }
+    if (hessianUpperTriangular_) {
+        mirrorUpperTriangle(tripletList);
+    }
     return tripletList;
 }
 
 CSRSparseMatrix CppAdInterface::computeSparseHessianCSR(const vector_t& x) {
-    if (isParameterized_) {
-        throw std::runtime_error("Parameter vector required.");
-    } else {
-        // initialize the eigen vector, but check size first
-        if (x.size() != variableDim_) {
-            throw std::runtime_error("Input vector size does not match the variable dimension.");
-        }
-    }
-    ValueVector x_std(x.data(), x.data() + x.size());
-    ValueVector w(model_->Range(), 1.0); // We only need the objective hessian, so range would be 1.
-    ValueVector hes;
-    SizeVector row, col;
-    model_->SparseHessian(x_std, w, hes, row, col);
-    CSRSparseMatrix hessianCSR(variableDim_, row.size());
-    // copy the data to the CSR format
-    size_t numNonZeros = 0;
-    size_t currentRow = 0;
-    for (size_t i = 0; i < row.size(); ++i) {
-        numNonZeros++;
-        if (row[i] == currentRow) {
-            // hessianCSR.innerIndices[i] = col[i];
-        } else {
-            while (currentRow < row[i]) {
-                hessianCSR.outerIndex[currentRow + 1] = numNonZeros - 1;
-                currentRow++;
-            }
-            // hessianCSR.innerIndices[i] = col[i];
-        }
-    }
-    while (currentRow < variableDim_) {
-        hessianCSR.outerIndex[currentRow + 1] = numNonZeros;
-        currentRow++;
-    }
-    std::memcpy(hessianCSR.innerIndices.data(), col.data(), col.size() * sizeof(size_t));
-    std::memcpy(hessianCSR.values.data(), hes.data(), hes.size() * sizeof(scalar_t));
-
+    CSRSparseMatrix hessianCSR(hessianCSRStructure_.outerIndex, hessianCSRStructure_.innerIndices, ValueVector(nnzHessian_));
+    computeSparseHessianValues(x, hessianCSR.values.data());
     return hessianCSR;
 }
 
@@ -591,6 +1305,9 @@ sparse_matrix_t CppAdInterface::computeSparseHessian(const vector_t& x, const ve
             tripletList.emplace_back(row[i], col[i], hes[i]);
         }
     }
+    if (hessianUpperTriangular_) {
+        mirrorUpperTriangle(tripletList); // the full hessian, only the CSR paths are triangular
+    }
     sparse_matrix_t sparseHessian(variableDim_, variableDim_);
     sparseHessian.setFromTriplets(tripletList.begin(), tripletList.end());
     return sparseHessian;
@@ -626,56 +1343,15 @@ triplet_vector_t CppAdInterface::computeSparseHessianTriplet(const vector_t& x,
             tripletList.emplace_back(row[i], col[i], hes[i]);
         }
     }
+    if (hessianUpperTriangular_) {
+        mirrorUpperTriangle(tripletList);
+    }
     return tripletList;
 }
 
 CSRSparseMatrix CppAdInterface::computeSparseHessianCSR(const vector_t& x, const vector_t& p) {
-    if (!isParameterized_) {
-        throw std::runtime_error("This model is not parameterized.");
-    }
-
-    if (x.size() != variableDim_) {
-        throw std::runtime_error("Input vector size does not match the variable dimension.");
-    }
-
-    if (p.size() != parameterDim_) {
-        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
-    }
-
-    // Convert Eigen::VectorXd to std::vector
-    ValueVector xp_std;
-    xp_std.reserve(variableDim_ + parameterDim_);
-    ValueVector w(model_->Range(), 1.0); // Assuming w is a vector of ones with size equal to the range of the model
-    xp_std.insert(xp_std.end(), x.data(), x.data() + x.size());
-    xp_std.insert(xp_std.end(), p.data(), p.data() + p.size());
-    ValueVector hes;
-    SizeVector row, col;
-    model_->SparseHessian(xp_std, w, hes, row, col); // automatically in row major format.
-    // convert the data to eigen CSR format for fast sparse matrixprocessing
-    CSRSparseMatrix hessianCSR(variableDim_, nnzHessian_);
-    // copy the data to the CSR format
-    size_t numNonZeros = 0;
-    size_t currentRow = 0;
-    for (size_t i = 0; i < row.size(); ++i) {
-        if (col[i] < variableDim_ && row[i] < variableDim_) {  // Only include entries with respect to the variables
-            numNonZeros++;
-            if (row[i] == currentRow) {
-                hessianCSR.innerIndices[numNonZeros - 1] = col[i];
-                hessianCSR.values[numNonZeros - 1] = hes[i];
-            } else {
-                while (currentRow < row[i]) {
-                    hessianCSR.outerIndex[currentRow + 1] = numNonZeros - 1;
-                    currentRow++;
-                }
-                hessianCSR.innerIndices[numNonZeros - 1] = col[i];
-                hessianCSR.values[numNonZeros - 1] = hes[i];
-            }
-        }
-    }
-    while (currentRow < variableDim_) {
-        hessianCSR.outerIndex[currentRow + 1] = numNonZeros;
-        currentRow++;
-    }
+    CSRSparseMatrix hessianCSR(hessianCSRStructure_.outerIndex, hessianCSRStructure_.innerIndices, ValueVector(nnzHessian_));
+    computeSparseHessianValues(x, p, hessianCSR.values.data());
     return hessianCSR;
 }
 
@@ -731,6 +1407,289 @@ vector_t CppAdInterface::computeFunctionValue(const vector_t& x, const vector_t&
     return y_eigen;
 }
 
+void CppAdInterface::computeFunctionValue(const vector_t& x, scalar_t* y) {
+    if (isParameterized_) {
+        throw std::runtime_error("Parameter vector required.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    model_->ForwardZero(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<scalar_t>(y, funDim_));
+}
+
+void CppAdInterface::computeFunctionValue(const vector_t& x, const vector_t& p, scalar_t* y) {
+    if (!isParameterized_) {
+        throw std::runtime_error("This model is not parameterized.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    if (p.size() != parameterDim_) {
+        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
+    }
+
+    std::memcpy(xpBuffer_.data(), x.data(), variableDim_ * sizeof(scalar_t));
+    std::memcpy(xpBuffer_.data() + variableDim_, p.data(), parameterDim_ * sizeof(scalar_t));
+    model_->ForwardZero(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<scalar_t>(y, funDim_));
+}
+
+void CppAdInterface::computeSparseJacobianValues(const vector_t& x, scalar_t* jacValues) {
+    if (isParameterized_) {
+        throw std::runtime_error("Parameter vector required.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    size_t const* row;
+    size_t const* col;
+    if (jacobianGatherIdentity_) {
+        // the generated jacobian is already in the CSR order, write it directly to the caller's buffer
+        model_->SparseJacobian(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<scalar_t>(jacValues, nnzJacobian_), &row, &col);
+    } else {
+        model_->SparseJacobian(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<scalar_t>(jacobianBuffer_.data(), jacobianBuffer_.size()), &row, &col);
+        gatherValues(jacobianBuffer_, jacobianGather_, jacValues);
+    }
+}
+
+void CppAdInterface::computeSparseJacobianValues(const vector_t& x, const vector_t& p, scalar_t* jacValues) {
+    if (!isParameterized_) {
+        throw std::runtime_error("This model is not parameterized.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    if (p.size() != parameterDim_) {
+        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
+    }
+
+    std::memcpy(xpBuffer_.data(), x.data(), variableDim_ * sizeof(scalar_t));
+    std::memcpy(xpBuffer_.data() + variableDim_, p.data(), parameterDim_ * sizeof(scalar_t));
+    size_t const* row;
+    size_t const* col;
+    if (jacobianGatherIdentity_) {
+        // generated without the parameter columns and in the CSR order
+        model_->SparseJacobian(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<scalar_t>(jacValues, nnzJacobian_), &row, &col);
+    } else {
+        model_->SparseJacobian(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<scalar_t>(jacobianBuffer_.data(), jacobianBuffer_.size()), &row, &col);
+        gatherValues(jacobianBuffer_, jacobianGather_, jacValues); // the gather map skips the parameter columns of older libraries
+    }
+}
+
+void CppAdInterface::computeSparseHessianValues(const vector_t& x, scalar_t* hesValues) {
+    computeSparseHessianValues(x, hessianWeights_.data(), hesValues);
+}
+
+void CppAdInterface::computeSparseHessianValues(const vector_t& x, const vector_t& p, scalar_t* hesValues) {
+    computeSparseHessianValues(x, p, hessianWeights_.data(), hesValues);
+}
+
+void CppAdInterface::computeSparseHessianValues(const vector_t& x, const scalar_t* weights, scalar_t* hesValues) {
+    if (isParameterized_) {
+        throw std::runtime_error("Parameter vector required.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    size_t const* row;
+    size_t const* col;
+    if (hessianGatherIdentity_) {
+        model_->SparseHessian(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<const scalar_t>(weights, funDim_),
+                              CppAD::cg::ArrayView<scalar_t>(hesValues, nnzHessian_), &row, &col);
+    } else {
+        model_->SparseHessian(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<const scalar_t>(weights, funDim_),
+                              CppAD::cg::ArrayView<scalar_t>(hessianBuffer_.data(), hessianBuffer_.size()), &row, &col);
+        gatherValues(hessianBuffer_, hessianGather_, hesValues);
+    }
+}
+
+void CppAdInterface::computeSparseHessianValues(const vector_t& x, const vector_t& p, const scalar_t* weights, scalar_t* hesValues) {
+    if (!isParameterized_) {
+        throw std::runtime_error("This model is not parameterized.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    if (p.size() != parameterDim_) {
+        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
+    }
+
+    std::memcpy(xpBuffer_.data(), x.data(), variableDim_ * sizeof(scalar_t));
+    std::memcpy(xpBuffer_.data() + variableDim_, p.data(), parameterDim_ * sizeof(scalar_t));
+    size_t const* row;
+    size_t const* col;
+    if (hessianGatherIdentity_) {
+        model_->SparseHessian(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<const scalar_t>(weights, funDim_),
+                              CppAD::cg::ArrayView<scalar_t>(hesValues, nnzHessian_), &row, &col);
+    } else {
+        model_->SparseHessian(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<const scalar_t>(weights, funDim_),
+                              CppAD::cg::ArrayView<scalar_t>(hessianBuffer_.data(), hessianBuffer_.size()), &row, &col);
+        gatherValues(hessianBuffer_, hessianGather_, hesValues); // the gather map skips the parameter rows and columns of older libraries
+    }
+}
+
+void CppAdInterface::computeFunctionValueAndDerivatives(const vector_t& x, scalar_t* y, scalar_t* jacValues, scalar_t* hesValues) {
+    if (isParameterized_) {
+        throw std::runtime_error("Parameter vector required.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    if (!fusedModel_) {
+        computeFunctionValue(x, y);
+        computeSparseJacobianValues(x, jacValues);
+    } else {
+        fusedModel_->ForwardZero(CppAD::cg::ArrayView<const scalar_t>(x.data(), variableDim_), CppAD::cg::ArrayView<scalar_t>(fusedBuffer_.data(), fusedBuffer_.size()));
+        scatterFusedValues(y, jacValues, hasFusedHessian_ ? hesValues : nullptr);
+    }
+    if (hesValues != nullptr && !(fusedModel_ && hasFusedHessian_)) {
+        computeSparseHessianValues(x, hesValues);
+    }
+}
+
+void CppAdInterface::computeFunctionValueAndDerivatives(const vector_t& x, const vector_t& p, scalar_t* y, scalar_t* jacValues, scalar_t* hesValues) {
+    if (!isParameterized_) {
+        throw std::runtime_error("This model is not parameterized.");
+    }
+
+    if (x.size() != variableDim_) {
+        throw std::runtime_error("Input vector size does not match the variable dimension.");
+    }
+
+    if (p.size() != parameterDim_) {
+        throw std::runtime_error("Parameter vector size does not match the parameter dimension.");
+    }
+
+    if (!fusedModel_) {
+        computeFunctionValue(x, p, y);
+        computeSparseJacobianValues(x, p, jacValues);
+    } else {
+        std::memcpy(xpBuffer_.data(), x.data(), variableDim_ * sizeof(scalar_t));
+        std::memcpy(xpBuffer_.data() + variableDim_, p.data(), parameterDim_ * sizeof(scalar_t));
+        fusedModel_->ForwardZero(CppAD::cg::ArrayView<const scalar_t>(xpBuffer_.data(), xpBuffer_.size()), CppAD::cg::ArrayView<scalar_t>(fusedBuffer_.data(), fusedBuffer_.size()));
+        scatterFusedValues(y, jacValues, hasFusedHessian_ ? hesValues : nullptr);
+    }
+    if (hesValues != nullptr && !(fusedModel_ && hasFusedHessian_)) {
+        computeSparseHessianValues(x, p, hesValues);
+    }
+}
+
+void CppAdInterface::scatterFusedValues(scalar_t* y, scalar_t* jacValues, scalar_t* hesValues) const {
+    std::memcpy(y, fusedBuffer_.data(), funDim_ * sizeof(scalar_t));
+    gatherValues(fusedBuffer_, fusedJacobianGather_, jacValues);
+    if (hesValues != nullptr) {
+        gatherValues(fusedBuffer_, fusedHessianGather_, hesValues);
+    }
+}
+
+void CppAdInterface::computeFunctionValueBatch(const matrix_t& X, matrix_t& Y) {
+    evaluateBatch(X, nullptr, Y, nullptr);
+}
+
+void CppAdInterface::computeFunctionValueBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y) {
+    evaluateBatch(X, &P, Y, nullptr);
+}
+
+void CppAdInterface::computeFunctionValueAndJacobianBatch(const matrix_t& X, matrix_t& Y, matrix_t& jacValues) {
+    evaluateBatch(X, nullptr, Y, &jacValues);
+}
+
+void CppAdInterface::computeFunctionValueAndJacobianBatch(const matrix_t& X, const matrix_t& P, matrix_t& Y, matrix_t& jacValues) {
+    evaluateBatch(X, &P, Y, &jacValues);
+}
+
+// P and jacValues may be null, Y and jacValues are only resized if their size does not match
+void CppAdInterface::evaluateBatch(const matrix_t& X, const matrix_t* P, matrix_t& Y, matrix_t* jacValues) {
+    if (isParameterized_ && P == nullptr) {
+        throw std::runtime_error("Parameter vector required.");
+    }
+
+    if (!isParameterized_ && P != nullptr) {
+        throw std::runtime_error("This model is not parameterized.");
+    }
+
+    if (X.cols() != variableDim_) {
+        throw std::runtime_error("Input matrix columns do not match the variable dimension.");
+    }
+
+    if (P != nullptr && (P->rows() != X.rows() || P->cols() != parameterDim_)) {
+        throw std::runtime_error("Parameter matrix size does not match the number of points and the parameter dimension.");
+    }
+
+    if (jacValues != nullptr && infoLevel_ == ModelInfoLevel::ZERO_ORDER) {
+        throw std::runtime_error("Jacobian values requested from a zero order model.");
+    }
+
+    const size_t numPoints = X.rows();
+    const size_t nnzJacobian = jacobianCSRStructure_.innerIndices.size();
+    if (Y.rows() != numPoints || Y.cols() != funDim_) {
+        Y.resize(numPoints, funDim_);
+    }
+    if (jacValues != nullptr && (jacValues->rows() != numPoints || jacValues->cols() != nnzJacobian)) {
+        jacValues->resize(numPoints, nnzJacobian);
+    }
+    if (numPoints == 0) {
+        return;
+    }
+
+    CppAD::cg::GenericModel<scalar_t>* model = jacValues != nullptr ? batchJacobianModel_.get() : batchValueModel_.get();
+    if (model == nullptr) {
+        vector_t x(variableDim_), p(parameterDim_), y(funDim_), jac(nnzJacobian);
+        for (size_t point = 0; point < numPoints; ++point) {
+            x = X.row(point).transpose();
+            if (P != nullptr) {
+                p = P->row(point).transpose();
+            }
+            if (jacValues != nullptr) {
+                if (P != nullptr) {
+                    computeFunctionValueAndDerivatives(x, p, y.data(), jac.data(), nullptr);
+                } else {
+                    computeFunctionValueAndDerivatives(x, y.data(), jac.data(), nullptr);
+                }
+                jacValues->row(point) = jac.transpose();
+            } else if (P != nullptr) {
+                computeFunctionValue(x, p, y.data());
+            } else {
+                computeFunctionValue(x, y.data());
+            }
+            Y.row(point) = y.transpose();
+        }
+        return;
+    }
+
+    // the columns of X, P, Y and jacValues hold one component of all points, so every component is one copy per batch
+    for (size_t start = 0; start < numPoints; start += batchSize_) {
+        const size_t n = std::min(batchSize_, numPoints - start);
+        for (size_t i = 0; i < variableDim_; ++i) {
+            fillLanes(X.col(i).data() + start, n, batchSize_, batchInput_.data() + i * batchSize_);
+        }
+        for (size_t j = 0; j < parameterDim_; ++j) {
+            fillLanes(P->col(j).data() + start, n, batchSize_, batchInput_.data() + (variableDim_ + j) * batchSize_);
+        }
+        model->ForwardZero(CppAD::cg::ArrayView<const scalar_t>(batchInput_.data(), batchInput_.size()), CppAD::cg::ArrayView<scalar_t>(batchOutput_.data(), model->Range()));
+        for (size_t o = 0; o < funDim_; ++o) {
+            std::memcpy(Y.col(o).data() + start, batchOutput_.data() + o * batchSize_, n * sizeof(scalar_t));
+        }
+        if (jacValues != nullptr) {
+            for (size_t slot = 0; slot < nnzJacobian; ++slot) {
+                std::memcpy(jacValues->col(slot).data() + start, batchOutput_.data() + batchJacobianGather_[slot] * batchSize_, n * sizeof(scalar_t));
+            }
+        }
+    }
+}
 
 void CppAdInterface::printSparsityPatterns() const {
     if (infoLevel_ == ModelInfoLevel::ZERO_ORDER) {
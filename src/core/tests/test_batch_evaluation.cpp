@@ -0,0 +1,141 @@
+#include "solver_core/SolverPool.h"
+#include "test_utils.h"
+
+// test: the batch evaluation of the problem functions (batched models, point-wise fallback, stage functions), of the
+// problem and of the solver pool gives the values and jacobian values of a loop of single evaluations
+
+using namespace CRISP;
+
+namespace {
+const size_t kVariableDim = 4;
+const size_t kNumPoints = 11; // not a multiple of the batch size, the last call of the batched model is partial
+const scalar_t kTolerance = 1e-12;
+
+ad_function_with_param_t batchConstraint = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(3);
+    y(0) = x(0) * x(1) - p(0);
+    y(1) = sin(x(2)) + p(1) * x(3) * x(3);
+    y(2) = x(0) + x(3);
+};
+
+ad_function_t batchObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(0) * x(0) + x(1) * x(2) + exp(x(3));
+};
+
+// window [x_k, x_{k+1}] of the stages (x0, x1), (x1, x2), (x2, x3)
+ad_function_t stageKernel = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(1) - x(0) * x(0);
+};
+
+matrix_t samplePoints() {
+    matrix_t X(kNumPoints, kVariableDim);
+    for (size_t i = 0; i < kNumPoints; ++i) {
+        for (size_t j = 0; j < kVariableDim; ++j) {
+            X(i, j) = std::sin(1.0 + i + 0.3 * j);
+        }
+    }
+    return X;
+}
+
+// the points of a batch evaluated one by one
+void loopConstraint(ConstraintFunction& function, const matrix_t& X, const matrix_t* P, matrix_t& Y, matrix_t& jacValues) {
+    Y.resize(X.rows(), function.getFunDim());
+    jacValues.resize(X.rows(), function.getNumNonZerosJacobian());
+    vector_t value(function.getFunDim()), jac(function.getNumNonZerosJacobian());
+    for (Eigen::Index i = 0; i < X.rows(); ++i) {
+        const vector_t x = X.row(i).transpose();
+        if (P != nullptr) {
+            const vector_t p = P->row(i).transpose();
+            function.getValue(x, p, value.data());
+            function.getGradientCSRValues(x, p, jac.data());
+        } else {
+            function.getValue(x, value.data());
+            function.getGradientCSRValues(x, jac.data());
+        }
+        Y.row(i) = value.transpose();
+        jacValues.row(i) = jac.transpose();
+    }
+}
+
+void checkConstraintBatch(ConstraintFunction& function, const matrix_t& X, const matrix_t* P) {
+    matrix_t expectedY, expectedJac, Y, jacValues, valuesOnly;
+    loopConstraint(function, X, P, expectedY, expectedJac);
+    if (P != nullptr) {
+        function.getValueBatch(X, *P, valuesOnly);
+        function.getValueAndGradientCSRValuesBatch(X, *P, Y, jacValues);
+    } else {
+        function.getValueBatch(X, valuesOnly);
+        function.getValueAndGradientCSRValuesBatch(X, Y, jacValues);
+    }
+    CRISP_CHECK(test::maxDifference(valuesOnly, expectedY) < kTolerance);
+    CRISP_CHECK(test::maxDifference(Y, expectedY) < kTolerance);
+    CRISP_CHECK(test::maxDifference(jacValues, expectedJac) < kTolerance);
+}
+} // namespace
+
+int main() {
+    const CppAdInterface::CodeGenSettings defaults = CppAdInterface::getCodeGenSettings();
+    CppAdInterface::CodeGenSettings settings = defaults;
+    settings.batchSize = 4;
+    CppAdInterface::setCodeGenSettings(settings);
+    auto constraint = std::make_shared<ConstraintFunction>(kVariableDim, 2, "BatchProblem", "model", "batchConstraint", batchConstraint, true);
+    CppAdInterface::setCodeGenSettings(defaults);
+    // without batched models the points are evaluated one by one inside the interface
+    auto objective = std::make_shared<ObjectiveFunction>(kVariableDim, "BatchProblem", "model", "batchObjective", batchObjective, true);
+    auto stage = std::make_shared<StageConstraintFunction>(kVariableDim, StageLayout(kVariableDim - 1, 2, 1), "BatchProblem", "model", "stageKernel", stageKernel, true);
+
+    const matrix_t X = samplePoints();
+    matrix_t P(kNumPoints, 2);
+    for (size_t i = 0; i < kNumPoints; ++i) {
+        P.row(i) << 0.1 * i, 1.0 - 0.05 * i;
+    }
+    checkConstraintBatch(*constraint, X, &P);
+    checkConstraintBatch(*stage, X, nullptr);
+
+    matrix_t objectiveValues, gradientValues;
+    objective->getValueAndGradientCSRValuesBatch(X, objectiveValues, gradientValues);
+    vector_t gradient(objective->getNumNonZerosJacobian());
+    scalar_t value = 0.0;
+    bool objectiveMatches = objectiveValues.rows() == static_cast<Eigen::Index>(kNumPoints) && objectiveValues.cols() == 1;
+    for (size_t i = 0; i < kNumPoints && objectiveMatches; ++i) {
+        const vector_t x = X.row(i).transpose();
+        objective->getValue(x, &value);
+        objective->getGradientCSRValues(x, gradient.data());
+        objectiveMatches = std::abs(objectiveValues(i, 0) - value) < kTolerance && test::maxDifference(gradientValues.row(i).transpose(), gradient) < kTolerance;
+    }
+    CRISP_CHECK(objectiveMatches);
+
+    // the problem and the pool evaluate a function with its parameters of the problem definition at every point
+    OptimizationProblem problem(kVariableDim, "BatchProblem");
+    problem.addObjective(objective);
+    problem.addEqualityConstraint(constraint);
+    problem.addInequalityConstraint(stage);
+    vector_t parameters(2);
+    parameters << 0.5, -2.0;
+    problem.setParameters("batchConstraint", parameters);
+    const matrix_t sharedP = parameters.transpose().replicate(kNumPoints, 1);
+    matrix_t expectedY, expectedJac, Y, jacValues;
+    loopConstraint(*constraint, X, &sharedP, expectedY, expectedJac);
+    problem.evaluateFunctionBatch("batchConstraint", X, Y, &jacValues);
+    CRISP_CHECK(test::maxDifference(Y, expectedY) < kTolerance);
+    CRISP_CHECK(test::maxDifference(jacValues, expectedJac) < kTolerance);
+
+    SolverParameters params;
+    SolverPool pool(problem, params, 3);
+    pool.evaluateBatch("batchConstraint", X, Y, jacValues);
+    CRISP_CHECK(test::maxDifference(Y, expectedY) < kTolerance);
+    CRISP_CHECK(test::maxDifference(jacValues, expectedJac) < kTolerance);
+    pool.evaluateBatch("batchObjective", X, Y);
+    CRISP_CHECK(test::maxDifference(Y, objectiveValues) < kTolerance);
+
+    bool unknownThrows = false;
+    try {
+        pool.evaluateBatch("noSuchFunction", X, Y);
+    } catch (const std::runtime_error&) {
+        unknownThrows = true;
+    }
+    CRISP_CHECK(unknownThrows);
+    return CRISP_TEST_RESULT();
+}
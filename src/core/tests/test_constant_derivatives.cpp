@@ -0,0 +1,74 @@
+#include "solver_core/SolverInterface.h"
+#include "test_utils.h"
+
+// test: linear constraints and quadratic objectives are classified as constant, functions with abs or conditional
+// expressions are not even though their sparsity patterns look linear, and a solve with reuseConstantDerivatives = 1
+// crosses the kink of a piecewise linear constraint to the right solution
+
+using namespace CRISP;
+
+namespace {
+const std::string kModel = "ConstantDerivativeProblem";
+
+ad_function_t linearConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(0) + 2.0 * x(1) + 5.0;
+};
+
+ad_function_t quadraticObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = (x(0) + 2.0) * (x(0) + 2.0) + (x(1) - 1.0) * (x(1) - 1.0);
+};
+
+ad_function_t absConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = 1.0 - CppAD::abs(x(0));
+};
+
+// 1 - |x0| >= 0 as a conditional expression
+ad_function_t piecewiseLinearConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = CppAD::CondExpLt(x(0), ad_scalar_t(0.0), 1.0 + x(0), 1.0 - x(0));
+};
+
+// the piecewise constant slope of a piecewise quadratic, the hessian sparsity sees a quadratic
+ad_function_t piecewiseQuadraticObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = CppAD::CondExpLt(x(0), ad_scalar_t(0.0), x(0) * x(0), 4.0 * x(0) * x(0)) + x(1) * x(1);
+};
+} // namespace
+
+int main() {
+    const auto second = CppAdInterface::ModelInfoLevel::SECOND_ORDER;
+    ConstraintFunction linear(2, kModel, "model", "linearConstraint", linearConstraint);
+    auto quadratic = std::make_shared<ObjectiveFunction>(2, kModel, "model", "quadraticObjective", quadraticObjective);
+    ConstraintFunction absolute(2, kModel, "model", "absConstraint", absConstraint, false, second);
+    ObjectiveFunction piecewiseQuadratic(2, kModel, "model", "piecewiseQuadraticObjective", piecewiseQuadraticObjective);
+    CRISP_CHECK(linear.hasConstantJacobian());
+    CRISP_CHECK(quadratic->hasConstantHessian());
+    CRISP_CHECK(!absolute.hasConstantJacobian());
+    CRISP_CHECK(!piecewiseQuadratic.hasConstantHessian());
+
+    OptimizationProblem problem(2, kModel);
+    auto piecewiseLinear = std::make_shared<ConstraintFunction>(2, kModel, "model", "piecewiseLinearConstraint", piecewiseLinearConstraint);
+    CRISP_CHECK(!piecewiseLinear->hasConstantJacobian());
+    problem.addObjective(quadratic);
+    problem.addInequalityConstraint(piecewiseLinear);
+    CRISP_CHECK(problem.hasConstantObjectiveHessian());
+    CRISP_CHECK(!problem.hasConstantInequalityJacobian());
+
+    // the start is on the branch of slope -1, the solution x0 = -1 on the branch of slope +1
+    SolverParameters params;
+    params.setParameters("reuseConstantDerivatives", vector_t::Constant(1, 1));
+    params.setParameters("printSolution", vector_t::Constant(1, 0));
+    SolverInterface solver(problem, params);
+    vector_t start(2);
+    start << 0.5, 0.0;
+    solver.initialize(start);
+    solver.solve();
+    CRISP_CHECK(solver.getStatus() == SolverStatus::CONVERGED);
+    vector_t expected(2);
+    expected << -1.0, 1.0;
+    CRISP_CHECK(test::maxDifference(solver.getSolution(), expected) < 1e-3);
+    return CRISP_TEST_RESULT();
+}
@@ -1,4 +1,5 @@
 #include "cppad_core/CppAdInterface.h"
+#include "test_utils.h"
 #include <iostream>
 
 using namespace CRISP;
@@ -40,6 +41,10 @@ void testCppAdInterface() {
     vector_t y = interface.computeFunctionValue(x, p);
     std::cout << "Function value: " << y[0] << std::endl;
     std::cout << "Function value: " << y[1] << std::endl;
+    CRISP_CHECK_NEAR(y[0], 6.0 + 4.0 + 10.0, 1e-12);
+    CRISP_CHECK_NEAR(y[1], 6.0, 1e-12);
+    CRISP_CHECK_NEAR(jacobian.coeff(0, 0), 6.0 + 4.0, 1e-12);
+    CRISP_CHECK_NEAR(jacobian.coeff(1, 2), 1.0, 1e-12);
 
 
     // Print sparsity patterns
@@ -48,5 +53,5 @@ void testCppAdInterface() {
 
 int main() {
     testCppAdInterface();
-    return 0;
+    return CRISP_TEST_RESULT();
 }
\ No newline at end of file
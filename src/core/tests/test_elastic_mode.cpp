@@ -0,0 +1,127 @@
+#include "solver_core/SolverInterface.h"
+#include "test_utils.h"
+#include <limits>
+
+// test: the elastic QP of StageQPBackend has the solution of the hard QP with explicit l1 slack columns, also when its
+// rows are inconsistent, and a solve with elasticMode = 1 converges to the solution of the slack-augmented subproblem
+
+using namespace CRISP;
+
+namespace {
+const scalar_t kInf = std::numeric_limits<scalar_t>::infinity();
+
+// the two equality rows contradict each other and the inequality row contradicts the upper bound of x2. The penalties
+// are small enough for all three rows to stay violated, so the multipliers are unique (equal to the penalties)
+SubproblemData elasticQP() {
+    SubproblemData qp(3, 2, 1, 3);
+    qp.H = test::fromTriplets(3, 3, {{0, 0, 1.0}, {0, 1, 0.5}, {1, 1, 2.0}, {2, 2, 1.0}});
+    qp.g << -3.0, -3.0, 1.0;
+    qp.Aeq = test::fromTriplets(2, 3, {{0, 0, 1.0}, {0, 1, 1.0}, {1, 0, 1.0}, {1, 1, 1.0}});
+    qp.beq << 1.0, 2.0;
+    qp.G = test::fromTriplets(1, 3, {{0, 2, -1.0}});
+    qp.h << -3.0;
+    qp.lb.setConstant(-kInf);
+    qp.ub.setConstant(kInf);
+    qp.ub[2] = 1.0;
+    qp.eqPenalty.resize(2);
+    qp.eqPenalty << 0.5, 0.25;
+    qp.ineqPenalty = vector_t::Constant(1, 4.0);
+    return qp;
+}
+
+// the same QP with the slacks as variables [x, u, v, t]: Aeq x - u + v = beq, G x - t <= h, u, v, t >= 0
+SubproblemData slackQP(const SubproblemData& elastic) {
+    SubproblemData qp(8, 2, 1, 3);
+    triplet_vector_t hessian, equalities, inequalities;
+    for (int i = 0; i < elastic.H.outerSize(); ++i) {
+        for (sparse_matrix_t::InnerIterator it(elastic.H, i); it; ++it) {
+            hessian.emplace_back(it.row(), it.col(), it.value());
+        }
+    }
+    for (int i = 0; i < elastic.Aeq.outerSize(); ++i) {
+        for (sparse_matrix_t::InnerIterator it(elastic.Aeq, i); it; ++it) {
+            equalities.emplace_back(it.row(), it.col(), it.value());
+        }
+        equalities.emplace_back(i, 3 + i, -1.0);
+        equalities.emplace_back(i, 5 + i, 1.0);
+    }
+    inequalities.emplace_back(0, 2, -1.0);
+    inequalities.emplace_back(0, 7, -1.0);
+    qp.H = test::fromTriplets(8, 8, hessian);
+    qp.Aeq = test::fromTriplets(2, 8, equalities);
+    qp.G = test::fromTriplets(1, 8, inequalities);
+    qp.g << elastic.g, elastic.eqPenalty, elastic.eqPenalty, elastic.ineqPenalty;
+    qp.beq = elastic.beq;
+    qp.h = elastic.h;
+    qp.lb << elastic.lb, vector_t::Zero(5);
+    qp.ub << elastic.ub, vector_t::Constant(5, kInf);
+    return qp;
+}
+
+void testElasticQP() {
+    SubproblemData elastic = elasticQP();
+    StageQPBackend elasticBackend;
+    CRISP_CHECK(elasticBackend.supportsElastic());
+    elasticBackend.setup(elastic);
+    CRISP_CHECK(elasticBackend.solve());
+
+    StageQPBackend slackBackend;
+    slackBackend.setup(slackQP(elastic));
+    CRISP_CHECK(slackBackend.solve());
+
+    CRISP_CHECK(test::maxDifference(elasticBackend.primal(), slackBackend.primal().head(3)) < 1e-5);
+    CRISP_CHECK(test::maxDifference(elasticBackend.equalityDuals(), slackBackend.equalityDuals()) < 1e-5);
+    CRISP_CHECK(test::maxDifference(elasticBackend.inequalityDuals(), slackBackend.inequalityDuals()) < 1e-5);
+    // both equality residuals are positive, the inequality row is violated and x2 sits at its bound
+    CRISP_CHECK(test::maxDifference(elasticBackend.equalityDuals(), elastic.eqPenalty) < 1e-5);
+    CRISP_CHECK_NEAR(elasticBackend.inequalityDuals()[0], elastic.ineqPenalty[0], 1e-5);
+    CRISP_CHECK_NEAR(elasticBackend.primal()[0], 27.0 / 14.0, 1e-5);
+    CRISP_CHECK_NEAR(elasticBackend.primal()[2], 1.0, 1e-5);
+}
+
+ad_function_t elasticObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = (x(0) - 2.0) * (x(0) - 2.0) + (x(1) - 2.0) * (x(1) - 2.0) + x(2) * x(2) + x(0) * x(2);
+};
+
+ad_function_t elasticEqualityConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(0) * x(0) + x(1) - 1.0;
+};
+
+ad_function_t elasticInequalityConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(2) - 0.5;
+};
+
+vector_t solve(OptimizationProblem& problem, scalar_t elasticMode) {
+    SolverParameters params;
+    params.setParameters("qpBackend", vector_t::Constant(1, 1));
+    params.setParameters("elasticMode", vector_t::Constant(1, elasticMode));
+    SolverInterface solver(problem, params);
+    solver.initialize(vector_t::Constant(3, 3.0));
+    solver.solve();
+    CRISP_CHECK(solver.getStatus() == SolverStatus::CONVERGED);
+    return solver.getSolution();
+}
+
+void testElasticSolve() {
+    OptimizationProblem problem(3, "ElasticProblem");
+    problem.addObjective(std::make_shared<ObjectiveFunction>(3, "ElasticProblem", "model", "elasticObjective", elasticObjective));
+    problem.addEqualityConstraint(std::make_shared<ConstraintFunction>(3, "ElasticProblem", "model", "elasticEqualityConstraint", elasticEqualityConstraint));
+    problem.addInequalityConstraint(std::make_shared<ConstraintFunction>(3, "ElasticProblem", "model", "elasticInequalityConstraint", elasticInequalityConstraint));
+
+    const vector_t slackSolution = solve(problem, 0);
+    const vector_t elasticSolution = solve(problem, 1);
+    vector_t expected(3);
+    expected << 0.5, 0.75, 0.5;
+    CRISP_CHECK(test::maxDifference(slackSolution, expected) < 1e-3);
+    CRISP_CHECK(test::maxDifference(elasticSolution, expected) < 1e-3);
+}
+} // namespace
+
+int main() {
+    testElasticQP();
+    testElasticSolve();
+    return CRISP_TEST_RESULT();
+}
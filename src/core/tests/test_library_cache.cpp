@@ -0,0 +1,86 @@
+#include "cppad_core/CppAdInterface.h"
+#include "test_utils.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+
+// test: a second construction with an unchanged function and settings loads the cached library instead of generating
+// and compiling it again, while a change of the function, the info level or the compile flags rebuilds it. The constant
+// derivative classification is stored in the manifest and read back by a cached construction.
+
+using namespace CRISP;
+
+namespace {
+const std::string kFolder = "test_library_cache_model";
+const std::string kModel = "cacheModel";
+const std::string kFunction = "cacheFunction";
+const std::string kLibrary = kFolder + "/" + kModel + "/auto_generated/" + kModel + "_" + kFunction + "_cppad_cg_model" +
+                             CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION;
+const std::time_t kStamp = 1000000000; // any time in the past, a rebuild overwrites it
+
+// the threshold of the conditional expression is never reached near the recording point
+ad_function_with_param_t makeFunction(scalar_t coefficient, scalar_t threshold) {
+    return [coefficient, threshold](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+        y.resize(2);
+        y(0) = coefficient * x(0) * x(1) + p(0) * x(2);
+        y(1) = CppAD::CondExpLt(x(0), ad_scalar_t(threshold), x(0) + x(1) * x(2), x(1));
+    };
+}
+
+// construct, then stamp the library so that the next construction shows whether it was rebuilt
+bool constructRebuilds(scalar_t coefficient, CppAdInterface::ModelInfoLevel infoLevel = CppAdInterface::ModelInfoLevel::SECOND_ORDER,
+                       scalar_t threshold = 5.0) {
+    CppAdInterface function(3, 1, kModel, kFolder, kFunction, makeFunction(coefficient, threshold), infoLevel, false);
+    const bool rebuilt = boost::filesystem::last_write_time(kLibrary) != kStamp;
+    boost::filesystem::last_write_time(kLibrary, kStamp);
+    // the loaded library evaluates the function it was constructed with
+    vector_t x(3), p(1);
+    x << 1.0, 2.0, 3.0;
+    p << 4.0;
+    CRISP_CHECK_NEAR(function.computeFunctionValue(x, p)(0), coefficient * 2.0 + 12.0, 1e-12);
+    x(0) = 4.0; // between the thresholds of the tests
+    CRISP_CHECK_NEAR(function.computeFunctionValue(x, p)(1), threshold > 4.0 ? 10.0 : 2.0, 1e-12);
+    return rebuilt;
+}
+} // namespace
+
+int main() {
+    boost::filesystem::remove_all(kFolder);
+    const CppAdInterface::CodeGenSettings defaults = CppAdInterface::getCodeGenSettings();
+
+    CRISP_CHECK(constructRebuilds(2.0));  // first construction, nothing cached
+    CRISP_CHECK(!constructRebuilds(2.0)); // same function and settings
+    CRISP_CHECK(!constructRebuilds(2.0));
+    CRISP_CHECK(constructRebuilds(3.0));  // a changed constant changes the tape values
+    CRISP_CHECK(!constructRebuilds(3.0));
+    CRISP_CHECK(constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER));
+    // a moved threshold does not change the values near the recording point, only the operation graph
+    CRISP_CHECK(constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER, 3.0));
+    CRISP_CHECK(!constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER, 3.0));
+
+    CppAdInterface::CodeGenSettings settings = defaults;
+    settings.compileFlags = {"-O1"};
+    CppAdInterface::setCodeGenSettings(settings);
+    CRISP_CHECK(constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER));
+    CRISP_CHECK(!constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER));
+    settings.compilerPath = "/usr/bin/gcc"; // the default binary, but the key follows the setting
+    CppAdInterface::setCodeGenSettings(settings);
+    CRISP_CHECK(constructRebuilds(3.0, CppAdInterface::ModelInfoLevel::FIRST_ORDER));
+    CppAdInterface::setCodeGenSettings(defaults);
+
+    ad_function_t linear = [](const ad_vector_t& x, ad_vector_t& y) {
+        y.resize(1);
+        y(0) = 2.0 * x(0) - x(1);
+    };
+    for (int construction = 0; construction < 2; ++construction) {
+        CppAdInterface function(2, kModel, kFolder, "linearFunction", linear, CppAdInterface::ModelInfoLevel::FIRST_ORDER, false);
+        CRISP_CHECK(function.hasConstantJacobian());
+    }
+    std::ifstream manifest(kFolder + "/" + kModel + "/manifest.txt");
+    std::stringstream manifestContent;
+    manifestContent << manifest.rdbuf();
+    CRISP_CHECK(manifestContent.str().find("linearFunction@constant 10\n") != std::string::npos);
+
+    boost::filesystem::remove_all(kFolder);
+    return CRISP_TEST_RESULT();
+}
@@ -1,4 +1,5 @@
 #include "problem_core/OptimizationProblem.h"
+#include "test_utils.h"
 
 // test: the construction of a simple tracking problem.
 // This also serves as a template example for user to create their own optimization problem.
@@ -93,6 +94,7 @@ int main() {
     x << 10.0, 20.0, 1.5;
     scalar_t objValue = trackingProblem.evaluateObjective(x);
     std::cout << "Objective value: " << objValue << std::endl;
+    CRISP_CHECK_NEAR(objValue, 81.0 + 324.0 + 2.25, 1e-12);
     sparse_matrix_t objGradient = trackingProblem.evaluateObjectiveGradient(x);
     triplet_vector_t objGradientTriplet = trackingProblem.evaluateObjectiveGradientTriplet(x);
     std::cout << "Objective gradient: " << objGradient.toDense().row(0) << std::endl;
@@ -105,6 +107,9 @@ int main() {
     // evaluate the constraints
     vector_t equalityConstraints = trackingProblem.evaluateEqualityConstraints(x);
     std::cout << "Equality constraints: " << equalityConstraints.transpose() << std::endl;
+    vector_t expectedEquality(3);
+    expectedEquality << 8.5, 9.5, 18.5;
+    CRISP_CHECK(test::maxDifference(equalityConstraints, expectedEquality) < 1e-12);
     sparse_matrix_t equalityJacobian = trackingProblem.evaluateEqualityConstraintsJacobian(x);
     printSparseMatrix(equalityJacobian);
     triplet_vector_t equalityJacobianTriplet = trackingProblem.evaluateEqualityConstraintsJacobianTriplet(x);
@@ -112,10 +117,31 @@ int main() {
 
     vector_t inequalityConstraints = trackingProblem.evaluateInequalityConstraints(x);
     std::cout << "Inequality constraints: " << inequalityConstraints.transpose() << std::endl;
+    vector_t expectedInequality(2);
+    expectedInequality << -0.5, 2.5;
+    CRISP_CHECK(test::maxDifference(inequalityConstraints, expectedInequality) < 1e-12);
     sparse_matrix_t inequalityJacobian = trackingProblem.evaluateInequalityConstraintsJacobian(x);
     printSparseMatrix(inequalityJacobian);
     triplet_vector_t inequalityJacobianTriplet = trackingProblem.evaluateInequalityConstraintsJacobianTriplet(x);
     printTripletVector(inequalityJacobianTriplet);
+    // the evaluate-into API must agree with the allocating one
+    scalar_t objectiveInto;
+    vector_t equalityInto, inequalityInto, gradientInto;
+    CSRSparseMatrix equalityJacobianCSR, hessianCSR;
+    trackingProblem.evaluateValues(x, objectiveInto, equalityInto, inequalityInto);
+    trackingProblem.evaluateObjectiveGradient(x, gradientInto);
+    trackingProblem.evaluateEqualityConstraintsJacobianCSR(x, equalityJacobianCSR);
+    trackingProblem.evaluateObjectiveHessianCSR(x, hessianCSR);
+    sparse_matrix_t equalityJacobianInto, hessianInto;
+    equalityJacobianCSR.toEigenSparseMatrix(equalityJacobianInto, variableNum);
+    hessianCSR.toEigenSparseMatrix(hessianInto, variableNum);
+    CRISP_CHECK_NEAR(objectiveInto, objValue, 1e-12);
+    CRISP_CHECK(test::maxDifference(equalityInto, equalityConstraints) < 1e-12);
+    CRISP_CHECK(test::maxDifference(inequalityInto, inequalityConstraints) < 1e-12);
+    CRISP_CHECK(test::maxDifference(gradientInto, vector_t(objGradient.toDense().row(0).transpose())) < 1e-12);
+    CRISP_CHECK(test::maxDifference(equalityJacobianInto.toDense(), equalityJacobian.toDense()) < 1e-12);
+    CRISP_CHECK(test::maxDifference(hessianInto.toDense(), objHessian.toDense()) < 1e-12);
+
     // print name of constraints and objectives
     std::vector<std::string> eqconstraintNames = trackingProblem.getEqualityParamNames();
     std::vector<std::string> ineqconstraintNames = trackingProblem.getInequalityParamNames();
@@ -138,7 +164,7 @@ int main() {
 
 
 
-    return 0;
+    return CRISP_TEST_RESULT();
 
 }
 
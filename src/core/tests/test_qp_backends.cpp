@@ -0,0 +1,97 @@
+#include "solver_core/StageQPBackend.h"
+#include "test_utils.h"
+#include <limits>
+
+// test: the stage-structured backend solves a small block-banded QP to the primal and dual solution of PIQP, with the
+// stage ordering, with the AMD ordering and warm-started from the previous solution, and after updates of the vectors and
+// of the matrix values
+
+using namespace CRISP;
+
+namespace {
+const scalar_t kTolerance = 1e-5;
+const scalar_t kInf = std::numeric_limits<scalar_t>::infinity();
+
+// three stages of two variables, then two slack-like variables; the equalities couple consecutive stages and
+// the inequalities are partly active at the solution
+SubproblemData stageQP() {
+    SubproblemData qp(8, 2, 3, 6);
+    triplet_vector_t hessian;
+    for (int stage = 0; stage < 3; ++stage) {
+        hessian.emplace_back(2 * stage, 2 * stage, 2.0);
+        hessian.emplace_back(2 * stage, 2 * stage + 1, 0.5); // upper triangle only
+        hessian.emplace_back(2 * stage + 1, 2 * stage + 1, 1.0);
+    }
+    hessian.emplace_back(6, 6, 1.0);
+    hessian.emplace_back(7, 7, 1.0);
+    qp.H = test::fromTriplets(8, 8, hessian);
+    qp.g << -1.0, -2.0, 0.5, -1.0, 1.0, -1.0, 1.0, 0.5;
+    qp.Aeq = test::fromTriplets(2, 8, {{0, 2, 1.0}, {0, 0, -1.0}, {0, 1, -0.1}, {1, 4, 1.0}, {1, 2, -1.0}, {1, 3, -0.1}, {1, 6, 1.0}});
+    qp.beq << 0.2, 0.1;
+    qp.G = test::fromTriplets(3, 8, {{0, 1, 1.0}, {0, 3, 1.0}, {1, 5, -1.0}, {1, 7, -1.0}, {2, 0, 1.0}, {2, 4, 1.0}});
+    qp.h << 0.3, -0.5, 1.0;
+    qp.lb.setConstant(-kInf);
+    qp.ub.setConstant(kInf);
+    qp.lb[1] = -1.0;
+    qp.ub[1] = 1.0;
+    qp.lb[6] = qp.lb[7] = 0.0;
+    qp.x0.setZero();
+    return qp;
+}
+
+void checkAgrees(const QPBackend& backend, const QPBackend& reference) {
+    CRISP_CHECK(test::maxDifference(backend.primal(), reference.primal()) < kTolerance);
+    CRISP_CHECK(test::maxDifference(backend.equalityDuals(), reference.equalityDuals()) < kTolerance);
+    CRISP_CHECK(test::maxDifference(backend.inequalityDuals(), reference.inequalityDuals()) < kTolerance);
+}
+} // namespace
+
+int main() {
+    SubproblemData qp = stageQP();
+    PiqpBackend piqp;
+    piqp.setup(qp);
+    CRISP_CHECK(piqp.solve());
+    // the first inequality is active, its dual is not a trivial zero
+    CRISP_CHECK(piqp.inequalityDuals()[0] > 1e-3);
+
+    StageQPBackend staged(SizeVector(3, 2));
+    staged.setup(qp);
+    CRISP_CHECK(staged.solve());
+    checkAgrees(staged, piqp);
+
+    StageQPBackend unstaged;
+    unstaged.setup(qp);
+    CRISP_CHECK(unstaged.solve());
+    checkAgrees(unstaged, piqp);
+
+    // an update of the values with the previous solution as the start solves the changed QP like a fresh setup
+    qp.clearDirty();
+    qp.g[5] = -2.0;
+    qp.h[0] = 0.1;
+    qp.gDirty = qp.hDirty = true;
+    piqp.update(qp);
+    CRISP_CHECK(piqp.solve());
+    staged.update(qp);
+    staged.warmStart(staged.primal());
+    CRISP_CHECK(staged.solve());
+    checkAgrees(staged, piqp);
+
+    // new matrix values in the structure of the setup are scattered into PIQP's column major copies
+    qp.clearDirty();
+    qp.H.coeffRef(0, 1) = -0.3;
+    qp.H.coeffRef(4, 4) = 3.0;
+    qp.Aeq.coeffRef(1, 3) = 0.4;
+    qp.G.coeffRef(2, 0) = 2.0;
+    qp.G.coeffRef(0, 3) = 0.5;
+    qp.HDirty = qp.AeqDirty = qp.GDirty = true;
+    piqp.update(qp);
+    CRISP_CHECK(piqp.solve());
+    PiqpBackend fresh;
+    fresh.setup(qp);
+    CRISP_CHECK(fresh.solve());
+    checkAgrees(piqp, fresh);
+    staged.update(qp);
+    CRISP_CHECK(staged.solve());
+    checkAgrees(staged, fresh);
+    return CRISP_TEST_RESULT();
+}
@@ -0,0 +1,73 @@
+#include "solver_core/SolverInterface.h"
+#include "test_utils.h"
+
+// test: the quasi-Newton hessian (hessianType = 2) is block diagonal over the stages of setStageStructure and diagonal
+// without them, and solves with either approximation converge to the solution of the exact objective hessian
+
+using namespace CRISP;
+
+namespace {
+const size_t kNumStages = 3;
+const size_t kStageDim = 2;
+const size_t kVariableDim = kNumStages * kStageDim;
+
+// coupled within the stages, the quartic terms change the curvature between the iterates
+ad_function_t stageObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = 0.0;
+    for (size_t k = 0; k < kNumStages; ++k) {
+        const ad_scalar_t position = x(kStageDim * k);
+        const ad_scalar_t velocity = x(kStageDim * k + 1);
+        const scalar_t target = 1.0 + static_cast<scalar_t>(k);
+        y(0) += (position - target) * (position - target) + (velocity + 0.5) * (velocity + 0.5) + 0.5 * position * velocity +
+                0.1 * position * position * position * position;
+    }
+};
+
+// the stages are chained by linear dynamics
+ad_function_t stageDynamics = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(kNumStages - 1);
+    for (size_t k = 0; k + 1 < kNumStages; ++k) {
+        y(k) = x(kStageDim * (k + 1)) - x(kStageDim * k) - 0.5 * x(kStageDim * k + 1);
+    }
+};
+
+// the objective pulls the last velocity below the limit, so it is active at the solution
+ad_function_t velocityLimit = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(kStageDim * (kNumStages - 1) + 1) - 0.2;
+};
+
+vector_t solve(OptimizationProblem& problem, scalar_t hessianType) {
+    SolverParameters params;
+    params.setParameters("hessianType", vector_t::Constant(1, hessianType));
+    params.setParameters("printSolution", vector_t::Constant(1, 0));
+    SolverInterface solver(problem, params);
+    solver.initialize(vector_t::Constant(kVariableDim, 0.5));
+    solver.solve();
+    CRISP_CHECK(solver.getStatus() == SolverStatus::CONVERGED);
+    return solver.getSolution();
+}
+} // namespace
+
+int main() {
+    QuasiNewtonHessian diagonal;
+    diagonal.initialize(kVariableDim, SizeVector(), 2.0);
+    CRISP_CHECK(diagonal.getCSRStructure().nonZeros() == kVariableDim);
+    QuasiNewtonHessian staged;
+    staged.initialize(kVariableDim, SizeVector(kNumStages, kStageDim), 2.0);
+    CRISP_CHECK(staged.getCSRStructure().nonZeros() == kNumStages * kStageDim * kStageDim);
+
+    OptimizationProblem problem(kVariableDim, "QuasiNewtonProblem");
+    problem.addObjective(std::make_shared<ObjectiveFunction>(kVariableDim, "QuasiNewtonProblem", "model", "stageObjective", stageObjective));
+    problem.addEqualityConstraint(std::make_shared<ConstraintFunction>(kVariableDim, "QuasiNewtonProblem", "model", "stageDynamics", stageDynamics));
+    problem.addInequalityConstraint(std::make_shared<ConstraintFunction>(kVariableDim, "QuasiNewtonProblem", "model", "velocityLimit", velocityLimit));
+    const vector_t exact = solve(problem, 0);
+    CRISP_CHECK(std::abs(exact[kVariableDim - 1] - 0.2) < 1e-4); // the limit is active
+    const vector_t diagonalSolution = solve(problem, 2);
+    problem.setStageStructure(SizeVector(kNumStages, kStageDim));
+    const vector_t stagedSolution = solve(problem, 2);
+    CRISP_CHECK(test::maxDifference(diagonalSolution, exact) < 1e-3);
+    CRISP_CHECK(test::maxDifference(stagedSolution, exact) < 1e-3);
+    return CRISP_TEST_RESULT();
+}
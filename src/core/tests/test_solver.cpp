@@ -1,4 +1,5 @@
 #include "solver_core/SolverInterface.h"
+#include "test_utils.h"
 
 using namespace CRISP;
 
@@ -73,6 +74,9 @@ int main() {
     // Extract the solution and print the result
     const auto solution = solver.getSolution();
     std::cout << "Solution: " << solution.transpose() << std::endl;
+    CRISP_CHECK(solution.allFinite());
+    CRISP_CHECK(std::abs(problem.evaluateEqualityConstraints(solution)(0)) < 1e-4);
+    CRISP_CHECK((problem.evaluateInequalityConstraints(solution).array() > -1e-4).all());
 
-    return 0;
+    return CRISP_TEST_RESULT();
 }
\ No newline at end of file
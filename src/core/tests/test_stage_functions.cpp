@@ -0,0 +1,154 @@
+#include "problem_core/StageConstraintFunction.h"
+#include "problem_core/StageObjectiveFunction.h"
+#include "test_utils.h"
+
+// test: stage constraint and objective functions built from a per-stage kernel give the values, the stacked jacobian
+// (CSR structure and values), the summed gradient and the hessians of the equivalent monolithic functions, for
+// overlapping windows (stride < stageDim), with per-stage and shared parameters, serially and on a thread pool
+
+using namespace CRISP;
+
+namespace {
+const size_t kNumStages = 5;
+const size_t kStateDim = 2;
+const size_t kStageDim = 2 * kStateDim; // window (x_k, x_{k+1}), consecutive windows share x_{k+1}
+const size_t kVariableDim = (kNumStages + 1) * kStateDim;
+const scalar_t kTolerance = 1e-10;
+const std::string kModel = "StageFunctionProblem";
+
+// the terms of one stage on the window w = (x_k, x_{k+1}), p is the parameter of the stage
+template <typename Vector, typename Scalar>
+void constraintTerms(const Vector& w, const Scalar& p, Scalar& c0, Scalar& c1) {
+    c0 = w(2) - w(0) - p * w(1) * w(1);
+    c1 = w(3) - w(1) + sin(w(0)) * w(2);
+}
+
+template <typename Vector, typename Scalar>
+Scalar objectiveTerm(const Vector& w, const Scalar& p) {
+    return w(0) * w(0) * w(1) + (w(2) - w(3)) * (w(2) - w(3)) + p * w(0) * w(3);
+}
+
+ad_function_with_param_t constraintKernel = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(2);
+    constraintTerms(x, p(0), y(0), y(1));
+};
+
+ad_function_with_param_t objectiveKernel = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = objectiveTerm(x, p(0));
+};
+
+// the whole horizon in one tape, p holds one parameter per stage or one shared by all stages
+ad_function_with_param_t monolithicConstraint = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(2 * kNumStages);
+    for (size_t k = 0; k < kNumStages; ++k) {
+        const ad_vector_t w = x.segment(k * kStateDim, kStageDim);
+        constraintTerms(w, p(p.size() == 1 ? 0 : k), y(2 * k), y(2 * k + 1));
+    }
+};
+
+ad_function_with_param_t monolithicObjective = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = 0.0;
+    for (size_t k = 0; k < kNumStages; ++k) {
+        const ad_vector_t w = x.segment(k * kStateDim, kStageDim);
+        y(0) += objectiveTerm(w, p(p.size() == 1 ? 0 : k));
+    }
+};
+
+matrix_t dense(const CSRSparseMatrix& structure, const scalar_t* values, size_t cols) {
+    CSRSparseMatrix matrix = structure;
+    matrix.values.assign(values, values + structure.innerIndices.size());
+    return sparse_matrix_t(matrix.map(cols)).toDense();
+}
+
+bool sameStructure(const CSRSparseMatrix& a, const CSRSparseMatrix& b) {
+    return a.outerIndex == b.outerIndex && a.innerIndices == b.innerIndices;
+}
+
+void compareConstraints(StageConstraintFunction& stage, ConstraintFunction& monolithic, const vector_t& x, const vector_t& p) {
+    CRISP_CHECK(stage.getFunDim() == monolithic.getFunDim());
+    CRISP_CHECK(test::maxDifference(stage.getValue(x, p), monolithic.getValue(x, p)) < kTolerance);
+
+    // the stacked jacobian has the row major structure of the monolithic one
+    CRISP_CHECK(sameStructure(stage.getGradientCSRStructure(), monolithic.getGradientCSRStructure()));
+    const CSRSparseMatrix stageJacobian = stage.getGradientCSR(x, p);
+    const CSRSparseMatrix monolithicJacobian = monolithic.getGradientCSR(x, p);
+    CRISP_CHECK(test::maxDifference(Eigen::Map<const vector_t>(stageJacobian.values.data(), stageJacobian.values.size()),
+                                    Eigen::Map<const vector_t>(monolithicJacobian.values.data(), monolithicJacobian.values.size())) < kTolerance);
+    vector_t fusedValue(stage.getFunDim()), fusedJacobian(stage.getNumNonZerosJacobian());
+    stage.getValueAndGradientCSRValues(x, p, fusedValue.data(), fusedJacobian.data());
+    CRISP_CHECK(test::maxDifference(fusedValue, monolithic.getValue(x, p)) < kTolerance);
+    CRISP_CHECK(test::maxDifference(fusedJacobian, Eigen::Map<const vector_t>(monolithicJacobian.values.data(), monolithicJacobian.values.size())) < kTolerance);
+
+    // the weighted hessian sums the overlapping windows
+    vector_t weights(stage.getFunDim());
+    for (Eigen::Index i = 0; i < weights.size(); ++i) {
+        weights[i] = 0.5 + 0.3 * i;
+    }
+    vector_t stageHessian(stage.getNumNonZerosHessian()), monolithicHessian(monolithic.getNumNonZerosHessian());
+    stage.getHessianCSRValues(x, p, weights.data(), stageHessian.data());
+    monolithic.getHessianCSRValues(x, p, weights.data(), monolithicHessian.data());
+    const matrix_t expectedHessian = dense(monolithic.getHessianCSRStructure(), monolithicHessian.data(), kVariableDim);
+    CRISP_CHECK(test::maxDifference(dense(stage.getHessianCSRStructure(), stageHessian.data(), kVariableDim), expectedHessian) < kTolerance);
+    CRISP_CHECK(expectedHessian.cwiseAbs().maxCoeff() > 0.1);
+}
+
+void compareObjectives(StageObjectiveFunction& stage, ObjectiveFunction& monolithic, const vector_t& x, const vector_t& p) {
+    CRISP_CHECK(test::maxDifference(stage.getValue(x, p), monolithic.getValue(x, p)) < kTolerance);
+    const CSRSparseMatrix stageGradient = stage.getGradientCSR(x, p);
+    const CSRSparseMatrix monolithicGradient = monolithic.getGradientCSR(x, p);
+    const matrix_t expectedGradient = dense(monolithicGradient, monolithicGradient.values.data(), kVariableDim);
+    const matrix_t expectedHessian = sparse_matrix_t(monolithic.getHessianCSR(x, p).map(kVariableDim)).toDense();
+    CRISP_CHECK(test::maxDifference(dense(stageGradient, stageGradient.values.data(), kVariableDim), expectedGradient) < kTolerance);
+    CRISP_CHECK(test::maxDifference(matrix_t(sparse_matrix_t(stage.getHessianCSR(x, p).map(kVariableDim)).toDense()), expectedHessian) < kTolerance);
+    CRISP_CHECK(test::maxDifference(matrix_t(stage.getHessian(x, p).toDense()), expectedHessian) < kTolerance);
+
+    scalar_t fusedValue = 0.0;
+    vector_t fusedGradient(stage.getNumNonZerosJacobian()), fusedHessian(stage.getNumNonZerosHessian());
+    stage.getValueAndDerivativesCSRValues(x, p, &fusedValue, fusedGradient.data(), fusedHessian.data());
+    CRISP_CHECK_NEAR(fusedValue, monolithic.getValue(x, p)(0), kTolerance);
+    CRISP_CHECK(test::maxDifference(dense(stage.getGradientCSRStructure(), fusedGradient.data(), kVariableDim), expectedGradient) < kTolerance);
+    CRISP_CHECK(test::maxDifference(dense(stage.getHessianCSRStructure(), fusedHessian.data(), kVariableDim), expectedHessian) < kTolerance);
+}
+} // namespace
+
+int main() {
+    const auto second = CppAdInterface::ModelInfoLevel::SECOND_ORDER;
+    const StageLayout layout(kNumStages, kStageDim, kStateDim);
+    StageConstraintFunction stageConstraint(kVariableDim, layout, 1, kModel, "model", "constraintKernel", constraintKernel, false, second);
+    StageObjectiveFunction stageObjective(kVariableDim, layout, 1, kModel, "model", "objectiveKernel", objectiveKernel, false, second);
+    ConstraintFunction perStageConstraint(kVariableDim, kNumStages, kModel, "model", "perStageConstraint", monolithicConstraint, false, second);
+    ConstraintFunction sharedConstraint(kVariableDim, 1, kModel, "model", "sharedConstraint", monolithicConstraint, false, second);
+    ObjectiveFunction perStageObjective(kVariableDim, kNumStages, kModel, "model", "perStageObjective", monolithicObjective, false, second);
+    ObjectiveFunction sharedObjective(kVariableDim, 1, kModel, "model", "sharedObjective", monolithicObjective, false, second);
+
+    vector_t x(kVariableDim);
+    for (size_t i = 0; i < kVariableDim; ++i) {
+        x[i] = std::sin(1.0 + 0.7 * i);
+    }
+    vector_t perStage(kNumStages);
+    perStage << 0.5, -1.0, 2.0, 0.25, 1.5;
+    const vector_t shared = vector_t::Constant(1, 0.75);
+
+    // serially, then in 3 chunks of 1 or 2 stages (the pool size does not divide the number of stages)
+    auto pool = std::make_shared<ThreadPool>(3);
+    for (const std::shared_ptr<ThreadPool>& threadPool : {std::shared_ptr<ThreadPool>(), pool}) {
+        stageConstraint.setThreadPool(threadPool);
+        stageObjective.setThreadPool(threadPool);
+        compareConstraints(stageConstraint, perStageConstraint, x, perStage);
+        compareConstraints(stageConstraint, sharedConstraint, x, shared);
+        compareObjectives(stageObjective, perStageObjective, x, perStage);
+        compareObjectives(stageObjective, sharedObjective, x, shared);
+    }
+
+    // a parameter vector of neither size is rejected
+    bool rejected = false;
+    try {
+        stageConstraint.getValue(x, vector_t::Zero(2));
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CRISP_CHECK(rejected);
+    return CRISP_TEST_RESULT();
+}
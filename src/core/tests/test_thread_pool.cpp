@@ -0,0 +1,76 @@
+#include "common/ThreadPool.h"
+#include "test_utils.h"
+#include <stdexcept>
+
+// test: the persistent thread pool runs every task exactly once, rethrows task exceptions and runs nested calls serially
+
+using namespace CRISP;
+
+void testEveryTaskRunsOnce(ThreadPool& pool) {
+    const size_t numTasks = 257;
+    std::vector<std::atomic<int>> counts(numTasks);
+    // repeated calls reuse the sleeping workers, a call must not start before the previous one has drained
+    for (int round = 0; round < 200; ++round) {
+        pool.parallelFor(numTasks, [&](size_t i) { counts[i].fetch_add(1); });
+    }
+    bool allOnce = true;
+    for (const auto& count : counts) {
+        allOnce = allOnce && count.load() == 200;
+    }
+    CRISP_CHECK(allOnce);
+}
+
+void testExceptionIsRethrown(ThreadPool& pool) {
+    std::atomic<int> finished{0};
+    bool caught = false;
+    try {
+        pool.parallelFor(64, [&](size_t i) {
+            if (i == 17) {
+                throw std::runtime_error("task 17 failed");
+            }
+            finished.fetch_add(1);
+        });
+    } catch (const std::runtime_error& error) {
+        caught = std::string(error.what()) == "task 17 failed";
+    }
+    CRISP_CHECK(caught);
+    // with workers the remaining tasks still run, a serial pool stops at the throwing task; the pool stays usable
+    CRISP_CHECK(finished.load() == (pool.size() > 1 ? 63 : 17));
+    std::atomic<int> afterwards{0};
+    pool.parallelFor(8, [&](size_t) { afterwards.fetch_add(1); });
+    CRISP_CHECK(afterwards.load() == 8);
+}
+
+void testNestedCallRunsSerially(ThreadPool& pool) {
+    std::vector<std::atomic<int>> counts(8 * 8);
+    std::atomic<bool> nestedOnOtherThread{false};
+    pool.parallelFor(8, [&](size_t i) {
+        const std::thread::id outerThread = std::this_thread::get_id();
+        pool.parallelFor(8, [&](size_t j) {
+            if (std::this_thread::get_id() != outerThread) {
+                nestedOnOtherThread = true;
+            }
+            counts[i * 8 + j].fetch_add(1);
+        });
+    });
+    bool allOnce = true;
+    for (const auto& count : counts) {
+        allOnce = allOnce && count.load() == 1;
+    }
+    CRISP_CHECK(allOnce);
+    CRISP_CHECK(!nestedOnOtherThread.load());
+}
+
+int main() {
+    ThreadPool serialPool(1);
+    CRISP_CHECK(serialPool.size() == 1);
+    testEveryTaskRunsOnce(serialPool);
+    testExceptionIsRethrown(serialPool);
+
+    ThreadPool pool(4);
+    CRISP_CHECK(pool.size() == 4);
+    testEveryTaskRunsOnce(pool);
+    testExceptionIsRethrown(pool);
+    testNestedCallRunsSerially(pool);
+    return CRISP_TEST_RESULT();
+}
@@ -0,0 +1,97 @@
+#include "solver_core/SolverInterface.h"
+#include "test_utils.h"
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+
+// test: the iteration trace of two solves through a ring buffer much smaller than the number of iterations (the writer
+// wraps around the ring many times) is a valid NPY file with one record per iteration, in order, with the header shape
+// rewritten to the record count and the iterates and steps of the solves
+
+using namespace CRISP;
+
+namespace {
+const std::string kTraceFile = "test_trace_recorder.npy";
+const size_t kCapacity = 4;
+const size_t kVariableDim = 2;
+
+// the small maximal trust region makes the solver walk towards the minimum in many short steps
+ad_function_t traceObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = (x(0) - 5.0) * (x(0) - 5.0) + (x(1) - 5.0) * (x(1) - 5.0);
+};
+
+ad_function_t traceInequalityConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = 20.0 - x(0) - x(1);
+};
+
+size_t solveOnce(SolverInterface& solver, vector_t& solution) {
+    solver.initialize(vector_t::Zero(kVariableDim));
+    solver.solve();
+    CRISP_CHECK(solver.getStatus() == SolverStatus::CONVERGED);
+    solution = solver.getIterate();
+    return solver.getStats().iterations;
+}
+} // namespace
+
+int main() {
+    boost::filesystem::remove(kTraceFile);
+    OptimizationProblem problem(kVariableDim, "TraceProblem");
+    problem.addObjective(std::make_shared<ObjectiveFunction>(kVariableDim, "TraceProblem", "model", "traceObjective", traceObjective));
+    problem.addInequalityConstraint(std::make_shared<ConstraintFunction>(kVariableDim, "TraceProblem", "model", "traceInequalityConstraint", traceInequalityConstraint));
+    SolverParameters params;
+    params.setParameters("trustRegionInitRadius", vector_t::Constant(1, 0.1));
+    params.setParameters("trustRegionMaxRadius", vector_t::Constant(1, 0.1));
+    params.setParameters("printSolution", vector_t::Constant(1, 0));
+    SolverInterface solver(problem, params);
+    solver.setTraceFile(kTraceFile, kCapacity);
+    vector_t solutions[2];
+    const size_t iterations[2] = {solveOnce(solver, solutions[0]), solveOnce(solver, solutions[1])};
+    CRISP_CHECK(iterations[0] > 10 * kCapacity);
+    solver.closeTrace(); // writes the pending records
+    const size_t numRecords = iterations[0] + iterations[1];
+
+    std::ifstream file(kTraceFile, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CRISP_CHECK(bytes.size() > 10 && std::memcmp(bytes.data(), "\x93NUMPY\x01\x00", 8) == 0);
+    if (bytes.size() <= 10) {
+        return CRISP_TEST_RESULT();
+    }
+    const size_t headerLength = static_cast<unsigned char>(bytes[8]) | (static_cast<unsigned char>(bytes[9]) << 8);
+    const size_t dataOffset = 10 + headerLength;
+    CRISP_CHECK(dataOffset % 64 == 0);
+    const std::string header(bytes.data() + 10, headerLength);
+    CRISP_CHECK(header.find("'shape': (" + std::to_string(numRecords) + ",)") != std::string::npos);
+    CRISP_CHECK(header.find("('x', '<f8', (2,)), ('step', '<f8', (2,))") != std::string::npos);
+    CRISP_CHECK(header.back() == '\n');
+    const size_t recordSize = TraceRecorder::NUM_FIELDS + 2 * kVariableDim;
+    CRISP_CHECK(bytes.size() == dataOffset + numRecords * recordSize * sizeof(scalar_t));
+    if (bytes.size() != dataOffset + numRecords * recordSize * sizeof(scalar_t)) {
+        return CRISP_TEST_RESULT();
+    }
+    std::vector<scalar_t> records(numRecords * recordSize);
+    std::memcpy(records.data(), bytes.data() + dataOffset, records.size() * sizeof(scalar_t));
+
+    size_t index = 0;
+    for (size_t solve = 0; solve < 2; ++solve) {
+        vector_t previous = vector_t::Zero(kVariableDim);
+        for (size_t k = 0; k < iterations[solve]; ++k, ++index) {
+            const scalar_t* record = records.data() + index * recordSize;
+            const Eigen::Map<const vector_t> x(record + TraceRecorder::NUM_FIELDS, kVariableDim);
+            const Eigen::Map<const vector_t> step(record + TraceRecorder::NUM_FIELDS + kVariableDim, kVariableDim);
+            CRISP_CHECK(record[TraceRecorder::SOLVE] == solve);
+            CRISP_CHECK(record[TraceRecorder::ITERATION] == k);
+            CRISP_CHECK(record[TraceRecorder::TRUST_REGION_RADIUS] <= 0.1 + 1e-12);
+            CRISP_CHECK_NEAR(record[TraceRecorder::STEP_NORM], step.lpNorm<Eigen::Infinity>(), 1e-12);
+            // an accepted step moves the iterate, a rejected one keeps it
+            const bool accepted = record[TraceRecorder::ACCEPTED] == 1.0;
+            CRISP_CHECK(test::maxDifference(x, accepted ? vector_t(previous + step) : previous) < 1e-12);
+            CRISP_CHECK_NEAR(record[TraceRecorder::OBJECTIVE], (x.array() - 5.0).square().sum(), 1e-9);
+            previous = x;
+        }
+        CRISP_CHECK(test::maxDifference(previous, solutions[solve]) < 1e-12);
+    }
+    boost::filesystem::remove(kTraceFile);
+    return CRISP_TEST_RESULT();
+}
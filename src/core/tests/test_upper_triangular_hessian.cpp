@@ -0,0 +1,101 @@
+#include "solver_core/SolverInterface.h"
+#include "test_utils.h"
+
+// test: functions generated with CodeGenSettings::upperTriangularHessian give the full symmetric hessian through the
+// matrix APIs, the upper triangle of the full hessian through the CSR path, the same quadratic model, and the solver
+// takes the same steps (objective and lagrangian hessian) as with the full hessians
+
+using namespace CRISP;
+
+namespace {
+const scalar_t kTolerance = 1e-8;
+
+// every hessian has entries off the diagonal
+ad_function_t coupledObjective = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = (x(0) - 1.0) * (x(0) - 1.0) + (x(1) - 2.0) * (x(1) - 2.0) + x(2) * x(2) + 0.5 * x(0) * x(1) + x(1) * x(2) * x(2);
+};
+
+ad_function_t coupledEqualityConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = x(0) * x(0) + x(1) + x(0) * x(2) - 2.0;
+};
+
+ad_function_t coupledInequalityConstraint = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize(1);
+    y(0) = 3.0 - x(0) * x(1);
+};
+
+void buildProblem(OptimizationProblem& problem, const std::string& name, bool upperTriangular) {
+    const CppAdInterface::CodeGenSettings defaults = CppAdInterface::getCodeGenSettings();
+    CppAdInterface::CodeGenSettings settings = defaults;
+    settings.upperTriangularHessian = upperTriangular;
+    CppAdInterface::setCodeGenSettings(settings);
+    const auto second = CppAdInterface::ModelInfoLevel::SECOND_ORDER;
+    problem.addObjective(std::make_shared<ObjectiveFunction>(3, name, "model", "coupledObjective", coupledObjective));
+    problem.addEqualityConstraint(std::make_shared<ConstraintFunction>(3, name, "model", "coupledEqualityConstraint", coupledEqualityConstraint, false, second));
+    problem.addInequalityConstraint(std::make_shared<ConstraintFunction>(3, name, "model", "coupledInequalityConstraint", coupledInequalityConstraint, false, second));
+    CppAdInterface::setCodeGenSettings(defaults);
+}
+
+void testEvaluation(const OptimizationProblem& upper, const OptimizationProblem& full) {
+    CRISP_CHECK(upper.isObjectiveHessianUpperTriangular());
+    CRISP_CHECK(!full.isObjectiveHessianUpperTriangular());
+    vector_t x(3);
+    x << 0.3, -1.2, 2.0;
+    const matrix_t fullHessian = full.evaluateObjectiveHessian(x).toDense();
+    const matrix_t upperHessian = upper.evaluateObjectiveHessian(x).toDense();
+    CRISP_CHECK(test::maxDifference(upperHessian, fullHessian) < kTolerance);
+    CRISP_CHECK(test::maxDifference(upperHessian, matrix_t(upperHessian.transpose())) < kTolerance);
+    CRISP_CHECK(std::abs(fullHessian(0, 1)) > 0.1 && std::abs(fullHessian(1, 2)) > 0.1);
+    sparse_matrix_t tripletHessian(3, 3);
+    triplet_vector_t triplets = upper.evaluateObjectiveHessianTriplet(x);
+    tripletHessian.setFromTriplets(triplets.begin(), triplets.end());
+    CRISP_CHECK(test::maxDifference(matrix_t(tripletHessian.toDense()), fullHessian) < kTolerance);
+
+    // the CSR path keeps the triangle, the quadratic model reads it as the symmetric matrix
+    CSRSparseMatrix upperCSR = upper.evaluateObjectiveHessianCSR(x);
+    CSRSparseMatrix fullCSR = full.evaluateObjectiveHessianCSR(x);
+    CRISP_CHECK(upperCSR.nonZeros() < fullCSR.nonZeros());
+    const matrix_t upperTriangle = fullHessian.triangularView<Eigen::Upper>();
+    CRISP_CHECK(test::maxDifference(matrix_t(sparse_matrix_t(upperCSR.map(3)).toDense()), upperTriangle) < kTolerance);
+    vector_t p(3);
+    p << 0.7, -0.4, 1.3;
+    const vector_t upperStep = upperCSR.map(3).selfadjointView<Eigen::Upper>() * p;
+    const vector_t fullStep = fullCSR.map(3) * p;
+    CRISP_CHECK(test::maxDifference(upperStep, fullStep) < kTolerance);
+    CRISP_CHECK_NEAR(0.5 * p.dot(upperStep), 0.5 * p.dot(fullHessian * p), kTolerance);
+}
+
+// the first iterate is the step of the first QP, the solve then follows the same path
+void testSolve(OptimizationProblem& upper, OptimizationProblem& full, scalar_t hessianType) {
+    for (scalar_t maxIterations : {1.0, 200.0}) {
+        std::vector<vector_t> solutions;
+        std::vector<size_t> iterations;
+        for (OptimizationProblem* problem : {&upper, &full}) {
+            SolverParameters params;
+            params.setParameters("hessianType", vector_t::Constant(1, hessianType));
+            params.setParameters("maxIterations", vector_t::Constant(1, maxIterations));
+            params.setParameters("printSolution", vector_t::Constant(1, 0));
+            SolverInterface solver(*problem, params);
+            solver.initialize(vector_t::Constant(3, 1.5));
+            solver.solve();
+            solutions.push_back(solver.getSolution());
+            iterations.push_back(solver.getNumIterations());
+        }
+        CRISP_CHECK(iterations[0] == iterations[1]);
+        CRISP_CHECK(test::maxDifference(solutions[0], solutions[1]) < 1e-6);
+    }
+}
+} // namespace
+
+int main() {
+    OptimizationProblem upper(3, "UpperHessianProblem");
+    OptimizationProblem full(3, "FullHessianProblem");
+    buildProblem(upper, "UpperHessianProblem", true);
+    buildProblem(full, "FullHessianProblem", false);
+    testEvaluation(upper, full);
+    testSolve(upper, full, 0);
+    testSolve(upper, full, 1);
+    return CRISP_TEST_RESULT();
+}
@@ -0,0 +1,68 @@
+#ifndef CRISP_TEST_UTILS_H
+#define CRISP_TEST_UTILS_H
+
+#include "common/BasicTypes.h"
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <string>
+
+// Minimal check helpers for the core tests: every failed check is printed and counted, and
+// main returns CRISP_TEST_RESULT() so ctest sees a non-zero exit code on any failure.
+namespace CRISP {
+namespace test {
+
+inline int& failureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void check(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+        ++failureCount();
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+}
+
+inline void checkNear(scalar_t a, scalar_t b, scalar_t tol, const char* expression, const char* file, int line) {
+    if (!(std::abs(a - b) <= tol)) {
+        ++failureCount();
+        std::cerr << file << ":" << line << ": check failed: " << expression << " (" << a << " vs " << b
+                  << ", tol " << tol << ")" << std::endl;
+    }
+}
+
+// max-norm distance of two dense matrices (vectors included), infinity on a size mismatch
+template <typename A, typename B>
+scalar_t maxDifference(const A& a, const B& b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) return std::numeric_limits<scalar_t>::infinity();
+    if (a.size() == 0) return 0.0;
+    return (a - b).cwiseAbs().maxCoeff();
+}
+
+// sparse matrix of the given size from triplets, duplicate entries are summed
+inline sparse_matrix_t fromTriplets(Eigen::Index rows, Eigen::Index cols, const triplet_vector_t& triplets) {
+    sparse_matrix_t matrix(rows, cols);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    return matrix;
+}
+
+} // namespace test
+
+inline void printSparseMatrix(const sparse_matrix_t& matrix) {
+    std::cout << matrix.toDense() << std::endl;
+}
+
+inline void printTripletVector(const triplet_vector_t& triplets) {
+    for (const auto& triplet : triplets) {
+        std::cout << "(" << triplet.row() << ", " << triplet.col() << ") = " << triplet.value() << std::endl;
+    }
+}
+
+} // namespace CRISP
+
+#define CRISP_CHECK(condition) ::CRISP::test::check((condition), #condition, __FILE__, __LINE__)
+#define CRISP_CHECK_NEAR(a, b, tol) ::CRISP::test::checkNear((a), (b), (tol), #a " ~ " #b, __FILE__, __LINE__)
+#define CRISP_TEST_RESULT() (::CRISP::test::failureCount() == 0 ? 0 : 1)
+
+#endif // CRISP_TEST_UTILS_H
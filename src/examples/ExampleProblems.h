@@ -0,0 +1,49 @@
+// NOTE: the shipped examples behind one interface, for the drivers that run all of them (crisp_bench, crisp_sweep).
+// CRISP_EXAMPLES_DIR must point to this folder, some examples read their initial guess from it.
+#ifndef EXAMPLE_PROBLEMS_H
+#define EXAMPLE_PROBLEMS_H
+#include "pushbot/cpp/PushbotProblem.h"
+#include "pushbox/PushboxProblem.h"
+#include "2dHopper/cpp/HopperProblem.h"
+#include "Transp/cpp/TranspProblem.h"
+#include "waiter/cpp/WaiterProblem.h"
+#include "pushT/PushTProblem.h"
+#include <functional>
+
+namespace CRISP {
+struct ExampleProblem {
+    std::string name;
+    std::function<OptimizationProblem(const std::string&, bool)> create; // (folderName, regenerateLibrary)
+    std::function<void(SolverInterface&, const vector_t&)> setup;         // hyperparameters and problem parameters, given the initial guess
+    std::function<vector_t()> initialGuess;
+};
+
+inline const std::vector<ExampleProblem>& exampleProblems() {
+    static const std::vector<ExampleProblem> problems = {
+        {"pushbot", pushbot::createProblem, pushbot::setupSolver,
+            [] { return pushbot::initialGuess(CRISP_EXAMPLES_DIR); }},
+        {"pushbox", pushbox::createProblem, [](SolverInterface& solver, const vector_t&) { pushbox::setupSolver(solver); },
+            pushbox::initialGuess},
+        {"hopper", hopper::createProblem, [](SolverInterface& solver, const vector_t&) { hopper::setupSolver(solver); },
+            [] { return hopper::initialGuess(CRISP_EXAMPLES_DIR); }},
+        {"cartTransp", cartTransp::createProblem, [](SolverInterface& solver, const vector_t&) { cartTransp::setupSolver(solver); },
+            cartTransp::initialGuess},
+        {"waiter", waiter::createProblem, [](SolverInterface& solver, const vector_t&) { waiter::setupSolver(solver); },
+            waiter::initialGuess},
+        {"pushT", pushT::createProblem, [](SolverInterface& solver, const vector_t&) { pushT::setupSolver(solver); },
+            pushT::initialGuess},
+    };
+    return problems;
+}
+
+inline const ExampleProblem& findExampleProblem(const std::string& name) {
+    for (const auto& problem : exampleProblems()) {
+        if (problem.name == name) {
+            return problem;
+        }
+    }
+    throw std::runtime_error("Unknown example problem " + name + ".");
+}
+} // namespace CRISP
+
+#endif // EXAMPLE_PROBLEMS_H
@@ -0,0 +1,212 @@
+#ifndef PUSHBOX_PROBLEM_H
+#define PUSHBOX_PROBLEM_H
+#include "solver_core/SolverInterface.h"
+// #include "common/MatlabHelper.h"
+#include <chrono>
+#include "math.h"
+
+namespace pushbox {
+using namespace CRISP;
+
+// Define model model parameters for pushbox
+const scalar_t a = 0.5;
+const scalar_t b = 0.25;
+const scalar_t m = 1;
+const scalar_t mu = 0.5;
+const scalar_t g = 9.8;
+const scalar_t r = sqrt(a * a + b * b);
+const scalar_t c = 0.4;
+const scalar_t dt = 0.02;
+const size_t N = 100; // number of time steps
+const size_t num_state = 3;
+const size_t num_control = 6;
+
+// define the dynamics constraints
+ad_function_t pushboxDynamicConstraints = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize((N - 1) * num_state);
+    for (size_t i = 0; i < N - 1; ++i) {
+        size_t idx = i * (num_state + num_control);
+        // Extract state and control for current and next time steps
+        ad_scalar_t px_i = x[idx + 0];
+        ad_scalar_t py_i = x[idx + 1];
+        ad_scalar_t theta_i = x[idx + 2];
+        ad_scalar_t cx_i = x[idx + 3];
+        ad_scalar_t cy_i = x[idx + 4];
+        ad_scalar_t lambda1_i = x[idx + 5];
+        ad_scalar_t lambda2_i = x[idx + 6];
+        ad_scalar_t lambda3_i = x[idx + 7];
+        ad_scalar_t lambda4_i = x[idx + 8];
+
+        ad_scalar_t px_next = x[idx + (num_state + num_control) + 0];
+        ad_scalar_t py_next = x[idx + (num_state + num_control) + 1];
+        ad_scalar_t theta_next = x[idx + (num_state + num_control) + 2];
+
+        ad_scalar_t px_dot = (1/(mu*m*g))*(cos(theta_i)*(lambda2_i + lambda4_i) - sin(theta_i)*(lambda1_i + lambda3_i));
+        ad_scalar_t py_dot = (1/(mu*m*g))*(sin(theta_i)*(lambda2_i + lambda4_i) + cos(theta_i)*(lambda1_i + lambda3_i));
+        ad_scalar_t theta_dot = (1/(mu*m*g*c*r))*(-cy_i*(lambda2_i + lambda4_i) + cx_i*(lambda1_i + lambda3_i));
+
+        // Explicit State Update
+        y.segment(i * num_state, num_state) << px_next - px_i - px_dot * dt,
+                                                py_next - py_i - py_dot * dt,
+                                                theta_next - theta_i - theta_dot * dt;
+    }
+};
+
+// contact implicit constraints for pushbox
+
+ad_function_t pushboxContactConstraints = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize((N - 1) * 12);
+    for (size_t i = 0; i < N - 1; ++i) {
+        size_t idx = i * (num_state + num_control);
+        ad_scalar_t px_i = x[idx + 0];
+        ad_scalar_t py_i = x[idx + 1];
+        ad_scalar_t theta_i = x[idx + 2];
+        ad_scalar_t cx_i = x[idx + 3];
+        ad_scalar_t cy_i = x[idx + 4];
+        ad_scalar_t lambda1_i = x[idx + 5];
+        ad_scalar_t lambda2_i = x[idx + 6];
+        ad_scalar_t lambda3_i = x[idx + 7];
+        ad_scalar_t lambda4_i = x[idx + 8];
+
+        y.segment(i * 12, 12) << lambda1_i,
+                            lambda2_i,
+                            -lambda3_i,
+                            -lambda4_i,
+                            cy_i + b,
+                            cx_i + a,
+                            b - cy_i,
+                            a - cx_i,
+                            -(lambda1_i)*(cy_i+b),
+                            -(lambda2_i)*(cx_i+a),
+                            -(-lambda3_i)*(b-cy_i),
+                            -(-lambda4_i)*(a-cx_i);
+    }
+};
+
+// allow only one contact force at a time
+ad_function_t pushboxContactSingleForceConstraints = [](const ad_vector_t& x, ad_vector_t& y) {
+    y.resize((N - 1) * 6);
+    for (size_t i = 0; i < N - 1; ++i) {
+        size_t idx = i * (num_state + num_control);
+        ad_scalar_t lambda1_i = x[idx + 5];
+        ad_scalar_t lambda2_i = x[idx + 6];
+        ad_scalar_t lambda3_i = x[idx + 7];
+        ad_scalar_t lambda4_i = x[idx + 8];
+
+        y.segment(i * 6, 6) << -(lambda1_i * lambda2_i),
+                            -(lambda1_i * (-lambda3_i)),
+                            -(lambda1_i * (-lambda4_i)),
+                            -(lambda2_i * (-lambda3_i)),
+                            -(lambda2_i * (-lambda4_i)),
+                            -(-lambda3_i * (-lambda4_i));
+    }
+};
+
+// initial constraints
+ad_function_with_param_t pushboxInitialConstraints = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(3);
+    y.segment(0, 3) << x[0] - p[0],
+                    x[1] - p[1],
+                    x[2] - p[2];
+};
+
+// cost function for pushbox
+ad_function_with_param_t pushboxObjective = [](const ad_vector_t& x, const ad_vector_t& p, ad_vector_t& y) {
+    y.resize(1);
+    y[0] = 0.0;
+    ad_scalar_t tracking_cost(0.0);
+    ad_scalar_t control_cost(0.0);
+    for (size_t i = 0; i < N; ++i) {
+        size_t idx = i * (num_state + num_control);
+        ad_scalar_t px_i = x[idx + 0];
+        ad_scalar_t py_i = x[idx + 1];
+        ad_scalar_t theta_i = x[idx + 2];
+        ad_scalar_t cx_i = x[idx + 3];
+        ad_scalar_t cy_i = x[idx + 4];
+        ad_scalar_t lambda1_i = x[idx + 5];
+        ad_scalar_t lambda2_i = x[idx + 6];
+        ad_scalar_t lambda3_i = x[idx + 7];
+        ad_scalar_t lambda4_i = x[idx + 8];
+        ad_matrix_t Q(num_state, num_state);
+        Q.setZero();
+        Q(0, 0) = 100;
+        Q(1, 1) = 100;
+        Q(2, 2) = 100;
+        ad_matrix_t R(4, 4);
+        R.setZero();
+        R(0, 0) = 0.001;
+        R(1, 1) = 0.001;
+        R(2, 2) = 0.001;
+        R(3, 3) = 0.001;
+
+        if (i == N - 1) {
+            ad_vector_t tracking_error(num_state);
+
+            tracking_error << px_i - p[0],
+                            py_i - p[1],
+                            theta_i - p[2];
+            tracking_cost += tracking_error.transpose() * Q * tracking_error;
+
+        }
+
+        if (i < N - 1) {
+            ad_vector_t control_error(4);
+            control_error << lambda1_i,
+                            lambda2_i,
+                            lambda3_i,
+                            lambda4_i;
+            control_cost += control_error.transpose() * R * control_error;
+        }
+    }
+    y[0] = tracking_cost + control_cost;
+};
+
+const size_t variableNum = N * (num_state + num_control);
+const std::string problemName = "Pushbox";
+
+// generate (or load from folderName) the functions and assemble the problem
+inline OptimizationProblem createProblem(const std::string& folderName = "model", bool regenerateLibrary = false) {
+    OptimizationProblem pushboxProblem(variableNum, problemName);
+
+    auto obj = std::make_shared<ObjectiveFunction>(variableNum, num_state, problemName, folderName, "pushboxObjective", pushboxObjective, regenerateLibrary);
+    auto dynamics = std::make_shared<ConstraintFunction>(variableNum, problemName, folderName, "pushboxDynamicConstraints", pushboxDynamicConstraints, regenerateLibrary);
+    auto contact = std::make_shared<ConstraintFunction>(variableNum, problemName, folderName, "pushboxContactConstraints", pushboxContactConstraints, regenerateLibrary);
+    auto initial = std::make_shared<ConstraintFunction>(variableNum, num_state, problemName, folderName, "pushboxInitialConstraints", pushboxInitialConstraints, regenerateLibrary);
+    auto contactSingleForce = std::make_shared<ConstraintFunction>(variableNum, problemName, folderName, "pushboxContactSingleForceConstraints", pushboxContactSingleForceConstraints, regenerateLibrary);
+
+    // ---------------------- ! the above four lines are enough for generate the auto-differentiation functions library for this problem and the usage in python ! ---------------------- //
+
+    pushboxProblem.addObjective(obj);
+    pushboxProblem.addEqualityConstraint(dynamics);
+    pushboxProblem.addEqualityConstraint(initial);
+    pushboxProblem.addInequalityConstraint(contact);
+    pushboxProblem.addInequalityConstraint(contactSingleForce);
+    // the variables are stored stage by stage (states, then controls), used by qpBackend = 1 and hessianType = 2
+    pushboxProblem.setStageStructure(SizeVector(N, num_state + num_control));
+    return pushboxProblem;
+}
+
+// hyperparameters and problem parameters (initial and final states) of the example
+inline void setupSolver(SolverInterface& solver) {
+    vector_t xInitialStates(num_state);
+    vector_t xFinalStates(num_state);
+    // define a theta from 0 to 2pi, and define different final state for the problem with equal interval, for example 20 degree
+    xInitialStates << 0, 0, 0;
+    // solver.setHyperParameters("WeightedMode", vector_t::Constant(1, 1));
+    solver.setProblemParameters("pushboxInitialConstraints", xInitialStates);
+    solver.setHyperParameters("trailTol", vector_t::Constant(1, 1e-3));
+    solver.setHyperParameters("trustRegionTol", vector_t::Constant(1, 1e-3));
+    solver.setHyperParameters("WeightedMode", vector_t::Constant(1, 1));
+    size_t num_segments = 18;
+    scalar_t theta = 12 * 2 * M_PI / num_segments;
+    xFinalStates << 3*cos(theta), 3*sin(theta), theta;
+    solver.setProblemParameters("pushboxObjective", xFinalStates);
+}
+
+// zero initial guess
+inline vector_t initialGuess() {
+    return vector_t::Zero(variableNum);
+}
+} // namespace pushbox
+
+#endif // PUSHBOX_PROBLEM_H
@@ -0,0 +1,404 @@
+// NOTE: parameter sweeps over one of the shipped examples. A job file lists the solves, the jobs are split into chunks of
+// consecutive jobs and the chunks are handed out to worker processes through a work queue directory:
+//   ./crisp_sweep jobs.yaml sweep.npz --workers 8
+// A chunk is claimed by creating its claim file exclusively and finished by renaming its result file into place, so several
+// hosts can share one sweep by running the same command on a shared filesystem with a common --queue directory. Finished
+// chunks are kept, an interrupted sweep continues where it stopped (--reclaim hands out the chunks of crashed workers again).
+// The invocation that finds all chunks finished merges them into one numpy .npz file with a column per result field and the
+// solution matrix (jobs x variables), see kColumns.
+//
+// The problem is created (its library compiled or loaded) once before the workers are forked, every worker keeps one solver
+// for all its jobs. A job without an initial guess is warm-started from the solution of the previous job of its chunk, so
+// neighboring jobs of the file should be neighboring problems. Job file:
+//   problem: pushT                  # name of the example, see ExampleProblems.h
+//   folder: model                   # folder of the model library
+//   chunkSize: 8                    # consecutive jobs solved by one worker
+//   warmStart: true
+//   hyperParameters: {maxIterations: 200, mpcMode: 1}
+//   parameters: {...}               # problem parameters of all jobs
+//   initialGuessFile: guess.txt     # initial guess of the jobs without one (default: the guess of the example)
+//   jobs:
+//     - parameters: {pushTObjective: [0.036, -0.143, -0.877, -0.480]}
+//     - parameters: {pushTObjective: [0.036, -0.100, -0.877, -0.480]}
+//       initialGuess: [...]         # or initialGuessFile, whitespace separated values
+// Relative file names are relative to the folder of the job file, pushT_goals.yaml is an example.
+#include "ExampleProblems.h"
+#include "NpzWriter.h"
+#include <boost/filesystem.hpp>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using namespace CRISP;
+namespace fs = boost::filesystem;
+
+namespace {
+const scalar_t kJobFailed = -1; // status of a job that threw
+
+// the result fields of a job, stored in this order in the chunk files and as columns of the output
+struct Column {
+    const char* name;
+    bool integer;
+};
+const std::vector<Column> kColumns = {
+    {"job", true}, {"worker", true}, {"status", true}, {"warm_started", true}, {"iterations", true},
+    {"objective", false}, {"max_equality_violation", false}, {"max_inequality_violation", false},
+    {"solve_time", false}, {"qp_time", false}, {"evaluation_time", false}, {"derivative_time", false},
+    {"subproblem_time", false}, {"merit_time", false}, {"soc_time", false},
+    {"accepted_steps", true}, {"rejected_steps", true}, {"second_order_corrections", true},
+    {"penalty_increases", true}, {"qp_iterations", true},
+};
+
+struct SweepJob {
+    std::unordered_map<std::string, vector_t> problemParameters;
+    vector_t initialGuess; // empty: warm start or the default guess
+};
+
+struct Sweep {
+    std::string problem;
+    std::string folder = "model";
+    size_t chunkSize = 8;
+    bool warmStart = true;
+    std::vector<std::pair<std::string, vector_t>> hyperParameters;
+    std::unordered_map<std::string, vector_t> problemParameters;
+    vector_t initialGuess;
+    std::vector<SweepJob> jobs;
+
+    size_t numChunks() const {
+        return (jobs.size() + chunkSize - 1) / chunkSize;
+    }
+};
+
+vector_t readVector(const YAML::Node& node) {
+    if (node.IsScalar()) {
+        return vector_t::Constant(1, node.as<scalar_t>());
+    }
+    std::vector<scalar_t> values = node.as<std::vector<scalar_t>>();
+    return Eigen::Map<vector_t>(values.data(), values.size());
+}
+
+vector_t readVectorFile(const fs::path& fileName) {
+    std::ifstream file(fileName.string());
+    if (!file) {
+        throw std::runtime_error("Failed to open " + fileName.string() + ".");
+    }
+    std::vector<scalar_t> values;
+    scalar_t value;
+    while (file >> value) {
+        values.push_back(value);
+    }
+    return Eigen::Map<vector_t>(values.data(), values.size());
+}
+
+std::unordered_map<std::string, vector_t> readParameters(const YAML::Node& node) {
+    std::unordered_map<std::string, vector_t> parameters;
+    for (const auto& it : node) {
+        parameters[it.first.as<std::string>()] = readVector(it.second);
+    }
+    return parameters;
+}
+
+vector_t readInitialGuess(const YAML::Node& node, const fs::path& folder) {
+    if (node["initialGuess"]) {
+        return readVector(node["initialGuess"]);
+    }
+    if (node["initialGuessFile"]) {
+        fs::path fileName(node["initialGuessFile"].as<std::string>());
+        return readVectorFile(fileName.is_absolute() ? fileName : folder / fileName);
+    }
+    return vector_t();
+}
+
+Sweep readSweep(const std::string& fileName) {
+    YAML::Node config = YAML::LoadFile(fileName);
+    fs::path folder = fs::absolute(fileName).parent_path();
+    Sweep sweep;
+    sweep.problem = config["problem"].as<std::string>();
+    if (config["folder"]) {
+        sweep.folder = config["folder"].as<std::string>();
+    }
+    if (config["chunkSize"]) {
+        sweep.chunkSize = std::max<size_t>(config["chunkSize"].as<size_t>(), 1);
+    }
+    if (config["warmStart"]) {
+        sweep.warmStart = config["warmStart"].as<bool>();
+    }
+    for (const auto& it : config["hyperParameters"]) {
+        sweep.hyperParameters.emplace_back(it.first.as<std::string>(), readVector(it.second));
+    }
+    sweep.problemParameters = readParameters(config["parameters"]);
+    sweep.initialGuess = readInitialGuess(config, folder);
+    for (const auto& node : config["jobs"]) {
+        SweepJob job;
+        job.problemParameters = readParameters(node["parameters"]);
+        job.initialGuess = readInitialGuess(node, folder);
+        sweep.jobs.push_back(std::move(job));
+    }
+    if (sweep.jobs.empty()) {
+        throw std::runtime_error("The job file " + fileName + " has no jobs.");
+    }
+    return sweep;
+}
+
+fs::path chunkFile(const fs::path& queue, size_t chunk, const std::string& extension) {
+    return queue / ("chunk_" + std::to_string(chunk) + extension);
+}
+
+// exclusive creation is atomic, also on NFS (v3 and later), only one worker of all hosts gets the chunk
+bool claimChunk(const fs::path& queue, size_t chunk) {
+    int fd = ::open(chunkFile(queue, chunk, ".claim").c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    char host[256] = {};
+    ::gethostname(host, sizeof(host) - 1);
+    std::string owner = std::string(host) + " " + std::to_string(::getpid()) + "\n";
+    ssize_t written = ::write(fd, owner.data(), owner.size());
+    (void)written; // the owner is informative only
+    ::close(fd);
+    return true;
+}
+
+class SweepWorker {
+public:
+    SweepWorker(const Sweep& sweep, const ExampleProblem& example, OptimizationProblem& problem)
+        : sweep_(sweep), problem_(problem), solver_(problem, parameters_) {
+        defaultGuess_ = sweep.initialGuess.size() > 0 ? sweep.initialGuess : example.initialGuess();
+        if (static_cast<size_t>(defaultGuess_.size()) != problem.getVariableDim()) {
+            throw std::runtime_error("The initial guess has " + std::to_string(defaultGuess_.size()) + " values, the problem " +
+                                     std::to_string(problem.getVariableDim()) + " variables.");
+        }
+        example.setup(solver_, defaultGuess_);
+        solver_.setHyperParameters("verbose", vector_t::Constant(1, 0));
+        solver_.setHyperParameters("printSolution", vector_t::Constant(1, 0));
+        for (const auto& it : sweep.hyperParameters) {
+            solver_.setHyperParameters(it.first, it.second);
+        }
+        for (const auto& it : sweep.problemParameters) {
+            solver_.setProblemParameters(it.first, it.second);
+        }
+        baseParameters_ = problem.getParametersMap();
+    }
+
+    // claims and solves chunks until none is left
+    void run(const fs::path& queue) {
+        for (size_t chunk = 0; chunk < sweep_.numChunks(); ++chunk) {
+            if (fs::exists(chunkFile(queue, chunk, ".bin")) || !claimChunk(queue, chunk)) {
+                continue;
+            }
+            std::vector<scalar_t> records = solveChunk(chunk);
+            // write next to the result and rename, a result file is always complete
+            fs::path temporary = chunkFile(queue, chunk, ".bin." + std::to_string(::getpid()));
+            {
+                std::ofstream file(temporary.string(), std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(scalar_t));
+                if (!file) {
+                    throw std::runtime_error("Failed to write " + temporary.string() + ".");
+                }
+            }
+            fs::rename(temporary, chunkFile(queue, chunk, ".bin"));
+        }
+    }
+
+private:
+    std::vector<scalar_t> solveChunk(size_t chunk) {
+        size_t first = chunk * sweep_.chunkSize;
+        size_t last = std::min(first + sweep_.chunkSize, sweep_.jobs.size());
+        std::vector<scalar_t> records;
+        records.reserve((last - first) * (kColumns.size() + problem_.getVariableDim()));
+        vector_t solution;
+        bool previousSolved = false;
+        for (size_t job = first; job < last; ++job) {
+            const SweepJob& sweepJob = sweep_.jobs[job];
+            bool warmStarted = sweepJob.initialGuess.size() == 0 && sweep_.warmStart && previousSolved;
+            std::vector<scalar_t> record(kColumns.size(), 0.0);
+            record[0] = job;
+            record[1] = ::getpid();
+            record[3] = warmStarted;
+            try {
+                // restore the parameters of the problem definition first, so a job never sees the overrides of a previous job
+                for (const auto& it : baseParameters_) {
+                    solver_.setProblemParameters(it.first, it.second);
+                }
+                for (const auto& it : sweepJob.problemParameters) {
+                    solver_.setProblemParameters(it.first, it.second);
+                }
+                solver_.initialize(warmStarted ? solution : sweepJob.initialGuess.size() > 0 ? sweepJob.initialGuess : defaultGuess_);
+                solver_.solve();
+                solution = solver_.getIterate();
+                const SolverStats& stats = solver_.getStats();
+                record[2] = static_cast<scalar_t>(solver_.getStatus());
+                record[4] = solver_.getNumIterations();
+                record[5] = solver_.getObjectiveValue();
+                record[6] = solver_.getMaxEqualityViolation();
+                record[7] = solver_.getMaxInequalityViolation();
+                record[8] = solver_.getSolveTime();
+                record[9] = solver_.getQPTime();
+                record[10] = stats.evaluationTime;
+                record[11] = stats.derivativeTime;
+                record[12] = stats.subproblemTime;
+                record[13] = stats.meritTime;
+                record[14] = stats.secondOrderCorrectionTime;
+                record[15] = stats.acceptedSteps;
+                record[16] = stats.rejectedSteps;
+                record[17] = stats.secondOrderCorrections;
+                record[18] = stats.penaltyIncreases;
+                record[19] = stats.qpIterations;
+                previousSolved = true;
+            } catch (const std::exception& e) {
+                std::cerr << "Job " << job << " failed: " << e.what() << std::endl;
+                record[2] = kJobFailed;
+                solution = vector_t::Constant(problem_.getVariableDim(), std::numeric_limits<scalar_t>::quiet_NaN());
+                previousSolved = false;
+            }
+            records.insert(records.end(), record.begin(), record.end());
+            records.insert(records.end(), solution.data(), solution.data() + solution.size());
+        }
+        return records;
+    }
+
+    const Sweep& sweep_;
+    OptimizationProblem& problem_;
+    SolverParameters parameters_;
+    SolverInterface solver_;
+    vector_t defaultGuess_;
+    std::unordered_map<std::string, vector_t> baseParameters_;
+};
+
+// writes the output once all chunks are finished
+void mergeChunks(const Sweep& sweep, size_t variableDim, const fs::path& queue, const std::string& output) {
+    size_t recordSize = kColumns.size() + variableDim;
+    std::vector<scalar_t> records;
+    records.reserve(sweep.jobs.size() * recordSize);
+    size_t finished = 0;
+    for (size_t chunk = 0; chunk < sweep.numChunks(); ++chunk) {
+        fs::path fileName = chunkFile(queue, chunk, ".bin");
+        if (!fs::exists(fileName)) {
+            continue;
+        }
+        size_t numJobs = std::min(sweep.chunkSize, sweep.jobs.size() - chunk * sweep.chunkSize);
+        if (fs::file_size(fileName) != numJobs * recordSize * sizeof(scalar_t)) {
+            throw std::runtime_error("The result " + fileName.string() + " does not belong to this job file.");
+        }
+        std::ifstream file(fileName.string(), std::ios::binary);
+        size_t offset = records.size();
+        records.resize(offset + numJobs * recordSize);
+        file.read(reinterpret_cast<char*>(records.data() + offset), numJobs * recordSize * sizeof(scalar_t));
+        ++finished;
+    }
+    if (finished < sweep.numChunks()) {
+        std::cout << finished << " of " << sweep.numChunks() << " chunks finished, the output is written once all are done." << std::endl;
+        return;
+    }
+    size_t numJobs = sweep.jobs.size();
+    NpzWriter writer;
+    for (size_t c = 0; c < kColumns.size(); ++c) {
+        if (kColumns[c].integer) {
+            std::vector<int64_t> column(numJobs);
+            for (size_t job = 0; job < numJobs; ++job) {
+                column[job] = static_cast<int64_t>(records[job * recordSize + c]);
+            }
+            writer.addColumn(kColumns[c].name, column);
+        } else {
+            std::vector<double> column(numJobs);
+            for (size_t job = 0; job < numJobs; ++job) {
+                column[job] = records[job * recordSize + c];
+            }
+            writer.addColumn(kColumns[c].name, column);
+        }
+    }
+    std::vector<double> solutions(numJobs * variableDim);
+    for (size_t job = 0; job < numJobs; ++job) {
+        std::copy_n(records.begin() + job * recordSize + kColumns.size(), variableDim, solutions.begin() + job * variableDim);
+    }
+    writer.addMatrix("solution", numJobs, variableDim, solutions);
+    // several hosts may merge at the same time, each renames a complete file
+    std::string temporary = output + "." + std::to_string(::getpid());
+    writer.write(temporary);
+    fs::rename(temporary, output);
+    std::cout << "Wrote " << numJobs << " jobs to " << output << "." << std::endl;
+}
+
+int usage() {
+    std::cerr << "Usage: crisp_sweep <jobs.yaml> <output.npz> [--workers N] [--queue DIR] [--reclaim]" << std::endl;
+    return 2;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        return usage();
+    }
+    std::string jobFile = argv[1];
+    std::string output = argv[2];
+    size_t numWorkers = 1;
+    fs::path queue = output + ".parts";
+    bool reclaim = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--workers" && i + 1 < argc) {
+            numWorkers = std::max(std::stoi(argv[++i]), 1);
+        } else if (option == "--queue" && i + 1 < argc) {
+            queue = argv[++i];
+        } else if (option == "--reclaim") {
+            reclaim = true;
+        } else {
+            return usage();
+        }
+    }
+    try {
+        Sweep sweep = readSweep(jobFile);
+        const ExampleProblem& example = findExampleProblem(sweep.problem);
+        OptimizationProblem problem = example.create(sweep.folder, false);
+        fs::create_directories(queue);
+        if (reclaim) {
+            for (size_t chunk = 0; chunk < sweep.numChunks(); ++chunk) {
+                if (!fs::exists(chunkFile(queue, chunk, ".bin"))) {
+                    fs::remove(chunkFile(queue, chunk, ".claim"));
+                }
+            }
+        }
+        bool failed = false;
+        if (numWorkers == 1) {
+            SweepWorker(sweep, example, problem).run(queue);
+        } else {
+            // the workers share the loaded problem copy-on-write
+            std::cout.flush();
+            std::vector<pid_t> workers;
+            for (size_t i = 0; i < numWorkers; ++i) {
+                pid_t pid = ::fork();
+                if (pid < 0) {
+                    throw std::runtime_error("Failed to start a worker process.");
+                }
+                if (pid == 0) {
+                    int code = 0;
+                    try {
+                        SweepWorker(sweep, example, problem).run(queue);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Worker " << ::getpid() << " failed: " << e.what() << std::endl;
+                        code = 1;
+                    }
+                    std::cout.flush();
+                    ::_exit(code);
+                }
+                workers.push_back(pid);
+            }
+            for (pid_t pid : workers) {
+                int status = 0;
+                ::waitpid(pid, &status, 0);
+                failed = failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            }
+            if (failed) {
+                std::cerr << "Some workers failed, rerun with --reclaim to solve their chunks again." << std::endl;
+            }
+        }
+        mergeChunks(sweep, problem.getVariableDim(), queue, output);
+        return failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
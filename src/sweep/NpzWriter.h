@@ -0,0 +1,152 @@
+// NOTE: minimal writer of numpy .npz archives: an uncompressed zip file with one .npy member per column, read with
+//     data = np.load("sweep.npz"); data["objective"], data["solution"]
+// Only the little endian float64 and int64 arrays of the sweep results are supported.
+#ifndef NPZ_WRITER_H
+#define NPZ_WRITER_H
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace CRISP {
+class NpzWriter {
+public:
+    // a column of rows values
+    void addColumn(const std::string& name, const std::vector<double>& values) {
+        addArray(name, "<f8", std::to_string(values.size()) + ",", values.data(), values.size() * sizeof(double));
+    }
+
+    void addColumn(const std::string& name, const std::vector<int64_t>& values) {
+        addArray(name, "<i8", std::to_string(values.size()) + ",", values.data(), values.size() * sizeof(int64_t));
+    }
+
+    // rows x cols values in row-major order
+    void addMatrix(const std::string& name, size_t rows, size_t cols, const std::vector<double>& values) {
+        if (values.size() != rows * cols) {
+            throw std::runtime_error("The matrix " + name + " has " + std::to_string(values.size()) + " values instead of " + std::to_string(rows * cols) + ".");
+        }
+        addArray(name, "<f8", std::to_string(rows) + ", " + std::to_string(cols), values.data(), values.size() * sizeof(double));
+    }
+
+    void write(const std::string& fileName) const {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + fileName + ".");
+        }
+        std::string directory;
+        uint32_t offset = 0;
+        for (const Member& member : members_) {
+            std::string local;
+            putHeader(local, 0x04034b50, member, 0);
+            local += member.name;
+            file.write(local.data(), local.size());
+            file.write(member.data.data(), member.data.size());
+            putHeader(directory, 0x02014b50, member, offset);
+            directory += member.name;
+            offset = checkedSize(offset + static_cast<uint64_t>(local.size()) + member.data.size());
+        }
+        file.write(directory.data(), directory.size());
+        std::string end;
+        put32(end, 0x06054b50);
+        put16(end, 0);
+        put16(end, 0);
+        put16(end, members_.size());
+        put16(end, members_.size());
+        put32(end, directory.size());
+        put32(end, offset);
+        put16(end, 0);
+        file.write(end.data(), end.size());
+        if (!file) {
+            throw std::runtime_error("Failed to write " + fileName + ".");
+        }
+    }
+
+private:
+    struct Member {
+        std::string name; // <column>.npy
+        std::string data; // the npy file
+        uint32_t crc = 0;
+    };
+
+    void addArray(const std::string& name, const std::string& descr, const std::string& shape, const void* values, size_t bytes) {
+        std::string header = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + shape + "), }";
+        header.append((64 - (10 + header.size() + 1) % 64) % 64, ' ');
+        header += '\n';
+        Member member;
+        member.name = name + ".npy";
+        member.data = std::string("\x93NUMPY\x01\x00", 8);
+        put16(member.data, header.size());
+        member.data += header;
+        member.data.append(static_cast<const char*>(values), bytes);
+        checkedSize(member.data.size());
+        member.crc = crc32(member.data);
+        members_.push_back(std::move(member));
+    }
+
+    // the common part of the local file header and of the central directory entry, stored without compression
+    static void putHeader(std::string& out, uint32_t signature, const Member& member, uint32_t localOffset) {
+        bool central = signature == 0x02014b50;
+        put32(out, signature);
+        if (central) {
+            put16(out, 20); // made by
+        }
+        put16(out, 20);     // needed to extract
+        put16(out, 0);      // flags
+        put16(out, 0);      // stored
+        put16(out, 0);      // time
+        put16(out, 0x21);   // date, 1980-01-01
+        put32(out, member.crc);
+        put32(out, member.data.size());
+        put32(out, member.data.size());
+        put16(out, member.name.size());
+        put16(out, 0);      // extra field
+        if (central) {
+            put16(out, 0);  // comment
+            put16(out, 0);  // disk
+            put16(out, 0);  // internal attributes
+            put32(out, 0);  // external attributes
+            put32(out, localOffset);
+        }
+    }
+
+    static uint32_t checkedSize(uint64_t size) {
+        if (size > 0xffffffffu) {
+            throw std::runtime_error("The npz archive exceeds 4 GB, zip64 is not supported.");
+        }
+        return static_cast<uint32_t>(size);
+    }
+
+    static void put16(std::string& out, size_t value) {
+        out += static_cast<char>(value & 0xff);
+        out += static_cast<char>((value >> 8) & 0xff);
+    }
+
+    static void put32(std::string& out, size_t value) {
+        put16(out, value & 0xffff);
+        put16(out, (value >> 16) & 0xffff);
+    }
+
+    static uint32_t crc32(const std::string& data) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[i] = c;
+            }
+            return entries;
+        }();
+        uint32_t crc = 0xffffffffu;
+        for (unsigned char byte : data) {
+            crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffffu;
+    }
+
+    std::vector<Member> members_;
+};
+} // namespace CRISP
+#endif // NPZ_WRITER_H